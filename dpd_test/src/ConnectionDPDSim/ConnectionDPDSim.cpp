@@ -0,0 +1,293 @@
+/**
+    @file ConnectionDPDSim.cpp
+    @author Lime Microsystems
+    @brief Simulated QSpark DPD board: the ADPD predistorter, a PA model and the
+    feedback capture, for running the DPD loop without hardware.
+*/
+
+#include "ConnectionDPDSim.h"
+#include "kiss_fft.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+using namespace lime;
+
+static const uint32_t ADPD_OFFSET = 2*32;
+static const uint32_t SPI_CTRL = 0x0012 + ADPD_OFFSET;
+static const uint32_t SPI_DATA = 0x0016 + ADPD_OFFSET;
+static const uint32_t BURST_SAMPLES = 0x0040;
+static const uint32_t BURST_CTRL = 0x0041;
+static const uint32_t INTERFACE_CTRL = 0x000A;
+static const uint32_t INTERFACE_CFG = 0x0008;
+
+static const double FULL_SCALE = 8192.0; //!< 14-bit xp, yp and x
+static const size_t WAVEFORM_LENGTH = 1 << 16;
+
+ConnectionDPDSim::ConnectionDPDSim(const std::string &args):
+    opened(true),
+    coeffScale(8192.0*4.0/16.0),
+    paScale(1.0),
+    delay(2),
+    noiseRms(0.0),
+    rng(1),
+    position(0),
+    readBytes(0),
+    bursts(0)
+{
+    double snr = 60.0, rms = 0.25, bw = 0.2, range = 16.0;
+    unsigned seed = 1;
+
+    std::stringstream ss(args);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        const size_t eq = item.find('=');
+        if (eq == std::string::npos) continue;
+        const std::string key = item.substr(0, eq);
+        const double value = atof(item.substr(eq+1).c_str());
+        if (key == "delay") delay = (int)value;
+        else if (key == "snr") snr = value;
+        else if (key == "range") range = value;
+        else if (key == "rms") rms = value;
+        else if (key == "bw") bw = value;
+        else if (key == "seed") seed = (unsigned)value;
+    }
+    if (pa.Configure(args) != 0 || delay < 0 || range <= 0 || rms <= 0 || bw <= 0 || bw > 1)
+    {
+        opened = false;
+        return;
+    }
+    coeffScale = FULL_SCALE*4.0/range;
+    paScale = 1.0/pa.SmallSignalGain();
+    noiseRms = rms*FULL_SCALE/std::sqrt(2.0)/std::pow(10.0, snr/20.0);
+    rng.seed(seed);
+
+    //the gateware starts in bypass
+    for (int i = 0; i < ROWS; ++i)
+        for (int j = 0; j < COLS; ++j)
+            loading[i][j] = active[i][j] = 0;
+    loading[0][0] = active[0][0] = 1.0;
+
+    //band limited complex Gaussian transmit signal, flat over |f| < bw/2
+    std::vector<kiss_fft_cpx> spectrum(WAVEFORM_LENGTH), time(WAVEFORM_LENGTH);
+    const int edge = (int)(bw/2*WAVEFORM_LENGTH);
+    std::normal_distribution<double> gauss(0.0, 1.0);
+    for (size_t k = 0; k < WAVEFORM_LENGTH; ++k)
+    {
+        const int f = (k <= WAVEFORM_LENGTH/2) ? (int)k : (int)k - (int)WAVEFORM_LENGTH;
+        const bool inBand = f > -edge && f < edge;
+        spectrum[k].r = inBand ? (float)gauss(rng) : 0.0f;
+        spectrum[k].i = inBand ? (float)gauss(rng) : 0.0f;
+    }
+    kiss_fft_cfg plan = kiss_fft_alloc(WAVEFORM_LENGTH, 1, 0, 0);
+    kiss_fft(plan, spectrum.data(), time.data());
+    kiss_fft_free(plan);
+
+    double power = 0;
+    for (const auto &t : time) power += t.r*t.r + t.i*t.i;
+    const double scale = rms*FULL_SCALE/std::sqrt(power/WAVEFORM_LENGTH);
+    waveform.resize(WAVEFORM_LENGTH);
+    for (size_t k = 0; k < WAVEFORM_LENGTH; ++k)
+    {
+        //the DAC takes integers
+        double re = std::floor(time[k].r*scale + 0.5);
+        double im = std::floor(time[k].i*scale + 0.5);
+        waveform[k] = std::complex<double>(
+            std::max(-FULL_SCALE, std::min(FULL_SCALE-1, re)),
+            std::max(-FULL_SCALE, std::min(FULL_SCALE-1, im)));
+    }
+}
+
+ConnectionDPDSim::~ConnectionDPDSim(void)
+{
+    return;
+}
+
+bool ConnectionDPDSim::IsOpen(void)
+{
+    return opened;
+}
+
+DeviceInfo ConnectionDPDSim::GetDeviceInfo(void)
+{
+    DeviceInfo info;
+    info.deviceName = "DPD simulator";
+    switch (pa.type)
+    {
+    case PAModel::RAPP: info.expansionName = "Rapp PA"; break;
+    case PAModel::SALEH: info.expansionName = "Saleh PA"; break;
+    case PAModel::MEMORY_POLYNOMIAL: info.expansionName = "Memory polynomial PA"; break;
+    }
+    info.firmwareVersion = "0";
+    info.hardwareVersion = "0";
+    info.protocolVersion = "0";
+    info.boardSerialNumber = 0;
+    return info;
+}
+
+int ConnectionDPDSim::WriteRegisters(const uint32_t *addrs, const uint32_t *data, const size_t size)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    for (size_t i = 0; i < size; ++i)
+        SetRegister(addrs[i], data[i]);
+    return 0;
+}
+
+int ConnectionDPDSim::ReadRegisters(const uint32_t *addrs, uint32_t *data, const size_t size)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    for (size_t i = 0; i < size; ++i)
+    {
+        auto it = registers.find(addrs[i]);
+        data[i] = (it == registers.end()) ? 0 : it->second;
+    }
+    return 0;
+}
+
+void ConnectionDPDSim::SetRegister(const uint32_t addr, const uint32_t value)
+{
+    const uint16_t previous = registers[addr];
+    registers[addr] = value;
+
+    if (addr == SPI_CTRL)
+    {
+        const uint32_t cmd = value & 0xF000;
+        const int i = (value >> 4) & 0xF;
+        const int j = value & 0xF;
+        if ((cmd == 0x3000 || cmd == 0xC000) && i < ROWS && j < COLS)
+        {
+            //16 MSBs in spi_data, the 2 LSBs in bits 9:8 of spi_ctrl
+            const int fixed = (int16_t)registers[SPI_DATA]*4 + ((value >> 8) & 0x3);
+            const double v = fixed/(4.0*coeffScale);
+            if (cmd == 0x3000) loading[i][j].real(v);
+            else loading[i][j].imag(v);
+        }
+        else if (cmd == 0xF000)
+            memcpy(active, loading, sizeof(active));
+    }
+    else if (addr == BURST_CTRL)
+    {
+        const bool start = (value & 0x1) && !(previous & 0x1);
+        if (start && (registers[INTERFACE_CTRL] & 0x1)) MakeBurst();
+    }
+}
+
+void ConnectionDPDSim::Predistort(const std::complex<double> *in, std::complex<double> *out, const size_t len) const
+{
+    for (size_t s = 0; s < len; ++s)
+    {
+        std::complex<double> y = 0;
+        for (int i = 0; i < ROWS; ++i)
+        {
+            const std::complex<double> x = in[(ptrdiff_t)s - i];
+            const double e = std::norm(x)/(FULL_SCALE*FULL_SCALE);
+            std::complex<double> poly = active[i][COLS-1];
+            for (int j = COLS-2; j >= 0; --j)
+                poly = poly*e + active[i][j];
+            y += poly*x;
+        }
+        out[s] = y;
+    }
+}
+
+//! Rounds and limits to a signed field of the given width, 12-bit fields hold the 12 MSBs
+static int Quantize(double v, int bits)
+{
+    int i = (int)std::floor(v + 0.5);
+    if (i > 8191) i = 8191;
+    if (i < -8192) i = -8192;
+    if (bits == 12) i >>= 2;
+    return i;
+}
+
+//! Field f of a little endian packed stream, the layout of the QSpark capture
+static void PutField(unsigned char *buf, int bits, long f, int value)
+{
+    const long bit = f*bits;
+    const int shift = bit & 7;
+    const uint32_t v = ((uint32_t)value & ((1u << bits) - 1)) << shift;
+    for (int n = 0; n < shift + bits; n += 8)
+        buf[(bit >> 3) + n/8] |= (unsigned char)(v >> n);
+}
+
+void ConnectionDPDSim::MakeBurst(void)
+{
+    const long samples = registers[BURST_SAMPLES];
+    int bits = 14;
+    switch (registers[INTERFACE_CFG] & 0x3)
+    {
+    case 0: bits = 16; break;
+    case 2: bits = 12; break;
+    }
+    burst.assign((long)(samples*6*bits/8.0 + 0.5), 0);
+    if (samples <= 0) return;
+
+    //history for the predistorter taps, the PA memory and the feedback delay
+    const size_t pre = (ROWS-1) + PAModel::MEMORY + delay;
+    const size_t total = pre + samples;
+    std::vector<std::complex<double>> xp(total), yp(total), x(total);
+    for (size_t k = 0; k < total; ++k)
+        xp[k] = waveform[(position + WAVEFORM_LENGTH*4 + k - pre) % WAVEFORM_LENGTH];
+
+    Predistort(&xp[ROWS-1], &yp[ROWS-1], total - (ROWS-1));
+    for (size_t k = ROWS-1; k < total; ++k)
+    {
+        //the DAC sees the gateware output
+        yp[k] = std::complex<double>(Quantize(yp[k].real(), 14), Quantize(yp[k].imag(), 14)) / FULL_SCALE;
+    }
+    const size_t first = ROWS-1 + PAModel::MEMORY;
+    pa.Process(&yp[first], &x[first], total - first);
+
+    unsigned char *buf = burst.data();
+    for (long s = 0; s < samples; ++s)
+    {
+        const size_t k = pre + s;
+        const std::complex<double> fb = x[k - delay]*FULL_SCALE*paScale;
+        PutField(buf, bits, 4*s, Quantize(xp[k].real(), bits));
+        PutField(buf, bits, 4*s+1, Quantize(xp[k].imag(), bits));
+        PutField(buf, bits, 4*s+2, Quantize(yp[k].real()*FULL_SCALE, bits));
+        PutField(buf, bits, 4*s+3, Quantize(yp[k].imag()*FULL_SCALE, bits));
+        PutField(buf, bits, 4*samples + 2*s, Quantize(fb.real() + noiseRms*noise(rng), bits));
+        PutField(buf, bits, 4*samples + 2*s+1, Quantize(fb.imag() + noiseRms*noise(rng), bits));
+    }
+    position = (position + samples) % WAVEFORM_LENGTH;
+    ++bursts;
+}
+
+int ConnectionDPDSim::BeginDataReading(char *buffer, long length)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    readBytes = std::min(length, (long)burst.size());
+    if (readBytes > 0) memcpy(buffer, burst.data(), readBytes);
+    burst.clear();
+    return 0;
+}
+
+int ConnectionDPDSim::WaitForReading(int contextHandle, unsigned int timeout_ms)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return readBytes > 0 ? 1 : 0;
+}
+
+int ConnectionDPDSim::FinishDataReading(char *buffer, long &length, int contextHandle)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    length = readBytes;
+    readBytes = 0;
+    return length;
+}
+
+void ConnectionDPDSim::AbortReading(void)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    readBytes = 0;
+}
+
+unsigned long ConnectionDPDSim::Bursts(void) const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return bursts;
+}
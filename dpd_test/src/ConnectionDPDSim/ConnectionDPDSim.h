@@ -0,0 +1,109 @@
+/**
+    @file ConnectionDPDSim.h
+    @author Lime Microsystems
+    @brief Simulated QSpark DPD board: the ADPD predistorter, a PA model and the
+    feedback capture, for running the DPD loop without hardware.
+*/
+
+#pragma once
+#include <ConnectionRegistry.h>
+#include <IConnection.h>
+#include "PAModel.h"
+#include <complex>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace lime{
+
+/** @brief Loopback stand-in for the DPD gateware.
+
+    The transmit signal xp is a band limited complex Gaussian waveform played in a loop.
+    Each burst runs xp through the predistorter with the committed coefficients (yp), yp
+    through the PA model, and returns the feedback x with delay and noise added, in the
+    packed xp, yp, x format DPDTest and DPDUtil capture.
+
+    Registers, the ADPD window sits at offset 64 like DPDTest::SPI_write():
+    - 0x0052 spi_ctrl, 0x0056 spi_data: 0x30ij/0xC0ij strobes load a[i][j]/b[i][j],
+      0xF000 commits the loaded table
+    - 0x0040 samples per burst, 0x0041 bit 0 rising edge starts a burst
+    - 0x000A bit 0 enables the receiver, 0x0008 bits 1:0 sample width
+    Everything else reads back what was written.
+
+    The handle address holds the settings, comma separated key=value pairs. Besides the
+    PAModel keys: delay (feedback delay in samples, 2), snr (dB, 60), range (coefficient
+    range of the host, 16), rms (xp level of full scale, 0.25), bw (xp bandwidth of the
+    sample rate, 0.2), seed (1).
+
+    With the DPDUtil defaults the loop converges on pa=rapp as is, on pa=mp with rms=0.15,
+    and on pa=saleh with rms=0.12 and --m=1. At rms=0.25 the mp and saleh models are driven
+    into compression and the higher order coefficients run out of range.
+*/
+class ConnectionDPDSim : public IConnection
+{
+public:
+    ConnectionDPDSim(const std::string &args);
+
+    ~ConnectionDPDSim(void);
+
+    bool IsOpen(void);
+
+    DeviceInfo GetDeviceInfo(void);
+
+    int WriteRegisters(const uint32_t *addrs, const uint32_t *data, const size_t size);
+
+    int ReadRegisters(const uint32_t *addrs, uint32_t *data, const size_t size);
+
+    int BeginDataReading(char *buffer, long length);
+    int WaitForReading(int contextHandle, unsigned int timeout_ms);
+    int FinishDataReading(char *buffer, long &length, int contextHandle);
+    void AbortReading(void);
+
+    //! Bursts generated since the connection was made
+    unsigned long Bursts(void) const;
+
+private:
+    static const int ROWS = 6; //!< tap slots of the coefficient table
+    static const int COLS = 4; //!< power slots of the coefficient table
+
+    void SetRegister(const uint32_t addr, const uint32_t value);
+    void MakeBurst(void);
+    void Predistort(const std::complex<double> *in, std::complex<double> *out, const size_t len) const;
+
+    bool opened;
+    std::map<uint32_t, uint16_t> registers;
+
+    //! coefficients being loaded and the committed ones, tap i power j
+    std::complex<double> loading[ROWS][COLS];
+    std::complex<double> active[ROWS][COLS];
+    double coeffScale; //!< fixed point value of 1.0
+
+    PAModel pa;
+    double paScale; //!< feedback attenuation, 1/small signal gain
+    int delay;
+    double noiseRms;
+    std::mt19937 rng;
+    std::normal_distribution<double> noise;
+
+    std::vector<std::complex<double>> waveform;
+    size_t position; //!< start of the next burst in waveform
+
+    std::vector<unsigned char> burst; //!< packed burst waiting to be read
+    long readBytes; //!< bytes handed out by the last BeginDataReading()
+    unsigned long bursts;
+    mutable std::mutex lock;
+};
+
+class ConnectionDPDSimEntry : public ConnectionRegistryEntry
+{
+public:
+    ConnectionDPDSimEntry(void);
+
+    std::vector<ConnectionHandle> enumerate(const ConnectionHandle &hint);
+
+    IConnection *make(const ConnectionHandle &handle);
+};
+
+}
@@ -0,0 +1,44 @@
+/**
+    @file ConnectionDPDSimEntry.cpp
+    @author Lime Microsystems
+    @brief Registry entry of the DPD loopback simulator.
+*/
+
+#include "ConnectionDPDSim.h"
+#include <cstdlib>
+
+using namespace lime;
+
+//! make a static-initialized entry in the registry
+void __loadConnectionDPDSimEntry(void) //TODO fixme replace with LoadLibrary/dlopen
+{
+static ConnectionDPDSimEntry DPDSimEntry;
+}
+
+ConnectionDPDSimEntry::ConnectionDPDSimEntry(void):
+    ConnectionRegistryEntry("DPDSim")
+{
+    return;
+}
+
+std::vector<ConnectionHandle> ConnectionDPDSimEntry::enumerate(const ConnectionHandle &hint)
+{
+    //only listed when asked for by module name or through LIME_DPD_SIM=settings,
+    //so a real board is never shadowed by the simulator
+    std::vector<ConnectionHandle> result;
+    const char *env = getenv("LIME_DPD_SIM");
+    if (hint.module != "DPDSim" && env == nullptr)
+        return result;
+
+    ConnectionHandle handle;
+    handle.media = "Simulation";
+    handle.name = "DPD simulator";
+    handle.addr = (hint.module == "DPDSim" || env == nullptr) ? hint.addr : env;
+    result.push_back(handle);
+    return result;
+}
+
+IConnection *ConnectionDPDSimEntry::make(const ConnectionHandle &handle)
+{
+    return new ConnectionDPDSim(handle.addr);
+}
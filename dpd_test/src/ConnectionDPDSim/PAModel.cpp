@@ -0,0 +1,104 @@
+/**
+    @file PAModel.cpp
+    @author Lime Microsystems
+    @brief Behavioral baseband power amplifier models for the DPD loopback simulator.
+*/
+
+#include "PAModel.h"
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+
+using namespace lime;
+
+//! Ding et al., "A robust digital baseband predistorter constructed using memory polynomials", 2004
+static const std::complex<double> dingCoeffs[PAModel::MEMORY + 1][3] = {
+    {{1.0513, 0.0904}, {-0.0542, -0.2900}, {-0.9657, -0.7028}},
+    {{-0.0680, -0.0023}, {0.2234, 0.2317}, {-0.2451, -0.3735}},
+    {{0.0289, -0.0054}, {-0.0621, -0.0932}, {0.1229, 0.1508}},
+};
+
+PAModel::PAModel(void):
+    type(RAPP),
+    gain(1.0),
+    sat(1.0),
+    p(2.0),
+    aa(2.1587),
+    ba(1.1517),
+    ap(4.0033),
+    bp(9.1040)
+{
+    return;
+}
+
+int PAModel::Configure(const std::string &args)
+{
+    std::stringstream ss(args);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        const size_t eq = item.find('=');
+        if (eq == std::string::npos) continue;
+        const std::string key = item.substr(0, eq);
+        const std::string value = item.substr(eq+1);
+        if (key == "pa")
+        {
+            if (value == "rapp") type = RAPP;
+            else if (value == "saleh") type = SALEH;
+            else if (value == "mp") type = MEMORY_POLYNOMIAL;
+            else return -1;
+        }
+        else if (key == "gain") gain = atof(value.c_str());
+        else if (key == "sat") sat = atof(value.c_str());
+        else if (key == "p") p = atof(value.c_str());
+        else if (key == "aa") aa = atof(value.c_str());
+        else if (key == "ba") ba = atof(value.c_str());
+        else if (key == "ap") ap = atof(value.c_str());
+        else if (key == "bp") bp = atof(value.c_str());
+    }
+    if (gain <= 0 || sat <= 0 || p <= 0 || aa <= 0) return -1;
+    return 0;
+}
+
+double PAModel::SmallSignalGain(void) const
+{
+    switch (type)
+    {
+    case SALEH: return gain*aa;
+    case MEMORY_POLYNOMIAL: return gain*std::abs(dingCoeffs[0][0]);
+    default: return gain;
+    }
+}
+
+void PAModel::Process(const std::complex<double> *in, std::complex<double> *out, const size_t len) const
+{
+    for (size_t s = 0; s < len; ++s)
+    {
+        const std::complex<double> x = in[s];
+        const double r = std::abs(x);
+        switch (type)
+        {
+        case RAPP:
+            out[s] = gain*x / std::pow(1.0 + std::pow(gain*r/sat, 2*p), 1.0/(2*p));
+            break;
+        case SALEH:
+        {
+            const double phi = ap*r*r/(1.0 + bp*r*r);
+            out[s] = gain*aa/(1.0 + ba*r*r) * x * std::polar(1.0, phi);
+            break;
+        }
+        case MEMORY_POLYNOMIAL:
+        {
+            std::complex<double> y = 0;
+            for (size_t k = 0; k <= MEMORY; ++k)
+            {
+                const std::complex<double> xk = in[(ptrdiff_t)s - (ptrdiff_t)k];
+                const double e = std::norm(xk);
+                y += xk*(dingCoeffs[k][0] + e*(dingCoeffs[k][1] + e*dingCoeffs[k][2]));
+            }
+            out[s] = gain*y;
+            break;
+        }
+        }
+    }
+}
@@ -0,0 +1,59 @@
+/**
+    @file PAModel.h
+    @author Lime Microsystems
+    @brief Behavioral baseband power amplifier models for the DPD loopback simulator.
+*/
+
+#pragma once
+#include <complex>
+#include <string>
+#include <cstddef>
+
+namespace lime{
+
+/** @brief Baseband PA working on samples normalised to full scale 1.0.
+
+    - RAPP: memoryless AM/AM, out = g*x/(1+(g*|x|/sat)^2p)^(1/2p)
+    - SALEH: memoryless AM/AM and AM/PM,
+      A(r) = aa*r/(1+ba*r^2), phi(r) = ap*r^2/(1+bp*r^2)
+    - MEMORY_POLYNOMIAL: odd orders 1, 3, 5 on the current and two previous samples,
+      the class AB amplifier coefficients of Ding et al. (2004)
+*/
+class PAModel
+{
+public:
+    enum Type
+    {
+        RAPP,
+        SALEH,
+        MEMORY_POLYNOMIAL,
+    };
+
+    //! Previous input samples the models look at
+    static const size_t MEMORY = 2;
+
+    PAModel(void);
+
+    /** @brief Sets the model from comma separated key=value pairs.
+        pa=rapp|saleh|mp, gain, sat, p, aa, ba, ap, bp. Keys it does not know are left
+        for the caller and ignored here.
+        @return 0 on success, -1 on a bad value
+    */
+    int Configure(const std::string &args);
+
+    //! Gain of the model for small inputs, the simulator divides the feedback by it
+    double SmallSignalGain(void) const;
+
+    /** @brief Amplifies len samples.
+        in[-MEMORY, len) must be valid, out[0, len) is written.
+    */
+    void Process(const std::complex<double> *in, std::complex<double> *out, const size_t len) const;
+
+    Type type;
+    double gain; //!< output scale of every model
+    double sat; //!< Rapp saturation level
+    double p; //!< Rapp knee sharpness
+    double aa, ba, ap, bp; //!< Saleh parameters
+};
+
+}
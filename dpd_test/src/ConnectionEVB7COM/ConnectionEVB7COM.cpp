@@ -45,6 +45,7 @@ ConnectionEVB7COM::ConnectionEVB7COM(const char *comName, int baudrate)
 
 ConnectionEVB7COM::~ConnectionEVB7COM(void)
 {
+    StopControlThread();
     this->Close();
 }
 
@@ -301,16 +302,18 @@ int ConnectionEVB7COM::Read(unsigned char *buffer, int length, int timeout_ms)
 #ifndef __unix__
 
         DWORD bytesReceived = 0;
-        if ( !ReadFile(hComm, cRawData, bytesToRead, &bytesReceived, NULL) )
+        if ( !ReadFile(hComm, cRawData, bytesToRead - totalBytesReaded, &bytesReceived, NULL) )
         {
             status = false;
         }
 
         bytesReaded = bytesReceived;
 #else
-        bytesReaded = read(hComm, cRawData, bytesToRead);
+        //never read past this reply, the next one may already be waiting
+        bytesReaded = read(hComm, cRawData, bytesToRead - totalBytesReaded);
         if(bytesReaded <= 0)
         {
+            bytesReaded = 0;
 //            if(bytesReaded < 0)
 //                MessageLog::getInstance()->write("COM PORT: error reading data\n", LOG_ERROR);
 //            if(bytesReaded == 0)
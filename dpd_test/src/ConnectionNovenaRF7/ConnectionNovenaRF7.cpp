@@ -51,6 +51,7 @@ ConnectionNovenaRF7::ConnectionNovenaRF7(void)
 
 ConnectionNovenaRF7::~ConnectionNovenaRF7(void)
 {
+    StopControlThread();
     this->Close();
 }
 
@@ -6,10 +6,12 @@
 #cmakedefine ENABLE_EVB7COM
 #cmakedefine ENABLE_STREAM
 #cmakedefine ENABLE_NOVENARF7
+#cmakedefine ENABLE_DPDSIM
 
 void __loadConnectionEVB7COMEntry(void);
 void __loadConnectionSTREAMEntry(void);
 void __loadConnectionNovenaRF7Entry(void);
+void __loadConnectionDPDSimEntry(void);
 
 void __loadAllConnections(void)
 {
@@ -24,4 +26,8 @@ void __loadAllConnections(void)
     #ifdef ENABLE_NOVENARF7
     __loadConnectionNovenaRF7Entry();
     #endif
+
+    #ifdef ENABLE_DPDSIM
+    __loadConnectionDPDSimEntry();
+    #endif
 }
@@ -210,6 +210,26 @@ int IConnection::ReadStreamStatus(const size_t streamID, const long timeout_ms,
     return -1;
 }
 
+int IConnection::AcquireReadBuffer(const size_t streamID, size_t &handle, const void **buffs, const long timeout_ms, StreamMetadata &metadata)
+{
+    return -1;
+}
+
+void IConnection::ReleaseReadBuffer(const size_t streamID, const size_t handle)
+{
+    return;
+}
+
+int IConnection::AcquireWriteBuffer(const size_t streamID, size_t &handle, void **buffs, const long timeout_ms)
+{
+    return -1;
+}
+
+void IConnection::ReleaseWriteBuffer(const size_t streamID, const size_t handle, const size_t numElems, const StreamMetadata &metadata)
+{
+    return;
+}
+
 /** @brief Sets callback function which gets called each time data is sent or received
 */
 void IConnection::SetDataLogCallback(std::function<void(bool, const unsigned char*, const unsigned int)> callback)
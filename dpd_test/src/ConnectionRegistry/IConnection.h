@@ -128,6 +128,7 @@ struct StreamConfig
         STREAM_12_BIT_IN_16,
         STREAM_12_BIT_COMPRESSED,
         STREAM_COMPLEX_FLOAT32,
+        STREAM_14_BIT_IN_16,
     };
 
     /*!
@@ -145,6 +146,9 @@ struct StreamConfig
      * This is not the format presented to the API caller.
      * Choosing a compressed format can decrease link use
      * at the expense of additional processing on the PC
+     * The link sample width also sets the full scale of
+     * STREAM_COMPLEX_FLOAT32 samples, 2048 for 12 bit, 8192 for 14 bit.
+     * Connections that cannot program the requested width fail SetupStream().
      * Default: STREAM_12_BIT_IN_16
      */
     StreamDataFormat linkFormat;
@@ -395,6 +399,8 @@ public:
 
     /*!
      * Read blocking data from the stream into the specified buffer.
+     * RX streams of a device may be read from different threads,
+     * when they share the received samples each read gets its own part.
      *
      * @param streamID the RX stream index number
      * @param buffs an array of buffers pointers
@@ -407,6 +413,8 @@ public:
 
     /*!
      * Write blocking data into the stream from the specified buffer.
+     * TX streams of a device may be written from different threads,
+     * their packets are queued one at a time.
      *
      * - The metadata timestamp corresponds to the start of the buffer.
      * - The end of burst only applies when all bytes have been written.
@@ -431,6 +439,56 @@ public:
      */
     virtual int ReadStreamStatus(const size_t streamID, const long timeout_ms, StreamMetadata &metadata);
 
+    /*!
+     * Direct buffer access API.
+     * Acquire a buffer of received samples from the stream in place.
+     * The buffers point into driver storage and stay valid until
+     * ReleaseReadBuffer() is called with the same handle.
+     * Only streams in the native STREAM_12_BIT_IN_16 format support
+     * direct access, and ReadStream() must not be mixed with it
+     * on the same stream. Until the buffer is released, reads of
+     * other RX streams sharing the samples wait.
+     *
+     * @param streamID the RX stream index number
+     * @param [out] handle the buffer handle for ReleaseReadBuffer()
+     * @param [out] buffs an array of pointers, one per stream channel
+     * @param timeout_ms the timeout in milliseconds
+     * @param [out] metadata stream metadata of the buffer
+     * @return the number of samples per buffer, 0 for timeout or -1 for error
+     */
+    virtual int AcquireReadBuffer(const size_t streamID, size_t &handle, const void **buffs, const long timeout_ms, StreamMetadata &metadata);
+
+    /*!
+     * Release a buffer acquired with AcquireReadBuffer().
+     * @param streamID the RX stream index number
+     * @param handle the buffer handle from AcquireReadBuffer()
+     */
+    virtual void ReleaseReadBuffer(const size_t streamID, const size_t handle);
+
+    /*!
+     * Acquire a buffer to fill with samples for transmission in place.
+     * The same format and mixing restrictions as AcquireReadBuffer() apply.
+     * Until the buffer is released, writes of other TX streams wait.
+     *
+     * @param streamID the TX stream index number
+     * @param [out] handle the buffer handle for ReleaseWriteBuffer()
+     * @param [out] buffs an array of pointers, one per stream channel
+     * @param timeout_ms the timeout in milliseconds
+     * @return the number of samples per buffer, 0 for timeout or -1 for error
+     */
+    virtual int AcquireWriteBuffer(const size_t streamID, size_t &handle, void **buffs, const long timeout_ms);
+
+    /*!
+     * Release a buffer acquired with AcquireWriteBuffer() for transmission.
+     * The metadata has the same meaning as for WriteStream().
+     *
+     * @param streamID the TX stream index number
+     * @param handle the buffer handle from AcquireWriteBuffer()
+     * @param numElems the number of samples written to each buffer
+     * @param metadata optional stream metadata
+     */
+    virtual void ReleaseWriteBuffer(const size_t streamID, const size_t handle, const size_t numElems, const StreamMetadata &metadata);
+
     /***********************************************************************
      * Programming API
      **********************************************************************/
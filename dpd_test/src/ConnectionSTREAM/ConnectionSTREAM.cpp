@@ -85,6 +85,7 @@ ConnectionSTREAM::ConnectionSTREAM(void *arg, const unsigned index, const int vi
 ConnectionSTREAM::~ConnectionSTREAM()
 {
     mStreamService.reset();
+    StopControlThread();
     Close();
 }
 
@@ -243,8 +244,8 @@ int ConnectionSTREAM::Write(const unsigned char *buffer, const int length, int t
     long len = length;
     if(IsOpen())
     {
-		unsigned char* wbuffer = new unsigned char[length];
-		memcpy(wbuffer, buffer, length);
+		mControlOutBuffer.assign(buffer, buffer + length);
+		unsigned char* wbuffer = mControlOutBuffer.data();
         if(m_hardwareName == HW_DIGIRED || m_hardwareName == HW_STREAMER)
         {
             #ifndef __unix__
@@ -269,7 +270,6 @@ int ConnectionSTREAM::Write(const unsigned char *buffer, const int length, int t
                 len = actual;
             #endif
         }
-		delete wbuffer;
     }
     else
         return 0;
@@ -124,6 +124,10 @@ public:
 	int ReadStream(const size_t streamID, void * const *buffs, const size_t length, const long timeout_ms, StreamMetadata &metadata);
 	int WriteStream(const size_t streamID, const void * const *buffs, const size_t length, const long timeout_ms, const StreamMetadata &metadata);
 	int ReadStreamStatus(const size_t streamID, const long timeout_ms, StreamMetadata &metadata);
+	int AcquireReadBuffer(const size_t streamID, size_t &handle, const void **buffs, const long timeout_ms, StreamMetadata &metadata);
+	void ReleaseReadBuffer(const size_t streamID, const size_t handle);
+	int AcquireWriteBuffer(const size_t streamID, size_t &handle, void **buffs, const long timeout_ms);
+	void ReleaseWriteBuffer(const size_t streamID, const size_t handle, const size_t numElems, const StreamMetadata &metadata);
 
 	//hooks to update FPGA plls when baseband interface data rate is changed
 	void UpdateExternalDataRate(const size_t channel, const double txRate, const double rxRate);
@@ -170,6 +174,7 @@ private:
     std::shared_ptr<USBStreamService> mStreamService;
 
     std::mutex mExtraUsbMutex;
+    std::vector<unsigned char> mControlOutBuffer; //guarded by mExtraUsbMutex
 };
 
 
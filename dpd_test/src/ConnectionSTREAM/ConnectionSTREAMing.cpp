@@ -7,12 +7,15 @@
 #include "ConnectionSTREAM.h"
 #include "StreamerLTE.h"
 #include "fifo.h" //from StreamerLTE
+#include "SampleConvert.h"
 #include <LMS7002M.h>
 #include <iostream>
 #include <thread>
 #include <chrono>
 #include <algorithm>
 #include <complex>
+#include <mutex>
+#include <condition_variable>
 #include <ciso646>
 #include <FPGA_common.h>
 
@@ -34,12 +37,15 @@ struct USBStreamService : StreamerLTE
     ):
         StreamerLTE(dataPort),
         format(format),
+        linkBits(12),
         rxStreamUseCount(1), //always need rx for status reporting
         txStreamUseCount(0),
         mTxThread(nullptr),
         mRxThread(nullptr),
         rxStreamingContinuous(false),
         txTimeEnabled(false),
+        mRxFrameHeld(false),
+        mTxFrameHeld(false),
         mLastRxTimestamp(0),
         mTimestampOffset(0),
         mHwCounterRate(0.0)
@@ -68,7 +74,7 @@ struct USBStreamService : StreamerLTE
         Reg_write(dataPort, 0x0009, interface_ctrl_0009 & ~0x3);
 
         //enable MIMO mode, 12 bit compressed values
-        uint16_t smpl_width = 0x2; // 0-16 bit, 1-14 bit, 2-12 bit
+        uint16_t smpl_width = 0x2; // 0-16 bit, 1-14 bit, 2-12 bit, keep linkBits in step
         if (channelsCount == 2)
         {
             Reg_write(dataPort, 0x0007, 0x0003); //channel enables
@@ -245,7 +251,26 @@ struct USBStreamService : StreamerLTE
         return mTxFIFO;
     }
 
+    /*!
+     * Waits until no frame of AcquireReadBuffer() is out, with mRxReadLock held.
+     * @return false on timeout
+     */
+    bool WaitRxFrameReleased(std::unique_lock<std::mutex> &lock, const long timeout_ms)
+    {
+        return mRxFrameReleased.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this]() { return not mRxFrameHeld; });
+    }
+
+    /*!
+     * Waits until no frame of AcquireWriteBuffer() is out, with mTxWriteLock held.
+     * @return false on timeout
+     */
+    bool WaitTxFrameReleased(std::unique_lock<std::mutex> &lock, const long timeout_ms)
+    {
+        return mTxFrameReleased.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this]() { return not mTxFrameHeld; });
+    }
+
     const StreamDataFormat format;
+    const int linkBits; //!< sample width programmed in register 0x0008
     std::atomic<int> rxStreamUseCount;
     std::atomic<int> txStreamUseCount;
     std::thread *mTxThread;
@@ -254,6 +279,14 @@ struct USBStreamService : StreamerLTE
     //! this lets us restore streaming after calibration
     std::atomic<bool> rxStreamingContinuous;
     std::atomic<bool> txTimeEnabled;
+    //! the rx FIFO has a single consumer, rx streams take it in turns
+    std::mutex mRxReadLock;
+    std::condition_variable mRxFrameReleased;
+    bool mRxFrameHeld; //!< a frame of AcquireReadBuffer() is not released yet
+    //! the tx FIFO has a single producer, tx streams take it in turns
+    std::mutex mTxWriteLock;
+    std::condition_variable mTxFrameReleased;
+    bool mTxFrameHeld; //!< a frame of AcquireWriteBuffer() is not released yet
     std::atomic<uint64_t> mLastRxTimestamp;
     std::atomic<int64_t> mTimestampOffset;
     std::atomic<double> mHwCounterRate;
@@ -264,14 +297,16 @@ struct USBStreamService : StreamerLTE
 
 struct USBStreamServiceChannel
 {
-    USBStreamServiceChannel(bool isTx, const size_t channelsCount, const bool convertFloat):
+    USBStreamServiceChannel(bool isTx, const size_t channelsCount, const bool convertFloat, const int linkBits):
         isTx(isTx),
         channelsCount(channelsCount),
         convertFloat(convertFloat),
+        linkBits(linkBits),
         sampsRemaining(0),
         bufferOffset(0),
         nextTimestamp(0),
-        currentFifoFlags(0)
+        currentFifoFlags(0),
+        directFrame(nullptr)
     {
         for (size_t i = 0; i < channelsCount; i++)
         {
@@ -291,12 +326,14 @@ struct USBStreamServiceChannel
     const bool isTx;
     const size_t channelsCount;
     const bool convertFloat;
+    const int linkBits; //!< full scale of float samples is 2^(linkBits-1)
     std::vector<complex16_t *> FIFOBuffers;
 
     size_t sampsRemaining;
     size_t bufferOffset;
     uint64_t nextTimestamp;
     uint32_t currentFifoFlags;
+    PacketFrame *directFrame; //!< frame held by AcquireWriteBuffer()
 };
 
 /***********************************************************************
@@ -313,6 +350,11 @@ std::string ConnectionSTREAM::SetupStream(size_t &streamID, const StreamConfig &
     else if (config.format == StreamConfig::STREAM_12_BIT_IN_16) convertFloat = false;
     else return "ConnectionSTREAM::setupStream() only complex floats or int16";
 
+    //the float full scale follows the sample width the service programmed
+    const int linkBits = mStreamService->linkBits;
+    if (config.linkFormat == StreamConfig::STREAM_14_BIT_IN_16 and linkBits != 14)
+        return "ConnectionSTREAM::setupStream() the link carries 12 bit samples";
+
     //check channel config
     //provide a default channel 0 if none specified
     std::vector<size_t> channels(config.channels);
@@ -339,7 +381,7 @@ std::string ConnectionSTREAM::SetupStream(size_t &streamID, const StreamConfig &
     if (!config.isTx) mStreamService->rxStreamUseCount++;
     mStreamService->updateThreadState();
 
-    streamID = size_t(new USBStreamServiceChannel(config.isTx, channels.size(), convertFloat));
+    streamID = size_t(new USBStreamServiceChannel(config.isTx, channels.size(), convertFloat, linkBits));
     return ""; //success
 }
 
@@ -382,6 +424,9 @@ int ConnectionSTREAM::ReadStream(const size_t streamID, void * const *buffs, con
     //intermediate buffer can be removed with different fifo implementation
     if (stream->sampsRemaining == 0)
     {
+        std::unique_lock<std::mutex> lock(mStreamService->mRxReadLock);
+        if (not mStreamService->WaitRxFrameReleased(lock, timeout_ms)) return 0; //timeout
+
         stream->bufferOffset = 0;
         //first receive full STREAM_MTU with no timeout
         stream->sampsRemaining = mStreamService->GetRxFIFO()->pop_samples(
@@ -414,12 +459,7 @@ int ConnectionSTREAM::ReadStream(const size_t streamID, void * const *buffs, con
         {
             auto buffIn = stream->FIFOBuffers[i]+stream->bufferOffset;
             auto buffOut = (std::complex<float> *)buffs[i];
-            for (size_t j = 0; j < samplesCount; j++)
-            {
-                buffOut[j] = std::complex<float>(
-                    float(buffIn[j].i)/2048,
-                    float(buffIn[j].q)/2048);
-            }
+            ConvertInt16ToFloat(buffIn, buffOut, samplesCount, stream->linkBits);
         }
     }
     else
@@ -465,11 +505,7 @@ int ConnectionSTREAM::WriteStream(const size_t streamID, const void * const *buf
         {
             auto buffIn = (const std::complex<float> *)buffs[i];
             auto bufOut = stream->FIFOBuffers[i]+stream->bufferOffset;
-            for (size_t j = 0; j < samplesCount; j++)
-            {
-                bufOut[j].i = int16_t(buffIn[j].real()*2048);
-                bufOut[j].q = int16_t(buffIn[j].imag()*2048);
-            }
+            ConvertFloatToInt16(buffIn, bufOut, samplesCount, stream->linkBits);
         }
     }
     else
@@ -513,6 +549,8 @@ int ConnectionSTREAM::WriteStream(const size_t streamID, const void * const *buf
         uint32_t statusFlags = 0;
         if (mStreamService->txTimeEnabled) statusFlags |= STATUS_FLAG_TX_TIME;
         if (actualEob) statusFlags |= STATUS_FLAG_TX_END;
+        std::unique_lock<std::mutex> lock(mStreamService->mTxWriteLock);
+        if (not mStreamService->WaitTxFrameReleased(lock, timeout_ms)) return 0; //timeout
         size_t sampsPushed = mStreamService->GetTxFIFO()->push_samples(
             (const complex16_t **)stream->FIFOBuffers.data(),
             STREAM_MTU,
@@ -535,6 +573,89 @@ int ConnectionSTREAM::ReadStreamStatus(const size_t streamID, const long timeout
     return -1;
 }
 
+int ConnectionSTREAM::AcquireReadBuffer(const size_t streamID, size_t &handle, const void **buffs, const long timeout_ms, StreamMetadata &metadata)
+{
+    auto *stream = (USBStreamServiceChannel *)streamID;
+    if (stream->isTx or stream->convertFloat) return -1;
+
+    //hand out the FIFO packet frame itself, no intermediate buffer
+    std::unique_lock<std::mutex> lock(mStreamService->mRxReadLock);
+    if (not mStreamService->WaitRxFrameReleased(lock, timeout_ms)) return 0; //timeout
+    uint32_t fifoHandle = 0;
+    PacketFrame *frame = mStreamService->GetRxFIFO()->acquire_read(timeout_ms, &fifoHandle);
+    if (frame == nullptr) return 0; //timeout
+    mStreamService->mRxFrameHeld = true;
+
+    for (size_t i = 0; i < stream->channelsCount; i++)
+        buffs[i] = frame->samples[i] + frame->first;
+
+    metadata.timestamp = frame->timestamp + frame->first + mStreamService->mTimestampOffset;
+    metadata.hasTimestamp = true;
+    metadata.endOfBurst = (frame->flags & STATUS_FLAG_RX_END) != 0;
+
+    handle = fifoHandle;
+    return frame->last - frame->first;
+}
+
+void ConnectionSTREAM::ReleaseReadBuffer(const size_t streamID, const size_t handle)
+{
+    std::lock_guard<std::mutex> lock(mStreamService->mRxReadLock);
+    mStreamService->GetRxFIFO()->release_read(uint32_t(handle));
+    mStreamService->mRxFrameHeld = false;
+    mStreamService->mRxFrameReleased.notify_all();
+}
+
+int ConnectionSTREAM::AcquireWriteBuffer(const size_t streamID, size_t &handle, void **buffs, const long timeout_ms)
+{
+    auto *stream = (USBStreamServiceChannel *)streamID;
+    if (not stream->isTx or stream->convertFloat) return -1;
+
+    std::unique_lock<std::mutex> lock(mStreamService->mTxWriteLock);
+    if (not mStreamService->WaitTxFrameReleased(lock, timeout_ms)) return 0; //timeout
+    uint32_t fifoHandle = 0;
+    PacketFrame *frame = mStreamService->GetTxFIFO()->acquire_write(timeout_ms, &fifoHandle);
+    if (frame == nullptr) return 0; //timeout
+    mStreamService->mTxFrameHeld = true;
+
+    for (size_t i = 0; i < stream->channelsCount; i++)
+        buffs[i] = frame->samples[i];
+
+    stream->directFrame = frame;
+    handle = fifoHandle;
+    return std::min<int>(frame->samplesCount, STREAM_MTU);
+}
+
+void ConnectionSTREAM::ReleaseWriteBuffer(const size_t streamID, const size_t handle, const size_t numElems, const StreamMetadata &metadata)
+{
+    auto *stream = (USBStreamServiceChannel *)streamID;
+    PacketFrame *frame = stream->directFrame;
+    stream->directFrame = nullptr;
+    if (frame == nullptr) return;
+
+    if (metadata.hasTimestamp)
+        stream->nextTimestamp = metadata.timestamp - mStreamService->mTimestampOffset;
+
+    //same packet sizes as WriteStream, an end of burst is padded with zeros
+    //numElems cannot exceed what AcquireWriteBuffer() handed out
+    const size_t capacity = std::min<size_t>(frame->samplesCount, STREAM_MTU);
+    size_t samplesCount = std::min(numElems, capacity);
+    if (metadata.endOfBurst and samplesCount < capacity)
+    {
+        for (size_t i = 0; i < stream->channelsCount; i++)
+            std::memset(frame->samples[i] + samplesCount, 0, (capacity - samplesCount)*sizeof(complex16_t));
+        samplesCount = capacity;
+    }
+
+    uint32_t statusFlags = 0;
+    if (mStreamService->txTimeEnabled) statusFlags |= STATUS_FLAG_TX_TIME;
+    if (metadata.endOfBurst) statusFlags |= STATUS_FLAG_TX_END;
+    std::lock_guard<std::mutex> lock(mStreamService->mTxWriteLock);
+    mStreamService->GetTxFIFO()->release_write(uint32_t(handle), samplesCount, stream->nextTimestamp, statusFlags);
+    stream->nextTimestamp += samplesCount;
+    mStreamService->mTxFrameHeld = false;
+    mStreamService->mTxFrameReleased.notify_all();
+}
+
 /** @brief Configures FPGA PLLs to LimeLight interface frequency
 */
 void ConnectionSTREAM::UpdateExternalDataRate(const size_t channel, const double txRate_Hz, const double rxRate_Hz)
@@ -0,0 +1,234 @@
+/**
+    @file SampleConvert.cpp
+    @author Lime Microsystems
+    @brief Conversion between link int16 samples and complex float samples.
+
+    SSE2 is the baseline on x86-64, the AVX2 kernels are compiled with a
+    function target attribute and picked at run time when the CPU has AVX2.
+    Other architectures use the scalar loops.
+*/
+
+#include "SampleConvert.h"
+#include <math.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define CONVERT_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(_MSC_VER)
+#define CONVERT_AVX2
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+using namespace lime;
+
+typedef void (*ToFloatFn)(const int16_t *, float *, size_t, float);
+typedef void (*ToInt16Fn)(const float *, int16_t *, size_t, float);
+
+/***********************************************************************
+ * Scalar kernels, also used for the tails of the vector kernels
+ * Float to int16 rounds to nearest, saturates and turns NaN into 0
+ * in every kernel.
+ **********************************************************************/
+static void ToFloatScalar(const int16_t *in, float *out, size_t n, float scale)
+{
+    const float k = 1.0f/scale;
+    for (size_t j = 0; j < n; j++)
+        out[j] = in[j]*k;
+}
+
+static void ToInt16Scalar(const float *in, int16_t *out, size_t n, float scale)
+{
+    for (size_t j = 0; j < n; j++)
+    {
+        float v = in[j]*scale;
+        if (v != v) v = 0;
+        if (v > scale-1) v = scale-1;
+        if (v < -scale) v = -scale;
+        out[j] = int16_t(lrintf(v));
+    }
+}
+
+#ifdef CONVERT_SSE2
+/***********************************************************************
+ * SSE2 kernels, 8 values per iteration
+ **********************************************************************/
+static void ToFloatSSE2(const int16_t *in, float *out, size_t n, float scale)
+{
+    const __m128 k = _mm_set1_ps(1.0f/scale);
+    size_t j = 0;
+    for (; j + 8 <= n; j += 8)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)(in + j));
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+        _mm_storeu_ps(out + j, _mm_mul_ps(_mm_cvtepi32_ps(lo), k));
+        _mm_storeu_ps(out + j + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), k));
+    }
+    ToFloatScalar(in + j, out + j, n - j, scale);
+}
+
+static void ToInt16SSE2(const float *in, int16_t *out, size_t n, float scale)
+{
+    const __m128 k = _mm_set1_ps(scale);
+    const __m128 vmax = _mm_set1_ps(scale-1);
+    const __m128 vmin = _mm_set1_ps(-scale);
+    size_t j = 0;
+    for (; j + 8 <= n; j += 8)
+    {
+        __m128 a = _mm_mul_ps(_mm_loadu_ps(in + j), k);
+        __m128 b = _mm_mul_ps(_mm_loadu_ps(in + j + 4), k);
+        a = _mm_and_ps(a, _mm_cmpord_ps(a, a));
+        b = _mm_and_ps(b, _mm_cmpord_ps(b, b));
+        a = _mm_max_ps(_mm_min_ps(a, vmax), vmin);
+        b = _mm_max_ps(_mm_min_ps(b, vmax), vmin);
+        __m128i x = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+        _mm_storeu_si128((__m128i *)(out + j), x);
+    }
+    ToInt16Scalar(in + j, out + j, n - j, scale);
+}
+#endif
+
+#ifdef CONVERT_AVX2
+/***********************************************************************
+ * AVX2 kernels, 16 values per iteration
+ **********************************************************************/
+TARGET_AVX2 static void ToFloatAVX2(const int16_t *in, float *out, size_t n, float scale)
+{
+    const __m256 k = _mm256_set1_ps(1.0f/scale);
+    size_t j = 0;
+    for (; j + 16 <= n; j += 16)
+    {
+        __m256i lo = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(in + j)));
+        __m256i hi = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(in + j + 8)));
+        _mm256_storeu_ps(out + j, _mm256_mul_ps(_mm256_cvtepi32_ps(lo), k));
+        _mm256_storeu_ps(out + j + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(hi), k));
+    }
+    ToFloatSSE2(in + j, out + j, n - j, scale);
+}
+
+TARGET_AVX2 static void ToInt16AVX2(const float *in, int16_t *out, size_t n, float scale)
+{
+    const __m256 k = _mm256_set1_ps(scale);
+    const __m256 vmax = _mm256_set1_ps(scale-1);
+    const __m256 vmin = _mm256_set1_ps(-scale);
+    size_t j = 0;
+    for (; j + 16 <= n; j += 16)
+    {
+        __m256 a = _mm256_mul_ps(_mm256_loadu_ps(in + j), k);
+        __m256 b = _mm256_mul_ps(_mm256_loadu_ps(in + j + 8), k);
+        a = _mm256_and_ps(a, _mm256_cmp_ps(a, a, _CMP_ORD_Q));
+        b = _mm256_and_ps(b, _mm256_cmp_ps(b, b, _CMP_ORD_Q));
+        a = _mm256_max_ps(_mm256_min_ps(a, vmax), vmin);
+        b = _mm256_max_ps(_mm256_min_ps(b, vmax), vmin);
+        //packs works within 128-bit lanes, restore the order afterwards
+        __m256i x = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+        x = _mm256_permute4x64_epi64(x, 0xD8);
+        _mm256_storeu_si256((__m256i *)(out + j), x);
+    }
+    ToInt16SSE2(in + j, out + j, n - j, scale);
+}
+
+static bool HasAVX2(void)
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx) return false;
+    if ((_xgetbv(0) & 0x6) != 0x6) return false; //OS saves YMM state
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+/***********************************************************************
+ * Dispatch
+ **********************************************************************/
+struct ConvertKernels
+{
+    ConvertKernels(void)
+    {
+        //every supported set replaces the previous one
+        Select("scalar");
+        Select("SSE2");
+        Select("AVX2");
+    }
+    bool Select(const char *which)
+    {
+        if (strcmp(which, "scalar") == 0)
+        {
+            toFloat = ToFloatScalar;
+            toInt16 = ToInt16Scalar;
+            name = "scalar";
+            return true;
+        }
+#ifdef CONVERT_SSE2
+        if (strcmp(which, "SSE2") == 0)
+        {
+            toFloat = ToFloatSSE2;
+            toInt16 = ToInt16SSE2;
+            name = "SSE2";
+            return true;
+        }
+#endif
+#ifdef CONVERT_AVX2
+        if (strcmp(which, "AVX2") == 0 && HasAVX2())
+        {
+            toFloat = ToFloatAVX2;
+            toInt16 = ToInt16AVX2;
+            name = "AVX2";
+            return true;
+        }
+#endif
+        return false;
+    }
+    ToFloatFn toFloat;
+    ToInt16Fn toInt16;
+    const char *name;
+};
+
+static ConvertKernels &Kernels(void)
+{
+    static ConvertKernels kernels;
+    return kernels;
+}
+
+static inline float FullScale(const int linkBits)
+{
+    return (linkBits == 14) ? 8192.0f : 2048.0f;
+}
+
+const char *lime::SampleConvertImplementation(void)
+{
+    return Kernels().name;
+}
+
+bool lime::SelectSampleConvertImplementation(const char *name)
+{
+    return Kernels().Select(name);
+}
+
+void lime::ConvertInt16ToFloat(const complex16_t *in, std::complex<float> *out, const size_t count, const int linkBits)
+{
+    Kernels().toFloat((const int16_t *)in, (float *)out, 2*count, FullScale(linkBits));
+}
+
+void lime::ConvertFloatToInt16(const std::complex<float> *in, complex16_t *out, const size_t count, const int linkBits)
+{
+    Kernels().toInt16((const float *)in, (int16_t *)out, 2*count, FullScale(linkBits));
+}
@@ -0,0 +1,43 @@
+/**
+    @file SampleConvert.h
+    @author Lime Microsystems
+    @brief Conversion between link int16 samples and complex float samples.
+*/
+
+#pragma once
+#include <complex>
+#include <stddef.h>
+#include "dataTypes.h"
+
+namespace lime
+{
+
+/** @brief Name of the kernels selected for this CPU, "AVX2", "SSE2" or "scalar"
+*/
+const char *SampleConvertImplementation(void);
+
+/** @brief Forces the kernels to use, for tests and benchmarks
+    Must not be called while other threads convert samples.
+    @param name "AVX2", "SSE2" or "scalar"
+    @return false if this build or CPU does not have them, the selection is unchanged then
+*/
+bool SelectSampleConvertImplementation(const char *name);
+
+/** @brief Converts link samples to floats in [-1.0, 1.0)
+    @param in link samples
+    @param out converted samples
+    @param count number of complex samples
+    @param linkBits sample width on the link, 12 or 14, full scale is 2^(linkBits-1)
+*/
+void ConvertInt16ToFloat(const complex16_t *in, std::complex<float> *out, const size_t count, const int linkBits = 12);
+
+/** @brief Converts floats to link samples, rounding to nearest and saturating
+    to the link range [-2^(linkBits-1), 2^(linkBits-1)-1], NaN gives 0
+    @param in samples to convert, full scale is 1.0
+    @param out link samples
+    @param count number of complex samples
+    @param linkBits sample width on the link, 12 or 14
+*/
+void ConvertFloatToInt16(const std::complex<float> *in, complex16_t *out, const size_t count, const int linkBits = 12);
+
+}
@@ -1,12 +1,16 @@
 #include "DPDTest.h"
 
 #include <vector>
+#include <algorithm>
+#include <stdio.h>
 //#include "lmsComms.h"
 #include "IConnection.h"
 #include "LMS64CProtocol.h"
 
 #include "OpenGLGraph.h"
 #include "kiss_fft.h"
+#include "delay_align.h"
+#include "dpd_board.h"
 #include "iniParser.h"
 //#include "math.h"
 
@@ -72,6 +76,8 @@ const long DPDTest::ID_BUTTON_CALFFT = wxNewId();
 const long DPDTest::ID_STATICTEXT_12 = wxNewId();
 const long DPDTest::ID_TEXTCTRL_12 = wxNewId();
 const long DPDTest::ID_COMBOBOX_WINDOW = wxNewId();
+const long DPDTest::ID_STATICTEXT_TRAINING = wxNewId();
+const long DPDTest::ID_COMBOBOX_TRAINING = wxNewId();
 const long DPDTest::ID_STATICTEXT_2 = wxNewId();
 const long DPDTest::ID_TEXTCTRL_NUM = wxNewId();
 const long DPDTest::ID_BUTTON_TIMER = wxNewId();
@@ -103,6 +109,7 @@ const char *config_filename = "QADPDconfig.ini";
 
 DPDTest::~DPDTest(){
 
+	pipeline.stop();
 	Qadpd->release_memory();
 	Qadpd->finish();
 
@@ -118,6 +125,7 @@ DPDTest::~DPDTest(){
 	//m_ADPD_txtAm->Enable(true);
 	//m_ADPD_txtSkip->Enable(true);
 	m_ADPD_txtTrain->Enable(true);
+	cmbTraining->Enable(true);
 	TrainMode->Enable(false);
 	btnCapture->Enable(false);
 	Button_TRAIN->Enable(false);
@@ -134,17 +142,19 @@ DPDTest::~DPDTest(){
 
 DPDTest::DPDTest( wxWindow* parent, wxWindowID id, const wxString& title, const wxPoint& pos, const wxSize& size, long style ) : wxFrame( parent, id, title, pos, size, style )
 , mDataPort(nullptr)
+, pipeline(engine)
 //, m_timer(this, TIMER_ID)
 {
     
 	//range = 4.0;
 	range = 16.0;
 	ind = 0;
+	shownFrame = 0;
+	coefUploadFailed = false;
 	m_timer = new wxTimer(this, TIMER_ID);
 	m_bTrain = true;
 
 	m_iWindowFunc = 0;
-	windowFcoefs = NULL;
 
 	xp_samples=NULL;
 	yp_samples=NULL;
@@ -476,6 +486,17 @@ DPDTest::DPDTest( wxWindow* parent, wxWindowID id, const wxString& title, const
 	m_ADPD_txtTrain->SetExtraStyle(m_ADPD_txtTrain->GetExtraStyle() | wxWS_EX_BLOCK_EVENTS);
 	m_ADPD_controlsSizer2->Add(m_ADPD_txtTrain, 1, wxALIGN_LEFT | wxALIGN_CENTER_VERTICAL | wxEXPAND | wxALL, 2);
 
+	StaticText_TRAINING = new wxStaticText(m_ADPD_tabSpectrum, ID_STATICTEXT_TRAINING, _T("Training:"), wxDefaultPosition, wxDefaultSize, 0, _T("ID_STATICTEXT_TRAINING"));
+	m_ADPD_controlsSizer2->Add(StaticText_TRAINING, 1, wxALIGN_LEFT | wxALIGN_CENTER_VERTICAL | wxEXPAND | wxALL, 2);
+	// order must follow the qadpd training algorithm enum
+	cmbTraining = new wxComboBox(m_ADPD_tabSpectrum, ID_COMBOBOX_TRAINING, wxEmptyString, wxDefaultPosition, wxDefaultSize, 0, 0, wxCB_READONLY, wxDefaultValidator, _T("ID_COMBOBOX_TRAINING"));
+	cmbTraining->SetSelection(cmbTraining->Append(_T("LU")));
+	cmbTraining->Append(_T("Gauss-Seidel"));
+	cmbTraining->Append(_T("Gradient"));
+	cmbTraining->Append(_T("RLS"));
+	cmbTraining->Append(_T("Block LS"));
+	m_ADPD_controlsSizer2->Add(cmbTraining, 1, wxALIGN_LEFT | wxALIGN_CENTER_VERTICAL | wxEXPAND | wxALL, 2);
+
 
 	StaticText_11 = new wxStaticText(m_ADPD_tabSpectrum, ID_STATICTEXT_ADPD11, _T(""), wxDefaultPosition, wxDefaultSize, 0, _T("ID_STATICTEXT_ADPD11"));
     //m_ADPD_controlsSizer2->Add(StaticText_11, 1, wxALIGN_LEFT | wxALIGN_CENTER_VERTICAL | wxEXPAND | wxALL, 2);
@@ -681,8 +702,12 @@ DPDTest::DPDTest( wxWindow* parent, wxWindowID id, const wxString& title, const
 	QADPD_SPAN = 20.0;
 	mNyquist_MHz = QADPD_SPAN/2.0;
 	QADPD_UPDATE=1;
+	QADPD_TRAINING = qadpd::LU;
+	QADPD_DELAYRANGE = 3;
+	QADPD_FRACDELAY = false;
 	OpenConfig();
-	Qadpd = new qadpd(QADPD_N, QADPD_M, QADPD_ND);
+	engine.set_channels(1, QADPD_N, QADPD_M, QADPD_ND);
+	Qadpd = engine.channel(0);
 	
 	Button_START->Enable(true);
 	Button_TRAIN->Enable(false);
@@ -697,6 +722,7 @@ DPDTest::DPDTest( wxWindow* parent, wxWindowID id, const wxString& title, const
 	//m_ADPD_txtAm->Enable(true);
 	//m_ADPD_txtSkip->Enable(true);
 	m_ADPD_txtTrain->Enable(true);
+	cmbTraining->Enable(true);
 	TrainMode->Enable(false);
 	//CheckBox_YPFPGA->Enable(true);
 	//btnCalculateFFT->Enable(false);
@@ -807,6 +833,12 @@ void DPDTest::OpenConfig() {
 	QADPD_ND = m_options.Get("QADPD_ND", 0); spin_ADPD_Delay->SetValue(QADPD_ND);
 	QADPD_SKIP = m_options.Get("QADPD_SKIP", 0);
 	QADPD_UPDATE = m_options.Get("QADPD_UPDATE", 1);
+	QADPD_TRAINING = m_options.Get("QADPD_TRAINING", (int)qadpd::LU);
+	if ((QADPD_TRAINING < 0) || (QADPD_TRAINING >= (int)cmbTraining->GetCount())) QADPD_TRAINING = qadpd::LU;
+	cmbTraining->SetSelection(QADPD_TRAINING);
+	QADPD_DELAYRANGE = m_options.Get("QADPD_DELAYRANGE", 3);
+	if ((QADPD_DELAYRANGE < 0) || (QADPD_DELAYRANGE > 64)) QADPD_DELAYRANGE = 3;
+	QADPD_FRACDELAY = (m_options.Get("QADPD_FRACDELAY", 0) == 1);
 
 	wxString temps1;
 	temps1.Printf(_T("%d"), QADPD_SKIP);
@@ -954,12 +986,16 @@ void DPDTest::SaveConfig()
 	QADPD_LAMBDA = tempd;
 
 	QADPD_YPFPGA = true; // CheckBox_YPFPGA->IsChecked();
+	QADPD_TRAINING = cmbTraining->GetSelection();
 
 	m_options.Set("QADPD_N", QADPD_N);
 	m_options.Set("QADPD_M", QADPD_M);
 	m_options.Set("QADPD_AM", QADPD_AM);
 	m_options.Set("QADPD_SKIP", QADPD_SKIP);
 	m_options.Set("QADPD_UPDATE", QADPD_UPDATE);
+	m_options.Set("QADPD_TRAINING", QADPD_TRAINING);
+	m_options.Set("QADPD_DELAYRANGE", QADPD_DELAYRANGE);
+	m_options.Set("QADPD_FRACDELAY", QADPD_FRACDELAY ? 1 : 0);
 
 	m_options.Set("QADPD_ND", QADPD_ND);
 	if (QADPD_YPFPGA == true) m_options.Set("QADPD_YPFPGA", 1);
@@ -1224,6 +1260,12 @@ void DPDTest::onEnableDisable() {
 		//CheckBox_Train->Enable(false);
 		timer_enabled = false;
 		m_timer->Stop();    // stop
+		if (pipeline.running()) {
+			pipeline.stop();
+			// the pipeline may have trained past the frame on screen
+			std::shared_ptr<const dpd_coeffs> c = engine.coeffs(0);
+			if (c) ind = c->lag;
+		}
 
 	}
 	else {  
@@ -1236,7 +1278,15 @@ void DPDTest::onEnableDisable() {
 		m_ADPD_Num->Enable(false);
 		//CheckBox_Train->Enable(true);
 		timer_enabled = true;
-		m_timer->Start(1000);    // 1 second interval
+		shownFrame = 0;
+		coefUploadFailed = false;
+		pipeline.start(pipeline_config(),
+			[this](std::vector<unsigned char> &buffer) {
+				bool timedOut;
+				return dpd_board::capture(mDataPort, dpd_board::CAPTURE_SAMPLES, dpd_board::CAPTURE_BITS, buffer, timedOut);
+			},
+			[this]() { if (send_coef() != 0) coefUploadFailed = true; });
+		m_timer->Start(100);    // only picks up finished frames
 	}
 
 
@@ -1276,9 +1326,10 @@ void DPDTest::OnbtnStartClick(wxCommandEvent& event)
 	m_ADPD_txtLambda->GetValue().ToDouble(&tempd);
 	QADPD_LAMBDA = tempd;
 	QADPD_YPFPGA = true; // CheckBox_YPFPGA->IsChecked();
+	QADPD_TRAINING = cmbTraining->GetSelection();
 
 	SaveConfig();
-	Qadpd->init(QADPD_N, QADPD_M, QADPD_ND, 1.0, QADPD_LAMBDA, (1 << (QADPD_AM - 1)), QADPD_SKIP);
+	engine.init(QADPD_N, QADPD_M, QADPD_ND, QADPD_LAMBDA, (1 << (QADPD_AM - 1)), QADPD_SKIP, QADPD_TRAINING);
 		
 	Button_START->Enable(false);
 	Button_TRAIN->Enable(true);
@@ -1292,6 +1343,7 @@ void DPDTest::OnbtnStartClick(wxCommandEvent& event)
 	//m_ADPD_txtAm->Enable(false);
 	//m_ADPD_txtSkip->Enable(false);
 	m_ADPD_txtTrain->Enable(false);
+	cmbTraining->Enable(false);
 	TrainMode->Enable(true);
 	CheckBox_Train->Enable(true);
 	onEnableDisable();
@@ -1303,35 +1355,15 @@ void DPDTest::OnbtnStartClick(wxCommandEvent& event)
 
 int DPDTest::train(){
 
-	int	samplesCount = samplesReceived;
-
-
-	ind = prepare_train();
-	//ind = 0;
-	if ((ind > 3) || (ind < -3)) ind = 0;
-
-
-
-	Qadpd->skiping = QADPD_N + QADPD_ND + 1;
-	Qadpd->skiping += 100;
 	QADPD_YPFPGA = true;
 
-	Qadpd->updating = QADPD_UPDATE;
-	//ind = 0;
-	int i = 3;
-	while ((Qadpd->skiping >= 0) && (i < samplesCount - 3)){
-		//if ((abs(xp_samples[i].r/Qadpd->am)>0.5) || (abs(xp_samples[i].i/Qadpd->am)>0.5))  Qadpd->skiping = QADPD_N + QADPD_ND + 10;
-
-		Qadpd->always(xp_samples[i].r, xp_samples[i].i, x_samples[i+ind].r, x_samples[i+ind].i, yp_samples[i].r, yp_samples[i].i, QADPD_YPFPGA);
-		i++;
-	}
-	
-	
-	int temp = 0;
-	temp=Qadpd->update_coeff(range);
-	return temp;
-
+	dpd_capture cap = { xp_samples, x_samples, yp_samples, samplesReceived };
+	dpd_settings s = { QADPD_UPDATE, QADPD_DELAYRANGE, QADPD_FRACDELAY, QADPD_YPFPGA, range };
+	engine.train(&cap, 1, s);
 
+	std::shared_ptr<const dpd_coeffs> c = engine.coeffs(0);
+	ind = c->lag;
+	return c->status;
 }
 
 
@@ -1345,6 +1377,7 @@ void DPDTest::OnbtnTrainClick(wxCommandEvent& event)
 
 void DPDTest::OnbtnEndClick(wxCommandEvent& event)
 {
+	pipeline.stop();
 	Qadpd->release_memory();
 	Qadpd->finish();
 
@@ -1360,6 +1393,7 @@ void DPDTest::OnbtnEndClick(wxCommandEvent& event)
 	//m_ADPD_txtAm->Enable(true);
 	//m_ADPD_txtSkip->Enable(true);
 	m_ADPD_txtTrain->Enable(true);
+	cmbTraining->Enable(true);
 	TrainMode->Enable(false);
 	btnCapture->Enable(false);
 	Button_TRAIN->Enable(false);
@@ -1375,7 +1409,7 @@ void DPDTest::OnbtnEndClick(wxCommandEvent& event)
 
 
 
-void DPDTest::send_coef(){
+int DPDTest::send_coef(){
 
 	// adpd config  addresa 18
 	// adpd data  adresa  22 
@@ -1383,106 +1417,11 @@ void DPDTest::send_coef(){
 	// opseg brojeva je od[-16 do 16 - lsb]
 	// 0x0800 = 0000 1000 0000 0000  predstavlja jedinicu
 
-	// double am = 8192.0/4;  // skaliranje
-
-	double am = 8192.0 * 4.0 / range;  // skaliranje, za [-16, 16] = 8192/4; za [-4, 4] = 8192
-	int temp = 0;
-
-	SPI_write(mDataPort, 0x0012, 0x0000); //spi_ctrl <= x"0000";
-	SPI_write(mDataPort, 0x0016, 0x0000); //spi_data <= x"0000";
-
-	double a1, b1 = 0.0;
-
-	short tempsh = 0;
-	short tempsh2 = 0;
-	double eps = 0.002;
-
-	int i = 0;
-	int j = 0;
-	int LIM = 0;
-	int LIM2 = 1;
-
-	int temp_i = 0;
-
-
-	for (i = 0; i <= 5; i++)  // bilo je 3
-		for (j = 0; j <= 3; j++){
-
-			if ((i <= QADPD_N) && (j <= QADPD_M)) {
-
-
-				a1 = Qadpd->a[i][j];
-				b1 = Qadpd->b[i][j];
-
-				if (a1 > range) {
-					a1 = (range - eps);
-					Qadpd->a[i][j] = a1;
-				}
-				if (a1 < (-range)) {
-					a1 = (-range + eps);
-					Qadpd->a[i][j] = a1;
-				}
-				if (b1 > range) {
-					b1 = range - eps;
-					Qadpd->b[i][j] = b1;
-				}
-				if (b1 < (-range)) {
-					b1 = (-range + eps);
-					Qadpd->b[i][j] = b1;
-				}
-
-			}
-			else  {
-				a1 = 0.0;
-				b1 = 0.0;
-			}
-
-		
-			temp_i = (int)(am * a1 * 4.0 + 0.5);
-			tempsh = (short)(temp_i >> 2);
-			tempsh2 = (short)((temp_i & 0x0003) << 8);
-			temp = 0x3000 + tempsh2 + i * 16 + j;
-
-
-			for (int k = 0; k <= LIM; k++)  SPI_write(mDataPort, 0x0016, tempsh); 
-			for (int k = 0; k <= LIM2 * 100; k++);
-
-
-			for (int k = 0; k <= LIM; k++) SPI_write(mDataPort, 0x0012, temp); //spi_ctrl <= x"30"& conv_std_logic_vector(i, 4)& conv_std_logic_vector(j, 4);
-			for (int k = 0; k <= LIM2 * 100; k++);
-
-			//SPI_write(mDataPort, 0x0016, 0x0000); //spi_data <= a(i)(j);
-			for (int k = 0; k <= LIM; k++) SPI_write(mDataPort, 0x0012, 0x0000); //spi_ctrl <= x"0000";
-			for (int k = 0; k <= LIM2 * 100; k++);
-
-			//tempsh = (short)(am*b1);
-			//temp = 0xC000 + i * 16 + j;		
-			temp_i = (int)(am * b1 * 4.0 + 0.5);
-			tempsh = (short)(temp_i >> 2);
-			tempsh2 = (short)((temp_i & 0x0003) << 8);
-			temp = 0xC000 + tempsh2 + i * 16 + j;
-
-			for (int k = 0; k <= LIM; k++) SPI_write(mDataPort, 0x0016, tempsh); //spi_data <= b(i)(j);
-			for (int k = 0; k <= LIM2 * 100; k++);
-			//
-			for (int k = 0; k <= LIM; k++) SPI_write(mDataPort, 0x0012, temp); //spi_ctrl <= x"C0"& conv_std_logic_vector(i, 4)& conv_std_logic_vector(j, 4);
-			for (int k = 0; k <= LIM2 * 100; k++);
-
-			//SPI_write(mDataPort, 0x0016, 0x0000); //spi_data <= a(i)(j);
-			for (int k = 0; k <= LIM; k++)  SPI_write(mDataPort, 0x0012, 0x0000); //spi_ctrl <= x"0000";
-			for (int k = 0; k <= LIM2 * 100; k++);
-
-		}
-
-
-
-	for (int k = 0; k <= LIM; k++)  SPI_write(mDataPort, 0x0012, 0xF000); //spi_ctrl <= x"F000";
-	for (int k = 0; k <= LIM2 * 100; k++);
-	for (int k = 0; k <= LIM; k++)  SPI_write(mDataPort, 0x0012, 0x0000); //spi_ctrl <= x"F000";
-	for (int k = 0; k <= LIM2 * 100; k++);
-	for (int k = 0; k <= LIM; k++)  SPI_write(mDataPort, 0x0016, 0x0000); //spi_ctrl <= x"0000";
-	for (int k = 0; k <= LIM2 * 100; k++);
+	coef_upload::table next;
+	coef_upload::quantize(Qadpd->a, Qadpd->b, QADPD_N, QADPD_M, range, next);
 
+	// the table and the 0xF000 commit strobe go out in one WriteRegisters batch
+	return coefUploader.upload(mDataPort, next);
 }
 
 
@@ -1496,7 +1435,11 @@ void DPDTest::OnbtnSendClick(wxCommandEvent& event)
 		wxMessageBox("Not connected");
 		return;
 	}
-	else send_coef();
+	else {
+		coefUploader.invalidate(); // manual send goes out even if the table did not change
+		if (send_coef() != 0)
+			wxMessageBox("Failed to send DPD coefficients");
+	}
 }
 
 void DPDTest::OnbtnRTSClick(wxCommandEvent& event)
@@ -1518,7 +1461,10 @@ void DPDTest::OnbtnRTSClick(wxCommandEvent& event)
 
 		readdata_qspark();
 		temp=train();
-		if (temp>=0) send_coef();
+		if ((temp >= 0) && (send_coef() != 0)) {
+			wxMessageBox("Failed to send DPD coefficients");
+			break;
+		}
 
 	}
 
@@ -1648,6 +1594,7 @@ void DPDTest::OnbtnPlot4ControlsClick(wxCommandEvent& event)
 void DPDTest::Initialize(lime::IConnection* dataPort)
 {
     mDataPort = dataPort;
+	coefUploader.invalidate();
 }
 
 
@@ -1723,148 +1670,26 @@ void DPDTest::changePlotType(OpenGLGraph * graph, int plotType, int  m_iXaxisLef
 	}
 }
 
-int DPDTest::prepare_train(){
-
-	//Qadpd->start();
-
-	double error_nd_m3 = 0.0;
-	double error_nd_m2 = 0.0;
-	double error_nd_m1 = 0.0;
-	double error_nd_p0 = 0.0;
-	double error_nd_p1 = 0.0;
-	double error_nd_p2 = 0.0;
-	double error_nd_p3 = 0.0;
-
-	int SKIP = 100;
-	int LIMIT = 2000;	
-
-	int counter_e = 0;
-
-	// treba da smanji ND za 3
-	counter_e = 0;
-	for (int i = 0; i < samplesReceived - 3; i++) {
-		Qadpd->oeval(xp_samples[i].r, xp_samples[i].i, x_samples[i + 3].r, x_samples[i + 3].i, yp_samples[i].r, yp_samples[i].i, QADPD_YPFPGA);
-		if ((i > SKIP) && (counter_e<LIMIT)) { error_nd_p3 += Qadpd->err; counter_e++; }
-		if (counter_e >= LIMIT) i = samplesReceived;
-	}
-
-	// treba da smanji ND za 2
-	counter_e = 0;
-	for (int i = 0; i < samplesReceived - 2; i++) {
-		Qadpd->oeval(xp_samples[i].r, xp_samples[i].i, x_samples[i + 2].r, x_samples[i + 2].i, yp_samples[i].r, yp_samples[i].i, QADPD_YPFPGA);
-		if ((i > SKIP) && (counter_e<LIMIT)) { error_nd_p2 += Qadpd->err; counter_e++; }
-		if (counter_e >= LIMIT) i = samplesReceived;
-	}
-
-	// treba da smanji ND za 1
-	counter_e = 0;
-	for (int i = 0; i < samplesReceived - 1; i++) {
-		Qadpd->oeval(xp_samples[i].r, xp_samples[i].i, x_samples[i + 1].r, x_samples[i + 1].i, yp_samples[i].r, yp_samples[i].i, QADPD_YPFPGA);
-		if ((i > SKIP) && (counter_e<LIMIT)) { error_nd_p1 += Qadpd->err; counter_e++; }
-		if (counter_e >= LIMIT) i = samplesReceived;
-	}
-
-	// ND ostaje isto
-	counter_e = 0;
-	for (int i = 0; i < samplesReceived; i++) {
-		Qadpd->oeval(xp_samples[i].r, xp_samples[i].i, x_samples[i].r, x_samples[i].i, yp_samples[i].r, yp_samples[i].i, QADPD_YPFPGA);
-		if ((i > SKIP) && (counter_e<LIMIT)) { error_nd_p0 += Qadpd->err; counter_e++; }
-		if (counter_e >= LIMIT) i = samplesReceived;
-	}
-
-	// ND se povecava za 1
-	counter_e = 0;
-	for (int i = 1; i < samplesReceived; i++) {
-		Qadpd->oeval(xp_samples[i].r, xp_samples[i].i, x_samples[i - 1].r, x_samples[i - 1].i, yp_samples[i].r, yp_samples[i].i, QADPD_YPFPGA);
-		if ((i > SKIP) && (counter_e<LIMIT)) { error_nd_m1 += Qadpd->err; counter_e++; }
-		if (counter_e >= LIMIT) i = samplesReceived;
-	}
-
-	// ND se povecava za 2
-	counter_e = 0;
-	for (int i = 2; i < samplesReceived; i++) {
-		Qadpd->oeval(xp_samples[i].r, xp_samples[i].i, x_samples[i - 2].r, x_samples[i - 2].i, yp_samples[i].r, yp_samples[i].i, QADPD_YPFPGA);
-		if ((i > SKIP) && (counter_e<LIMIT)) { error_nd_m2 += Qadpd->err; counter_e++; }
-		if (counter_e >= LIMIT) i = samplesReceived;
-	}
-	
-	// ND se povecava za 3
-	counter_e = 0;
-	for (int i = 3; i < samplesReceived; i++) {
-		Qadpd->oeval(xp_samples[i].r, xp_samples[i].i, x_samples[i - 3].r, x_samples[i - 3].i, yp_samples[i].r, yp_samples[i].i, QADPD_YPFPGA);
-		if ((i > SKIP) && (counter_e<LIMIT)) { error_nd_m3 += Qadpd->err; counter_e++; }
-		if (counter_e >= LIMIT) i = samplesReceived;
-	}
-
-	int ind = 0;
-	double minim = 0.0;
-
-	if (error_nd_p3 < error_nd_p2) {
-		ind = 3;
-		minim = error_nd_p3;
-	}
-	else {
-		ind = 2;
-		minim = error_nd_p2;
-	}
-	
-	if (minim > error_nd_p1) {
-		ind = 1;
-		minim = error_nd_p1;
-	}
-
-	if (minim > error_nd_p0) {
-		ind = 0;
-		minim = error_nd_p0;
-	}
-
-	if (minim > error_nd_m1) {
-		ind = -1;
-		minim = error_nd_m1;
-	}
-
-	if (minim > error_nd_m2) {
-		ind = -2;
-		minim = error_nd_m2;
-	}
-
-	if (minim > error_nd_m3) {
-		ind = -3;
-		minim = error_nd_m3;
-	}
-	return (ind);
-}
-	
-
-
 void DPDTest::run_QADPD(){
 
-	Qadpd->start();
-	Qadpd->prepare();
+	dpd_capture cap = { xp_samples, x_samples, yp_samples, samplesReceived };
+	engine.evaluate(0, cap, ind, QADPD_YPFPGA, y_samples, u_samples, error_samples);
+	for (int i = 0; i < samplesReceived; i++) y1_samples[i] = y_samples[i];
 
-	for (int i = 3; i < samplesReceived-3; i++) {
-		
-		Qadpd->oeval(xp_samples[i].r, xp_samples[i].i, x_samples[i+ind].r, x_samples[i+ind].i, yp_samples[i].r, yp_samples[i].i, QADPD_YPFPGA);
-
-		y_samples[i].r = Qadpd->yI;
-		y_samples[i].i = Qadpd->yQ;
-
-		y1_samples[i].r = Qadpd->yI;
-		y1_samples[i].i = Qadpd->yQ;
-		u_samples[i].r = Qadpd->uI;
-		u_samples[i].i = Qadpd->uQ;
-		// Predistorter errors
-		error_samples[i].r = Qadpd->uI - Qadpd->yI; // Qadpd->err;
-		error_samples[i].i = Qadpd->uQ - Qadpd->yQ; // Qadpd->perr;
+	read_fft_settings();
 
-		if (QADPD_YPFPGA == false) {
-		}
-	}
+	//calculate  FFT, plan and window are set up by read_fft_settings()
+	const kiss_fft_cpx *in[4] = { xp_samples, yp_samples, x_samples, y_samples };
+	kiss_fft_cpx *windowed[4] = { xp1_samples, yp1_samples, x1_samples, y1_samples };
+	kiss_fft_cpx *out[4] = { xp_fft, yp_fft, x_fft, y_fft };
+	spectra.transform(4, in, windowed, out);
 
-	Qadpd->finish();
+	plot_all();
+}
 
-	//  FFT promeni ovo
-	long temp;
+// FFT size, span and window from the controls
+void DPDTest::read_fft_settings()
+{
 	double tempd = 0.0;
 	wxString temps;
 	QADPD_FFT1= m_ADPD_txtFFT1->GetValue();
@@ -1878,44 +1703,12 @@ void DPDTest::run_QADPD(){
 	QADPD_FFTSAMPLES = pow(2, QADPD_FFT1);
 	//QADPD_FFTSAMPLES = 16384;
 
-	wxString temps1;
-
-	kiss_fft_cfg m_fftCalcPlan = kiss_fft_alloc(QADPD_FFTSAMPLES, 0, 0, 0);
-
-	//calculate  FFT
-
 	m_iWindowFunc = cmbWindowFunction->GetSelection();
 	GenerateWindowCoefficients(m_iWindowFunc, QADPD_FFTSAMPLES);
+}
 
-	if (m_iWindowFunc > 0) //apply window function if it's selected
-	{
-		int index = 0;
-		while (index<QADPD_FFTSAMPLES)
-		{
-			xp1_samples[index].r = xp_samples[index].r * windowFcoefs[index];
-			xp1_samples[index].i = xp_samples[index].i * windowFcoefs[index];
-
-			yp1_samples[index].r = yp_samples[index].r * windowFcoefs[index];
-			yp1_samples[index].i = yp_samples[index].i * windowFcoefs[index];
-
-			x1_samples[index].r = x_samples[index].r * windowFcoefs[index];
-			x1_samples[index].i = x_samples[index].i * windowFcoefs[index];
-
-			y1_samples[index].r = y_samples[index].r * windowFcoefs[index];
-			y1_samples[index].i = y_samples[index].i * windowFcoefs[index];
-			++index;
-		}
-	}
-
-	
-	kiss_fft(m_fftCalcPlan, xp1_samples, xp_fft);
-	kiss_fft(m_fftCalcPlan, yp1_samples, yp_fft);
-	kiss_fft(m_fftCalcPlan, x1_samples, x_fft);
-	kiss_fft(m_fftCalcPlan, y1_samples, y_fft);
-
-	//free allocated memory
-	kiss_fft_free(m_fftCalcPlan);
-
+void DPDTest::plot_all()
+{
 	OnPlot(m_iValuePlot1, m_plot_ADPD0, StaticText_PLOT1, m_iCenterFreqRatioPlot1, m_dCenterFreqRatioPlot1,
 		m_iFreqSpanRatioPlot1, m_dFreqSpanRatioPlot1, m_iYaxisTopPlot1, m_iYaxisBottomPlot1, 0, m_iXaxisLeftPlot1, m_iXaxisRightPlot1);
 	OnPlot(m_iValuePlot2, m_plot_ADPD1, StaticText_PLOT2, m_iCenterFreqRatioPlot2, m_dCenterFreqRatioPlot2,
@@ -1924,7 +1717,6 @@ void DPDTest::run_QADPD(){
 		m_iFreqSpanRatioPlot3, m_dFreqSpanRatioPlot3, m_iYaxisTopPlot3, m_iYaxisBottomPlot3, 2, m_iXaxisLeftPlot3, m_iXaxisRightPlot3);
 	OnPlot(m_iValuePlot4, m_plot_ADPD3, StaticText_PLOT4, m_iCenterFreqRatioPlot4, m_dCenterFreqRatioPlot4,
 		m_iFreqSpanRatioPlot4, m_dFreqSpanRatioPlot4, m_iYaxisTopPlot4, m_iYaxisBottomPlot4, 3, m_iXaxisLeftPlot4, m_iXaxisRightPlot4);
-
 }
 
 //void DPDTest::OnbtnCalculateFFT(wxCommandEvent& event){	
@@ -1945,7 +1737,8 @@ void DPDTest::OnbtnTimerClick(wxCommandEvent& event){
 
 	// reset coeficients
 	Qadpd->reset_coeff();
-	send_coef();
+	if (send_coef() != 0)
+		wxMessageBox("Failed to send DPD coefficients");
 }
 
 void DPDTest::OnbtnTrain(wxCommandEvent &evt) {
@@ -1965,20 +1758,67 @@ void DPDTest::OnTimer(wxTimerEvent& event)
 {
 	// do whatever you want to do every second here
 
-	int temp = 0;
+	// Capture, training and FFTs run in the pipeline, only the plots are done here
+	if ((timer_enabled == true) && pipeline.running()) {
 
-	if (timer_enabled==true) {
-		
-		// readdata();
-		readdata_qspark();
-		if (m_bTrain == true) {
-			temp=train();
-			if (temp>=0) send_coef();
+		if (coefUploadFailed.exchange(false)) {
+			m_timer->Stop();
+			wxMessageBox("Failed to send DPD coefficients");
+			if (timer_enabled) m_timer->Start(100);
+			return;
+		}
+
+		pipeline.configure(pipeline_config());
+		std::shared_ptr<const dpd_frame> f = pipeline.latest();
+		if (f && (f->seq + 1 != shownFrame)) {
+			show_frame(*f);
+			shownFrame = f->seq + 1;
+			plot_all();
 		}
-		run_QADPD();
 	}
 }
 
+// Settings of the continuous mode, read from the controls on the GUI thread
+dpd_pipeline_config DPDTest::pipeline_config()
+{
+	dpd_pipeline_config cfg;
+	cfg.samples = samplesReceived;
+	cfg.captureSamples = dpd_board::CAPTURE_SAMPLES;
+	cfg.bitsInSample = dpd_board::CAPTURE_BITS;
+	cfg.gain = QADPD_GAIN;
+	cfg.train = m_bTrain;
+	dpd_settings s = { QADPD_UPDATE, QADPD_DELAYRANGE, QADPD_FRACDELAY, QADPD_YPFPGA, range };
+	cfg.settings = s;
+	cfg.lag = ind;
+
+	read_fft_settings();
+	cfg.fftSize = QADPD_FFTSAMPLES;
+	cfg.window = m_iWindowFunc;
+	return cfg;
+}
+
+// Copies a finished pipeline frame into the plotted buffers
+void DPDTest::show_frame(const dpd_frame &f)
+{
+	int n = (int)f.xp.size();
+	if (n > samplesReceived) n = samplesReceived;
+	std::copy(f.xp.begin(), f.xp.begin() + n, xp_samples);
+	std::copy(f.yp.begin(), f.yp.begin() + n, yp_samples);
+	std::copy(f.x.begin(), f.x.begin() + n, x_samples);
+	std::copy(f.y.begin(), f.y.begin() + n, y_samples);
+	std::copy(f.xp1.begin(), f.xp1.begin() + n, xp1_samples);
+	std::copy(f.yp1.begin(), f.yp1.begin() + n, yp1_samples);
+	std::copy(f.x1.begin(), f.x1.begin() + n, x1_samples);
+	std::copy(f.y1.begin(), f.y1.begin() + n, y1_samples);
+	std::copy(f.u.begin(), f.u.begin() + n, u_samples);
+	std::copy(f.error.begin(), f.error.begin() + n, error_samples);
+	std::copy(f.xp_fft.begin(), f.xp_fft.begin() + n, xp_fft);
+	std::copy(f.yp_fft.begin(), f.yp_fft.begin() + n, yp_fft);
+	std::copy(f.x_fft.begin(), f.x_fft.begin() + n, x_fft);
+	std::copy(f.y_fft.begin(), f.y_fft.begin() + n, y_fft);
+	ind = f.lag;
+}
+
 void DPDTest::CreateArrays(){
 
 	if (xp_samples != NULL) delete[] xp_samples;
@@ -2052,36 +1892,6 @@ void DPDTest::CreateArrays(){
 
 }
 
-static int ReadBitStream(const uint8_t* buffer, long offset, const uint8_t bitCount, bool toSigned = false)
-{
-	const int srcBitCount = 8;
-	int result = 0;
-	int bitsCollected = 0;
-	const uint8_t* src = buffer + (offset / srcBitCount) * 1;
-	offset = offset % srcBitCount;
-	const int bytesNeeded = bitCount / srcBitCount + (bitCount % srcBitCount != 0);
-
-	while (bitsCollected < bitCount)
-	{
-		for (int b = srcBitCount - 1 - offset; b >= 0 && bitsCollected < bitCount; --b)
-		{
-			int bit = ((*src) & (1 << b)) > 0;
-			result <<= 1;
-			result |= bit;
-			offset = 0;
-			++bitsCollected;
-		}
-		offset = 0;
-		++src;
-	}
-	if (toSigned && (result & (1 << (bitCount - 1))))
-	{
-		result <<= 32 - bitCount;
-		result >>= 32 - bitCount;
-	}
-	return result;
-}
-
 void DPDTest::readdata_qspark() //(wxCommandEvent& event)
 {
 	if (mDataPort == nullptr)
@@ -2090,91 +1900,28 @@ void DPDTest::readdata_qspark() //(wxCommandEvent& event)
 		return;
 	}
 	//long samplesToRead = 20480;
-	long samplesToRead = 16384;
+	long samplesToRead = dpd_board::CAPTURE_SAMPLES;
 	//txtSamplesCount->GetValue().ToLong(&samplesToRead);
+	const int bitsInSample = dpd_board::CAPTURE_BITS;
 
-	const int bitsInSample = 14;
-	const int bytesToRead = (samplesToRead * 6 * bitsInSample / 8.0 + 0.5);
-
-	mDataPort->WriteRegister(0x0040, samplesToRead);
-
-	unsigned char *buffer = new unsigned char[bytesToRead];
-	memset(buffer, 0, bytesToRead);
-
-	//switch off Rx/Tx
-	uint16_t interface_ctrl_000A;
-	mDataPort->ReadRegister(0x000A, interface_ctrl_000A);
-	mDataPort->WriteRegister(0x000A, interface_ctrl_000A & ~0x1);
-
-	//enable MIMO mode, 12 bit compressed values
-	uint16_t smpl_width; // 0-16 bit, 1-14 bit, 2-12 bit
-	if (bitsInSample == 12)
-		smpl_width = 2;
-	else if (bitsInSample == 14)
-		smpl_width = 1;
-	else if (bitsInSample == 16)
-		smpl_width = 0;
-	else
-		smpl_width = 2;
-	mDataPort->WriteRegister(0x0007, 1);
-
-	uint16_t interface_cfg_0008;
-	mDataPort->ReadRegister(0x0008, interface_cfg_0008);
-	interface_cfg_0008 = (interface_cfg_0008 & ~0x3) | smpl_width;
-	mDataPort->WriteRegister(0x0008, interface_cfg_0008);
-
-	//Reset USB FIFO
-	{
-		LMS64CProtocol* port = dynamic_cast<LMS64CProtocol *>(mDataPort);
-		LMS64CProtocol::GenericPacket ctrPkt;
-		ctrPkt.cmd = CMD_USB_FIFO_RST;
-		ctrPkt.outBuffer.push_back(0x01);
-		port->TransferPacket(ctrPkt);
-		ctrPkt.outBuffer[0] = 0x00;
-		port->TransferPacket(ctrPkt);
-	}
-
-	//switch on Rx
-	interface_ctrl_000A;
-	mDataPort->ReadRegister(0x000A, interface_ctrl_000A);
-	mDataPort->WriteRegister(0x000A, interface_ctrl_000A | 0x1);
-
-	mDataPort->WriteRegister(0x0041, 0x0); //0x1-burst, 0x3-continuos
-	mDataPort->WriteRegister(0x0041, 0x1); //0x1-burst, 0x3-continuos
-
-	int handle = mDataPort->BeginDataReading((char*)buffer, bytesToRead);
-	if (mDataPort->WaitForReading(handle, 1000) != 1)
+	std::vector<unsigned char> buffer;
+	bool timedOut = false;
+	int bytesReceived = dpd_board::capture(mDataPort, samplesToRead, bitsInSample, buffer, timedOut);
+	if (timedOut)
 	{
 		wxMessageBox("Failed to receive data");
 	}
 
-	long btr = bytesToRead;
-	int bytesReceived = mDataPort->FinishDataReading((char*)buffer, btr, handle);
-	uint8_t temp;
-	for (int i = 0; i < bytesToRead / 2; ++i)
-	{
-		temp = buffer[bytesToRead - 1 - i];
-		buffer[bytesToRead - 1 - i] = buffer[i];
-		buffer[i] = temp;
-	}
 	if (bytesReceived > 0)
 	{
-		int samplesReceived = samplesToRead;
-		int index = samplesToRead - 1;
+		dpd_decode(&buffer[0], (long)buffer.size(), bitsInSample, samplesToRead, QADPD_GAIN,
+			xp_samples, yp_samples, x_samples);
 
-		long bitOffset = 0;
-		bitOffset = bytesToRead * 8 - samplesToRead * 6 * bitsInSample;
-		//extract x samples
-		for (int i = 0; i < samplesToRead; ++i)
+		for (int index = 0; index < samplesToRead; ++index)
 		{
-		
-			x_samples[index].i = (int) (QADPD_GAIN*ReadBitStream(buffer, bitOffset, bitsInSample, true));
-			x1_samples[index].i = x_samples[index].i;
-			bitOffset += bitsInSample;
-			
-			x_samples[index].r = (int)(QADPD_GAIN*ReadBitStream(buffer, bitOffset, bitsInSample, true));
-			x1_samples[index].r = x_samples[index].r;
-			bitOffset += bitsInSample;
+			x1_samples[index] = x_samples[index];
+			xp1_samples[index] = xp_samples[index];
+			yp1_samples[index] = yp_samples[index];
 
 			y_samples[index].r = 0;  
 			y1_samples[index].r = 0;  
@@ -2185,50 +1932,14 @@ void DPDTest::readdata_qspark() //(wxCommandEvent& event)
 			y1_samples[index].i = 0; 
 			error_samples[index].i = 0;  			
 			u_samples[index].i = 0;
-
-			--index;
-		}
-
-		index = samplesToRead - 1;
-		for (int i = 0; i < samplesToRead; ++i)
-		{
-			//yp i
-			yp_samples[index].i = ReadBitStream(buffer, bitOffset, bitsInSample, true);
-			
-			yp1_samples[index].i = yp_samples[index].i;	
-			bitOffset += bitsInSample;
-
-			//yp q
-			yp_samples[index].r = ReadBitStream(buffer, bitOffset, bitsInSample, true);
-			
-			yp1_samples[index].r = yp_samples[index].r;	
-			bitOffset += bitsInSample;
-
-			//xp i
-			xp_samples[index].i = ReadBitStream(buffer, bitOffset, bitsInSample, true);
-			
-			xp1_samples[index].i = xp_samples[index].i;	
-			bitOffset += bitsInSample;
-			//xp q
-			xp_samples[index].r = ReadBitStream(buffer, bitOffset, bitsInSample, true);
-			
-			xp1_samples[index].r = xp_samples[index].r;	
-			bitOffset += bitsInSample;
-			--index;
 		}
-
-		
 	}
-	delete buffer;
-	buffer = NULL;
 
 	// bilo je i ovo
 	QADPD_SKIP = 0;
 
 }
 
-
-
 int DPDTest::SPI_write(lime::IConnection* dataPort, uint16_t address, uint16_t data) //  LMScomms
 {
 	
@@ -2280,17 +1991,18 @@ wxString DPDTest::PlotFFT(OpenGLGraph* plot, int m_iValue, int m_iCenterFreqRati
 	//int	samplesCount = samplesReceived;
 
 	float nyquist_MHz = mNyquist_MHz;
-	vector<float> freqAxis; //frequency domain x axis
-    freqAxis.resize(samplesCount, 0);
+	vector<float> &freqAxis = fftAxis; //frequency domain x axis
+    freqAxis.assign(samplesCount, 0);
     for (int i = 0; i < samplesCount; ++i)
         freqAxis[i] = 1e6*(-nyquist_MHz + 2 * (i + 1)*nyquist_MHz / samplesCount);
 
-    kiss_fft_cpx *normalizedFFToutput = new kiss_fft_cpx[samplesCount];
-	vector<float> outputs;
-	outputs.resize(samplesCount, 0);
+    fftNormalized.resize(samplesCount);
+    kiss_fft_cpx *normalizedFFToutput = &fftNormalized[0];
+	vector<float> &outputs = fftOutputs;
+	outputs.assign(samplesCount, 0);
 
-	vector <float> zeroes;
-	zeroes.resize(samplesCount, 0);
+	vector <float> &zeroes = fftZeroes;
+	zeroes.assign(samplesCount, 0);
 	for (int i = 0; i < samplesCount; ++i) zeroes[i] = 100.0;
 
 	int output_index = 0;
@@ -2514,8 +2226,6 @@ wxString DPDTest::PlotFFT(OpenGLGraph* plot, int m_iValue, int m_iCenterFreqRati
 	//	m_iFreqSpanRatioPlot, m_dFreqSpanRatioPlot);
 
 	
-
-    delete normalizedFFToutput;
 	return str;
 }
 
@@ -2777,57 +2487,13 @@ wxString DPDTest::PlotTimeDomain(OpenGLGraph* plot, int m_iValue, int m_iXaxisLe
 	return str;
 }
 
-/* @brief Calculates selected window function coefficients
+/* @brief Selects the window function, its coefficients are computed once per size
 @param func window function index
 @param fftsize number of samples for FFT calculations
 */
 void DPDTest::GenerateWindowCoefficients(int func, int fftsize)
 {
-	if (windowFcoefs)
-		delete[]windowFcoefs;
-
-	windowFcoefs = new float[fftsize];
-	float a0 = 0.35875;
-	float a1 = 0.48829;
-	float a2 = 0.14128;
-	float a3 = 0.01168;
-	float a4 = 1;
-	int N = fftsize;
-	float PI = 3.14159265359;
-	switch (func)
-	{
-	case 0:
-		mAmplitudeCorrectionCoef = 1;
-		break;
-	case 1: //blackman-harris		
-		for (int i = 0; i<N; ++i)
-		{
-			windowFcoefs[i] = a0 - a1*cos((2 * PI*i) / (N - 1)) + a2*cos((4 * PI*i) / (N - 1)) - a3*cos((6 * PI*i) / (N - 1));
-			mAmplitudeCorrectionCoef += windowFcoefs[i];
-		}
-		mAmplitudeCorrectionCoef = 1.0 / (mAmplitudeCorrectionCoef / N);
-		break;
-	case 2: //hamming
-		mAmplitudeCorrectionCoef = 0;
-		a0 = 0.54;
-		for (int i = 0; i<N; ++i)
-		{
-			windowFcoefs[i] = a0 - (1 - a0)*cos((2 * PI*i) / (N));
-			mAmplitudeCorrectionCoef += windowFcoefs[i];
-		}
-		mAmplitudeCorrectionCoef = 1.0 / (mAmplitudeCorrectionCoef / N);
-		break;
-	case 3: //hanning
-		mAmplitudeCorrectionCoef = 0;
-		for (int i = 0; i<N; ++i)
-		{
-			windowFcoefs[i] = 0.5 *(1 - cos((2 * PI*i) / (N)));
-			mAmplitudeCorrectionCoef += windowFcoefs[i];
-		}
-		mAmplitudeCorrectionCoef = 1.0 / (mAmplitudeCorrectionCoef / N);
-		break;
-	default:
-		mAmplitudeCorrectionCoef = 1;
-	}
-	//m_windowFunction = func;
+	// tables and plans are kept by the cache, only built for a new size or window
+	spectra.configure(fftsize, func);
+	mAmplitudeCorrectionCoef = spectra.amplitude_correction();
 }
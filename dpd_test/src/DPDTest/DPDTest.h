@@ -43,6 +43,11 @@ namespace lime{
 // class wxNotebook;
 
 #include "qadpd.h"
+#include "coef_upload.h"
+#include "dpd_engine.h"
+#include "dpd_pipeline.h"
+#include "spectrum_cache.h"
+#include <atomic>
 
 
 class DPDTest : public wxFrame
@@ -102,6 +107,8 @@ private:
 	static const long ID_STATICTEXT_12;
 	static const long ID_TEXTCTRL_12;
 	static const long ID_COMBOBOX_WINDOW;
+	static const long ID_STATICTEXT_TRAINING;
+	static const long ID_COMBOBOX_TRAINING;
 
 	static const long ID_TEXTCTRL_NUM;
 	static const long ID_BUTTON_TIMER;
@@ -212,6 +219,8 @@ private:
 	wxTextCtrl * m_ADPD_txtTrain;
 
 	wxComboBox * cmbWindowFunction;
+	wxStaticText * StaticText_TRAINING;
+	wxComboBox * cmbTraining;
 
 	wxRadioBox * TrainMode;
 	wxStaticBoxSizer * StaticBoxSizerADPD6;
@@ -275,6 +284,9 @@ protected:
 	int QADPD_FFT1;
 	int QADPD_FFT2;
 	int QADPD_UPDATE;
+	int QADPD_TRAINING;
+	int QADPD_DELAYRANGE;	// delay search covers lags -QADPD_DELAYRANGE..QADPD_DELAYRANGE
+	bool QADPD_FRACDELAY;	// align the sub-sample delay too
 	double QADPD_SPAN;
 
 	qadpd * Qadpd;
@@ -301,7 +313,6 @@ protected:
 	void OnChangePlot();
 
 	int train();
-	int prepare_train();
 	//void readdata();
 	void readdata_qspark();
 
@@ -388,9 +399,20 @@ public:
 	void OnYaxisChange(OpenGLGraph * plot, int m_iYaxisTopPlot, int  m_iYaxisBottomPlot);
 	void OnCenterSpanChange(OpenGLGraph * plot, int m_iCenterFreqRatioPlot, double m_dCenterFreqRatioPlot,
 		int m_iFreqSpanRatioPlot, double m_dFreqSpanRatioPlot);
-	void send_coef();
+	int send_coef();
+	coef_upload::uploader coefUploader;
+	std::atomic<bool> coefUploadFailed;	// set by the pipeline, reported by OnTimer
+	dpd_engine engine;
+	dpd_pipeline pipeline;		// continuous mode, off the GUI thread
+	unsigned long shownFrame;	// seq of the plotted pipeline frame
+	dpd_pipeline_config pipeline_config();
+	void show_frame(const dpd_frame &f);
+	void read_fft_settings();
+	void plot_all();
 	void run_QADPD();
-	float * windowFcoefs;
+	spectrum_cache spectra;		// plans and windows of the one step path
+	std::vector<float> fftAxis, fftOutputs, fftZeroes;	// PlotFFT() buffers, kept between plots
+	std::vector<kiss_fft_cpx> fftNormalized;
 	void GenerateWindowCoefficients(int func, int fftsize);
 	double mAmplitudeCorrectionCoef;
 	int m_iWindowFunc;
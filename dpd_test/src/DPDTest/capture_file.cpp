@@ -0,0 +1,101 @@
+/* --------------------------------------------------------------------------------------------
+FILE:		capture_file.cpp
+DESCRIPTION  Recorded DPD captures
+CONTENT:
+AUTHOR:		Lime Microsystems LTD
+DATE:
+-------------------------------------------------------------------------------------------- */
+#include "capture_file.h"
+#include "dpd_board.h"
+
+#include <stdint.h>
+#include <string.h>
+
+namespace capture_file {
+
+static const char MAGIC[8] = { 'D', 'P', 'D', 'C', 'A', 'P', '0', '1' };
+static const long HEADER = 16;
+
+static void put_u32(unsigned char *p, uint32_t v)
+{
+	for (int i = 0; i < 4; i++) p[i] = (unsigned char)(v >> (8*i));
+}
+
+static uint32_t get_u32(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+int writer::open(const char *path, long samples, int bits)
+{
+	close();
+	fp = fopen(path, "wb");
+	if (!fp) return -1;
+	unsigned char head[HEADER];
+	memcpy(head, MAGIC, 8);
+	put_u32(head + 8, (uint32_t)samples);
+	put_u32(head + 12, (uint32_t)bits);
+	bytes = dpd_board::burst_bytes(samples, bits);
+	if (fwrite(head, 1, HEADER, fp) != (size_t)HEADER) {
+		close();
+		return -1;
+	}
+	return 0;
+}
+
+int writer::append(const std::vector<unsigned char> &burst)
+{
+	if (!fp) return -1;
+	long len = ((long)burst.size() < bytes) ? (long)burst.size() : bytes;
+	if (len > 0 && fwrite(&burst[0], 1, len, fp) != (size_t)len) return -1;
+	for (long i = len; i < bytes; i++)
+		if (fputc(0, fp) == EOF) return -1;
+	return 0;
+}
+
+void writer::close()
+{
+	if (fp) fclose(fp);
+	fp = 0;
+}
+
+int reader::open(const char *path)
+{
+	close();
+	fp = fopen(path, "rb");
+	if (!fp) return -1;
+	unsigned char head[HEADER];
+	if (fread(head, 1, HEADER, fp) != (size_t)HEADER || memcmp(head, MAGIC, 8) != 0) {
+		close();
+		return -1;
+	}
+	n = get_u32(head + 8);
+	width = get_u32(head + 12);
+	if (n <= 0 || (width != 12 && width != 14 && width != 16)) {
+		close();
+		return -1;
+	}
+	bytes = dpd_board::burst_bytes(n, width);
+	return 0;
+}
+
+int reader::next(std::vector<unsigned char> &burst)
+{
+	if (!fp) return -1;
+	burst.resize(bytes);
+	if (fread(&burst[0], 1, bytes, fp) != (size_t)bytes) return -1;
+	return 0;
+}
+
+void reader::rewind()
+{
+	if (fp) fseek(fp, HEADER, SEEK_SET);
+}
+
+void reader::close()
+{
+	if (fp) fclose(fp);
+	fp = 0;
+}
+
+}
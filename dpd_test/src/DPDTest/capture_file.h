@@ -0,0 +1,61 @@
+/* --------------------------------------------------------------------------------------------
+FILE:		capture_file.h
+DESCRIPTION  Recorded DPD captures. A file holds an 8 byte magic "DPDCAP01", the samples per
+		burst and the field width as little endian uint32, then the raw bursts exactly as
+		dpd_board::capture() received them, burst_bytes(samples, bits) bytes each.
+CONTENT:
+AUTHOR:		Lime Microsystems LTD
+DATE:
+-------------------------------------------------------------------------------------------- */
+#ifndef CAPTURE_FILE_H
+#define CAPTURE_FILE_H
+
+#include <stdio.h>
+#include <vector>
+
+namespace capture_file {
+	class writer {
+	public:
+		writer() : fp(0), bytes(0) {}
+		~writer() { close(); }
+
+		// Creates the file and writes the header, returns -1 on failure
+		int open(const char *path, long samples, int bits);
+		// Appends one burst, shorter bursts are zero padded. Returns -1 on failure.
+		int append(const std::vector<unsigned char> &burst);
+		void close();
+
+	private:
+		writer(const writer &);
+		writer &operator=(const writer &);
+		FILE *fp;
+		long bytes;
+	};
+
+	class reader {
+	public:
+		reader() : fp(0), n(0), width(0), bytes(0) {}
+		~reader() { close(); }
+
+		// Opens the file and reads the header, returns -1 if it is not a capture file
+		int open(const char *path);
+		// Reads the next burst, returns -1 at the end of the file
+		int next(std::vector<unsigned char> &burst);
+		// Starts again from the first burst
+		void rewind();
+		void close();
+
+		long samples() const { return n; }
+		int bits() const { return width; }
+
+	private:
+		reader(const reader &);
+		reader &operator=(const reader &);
+		FILE *fp;
+		long n;
+		int width;
+		long bytes;
+	};
+}
+
+#endif
@@ -0,0 +1,120 @@
+/* --------------------------------------------------------------------------------------------
+FILE:		coef_upload.cpp
+DESCRIPTION  Upload of the QADPD coefficient table to the gateware in one register batch
+CONTENT:
+AUTHOR:		Lime Microsystems LTD
+DATE:
+-------------------------------------------------------------------------------------------- */
+#include "coef_upload.h"
+#include "dense_matrix.h"
+#include "IConnection.h"
+
+namespace coef_upload {
+
+// ADPD registers sit behind the board SPI offset used by DPDTest::SPI_write
+static const uint32_t REG_OFFSET = 2 * 32;
+static const uint32_t SPI_CTRL = 0x0012 + REG_OFFSET;
+static const uint32_t SPI_DATA = 0x0016 + REG_OFFSET;
+
+word encode(double v, double am, bool isB, int i, int j)
+{
+	// 16 MSBs go to spi_data, the 2 LSBs ride in bits 8..9 of spi_ctrl
+	int temp_i = (int)(am * v * 4.0 + 0.5);
+	word w;
+	w.data = (uint16_t)(short)(temp_i >> 2);
+	w.ctrl = (uint16_t)((isB ? 0xC000 : 0x3000) + ((temp_i & 0x0003) << 8) + i * 16 + j);
+	return w;
+}
+
+// Limits v to the open interval (-range, range)
+static double limit(double &v, double range)
+{
+	const double eps = 0.002;
+	if (v > range) v = range - eps;
+	if (v < -range) v = -range + eps;
+	return v;
+}
+
+void quantize(dense::mat &a, dense::mat &b, int n, int m, double range, table &t)
+{
+	// 1.0 is 8192*4/range, for [-16, 16] 8192/4 and for [-4, 4] 8192
+	double am = 8192.0 * 4.0 / range;
+
+	for (int i = 0; i < ROWS; i++) {
+		for (int j = 0; j < COLS; j++) {
+			double a1 = 0.0, b1 = 0.0;
+			if ((i <= n) && (j <= m)) {
+				a1 = limit(a[i][j], range);
+				b1 = limit(b[i][j], range);
+			}
+			t.a[i][j] = encode(a1, am, false, i, j);
+			t.b[i][j] = encode(b1, am, true, i, j);
+		}
+	}
+}
+
+static inline void push(std::vector<uint32_t> &addrs, std::vector<uint32_t> &values, uint32_t addr, uint32_t value)
+{
+	addrs.push_back(addr);
+	values.push_back(value);
+}
+
+static inline void push_word(std::vector<uint32_t> &addrs, std::vector<uint32_t> &values, const word &w)
+{
+	push(addrs, values, SPI_DATA, w.data);
+	push(addrs, values, SPI_CTRL, w.ctrl);
+	push(addrs, values, SPI_CTRL, 0x0000);
+}
+
+uploader::uploader() : valid(false)
+{
+	addrs.reserve(6 * ROWS * COLS + 5);
+	values.reserve(6 * ROWS * COLS + 5);
+}
+
+void uploader::invalidate()
+{
+	valid = false;
+}
+
+static bool same(const table &x, const table &y)
+{
+	for (int i = 0; i < ROWS; i++)
+		for (int j = 0; j < COLS; j++)
+			if (x.a[i][j] != y.a[i][j] || x.b[i][j] != y.b[i][j]) return false;
+	return true;
+}
+
+int uploader::upload(lime::IConnection *port, const table &next)
+{
+	addrs.clear();
+	values.clear();
+	if (valid && same(next, committed))
+		return 0;
+
+	// every slot is rewritten, the gateware may not keep the others across a commit
+	push(addrs, values, SPI_CTRL, 0x0000);
+	push(addrs, values, SPI_DATA, 0x0000);
+	for (int i = 0; i < ROWS; i++)
+		for (int j = 0; j < COLS; j++) {
+			push_word(addrs, values, next.a[i][j]);
+			push_word(addrs, values, next.b[i][j]);
+		}
+
+	// commit strobe, then leave the interface idle
+	push(addrs, values, SPI_CTRL, 0xF000);
+	push(addrs, values, SPI_CTRL, 0x0000);
+	push(addrs, values, SPI_DATA, 0x0000);
+
+	int ret = port->WriteRegisters(addrs.data(), values.data(), addrs.size());
+	if (ret != 0) {
+		// part of the batch may have landed, resend everything next time
+		valid = false;
+		return ret;
+	}
+	committed = next;
+	valid = true;
+	return 0;
+}
+
+}
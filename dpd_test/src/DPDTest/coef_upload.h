@@ -0,0 +1,75 @@
+/* --------------------------------------------------------------------------------------------
+FILE:		coef_upload.h
+DESCRIPTION  Upload of the QADPD coefficient table to the gateware in one register batch.
+		Each a/b word is written to spi_data (0x16) and strobed into its slot by
+		spi_ctrl (0x12), the 0xF000 strobe then commits the whole table at once.
+CONTENT:
+AUTHOR:		Lime Microsystems LTD
+DATE:
+-------------------------------------------------------------------------------------------- */
+#ifndef COEF_UPLOAD_H
+#define COEF_UPLOAD_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace lime {
+	class IConnection;
+}
+namespace dense {
+	class mat;
+}
+
+namespace coef_upload {
+	const int ROWS = 6;		// nonlinearity order slots in the gateware
+	const int COLS = 4;		// memory depth slots in the gateware
+
+	// spi_data and spi_ctrl words of one coefficient
+	struct word {
+		uint16_t data;
+		uint16_t ctrl;
+		bool operator==(const word &o) const { return data == o.data && ctrl == o.ctrl; }
+		bool operator!=(const word &o) const { return !(*this == o); }
+	};
+
+	struct table {
+		word a[ROWS][COLS];
+		word b[ROWS][COLS];
+	};
+
+	// Fixed point words of coefficient v at slot (i, j), am is the scale of 1.0
+	word encode(double v, double am, bool isB, int i, int j);
+
+	// Table of the coefficients a[i][j], b[i][j] for i <= n, j <= m, other
+	// slots are zero. Coefficients outside (-range, range) are limited in
+	// a and b too, range sets the fixed point scale.
+	void quantize(dense::mat &a, dense::mat &b, int n, int m, double range, table &t);
+
+	// Keeps a host copy of the last committed table. An upload that equals
+	// it is skipped, any other upload writes every slot: what the gateware
+	// holds in slots that were not written before a commit is not known.
+	class uploader {
+	public:
+		uploader();
+
+		// Next upload() is sent even if the table did not change (first
+		// upload, board reset)
+		void invalidate();
+
+		// Sends every slot of next and the commit strobe with a single
+		// WriteRegisters() call, unless next is the committed table.
+		// On success next becomes the committed table.
+		int upload(lime::IConnection *port, const table &next);
+
+		// Register writes issued by the last upload()
+		size_t last_writes() const { return addrs.size(); }
+
+	private:
+		table committed;	// table the gateware is running
+		bool valid;			// committed matches the gateware
+		std::vector<uint32_t> addrs, values;
+	};
+}
+
+#endif
@@ -0,0 +1,215 @@
+/* --------------------------------------------------------------------------------------------
+FILE:		delay_align.cpp
+DESCRIPTION  Alignment of the PA feedback signal (x) to the predistorter output (xp)
+CONTENT:
+AUTHOR:		Lime Microsystems LTD
+DATE:
+-------------------------------------------------------------------------------------------- */
+#include "delay_align.h"
+#include "qadpd.h"
+#include "mpoly_kernels.h"
+#include "worker_pool.h"
+
+#include <math.h>
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+#define SEARCH_CHUNK 256	// samples scored between checks of the best score
+#define SHIFT_TAPS 8		// one sided length of the interpolation filter
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace delay_align {
+
+int search(const qadpd *q, const kiss_fft_cpx *xp, const kiss_fft_cpx *x, const kiss_fft_cpx *yp,
+	int len, int range, int skip, int limit, bool Yp_FPGA, worker_pool *pool, double *score)
+{
+	int i0 = skip + 1;		// first scored sample
+	int warm = q->n + q->nd;	// samples needed before i0 for exact y and u
+	int nlags = 2 * range + 1;
+	int n = q->n, m = q->m;
+
+	// Scored samples of lag 0, later lags stop earlier when x runs out
+	int i1 = skip + 1 + limit;
+	if (i1 > len) i1 = len;
+	if (i1 <= i0) {
+		if (score) *score = HUGE_VAL;
+		return 0;
+	}
+
+	// u does not depend on the lag, evaluated once over [s0, i1)
+	int s0 = i0 - warm;
+	if (s0 < 0) s0 = 0;
+	int count = i1 - s0;
+	std::vector<double> xIp(count), xQp(count), xI(count), xQ(count), yIp(count), yQp(count);
+	for (int i = 0; i < count; i++) {
+		xIp[i] = xp[s0 + i].r; xQp[i] = xp[s0 + i].i;
+		xI[i] = x[s0 + i].r; xQ[i] = x[s0 + i].i;
+		yIp[i] = yp[s0 + i].r; yQp[i] = yp[s0 + i].i;
+	}
+	std::vector<double> y0I(count), y0Q(count), uI(count), uQ(count);
+	q->oeval_block(&xIp[0], &xQp[0], &xI[0], &xQ[0], &yIp[0], &yQp[0], count, Yp_FPGA,
+		&y0I[0], &y0Q[0], &uI[0], &uQ[0], 0);
+
+	// Basis of x over every sample a lag can read, zeros outside the capture.
+	// Built once, lag L reads it shifted by L instead of rebuilding it.
+	int b0 = s0 - range - n;	// capture index of basis column 0
+	int stride = (i1 + range) - b0;
+	std::vector<double> wI(stride, 0.0), wQ(stride, 0.0);
+	for (int k = 0; k < stride; k++) {
+		int i = b0 + k;
+		if ((i < 0) || (i >= len)) continue;
+		wI[k] = x[i].r;
+		wQ[k] = x[i].i;
+	}
+	std::vector<double> pI((m+1)*stride), pQ((m+1)*stride);
+	q->basis(&wI[0], &wQ[0], stride, &pI[0], &pQ[0], stride);
+	double am = q->am;
+
+	// Candidates ordered 0, +1, -1, +2, -2 ... so likely lags finish first
+	std::vector<int> lags(nlags);
+	for (int k = 0; k < nlags; k++) lags[k] = (k & 1) ? (k + 1) / 2 : -(k / 2);
+	std::vector<double> sums(nlags, 0.0);
+	std::vector<bool> done(nlags, false);
+
+	std::mutex lock;
+	double best = HUGE_VAL;
+	std::atomic<int> next(0);
+
+	auto worker = [&]() {
+		std::vector<double> yI(SEARCH_CHUNK), yQ(SEARCH_CHUNK);
+		int k;
+		while ((k = next++) < nlags) {
+			int L = lags[k];
+			int e1 = i1;
+			if (e1 > len - (L > 0 ? L : 0)) e1 = len - (L > 0 ? L : 0);
+			double sum = 0.0;
+			bool dropped = false;
+
+			for (int c0 = i0; c0 < e1; c0 += SEARCH_CHUNK) {
+				int c1 = (c0 + SEARCH_CHUNK < e1) ? (c0 + SEARCH_CHUNK) : e1;
+				int off = c0 + L - b0;
+				q->eval_basis(&pI[off], &pQ[off], stride, c1 - c0, &yI[0], &yQ[0]);
+				mpoly::clip(&yI[0], c1 - c0, 0 - am, am - 1);
+				mpoly::clip(&yQ[0], c1 - c0, 0 - am, am - 1);
+				for (int i = c0; i < c1; i++) {
+					double dI = yI[i - c0] - uI[i - s0];
+					double dQ = yQ[i - c0] - uQ[i - s0];
+					sum += fabs(sqrt(dI*dI + dQ*dQ))/am;
+				}
+
+				std::lock_guard<std::mutex> guard(lock);
+				if (sum > best) { dropped = true; break; }
+			}
+
+			std::lock_guard<std::mutex> guard(lock);
+			sums[k] = sum;
+			if (!dropped) {
+				done[k] = true;
+				if (sum < best) best = sum;
+			}
+		}
+	};
+
+	int nthreads = pool ? pool->size() : 1;
+	if (nthreads > nlags) nthreads = nlags;
+	if (nthreads > 1) pool->run(nthreads, [&](int) { worker(); });
+	else worker();
+
+	// Smallest finished score, ties go to the smaller |lag|
+	int ind = 0;
+	double minim = HUGE_VAL;
+	for (int k = 0; k < nlags; k++) {
+		if (done[k] && (sums[k] < minim)) {
+			minim = sums[k];
+			ind = lags[k];
+		}
+	}
+	if (score) *score = minim;
+	return ind;
+}
+
+double xcorr_lag(const kiss_fft_cpx *xp, const kiss_fft_cpx *x, int len, int range, int skip, int limit)
+{
+	if (skip + limit > len) limit = len - skip;
+	if (limit <= 2 * range + 2) return 0.0;
+
+	// Zero padded to twice the window, so lags do not wrap around
+	int nfft = kiss_fft_next_fast_size(2 * limit);
+	std::vector<kiss_fft_cpx> a(nfft), b(nfft), A(nfft), B(nfft);
+	for (int i = 0; i < nfft; i++) {
+		a[i].r = a[i].i = 0;
+		b[i].r = b[i].i = 0;
+	}
+	for (int i = 0; i < limit; i++) {
+		a[i] = xp[skip + i];
+		b[i] = x[skip + i];
+	}
+
+	kiss_fft_cfg fwd = kiss_fft_alloc(nfft, 0, 0, 0);
+	kiss_fft_cfg inv = kiss_fft_alloc(nfft, 1, 0, 0);
+	kiss_fft(fwd, &a[0], &A[0]);
+	kiss_fft(fwd, &b[0], &B[0]);
+
+	// R[d] = sum x[i+d]*conj(xp[i]) = IFFT(B*conj(A))
+	for (int k = 0; k < nfft; k++) {
+		double re = B[k].r*A[k].r + B[k].i*A[k].i;
+		double im = B[k].i*A[k].r - B[k].r*A[k].i;
+		A[k].r = (kiss_fft_scalar)re;
+		A[k].i = (kiss_fft_scalar)im;
+	}
+	kiss_fft(inv, &A[0], &B[0]);
+	kiss_fft_free(fwd);
+	kiss_fft_free(inv);
+
+	// One extra lag each side, so a peak at +-range can still be interpolated
+	std::vector<double> mag(2 * range + 3);
+	for (int d = -range - 1; d <= range + 1; d++) {
+		const kiss_fft_cpx &r = B[(d + nfft) % nfft];
+		mag[d + range + 1] = sqrt((double)r.r*r.r + (double)r.i*r.i);
+	}
+	int peak = 1;
+	for (int k = 2; k <= 2 * range + 1; k++)
+		if (mag[k] > mag[peak]) peak = k;
+
+	double lag = peak - range - 1;
+	double ym = mag[peak - 1], y0 = mag[peak], yp = mag[peak + 1];
+	double den = ym - 2.0*y0 + yp;
+	if (den < 0.0) lag += 0.5*(ym - yp)/den;
+	return lag;
+}
+
+void shift(kiss_fft_cpx *x, int len, double frac)
+{
+	if (frac == 0.0) return;
+
+	double h[2 * SHIFT_TAPS];
+	double norm = 0.0;
+	for (int k = 0; k < 2 * SHIFT_TAPS; k++) {
+		double t = k - (SHIFT_TAPS - 1) - frac;	// tap k reads x[i + k - SHIFT_TAPS + 1]
+		double s = (fabs(t) < 1e-12) ? 1.0 : sin(M_PI*t)/(M_PI*t);
+		double w = 0.42 + 0.5*cos(M_PI*t/SHIFT_TAPS) + 0.08*cos(2.0*M_PI*t/SHIFT_TAPS);	// Blackman
+		h[k] = s*w;
+		norm += h[k];
+	}
+	for (int k = 0; k < 2 * SHIFT_TAPS; k++) h[k] /= norm;
+
+	std::vector<kiss_fft_cpx> src(x, x + len);
+	for (int i = 0; i < len; i++) {
+		double re = 0.0, im = 0.0;
+		for (int k = 0; k < 2 * SHIFT_TAPS; k++) {
+			int j = i + k - SHIFT_TAPS + 1;
+			if (j < 0) j = 0;
+			if (j >= len) j = len - 1;
+			re += h[k]*src[j].r;
+			im += h[k]*src[j].i;
+		}
+		x[i].r = (kiss_fft_scalar)re;
+		x[i].i = (kiss_fft_scalar)im;
+	}
+}
+
+}
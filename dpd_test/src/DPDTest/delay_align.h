@@ -0,0 +1,36 @@
+/* --------------------------------------------------------------------------------------------
+FILE:		delay_align.h
+DESCRIPTION  Alignment of the PA feedback signal (x) to the predistorter output (xp).
+		Integer lags are scored with the memory polynomial on a worker pool,
+		fractional lags are estimated by FFT cross-correlation.
+CONTENT:
+AUTHOR:		Lime Microsystems LTD
+DATE:
+-------------------------------------------------------------------------------------------- */
+#ifndef DELAY_ALIGN_H
+#define DELAY_ALIGN_H
+
+#include "kiss_fft.h"
+
+class qadpd;
+class worker_pool;
+
+namespace delay_align {
+	// Lag L in [-range, range] minimising the sum of qadpd::err over samples
+	// skip+1 .. skip+limit, with xp[i] and yp[i] paired to x[i+L].
+	// Lags run on the threads of pool, or on the calling thread when pool is
+	// null. A lag is dropped as soon as its partial sum exceeds the best
+	// finished one. Returns the lag, its score in *score.
+	int search(const qadpd *q, const kiss_fft_cpx *xp, const kiss_fft_cpx *x, const kiss_fft_cpx *yp,
+		int len, int range, int skip, int limit, bool Yp_FPGA, worker_pool *pool, double *score = 0);
+
+	// Lag of x against xp, in samples, from the peak of the cross-correlation
+	// over samples skip .. skip+limit-1. Peak is searched in [-range, range]
+	// and refined by parabolic interpolation.
+	double xcorr_lag(const kiss_fft_cpx *xp, const kiss_fft_cpx *x, int len, int range, int skip, int limit);
+
+	// x[i] <- x[i+frac], |frac| <= 0.5, windowed sinc interpolation
+	void shift(kiss_fft_cpx *x, int len, double frac);
+}
+
+#endif
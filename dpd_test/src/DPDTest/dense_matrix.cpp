@@ -0,0 +1,296 @@
+/* --------------------------------------------------------------------------------------------
+FILE:		dense_matrix.cpp
+DESCRIPTION  Contiguous, 64-byte aligned vectors and matrices for the DPD engine, and the
+		nrc linear solvers ported onto them
+CONTENT:
+AUTHOR:		Lime Microsystems LTD
+DATE:
+-------------------------------------------------------------------------------------------- */
+#include "dense_matrix.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+#define TINY 1.0e-20
+#define ITMAX 100
+#define ITMIN 10
+#define TOL 1.0e-7
+
+namespace dense {
+
+double *alloc(size_t count)
+{
+	if (count == 0) return 0;
+	void *p = 0;
+#ifdef _MSC_VER
+	p = _aligned_malloc(count*sizeof(double), ALIGN);
+#else
+	if (posix_memalign(&p, ALIGN, count*sizeof(double)) != 0) p = 0;
+#endif
+	if (!p) {
+		printf("Allocation failure in dense::alloc().\n");
+		return 0;
+	}
+	memset(p, 0, count*sizeof(double));
+	return (double *)p;
+}
+
+void release(double *p)
+{
+	if (!p) return;
+#ifdef _MSC_VER
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+void vec::resize(int size)
+{
+	release(p);
+	p = alloc(size);
+	n = p ? size : 0;
+}
+
+void vec::fill(double v)
+{
+	for (int i = 0; i < n; i++) p[i] = v;
+}
+
+void mat::resize(int rows, int cols, layout l)
+{
+	const int perLine = ALIGN / sizeof(double);
+	int inner = (l == ROW_MAJOR) ? cols : rows;
+	int outer = (l == ROW_MAJOR) ? rows : cols;
+
+	release(p);
+	order = l;
+	ldim = (inner + perLine - 1) / perLine * perLine;
+	p = alloc((size_t)outer*ldim);
+	r = p ? rows : 0;
+	c = p ? cols : 0;
+	if (!p) ldim = 0;
+}
+
+void mat::fill(double v)
+{
+	int outer = (order == ROW_MAJOR) ? r : c;
+	int inner = (order == ROW_MAJOR) ? c : r;
+	for (int i = 0; i < outer; i++) {
+		double *row = p + (ptrdiff_t)i*ldim;
+		for (int j = 0; j < inner; j++) row[j] = v;
+	}
+}
+
+void mat::copy(const mat &src)
+{
+	if (src.order == order && src.ldim == ldim) {
+		memcpy(p, src.p, (size_t)((order == ROW_MAJOR) ? r : c)*ldim*sizeof(double));
+		return;
+	}
+	for (int i = 0; i < r; i++)
+		for (int j = 0; j < c; j++) (*this)(i, j) = src(i, j);
+}
+
+view mat::all() const
+{
+	view v;
+	v.data = p;
+	v.rows = r;
+	v.cols = c;
+	v.rs = (order == ROW_MAJOR) ? ldim : 1;
+	v.cs = (order == ROW_MAJOR) ? 1 : ldim;
+	return v;
+}
+
+/* ******************************************************************** */
+/* LU Decomposition, right-looking form of nrc::ludcmp().		*/
+/* Every element gets its updates in the same order as in the Crout	*/
+/* loops of nrc::ludcmp(), so the factors are the same.		*/
+/* ******************************************************************** */
+int ludcmp(mat &a, int *indx, double *d)
+{
+	int n = a.rows();
+	int i, j, k, imax;
+	double big, dum, temp;
+	vec vv(n);
+
+	*d = 1.0;
+	for (i = 0; i < n; i++) {
+		const double *ai = a[i];
+		big = 0.0;
+		for (j = 0; j < n; j++)
+			if ((temp = fabs(ai[j])) > big) big = temp;
+		if (!big) {
+			printf("Singular matrix in routine LUDCMP\n");
+			return -1;
+		}
+		vv[i] = 1.0 / big;
+	}
+
+	for (j = 0; j < n; j++) {
+		big = 0.0;
+		imax = j;
+		for (i = j; i < n; i++) {
+			if ((dum = vv[i] * fabs(a[i][j])) >= big) {
+				big = dum;
+				imax = i;
+			}
+		}
+		if (j != imax) {
+			double *rj = a[j];
+			double *rm = a[imax];
+			for (k = 0; k < n; k++) {
+				dum = rm[k];
+				rm[k] = rj[k];
+				rj[k] = dum;
+			}
+			*d = -(*d);
+			vv[imax] = vv[j];
+		}
+		indx[j] = imax;
+		if (fabs(a[j][j]) <= TINY) a[j][j] = TINY;
+
+		if (j != n - 1) {
+			const double *rj = a[j];
+			dum = 1.0 / rj[j];
+			for (i = j + 1; i < n; i++) {
+				double *ri = a[i];
+				double l = (ri[j] *= dum);
+				for (k = j + 1; k < n; k++) ri[k] -= l * rj[k];
+			}
+		}
+	}
+	return 0;
+}
+
+void lubksb(const mat &a, const int *indx, double *b)
+{
+	int n = a.rows();
+	int i, ii = -1, ip, j;
+	double sum;
+
+	for (i = 0; i < n; i++) {
+		const double *ai = a[i];
+		ip = indx[i];
+		sum = b[ip];
+		b[ip] = b[i];
+		if (ii >= 0) {
+			for (j = ii; j <= i - 1; j++) sum -= ai[j] * b[j];
+		}
+		else if (sum) {
+			ii = i;
+		}
+		b[i] = sum;
+	}
+	for (i = n - 1; i >= 0; i--) {
+		const double *ai = a[i];
+		sum = b[i];
+		for (j = i + 1; j < n; j++) sum -= ai[j] * b[j];
+		b[i] = sum / ai[i];
+	}
+}
+
+int zcholdc(mat &ar, mat &ai, double *p)
+{
+	int n = ar.rows();
+	int i, j, k;
+	double sr, si;
+
+	for (i = 0; i < n; i++) {
+		const double *ari = ar[i], *aii = ai[i];
+		for (j = i; j < n; j++) {
+			double *arj = ar[j], *aij = ai[j];
+			// G(j, i) = conj(G(i, j)) - sum L(j, k)*conj(L(i, k))
+			sr = ari[j];
+			si = -aii[j];
+			for (k = i - 1; k >= 0; k--) {
+				sr -= arj[k] * ari[k] + aij[k] * aii[k];
+				si -= aij[k] * ari[k] - arj[k] * aii[k];
+			}
+			if (i == j) {
+				if (sr <= 0.0) return -1; // Not positive definite
+				p[i] = sqrt(sr);
+			}
+			else {
+				arj[i] = sr / p[i];
+				aij[i] = si / p[i];
+			}
+		}
+	}
+	return 0;
+}
+
+void zcholsl(const mat &ar, const mat &ai, const double *p, const double *br, const double *bi,
+	double *xr, double *xi)
+{
+	int n = ar.rows();
+	int i, k;
+	double sr, si;
+
+	// L*y = b
+	for (i = 0; i < n; i++) {
+		const double *ari = ar[i], *aii = ai[i];
+		for (sr = br[i], si = bi[i], k = i - 1; k >= 0; k--) {
+			sr -= ari[k] * xr[k] - aii[k] * xi[k];
+			si -= ari[k] * xi[k] + aii[k] * xr[k];
+		}
+		xr[i] = sr / p[i];
+		xi[i] = si / p[i];
+	}
+	// L^H*x = y
+	for (i = n - 1; i >= 0; i--) {
+		for (sr = xr[i], si = xi[i], k = i + 1; k < n; k++) {
+			double lr = ar[k][i], li = ai[k][i];
+			sr -= lr * xr[k] + li * xi[k];
+			si -= lr * xi[k] - li * xr[k];
+		}
+		xr[i] = sr / p[i];
+		xi[i] = si / p[i];
+	}
+}
+
+void lgrad(const mat &a, const double *b, double *x, double alpha)
+{
+	int n = a.rows();
+	double e, xx;
+
+	for (int iter = 0; iter < ITMAX; iter++) {
+		e = 0.0;
+		for (int i = 0; i < n; i++) {
+			const double *ai = a[i];
+			xx = x[i] + alpha*b[i];
+			for (int j = 0; j < n; j++) xx -= alpha*ai[j] * x[j];
+			e += fabs(x[i] - xx);
+			x[i] = xx;
+		}
+		if ((e < TOL) && (iter > ITMIN)) break;
+	}
+}
+
+void gauss_seidel(const mat &a, const double *b, double *x)
+{
+	int n = a.rows();
+	double e, xx;
+
+	for (int iter = 0; iter < ITMAX; iter++) {
+		e = 0.0;
+		for (int i = 0; i < n; i++) {
+			const double *ai = a[i];
+			xx = b[i];
+			for (int j = 0; j < i; j++) xx -= ai[j] * x[j];
+			for (int j = i + 1; j < n; j++) xx -= ai[j] * x[j];
+			xx /= ai[i];
+			e += fabs(x[i] - xx);
+			x[i] = xx;
+		}
+		if ((e < TOL) && (iter > ITMIN)) break;
+	}
+}
+
+}
@@ -0,0 +1,121 @@
+/* --------------------------------------------------------------------------------------------
+FILE:		dense_matrix.h
+DESCRIPTION  Contiguous, 64-byte aligned vectors and matrices for the DPD engine, and the
+		nrc linear solvers ported onto them. Indices are 0-based. Rows (or columns
+		of a column-major matrix) start on a cache line, so inner loops run over
+		contiguous memory instead of through row pointers.
+CONTENT:
+AUTHOR:		Lime Microsystems LTD
+DATE:
+-------------------------------------------------------------------------------------------- */
+#ifndef DENSE_MATRIX_H
+#define DENSE_MATRIX_H
+
+#include <stddef.h>
+
+namespace dense {
+	const int ALIGN = 64;	// bytes
+
+	// Zero filled storage of count doubles, aligned to ALIGN
+	double *alloc(size_t count);
+	void release(double *p);
+
+	// Strided access to a matrix, element (i, j) is data[i*rs + j*cs]
+	struct view {
+		double *data;
+		int rows, cols;
+		ptrdiff_t rs, cs;
+		double &operator()(int i, int j) const { return data[i*rs + j*cs]; }
+		view t() const { view v = { data, cols, rows, cs, rs }; return v; }
+	};
+
+	class vec {
+	public:
+		vec() : p(0), n(0) {}
+		explicit vec(int size) : p(0), n(0) { resize(size); }
+		~vec() { release(p); }
+
+		// Reallocates to size elements, all zero
+		void resize(int size);
+		void clear() { resize(0); }
+		void fill(double v);
+
+		int size() const { return n; }
+		double *data() { return p; }
+		const double *data() const { return p; }
+		double &operator[](int i) { return p[i]; }
+		double operator[](int i) const { return p[i]; }
+
+	private:
+		vec(const vec &);
+		vec &operator=(const vec &);
+		double *p;
+		int n;
+	};
+
+	class mat {
+	public:
+		enum layout { ROW_MAJOR, COL_MAJOR };
+
+		mat() : p(0), r(0), c(0), ldim(0), order(ROW_MAJOR) {}
+		mat(int rows, int cols, layout l = ROW_MAJOR) : p(0), r(0), c(0), ldim(0), order(l) { resize(rows, cols, l); }
+		~mat() { release(p); }
+
+		// Reallocates to rows x cols, all zero
+		void resize(int rows, int cols, layout l = ROW_MAJOR);
+		void clear() { resize(0, 0, order); }
+		void fill(double v);
+		// Copies the values of a matrix of the same size
+		void copy(const mat &src);
+
+		int rows() const { return r; }
+		int cols() const { return c; }
+		int ld() const { return ldim; }		// doubles between consecutive rows (columns)
+		layout storage() const { return order; }
+		double *data() { return p; }
+		const double *data() const { return p; }
+
+		// Row i of a row-major matrix, column i of a column-major one.
+		// For row-major storage m[i][j] is element (i, j).
+		double *operator[](int i) { return p + (ptrdiff_t)i*ldim; }
+		const double *operator[](int i) const { return p + (ptrdiff_t)i*ldim; }
+
+		double &operator()(int i, int j) { return (order == ROW_MAJOR) ? p[(ptrdiff_t)i*ldim + j] : p[(ptrdiff_t)j*ldim + i]; }
+		double operator()(int i, int j) const { return (order == ROW_MAJOR) ? p[(ptrdiff_t)i*ldim + j] : p[(ptrdiff_t)j*ldim + i]; }
+
+		// (i, j) access whatever the storage, t() of it gives the transpose
+		view all() const;
+
+	private:
+		mat(const mat &);
+		mat &operator=(const mat &);
+		double *p;
+		int r, c, ldim;
+		layout order;
+	};
+
+	// Solvers of nrc.h on 0-based row-major matrices, with the same numerics.
+	// ludcmp() is right-looking, every update runs along a contiguous row.
+
+	// LU decomposition with implicit partial pivoting, indx[0..n-1] gets the
+	// row permutation, *d +1/-1 for an even/odd number of swaps.
+	// Returns -1 for a singular matrix.
+	int ludcmp(mat &a, int *indx, double *d);
+	// Solves a*x = b with the output of ludcmp(), b is replaced by x
+	void lubksb(const mat &a, const int *indx, double *b);
+
+	// Cholesky decomposition G = L*L^H of a Hermitian positive definite matrix
+	// held as real part ar and imaginary part ai. Only the upper triangle is
+	// read and it is left as it was, L goes below the diagonal of ar/ai and its
+	// real diagonal to p[]. Returns -1 if the matrix is not positive definite.
+	int zcholdc(mat &ar, mat &ai, double *p);
+	// Solves G*x = b with the output of zcholdc()
+	void zcholsl(const mat &ar, const mat &ai, const double *p, const double *br, const double *bi,
+		double *xr, double *xi);
+
+	// Iterative solutions of a*x = b, x holds the starting point
+	void lgrad(const mat &a, const double *b, double *x, double alpha);
+	void gauss_seidel(const mat &a, const double *b, double *x);
+}
+
+#endif
@@ -0,0 +1,80 @@
+/* --------------------------------------------------------------------------------------------
+FILE:		dpd_board.cpp
+DESCRIPTION  Board side of the DPD loop, burst capture through the QSpark gateware
+CONTENT:
+AUTHOR:		Lime Microsystems LTD
+DATE:
+-------------------------------------------------------------------------------------------- */
+#include "dpd_board.h"
+#include "IConnection.h"
+#include "LMS64CProtocol.h"
+
+#include <stdint.h>
+
+using namespace lime;
+
+namespace dpd_board {
+
+int capture(IConnection *port, long samplesToRead, int bitsInSample, std::vector<unsigned char> &buffer, bool &timedOut)
+{
+	timedOut = false;
+	if (port == nullptr) return -1;
+
+	const int bytesToRead = burst_bytes(samplesToRead, bitsInSample);
+
+	port->WriteRegister(0x0040, samplesToRead);
+
+	buffer.assign(bytesToRead, 0);
+
+	//switch off Rx/Tx
+	uint16_t interface_ctrl_000A;
+	port->ReadRegister(0x000A, interface_ctrl_000A);
+	port->WriteRegister(0x000A, interface_ctrl_000A & ~0x1);
+
+	//enable MIMO mode, 12 bit compressed values
+	uint16_t smpl_width; // 0-16 bit, 1-14 bit, 2-12 bit
+	if (bitsInSample == 12)
+		smpl_width = 2;
+	else if (bitsInSample == 14)
+		smpl_width = 1;
+	else if (bitsInSample == 16)
+		smpl_width = 0;
+	else
+		smpl_width = 2;
+	port->WriteRegister(0x0007, 1);
+
+	uint16_t interface_cfg_0008;
+	port->ReadRegister(0x0008, interface_cfg_0008);
+	interface_cfg_0008 = (interface_cfg_0008 & ~0x3) | smpl_width;
+	port->WriteRegister(0x0008, interface_cfg_0008);
+
+	//Reset USB FIFO
+	LMS64CProtocol* protocol = dynamic_cast<LMS64CProtocol *>(port);
+	if (protocol)
+	{
+		LMS64CProtocol::GenericPacket ctrPkt;
+		ctrPkt.cmd = CMD_USB_FIFO_RST;
+		ctrPkt.outBuffer.push_back(0x01);
+		protocol->TransferPacket(ctrPkt);
+		ctrPkt.outBuffer[0] = 0x00;
+		protocol->TransferPacket(ctrPkt);
+	}
+
+	//switch on Rx
+	port->ReadRegister(0x000A, interface_ctrl_000A);
+	port->WriteRegister(0x000A, interface_ctrl_000A | 0x1);
+
+	port->WriteRegister(0x0041, 0x0); //0x1-burst, 0x3-continuos
+	port->WriteRegister(0x0041, 0x1); //0x1-burst, 0x3-continuos
+
+	int handle = port->BeginDataReading((char*)&buffer[0], bytesToRead);
+	if (port->WaitForReading(handle, 1000) != 1)
+	{
+		timedOut = true;
+	}
+
+	long btr = bytesToRead;
+	return port->FinishDataReading((char*)&buffer[0], btr, handle);
+}
+
+}
@@ -0,0 +1,31 @@
+/* --------------------------------------------------------------------------------------------
+FILE:		dpd_board.h
+DESCRIPTION  Board side of the DPD loop: burst capture of xp, yp and the PA feedback x
+		through the QSpark gateware, without any GUI dependency
+CONTENT:
+AUTHOR:		Lime Microsystems LTD
+DATE:
+-------------------------------------------------------------------------------------------- */
+#ifndef DPD_BOARD_H
+#define DPD_BOARD_H
+
+#include <vector>
+
+namespace lime {
+	class IConnection;
+}
+
+namespace dpd_board {
+	const long CAPTURE_SAMPLES = 16384;	// samples per burst
+	const int CAPTURE_BITS = 14;		// packed field width
+
+	// Bytes of a burst of samples, 6 fields of bits per sample
+	inline long burst_bytes(long samples, int bits) { return (long)(samples * 6 * bits / 8.0 + 0.5); }
+
+	// Reads one burst into buffer, see dpd_decode() for the layout. Returns the
+	// bytes received, -1 without a connection. timedOut is set when the board
+	// did not deliver within a second, whatever arrived is still returned.
+	int capture(lime::IConnection *port, long samples, int bits, std::vector<unsigned char> &buffer, bool &timedOut);
+}
+
+#endif
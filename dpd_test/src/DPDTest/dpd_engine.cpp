@@ -0,0 +1,196 @@
+/* --------------------------------------------------------------------------------------------
+FILE:		dpd_engine.cpp
+DESCRIPTION  Predistorter training for several PA paths
+CONTENT:
+AUTHOR:		Lime Microsystems LTD
+DATE:
+-------------------------------------------------------------------------------------------- */
+#include "dpd_engine.h"
+#include "qadpd.h"
+#include "delay_align.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+
+#define ALIGN_SKIP 100		// samples skipped before the delay search
+#define ALIGN_LIMIT 2000	// samples scored by the delay search
+
+typedef std::chrono::steady_clock clock_type;
+
+static double seconds(clock_type::time_point from, clock_type::time_point to)
+{
+	return std::chrono::duration<double>(to - from).count();
+}
+
+dpd_engine::dpd_engine(int threads) : pool(threads)
+{
+}
+
+dpd_engine::~dpd_engine()
+{
+}
+
+void dpd_engine::set_channels(int count, int N, int M, int Nd)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	while ((int)states.size() > count) states.pop_back();
+	while ((int)states.size() < count) states.push_back(std::unique_ptr<qadpd>(new qadpd(N, M, Nd)));
+	published.resize(count);
+}
+
+void dpd_engine::init(int N, int M, int Nd, double Lambda, double Am, int Skip, int training)
+{
+	for (int ch = 0; ch < channels(); ch++) {
+		qadpd *q = states[ch].get();
+		if (ch > 0) {
+			char name[64];
+			sprintf(name, "qadpd_error_ch%d.log", ch);
+			q->fname = name;
+			sprintf(name, "qadpd_coeff_ch%d.log", ch);
+			q->fname2 = name;
+		}
+		q->init(N, M, Nd, 1.0, Lambda, Am, Skip);
+		q->training = training;
+	}
+	std::lock_guard<std::mutex> guard(lock);
+	for (size_t ch = 0; ch < published.size(); ch++) published[ch].reset();
+}
+
+int dpd_engine::train_channel(int ch, dpd_capture &cap, const dpd_settings &s)
+{
+	return train_channel(ch, cap, s, &pool);
+}
+
+int dpd_engine::train_channel(int ch, dpd_capture &cap, const dpd_settings &s, worker_pool *align)
+{
+	qadpd *q = states[ch].get();
+	std::shared_ptr<dpd_coeffs> c(new dpd_coeffs);
+	clock_type::time_point t0 = clock_type::now();
+
+	// Sub-sample part of the feedback delay, removed from x before the integer search
+	if (s.fracDelay) {
+		double lag = delay_align::xcorr_lag(cap.xp, cap.x, cap.len, s.delayRange, ALIGN_SKIP, ALIGN_LIMIT);
+		double frac = lag - floor(lag + 0.5);
+		if (fabs(frac) > 0.05) delay_align::shift(cap.x, cap.len, frac);
+	}
+	int ind = delay_align::search(q, cap.xp, cap.x, cap.yp, cap.len, s.delayRange, ALIGN_SKIP, ALIGN_LIMIT, s.ypFpga, align);
+	if ((ind > s.delayRange) || (ind < -s.delayRange)) ind = 0;
+	clock_type::time_point t1 = clock_type::now();
+
+	q->skiping = q->n + q->nd + 1;
+	q->skiping += 100;
+	q->updating = s.update;
+
+	int edge = (abs(ind) > 3) ? abs(ind) : 3;	// keeps x[i+ind] inside the capture
+	int i = edge;
+	if (q->training == qadpd::BLOCK) {
+		// Same samples as the per sample loop below, solved once
+		int count = q->skiping + q->updating + 1;
+		if (count > cap.len - 2*edge) count = cap.len - 2*edge;
+		std::vector<double> xIp(count), xQp(count), xI(count), xQ(count), yIp(count), yQp(count);
+		for (int k = 0; k < count; k++) {
+			xIp[k] = cap.xp[i + k].r;
+			xQp[k] = cap.xp[i + k].i;
+			xI[k] = cap.x[i + k + ind].r;
+			xQ[k] = cap.x[i + k + ind].i;
+			yIp[k] = cap.yp[i + k].r;
+			yQp[k] = cap.yp[i + k].i;
+		}
+		q->train_block(&xIp[0], &xQp[0], &xI[0], &xQ[0], &yIp[0], &yQp[0], count, q->skiping, s.ypFpga);
+		c->samples = count;
+	}
+	else {
+		while ((q->skiping >= 0) && (i < cap.len - edge)) {
+			q->always(cap.xp[i].r, cap.xp[i].i, cap.x[i+ind].r, cap.x[i+ind].i, cap.yp[i].r, cap.yp[i].i, s.ypFpga);
+			i++;
+		}
+		c->samples = i - edge;
+	}
+	clock_type::time_point t2 = clock_type::now();
+
+	int status = q->update_coeff(s.range);
+	clock_type::time_point t3 = clock_type::now();
+
+	c->lag = ind;
+	c->status = status;
+	c->alignTime = seconds(t0, t1);
+	c->trainTime = seconds(t1, t2);
+	c->solveTime = seconds(t2, t3);
+	publish(ch, c);
+	return status;
+}
+
+void dpd_engine::train(dpd_capture *caps, int count, const dpd_settings &s)
+{
+	if (count > channels()) count = channels();
+	if (count == 1) {
+		train_channel(0, caps[0], s);
+		return;
+	}
+	// the pool runs the channels, each searches its lags on its own thread
+	pool.run(count, [&](int ch) { train_channel(ch, caps[ch], s, 0); });
+}
+
+void dpd_engine::evaluate(int ch, const dpd_capture &cap, int lag, bool ypFpga,
+	kiss_fft_cpx *y, kiss_fft_cpx *u, kiss_fft_cpx *error)
+{
+	qadpd *q = states[ch].get();
+	q->start();
+	q->prepare();
+
+	int edge = (abs(lag) > 3) ? abs(lag) : 3;
+	int count = cap.len - 2*edge;
+	if (count > 0) {
+		std::vector<double> xIp(count), xQp(count), xI(count), xQ(count), yIp(count), yQp(count);
+		std::vector<double> yI(count), yQ(count), uI(count), uQ(count);
+		for (int k = 0; k < count; k++) {
+			xIp[k] = cap.xp[k + edge].r;
+			xQp[k] = cap.xp[k + edge].i;
+			xI[k] = cap.x[k + edge + lag].r;
+			xQ[k] = cap.x[k + edge + lag].i;
+			yIp[k] = cap.yp[k + edge].r;
+			yQp[k] = cap.yp[k + edge].i;
+		}
+		q->oeval_block(&xIp[0], &xQp[0], &xI[0], &xQ[0], &yIp[0], &yQp[0], count, ypFpga,
+			&yI[0], &yQ[0], &uI[0], &uQ[0], NULL);
+
+		for (int k = 0; k < count; k++) {
+			int i = k + edge;
+			y[i].r = yI[k];
+			y[i].i = yQ[k];
+			u[i].r = uI[k];
+			u[i].i = uQ[k];
+			error[i].r = uI[k] - yI[k];
+			error[i].i = uQ[k] - yQ[k];
+		}
+	}
+
+	q->finish();
+}
+
+void dpd_engine::publish(int ch, std::shared_ptr<dpd_coeffs> c)
+{
+	const qadpd *q = states[ch].get();
+	c->n = q->n;
+	c->m = q->m;
+	c->a.resize((q->n + 1)*(q->m + 1));
+	c->b.resize((q->n + 1)*(q->m + 1));
+	for (int i = 0; i <= q->n; i++) {
+		for (int j = 0; j <= q->m; j++) {
+			c->a[i*(q->m + 1) + j] = q->a[i][j];
+			c->b[i*(q->m + 1) + j] = q->b[i][j];
+		}
+	}
+
+	std::lock_guard<std::mutex> guard(lock);
+	c->generation = published[ch] ? published[ch]->generation + 1 : 1;
+	published[ch] = c;
+}
+
+std::shared_ptr<const dpd_coeffs> dpd_engine::coeffs(int ch) const
+{
+	std::lock_guard<std::mutex> guard(lock);
+	return published[ch];
+}
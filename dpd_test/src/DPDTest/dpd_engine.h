@@ -0,0 +1,98 @@
+/* --------------------------------------------------------------------------------------------
+FILE:		dpd_engine.h
+DESCRIPTION  Predistorter training for several PA paths. Every channel has its own qadpd
+		state, the channels are aligned and trained concurrently on a worker pool
+		and each result is published as one immutable coefficient snapshot.
+CONTENT:
+AUTHOR:		Lime Microsystems LTD
+DATE:
+-------------------------------------------------------------------------------------------- */
+#ifndef DPD_ENGINE_H
+#define DPD_ENGINE_H
+
+#include "kiss_fft.h"
+#include "worker_pool.h"
+
+#include <vector>
+#include <memory>
+#include <mutex>
+
+class qadpd;
+
+// One capture of a PA path, samples [0, len)
+struct dpd_capture {
+	const kiss_fft_cpx *xp;	// predistorter input
+	kiss_fft_cpx *x;		// PA feedback, shifted in place by the fractional delay
+	const kiss_fft_cpx *yp;	// predistorter output
+	int len;
+};
+
+// Training run settings shared by all channels
+struct dpd_settings {
+	int update;			// adaptation samples after the delay lines are filled
+	int delayRange;		// integer lags searched, [-delayRange, delayRange]
+	bool fracDelay;		// remove the sub-sample feedback delay first
+	bool ypFpga;		// yp comes from the gateware
+	double range;		// coefficient limit, see qadpd::update_coeff()
+};
+
+// Coefficients of one channel after a training run
+struct dpd_coeffs {
+	int n, m;
+	std::vector<double> a, b;	// a[i*(m+1) + j] for tap i, power j
+	int lag;					// feedback delay used for training
+	int status;					// qadpd::update_coeff(), -1 if a coefficient was limited
+	unsigned long generation;	// training runs published for this channel
+	int samples;				// samples fed to the training
+	double alignTime;			// seconds in the delay search
+	double trainTime;			// seconds training, the solves of always() and train_block() included
+	double solveTime;			// seconds in qadpd::update_coeff()
+};
+
+class dpd_engine {
+public:
+	// threads = 0 uses one thread per core
+	explicit dpd_engine(int threads = 0);
+	~dpd_engine();
+
+	// (Re)creates count channel states, existing ones are kept
+	void set_channels(int count, int N, int M, int Nd);
+	int channels() const { return (int)states.size(); }
+	qadpd *channel(int ch) { return states[ch].get(); }
+
+	// qadpd::init() of every channel, each channel logs to its own files
+	void init(int N, int M, int Nd, double Lambda, double Am, int Skip, int training);
+
+	// Aligns and trains channel ch on the calling thread, the lags of the delay
+	// search run on the pool, then publishes it. One train_channel() or train()
+	// at a time. Returns the qadpd::update_coeff() status.
+	int train_channel(int ch, dpd_capture &cap, const dpd_settings &s);
+
+	// Trains channels 0 .. count-1 concurrently, caps[ch] is the capture of
+	// channel ch. Returns when all results are published.
+	void train(dpd_capture *caps, int count, const dpd_settings &s);
+
+	// Runs channel ch over samples [edge, len-edge) of cap with feedback delay
+	// lag, edge = max(3, |lag|). Writes the predistorter output y, the
+	// postdistorter output u and the error u-y there, other samples are kept.
+	void evaluate(int ch, const dpd_capture &cap, int lag, bool ypFpga,
+		kiss_fft_cpx *y, kiss_fft_cpx *u, kiss_fft_cpx *error);
+
+	// Latest coefficients of channel ch, null before the first training run.
+	// The snapshot never changes, a new run publishes a new one.
+	std::shared_ptr<const dpd_coeffs> coeffs(int ch) const;
+
+private:
+	dpd_engine(const dpd_engine &);
+	dpd_engine &operator=(const dpd_engine &);
+	void publish(int ch, std::shared_ptr<dpd_coeffs> c);
+	// align is the pool of the delay search, null to search on the calling thread
+	int train_channel(int ch, dpd_capture &cap, const dpd_settings &s, worker_pool *align);
+
+	worker_pool pool;
+	std::vector<std::unique_ptr<qadpd> > states;
+	std::vector<std::shared_ptr<const dpd_coeffs> > published;
+	mutable std::mutex lock;
+};
+
+#endif
@@ -0,0 +1,215 @@
+/* --------------------------------------------------------------------------------------------
+FILE:		dpd_pipeline.cpp
+DESCRIPTION  Continuous DPD loop on background threads
+CONTENT:
+AUTHOR:		Lime Microsystems LTD
+DATE:
+-------------------------------------------------------------------------------------------- */
+#include "dpd_pipeline.h"
+#include "packed_samples.h"
+#include "spectrum_cache.h"
+
+#include <chrono>
+
+#define QUEUE_DEPTH 1		// frames waiting between two stages
+#define RETRY_MS 100		// pause after a failed capture
+
+void dpd_decode(const unsigned char *raw, long len, int bits, int count, double gain,
+	kiss_fft_cpx *xp, kiss_fft_cpx *yp, kiss_fft_cpx *x)
+{
+	packed_samples::unpack_cpx(raw, len, bits, 0, 4, count, xp);
+	packed_samples::unpack_cpx(raw, len, bits, 2, 4, count, yp);
+	packed_samples::unpack_cpx(raw, len, bits, 4 * (long)count, 2, count, x);
+	for (int i = 0; i < count; i++) {
+		x[i].r = (int)(gain*x[i].r);
+		x[i].i = (int)(gain*x[i].i);
+	}
+}
+
+static bool same_config(const dpd_pipeline_config &a, const dpd_pipeline_config &b)
+{
+	return (a.samples == b.samples) && (a.captureSamples == b.captureSamples) &&
+		(a.bitsInSample == b.bitsInSample) && (a.gain == b.gain) && (a.train == b.train) &&
+		(a.settings.update == b.settings.update) && (a.settings.delayRange == b.settings.delayRange) &&
+		(a.settings.fracDelay == b.settings.fracDelay) && (a.settings.ypFpga == b.settings.ypFpga) &&
+		(a.settings.range == b.settings.range) && (a.lag == b.lag) &&
+		(a.fftSize == b.fftSize) && (a.window == b.window);
+}
+
+dpd_pipeline::dpd_pipeline(dpd_engine &e)
+	: engine(e), uploadWaiting(false), captured(QUEUE_DEPTH), decoded(QUEUE_DEPTH), trained(QUEUE_DEPTH),
+	quit(false), failed(0)
+{
+}
+
+dpd_pipeline::~dpd_pipeline()
+{
+	stop();
+}
+
+void dpd_pipeline::start(const dpd_pipeline_config &cfg, const capture_fn &captureFn, const upload_fn &uploadFn)
+{
+	stop();
+	capture = captureFn;
+	upload = uploadFn;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		config = std::make_shared<const dpd_pipeline_config>(cfg);
+		result.reset();
+		failed = 0;
+		quit = false;
+	}
+	threads.push_back(std::thread(&dpd_pipeline::capture_stage, this));
+	threads.push_back(std::thread(&dpd_pipeline::decode_stage, this));
+	threads.push_back(std::thread(&dpd_pipeline::train_stage, this));
+	threads.push_back(std::thread(&dpd_pipeline::analyse_stage, this));
+}
+
+void dpd_pipeline::stop()
+{
+	if (threads.empty()) return;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		quit = true;
+	}
+	idle.notify_all();
+	captured.close();
+	decoded.close();
+	trained.close();
+	for (size_t i = 0; i < threads.size(); i++) threads[i].join();
+	threads.clear();
+	captured.reopen();
+	decoded.reopen();
+	trained.reopen();
+}
+
+void dpd_pipeline::configure(const dpd_pipeline_config &cfg)
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		if (config && same_config(*config, cfg)) return;
+	}
+	std::shared_ptr<const dpd_pipeline_config> next = std::make_shared<const dpd_pipeline_config>(cfg);
+	std::lock_guard<std::mutex> guard(lock);
+	config = next;
+}
+
+std::shared_ptr<const dpd_frame> dpd_pipeline::latest() const
+{
+	std::lock_guard<std::mutex> guard(lock);
+	return result;
+}
+
+unsigned long dpd_pipeline::failures() const
+{
+	std::lock_guard<std::mutex> guard(lock);
+	return failed;
+}
+
+void dpd_pipeline::capture_stage()
+{
+	unsigned long seq = 0;
+	while (true) {
+		frame_ptr f(new dpd_frame);
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			if (quit) return;
+			f->cfg = config;
+		}
+
+		int received;
+		while (uploadWaiting) std::this_thread::yield();
+		{
+			std::lock_guard<std::mutex> guard(board);
+			received = capture(f->raw);
+		}
+		if (received <= 0) {
+			std::unique_lock<std::mutex> guard(lock);
+			failed++;
+			idle.wait_for(guard, std::chrono::milliseconds(RETRY_MS), [this]() { return quit; });
+			continue;
+		}
+
+		// training takes the newest burst, one that waits for decoding is dropped
+		f->seq = seq++;
+		if (!captured.push_latest(std::move(f))) return;
+	}
+}
+
+void dpd_pipeline::decode_stage()
+{
+	frame_ptr f;
+	while (captured.pop(f)) {
+		const dpd_pipeline_config &cfg = *f->cfg;
+		f->xp.assign(cfg.samples, kiss_fft_cpx());
+		f->yp.assign(cfg.samples, kiss_fft_cpx());
+		f->x.assign(cfg.samples, kiss_fft_cpx());
+		int count = (cfg.captureSamples < cfg.samples) ? cfg.captureSamples : cfg.samples;
+		dpd_decode(&f->raw[0], (long)f->raw.size(), cfg.bitsInSample, count, cfg.gain,
+			&f->xp[0], &f->yp[0], &f->x[0]);
+		std::vector<unsigned char>().swap(f->raw);
+		if (!decoded.push(std::move(f))) return;
+	}
+}
+
+void dpd_pipeline::train_stage()
+{
+	frame_ptr f;
+	while (decoded.pop(f)) {
+		const dpd_pipeline_config &cfg = *f->cfg;
+		dpd_capture cap = { &f->xp[0], &f->x[0], &f->yp[0], cfg.samples };
+		int lag = cfg.lag;
+
+		f->trained = cfg.train;
+		f->status = 0;
+		if (cfg.train) {
+			engine.train(&cap, 1, cfg.settings);
+			std::shared_ptr<const dpd_coeffs> c = engine.coeffs(0);
+			lag = c->lag;
+			f->status = c->status;
+			if (f->status >= 0) {
+				uploadWaiting = true;
+				std::lock_guard<std::mutex> guard(board);
+				uploadWaiting = false;
+				upload();
+			}
+		}
+
+		f->lag = lag;
+		f->y.assign(cfg.samples, kiss_fft_cpx());
+		f->u.assign(cfg.samples, kiss_fft_cpx());
+		f->error.assign(cfg.samples, kiss_fft_cpx());
+		engine.evaluate(0, cap, lag, cfg.settings.ypFpga, &f->y[0], &f->u[0], &f->error[0]);
+		if (!trained.push(std::move(f))) return;
+	}
+}
+
+void dpd_pipeline::analyse_stage()
+{
+	spectrum_cache spectra;		// kept for the whole run
+	frame_ptr f;
+	while (trained.pop(f)) {
+		const dpd_pipeline_config &cfg = *f->cfg;
+		int n = (cfg.fftSize < cfg.samples) ? cfg.fftSize : cfg.samples;
+
+		f->xp1 = f->xp;
+		f->yp1 = f->yp;
+		f->x1 = f->x;
+		f->y1 = f->y;
+		f->xp_fft.assign(cfg.samples, kiss_fft_cpx());
+		f->yp_fft.assign(cfg.samples, kiss_fft_cpx());
+		f->x_fft.assign(cfg.samples, kiss_fft_cpx());
+		f->y_fft.assign(cfg.samples, kiss_fft_cpx());
+		if (n > 0) {
+			spectra.configure(n, cfg.window);
+			const kiss_fft_cpx *in[4] = { &f->xp[0], &f->yp[0], &f->x[0], &f->y[0] };
+			kiss_fft_cpx *windowed[4] = { &f->xp1[0], &f->yp1[0], &f->x1[0], &f->y1[0] };
+			kiss_fft_cpx *out[4] = { &f->xp_fft[0], &f->yp_fft[0], &f->x_fft[0], &f->y_fft[0] };
+			spectra.transform(4, in, windowed, out);
+		}
+
+		std::shared_ptr<const dpd_frame> done(f.release());
+		std::lock_guard<std::mutex> guard(lock);
+		result = done;
+	}
+}
@@ -0,0 +1,182 @@
+/* --------------------------------------------------------------------------------------------
+FILE:		dpd_pipeline.h
+DESCRIPTION  Continuous DPD loop on background threads. Four stages, each on its own thread,
+		are connected by bounded queues:
+			capture  - reads one raw burst from the board
+			decode   - unpacks the burst into xp, yp and x
+			train    - aligns and trains the predistorter, uploads the coefficients
+			           and evaluates y, u and the error
+			analyse  - windows the signals and computes their spectra,
+			           with plans and windows kept by a spectrum_cache
+		The next capture runs while the current one is trained, a capture that is not
+		decoded yet is replaced by the newer one. Finished frames are published as
+		immutable snapshots, the GUI or DPDUtil only picks up the latest one.
+CONTENT:
+AUTHOR:		Lime Microsystems LTD
+DATE:
+-------------------------------------------------------------------------------------------- */
+#ifndef DPD_PIPELINE_H
+#define DPD_PIPELINE_H
+
+#include "kiss_fft.h"
+#include "dpd_engine.h"
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <functional>
+
+// Blocking FIFO of at most 'capacity' items. After close() push() fails and
+// pop() fails once the queue is empty.
+template <class T>
+class bounded_queue {
+public:
+	explicit bounded_queue(size_t capacity) : cap(capacity), closed(false) {}
+
+	bool push(T item)
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		notFull.wait(guard, [this]() { return closed || items.size() < cap; });
+		if (closed) return false;
+		items.push_back(std::move(item));
+		notEmpty.notify_one();
+		return true;
+	}
+
+	// Never waits, the oldest item is dropped when the queue is full
+	bool push_latest(T item)
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		if (closed) return false;
+		if (items.size() >= cap) items.pop_front();
+		items.push_back(std::move(item));
+		notEmpty.notify_one();
+		return true;
+	}
+
+	bool pop(T &item)
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		notEmpty.wait(guard, [this]() { return closed || !items.empty(); });
+		if (items.empty()) return false;
+		item = std::move(items.front());
+		items.pop_front();
+		notFull.notify_one();
+		return true;
+	}
+
+	void close()
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		closed = true;
+		notFull.notify_all();
+		notEmpty.notify_all();
+	}
+
+	// Drops the items and accepts pushes again
+	void reopen()
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		items.clear();
+		closed = false;
+	}
+
+private:
+	bounded_queue(const bounded_queue &);
+	bounded_queue &operator=(const bounded_queue &);
+	std::deque<T> items;
+	size_t cap;
+	bool closed;
+	std::mutex lock;
+	std::condition_variable notFull, notEmpty;
+};
+
+// Settings a frame is processed with, taken when its capture starts
+struct dpd_pipeline_config {
+	int samples;				// length of the signal buffers
+	int captureSamples;			// samples per burst
+	int bitsInSample;			// 12, 14 or 16
+	double gain;				// applied to the feedback x
+	bool train;					// train and upload before evaluating
+	dpd_settings settings;
+	int lag;					// feedback delay of frames that are not trained
+	int fftSize;				// <= samples, 0 skips the spectra
+	int window;					// spectrum_cache window type
+};
+
+// One capture and everything computed from it, samples [0, samples)
+struct dpd_frame {
+	unsigned long seq;			// capture number since start()
+	std::shared_ptr<const dpd_pipeline_config> cfg;
+	std::vector<unsigned char> raw;
+	std::vector<kiss_fft_cpx> xp, yp, x;		// decoded burst
+	std::vector<kiss_fft_cpx> y, u, error;		// predistorter evaluation
+	std::vector<kiss_fft_cpx> xp1, yp1, x1, y1;	// windowed signals
+	std::vector<kiss_fft_cpx> xp_fft, yp_fft, x_fft, y_fft;
+	int lag;					// feedback delay used for the evaluation
+	int status;					// qadpd::update_coeff(), 0 if not trained
+	bool trained;
+};
+
+// Burst decoding shared with the one step GUI path: fields of xp.r, xp.i, yp.r,
+// yp.i per sample followed by x.r, x.i per sample, x scaled by gain and truncated.
+void dpd_decode(const unsigned char *raw, long len, int bits, int count, double gain,
+	kiss_fft_cpx *xp, kiss_fft_cpx *yp, kiss_fft_cpx *x);
+
+class dpd_pipeline {
+public:
+	// Fills the buffer with one burst, returns the bytes received (<= 0 on failure)
+	typedef std::function<int(std::vector<unsigned char> &)> capture_fn;
+	// Sends the coefficients of channel 0 of the engine to the board
+	typedef std::function<void()> upload_fn;
+
+	// The train stage owns channel 0 of engine while the pipeline runs
+	explicit dpd_pipeline(dpd_engine &engine);
+	~dpd_pipeline();
+
+	// capture and upload are never called at the same time, both talk to the board
+	void start(const dpd_pipeline_config &cfg, const capture_fn &capture, const upload_fn &upload);
+	// Waits for the running stages to finish their current frame
+	void stop();
+	bool running() const { return !threads.empty(); }
+
+	// Applies to captures started from now on, settings equal to the current
+	// ones are ignored
+	void configure(const dpd_pipeline_config &cfg);
+
+	// Latest analysed frame, null before the first one
+	std::shared_ptr<const dpd_frame> latest() const;
+	unsigned long failures() const;	// captures that returned no data
+
+private:
+	dpd_pipeline(const dpd_pipeline &);
+	dpd_pipeline &operator=(const dpd_pipeline &);
+	typedef std::unique_ptr<dpd_frame> frame_ptr;
+
+	void capture_stage();
+	void decode_stage();
+	void train_stage();
+	void analyse_stage();
+
+	dpd_engine &engine;
+	capture_fn capture;
+	upload_fn upload;
+	std::mutex board;	// serialises capture and upload
+	std::atomic<bool> uploadWaiting;	// capture lets the upload take the board first
+
+	bounded_queue<frame_ptr> captured, decoded, trained;
+	std::vector<std::thread> threads;
+	bool quit;
+
+	mutable std::mutex lock;	// guards the members below and quit
+	std::condition_variable idle;
+	std::shared_ptr<const dpd_pipeline_config> config;
+	std::shared_ptr<const dpd_frame> result;
+	unsigned long failed;
+};
+
+#endif
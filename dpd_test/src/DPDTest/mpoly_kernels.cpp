@@ -0,0 +1,301 @@
+/* --------------------------------------------------------------------------------------------
+FILE:		mpoly_kernels.cpp
+DESCRIPTION  Vectorised building blocks for memory polynomial evaluation
+CONTENT:
+AUTHOR:		Lime Microsystems LTD
+DATE:
+-------------------------------------------------------------------------------------------- */
+#include "mpoly_kernels.h"
+#include <math.h>
+#include <string.h>
+
+// SSE2 is the baseline on x86-64, the AVX2 kernels are compiled with a function
+// target attribute and picked at run time when the CPU has AVX2
+#if defined(__x86_64__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define MPOLY_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(_MSC_VER)
+#define MPOLY_AVX2
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+typedef void (*cmac_fn)(double *, double *, const double *, const double *, double, double, int);
+typedef void (*envelope_fn)(const double *, const double *, int, double, bool, double *);
+typedef void (*scale_fn)(const double *, const double *, const double *, int, double *, double *);
+typedef void (*clip_fn)(double *, int, double, double);
+
+// --------------------------------------------------------------------------------------------
+// Scalar kernels, also used for the tails of the vector kernels
+// --------------------------------------------------------------------------------------------
+static void cmac_scalar(double *yI, double *yQ, const double *xI, const double *xQ, double a, double b, int len)
+{
+	for (int i = 0; i < len; i++) {
+		yI[i] += a*xI[i] - b*xQ[i];
+		yQ[i] += a*xQ[i] + b*xI[i];
+	}
+}
+
+// e = |x|^2/am2, or its square root when sEnv is false
+static void envelope_scalar(const double *xI, const double *xQ, int len, double am2, bool sEnv, double *e)
+{
+	for (int i = 0; i < len; i++) {
+		e[i] = (xI[i]*xI[i] + xQ[i]*xQ[i])/am2;
+		if (sEnv == false) e[i] = sqrt(e[i]);
+	}
+}
+
+// d = s*e, Q before I as dI may be the envelope itself
+static void scale_scalar(const double *sI, const double *sQ, const double *e, int len, double *dI, double *dQ)
+{
+	for (int i = 0; i < len; i++) {
+		double ei = e[i];
+		dQ[i] = sQ[i]*ei;
+		dI[i] = sI[i]*ei;
+	}
+}
+
+static void clip_scalar(double *y, int len, double lo, double hi)
+{
+	for (int i = 0; i < len; i++) {
+		if (y[i] > hi) y[i] = hi;
+		if (y[i] < lo) y[i] = lo;
+	}
+}
+
+#ifdef MPOLY_SSE2
+// --------------------------------------------------------------------------------------------
+// SSE2 kernels, 2 samples per iteration
+// --------------------------------------------------------------------------------------------
+static void cmac_sse2(double *yI, double *yQ, const double *xI, const double *xQ, double a, double b, int len)
+{
+	int i = 0;
+	const __m128d va = _mm_set1_pd(a);
+	const __m128d vb = _mm_set1_pd(b);
+	for (; i + 2 <= len; i += 2) {
+		__m128d xi = _mm_loadu_pd(xI + i);
+		__m128d xq = _mm_loadu_pd(xQ + i);
+		__m128d yi = _mm_loadu_pd(yI + i);
+		__m128d yq = _mm_loadu_pd(yQ + i);
+		yi = _mm_add_pd(yi, _mm_sub_pd(_mm_mul_pd(va, xi), _mm_mul_pd(vb, xq)));
+		yq = _mm_add_pd(yq, _mm_add_pd(_mm_mul_pd(va, xq), _mm_mul_pd(vb, xi)));
+		_mm_storeu_pd(yI + i, yi);
+		_mm_storeu_pd(yQ + i, yq);
+	}
+	cmac_scalar(yI + i, yQ + i, xI + i, xQ + i, a, b, len - i);
+}
+
+static void envelope_sse2(const double *xI, const double *xQ, int len, double am2, bool sEnv, double *e)
+{
+	int i = 0;
+	const __m128d vn = _mm_set1_pd(am2);
+	for (; i + 2 <= len; i += 2) {
+		__m128d xi = _mm_loadu_pd(xI + i);
+		__m128d xq = _mm_loadu_pd(xQ + i);
+		__m128d ve = _mm_div_pd(_mm_add_pd(_mm_mul_pd(xi, xi), _mm_mul_pd(xq, xq)), vn);
+		if (sEnv == false) ve = _mm_sqrt_pd(ve);
+		_mm_storeu_pd(e + i, ve);
+	}
+	envelope_scalar(xI + i, xQ + i, len - i, am2, sEnv, e + i);
+}
+
+static void scale_sse2(const double *sI, const double *sQ, const double *e, int len, double *dI, double *dQ)
+{
+	int i = 0;
+	for (; i + 2 <= len; i += 2) {
+		__m128d ve = _mm_loadu_pd(e + i);
+		_mm_storeu_pd(dQ + i, _mm_mul_pd(_mm_loadu_pd(sQ + i), ve));
+		_mm_storeu_pd(dI + i, _mm_mul_pd(_mm_loadu_pd(sI + i), ve));
+	}
+	scale_scalar(sI + i, sQ + i, e + i, len - i, dI + i, dQ + i);
+}
+
+static void clip_sse2(double *y, int len, double lo, double hi)
+{
+	int i = 0;
+	const __m128d vlo = _mm_set1_pd(lo);
+	const __m128d vhi = _mm_set1_pd(hi);
+	for (; i + 2 <= len; i += 2)
+		_mm_storeu_pd(y + i, _mm_max_pd(vlo, _mm_min_pd(vhi, _mm_loadu_pd(y + i))));
+	clip_scalar(y + i, len - i, lo, hi);
+}
+#endif
+
+#ifdef MPOLY_AVX2
+// --------------------------------------------------------------------------------------------
+// AVX2 kernels, 4 samples per iteration
+// --------------------------------------------------------------------------------------------
+TARGET_AVX2 static void cmac_avx2(double *yI, double *yQ, const double *xI, const double *xQ, double a, double b, int len)
+{
+	int i = 0;
+	const __m256d va = _mm256_set1_pd(a);
+	const __m256d vb = _mm256_set1_pd(b);
+	for (; i + 4 <= len; i += 4) {
+		__m256d xi = _mm256_loadu_pd(xI + i);
+		__m256d xq = _mm256_loadu_pd(xQ + i);
+		__m256d yi = _mm256_loadu_pd(yI + i);
+		__m256d yq = _mm256_loadu_pd(yQ + i);
+		yi = _mm256_add_pd(yi, _mm256_sub_pd(_mm256_mul_pd(va, xi), _mm256_mul_pd(vb, xq)));
+		yq = _mm256_add_pd(yq, _mm256_add_pd(_mm256_mul_pd(va, xq), _mm256_mul_pd(vb, xi)));
+		_mm256_storeu_pd(yI + i, yi);
+		_mm256_storeu_pd(yQ + i, yq);
+	}
+	cmac_scalar(yI + i, yQ + i, xI + i, xQ + i, a, b, len - i);
+}
+
+TARGET_AVX2 static void envelope_avx2(const double *xI, const double *xQ, int len, double am2, bool sEnv, double *e)
+{
+	int i = 0;
+	const __m256d vn = _mm256_set1_pd(am2);
+	for (; i + 4 <= len; i += 4) {
+		__m256d xi = _mm256_loadu_pd(xI + i);
+		__m256d xq = _mm256_loadu_pd(xQ + i);
+		__m256d ve = _mm256_div_pd(_mm256_add_pd(_mm256_mul_pd(xi, xi), _mm256_mul_pd(xq, xq)), vn);
+		if (sEnv == false) ve = _mm256_sqrt_pd(ve);
+		_mm256_storeu_pd(e + i, ve);
+	}
+	envelope_scalar(xI + i, xQ + i, len - i, am2, sEnv, e + i);
+}
+
+TARGET_AVX2 static void scale_avx2(const double *sI, const double *sQ, const double *e, int len, double *dI, double *dQ)
+{
+	int i = 0;
+	for (; i + 4 <= len; i += 4) {
+		__m256d ve = _mm256_loadu_pd(e + i);
+		_mm256_storeu_pd(dQ + i, _mm256_mul_pd(_mm256_loadu_pd(sQ + i), ve));
+		_mm256_storeu_pd(dI + i, _mm256_mul_pd(_mm256_loadu_pd(sI + i), ve));
+	}
+	scale_scalar(sI + i, sQ + i, e + i, len - i, dI + i, dQ + i);
+}
+
+TARGET_AVX2 static void clip_avx2(double *y, int len, double lo, double hi)
+{
+	int i = 0;
+	const __m256d vlo = _mm256_set1_pd(lo);
+	const __m256d vhi = _mm256_set1_pd(hi);
+	for (; i + 4 <= len; i += 4)
+		_mm256_storeu_pd(y + i, _mm256_max_pd(vlo, _mm256_min_pd(vhi, _mm256_loadu_pd(y + i))));
+	clip_scalar(y + i, len - i, lo, hi);
+}
+
+static bool has_avx2()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+	__cpuid(info, 1);
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	const bool avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx) return false;
+	if ((_xgetbv(0) & 0x6) != 0x6) return false;	// OS saves YMM state
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+// --------------------------------------------------------------------------------------------
+// Dispatch
+// --------------------------------------------------------------------------------------------
+struct mpoly_kernels {
+	mpoly_kernels()
+	{
+		// every supported set replaces the previous one
+		select("scalar");
+		select("SSE2");
+		select("AVX2");
+	}
+	bool select(const char *which)
+	{
+		if (strcmp(which, "scalar") == 0) {
+			cmac = cmac_scalar;
+			envelope = envelope_scalar;
+			scale = scale_scalar;
+			clip = clip_scalar;
+			name = "scalar";
+			return true;
+		}
+#ifdef MPOLY_SSE2
+		if (strcmp(which, "SSE2") == 0) {
+			cmac = cmac_sse2;
+			envelope = envelope_sse2;
+			scale = scale_sse2;
+			clip = clip_sse2;
+			name = "SSE2";
+			return true;
+		}
+#endif
+#ifdef MPOLY_AVX2
+		if (strcmp(which, "AVX2") == 0 && has_avx2()) {
+			cmac = cmac_avx2;
+			envelope = envelope_avx2;
+			scale = scale_avx2;
+			clip = clip_avx2;
+			name = "AVX2";
+			return true;
+		}
+#endif
+		return false;
+	}
+	cmac_fn cmac;
+	envelope_fn envelope;
+	scale_fn scale;
+	clip_fn clip;
+	const char *name;
+};
+
+static mpoly_kernels &kernels()
+{
+	static mpoly_kernels k;
+	return k;
+}
+
+const char *mpoly::simd_name()
+{
+	return kernels().name;
+}
+
+bool mpoly::select_simd(const char *name)
+{
+	return kernels().select(name);
+}
+
+void mpoly::cmac(double *yI, double *yQ, const double *xI, const double *xQ, double a, double b, int len)
+{
+	kernels().cmac(yI, yQ, xI, xQ, a, b, len);
+}
+
+void mpoly::power_basis(const double *xI, const double *xQ, int len, int m, double am, bool sEnv,
+	double *pI, double *pQ, int stride)
+{
+	const mpoly_kernels &k = kernels();
+	double *e = pI + m*stride;	// the last I row is free until the end, hold the envelope there
+
+	for (int i = 0; i < len; i++) {
+		pI[i] = xI[i];
+		pQ[i] = xQ[i];
+	}
+	if (m == 0) return;
+
+	k.envelope(xI, xQ, len, am*am, sEnv, e);
+
+	// p[j] = p[j-1]*e, same order of operations as qadpd::oeval().
+	// In the last row Q is written before I, which overwrites the envelope.
+	for (int j = 1; j <= m; j++)
+		k.scale(pI + (j-1)*stride, pQ + (j-1)*stride, e, len, pI + j*stride, pQ + j*stride);
+}
+
+void mpoly::clip(double *y, int len, double lo, double hi)
+{
+	kernels().clip(y, len, lo, hi);
+}
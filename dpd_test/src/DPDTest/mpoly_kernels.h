@@ -0,0 +1,34 @@
+/* --------------------------------------------------------------------------------------------
+FILE:		mpoly_kernels.h
+DESCRIPTION  Vectorised building blocks for memory polynomial evaluation.
+		All signals are kept as separate I and Q arrays (structure of arrays).
+		Kernels use AVX2 when the CPU has it, SSE2 on other x86 CPUs and
+		plain scalar loops elsewhere, selected at run time.
+CONTENT:
+AUTHOR:		Lime Microsystems LTD
+DATE:
+-------------------------------------------------------------------------------------------- */
+#ifndef MPOLY_KERNELS_H
+#define MPOLY_KERNELS_H
+
+namespace mpoly {
+	// Instruction set of the kernels selected for this CPU, "AVX2", "SSE2" or "scalar"
+	const char *simd_name();
+
+	// Forces the kernels to use, for tests and benchmarks. Not safe while other threads
+	// evaluate polynomials. Returns false, keeping the selection, if the build or CPU lacks them.
+	bool select_simd(const char *name);
+
+	// y += (a + j*b)*x for len samples
+	void cmac(double *yI, double *yQ, const double *xI, const double *xQ, double a, double b, int len);
+
+	// Power series x*e^j, j=0..m, for len samples, written to p[j*stride + s].
+	// e = |x|^2/am^2, or |x|/am when sEnv is false.
+	void power_basis(const double *xI, const double *xQ, int len, int m, double am, bool sEnv,
+		double *pI, double *pQ, int stride);
+
+	// Limit every sample to [lo, hi]
+	void clip(double *y, int len, double lo, double hi);
+}
+
+#endif
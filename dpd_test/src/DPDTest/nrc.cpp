@@ -94,7 +94,7 @@ void nrc::free_matrix(double **m, int nrl, int nrh, int ncl, int nch)
 /*************************************************/
 /*** Numerical Recipes standard error handler. ***/
 /*************************************************/
-void nrc::nrerror(char *error_text)
+void nrc::nrerror(const char *error_text)
 {
 	printf("Numerical Recipes run-time error...\n");
 	printf("%s\n",error_text);
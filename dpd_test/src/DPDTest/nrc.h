@@ -25,7 +25,7 @@ namespace nrc {
 	int  *ivector(int, int);
 	void free_ivector(int *, int , int );
 
-	void nrerror(char *);
+	void nrerror(const char *);
 
 	// LU decomposition and backsubstitution
 	int ludcmp(double **, int, int *, double *);
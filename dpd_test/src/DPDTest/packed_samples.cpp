@@ -0,0 +1,73 @@
+/* --------------------------------------------------------------------------------------------
+FILE:		packed_samples.cpp
+DESCRIPTION  Decoding of packed 12/14/16-bit capture streams
+CONTENT:
+AUTHOR:		Lime Microsystems LTD
+DATE:
+-------------------------------------------------------------------------------------------- */
+#include "packed_samples.h"
+
+namespace packed_samples {
+
+// Little endian 64-bit load, bytes past the end of the buffer read as zero
+static inline uint64_t load64(const uint8_t *buf, long len, long byte)
+{
+	uint64_t w = 0;
+	if (byte + 8 <= len) {
+		for (int k = 7; k >= 0; k--) w = (w << 8) | buf[byte + k];
+	}
+	else {
+		for (int k = 7; k >= 0; k--) {
+			w <<= 8;
+			if (byte + k < len) w |= buf[byte + k];
+		}
+	}
+	return w;
+}
+
+static inline int extend(uint32_t v, int bits)
+{
+	return (int32_t)(v << (32 - bits)) >> (32 - bits);
+}
+
+int field(const uint8_t *buf, long len, int bits, long f)
+{
+	long bit = f*bits;
+	uint64_t w = load64(buf, len, bit >> 3);
+	return extend((uint32_t)(w >> (bit & 7)) & ((1u << bits) - 1), bits);
+}
+
+void unpack_cpx(const uint8_t *buf, long len, int bits, long first, int stride, int count, kiss_fft_cpx *dst)
+{
+	const uint32_t mask = (1u << bits) - 1;
+
+	if (bits == 16) {
+		for (int s = 0; s < count; s++) {
+			long byte = (first + (long)s*stride) * 2;
+			dst[s].r = (int16_t)(buf[byte] | (buf[byte + 1] << 8));
+			dst[s].i = (int16_t)(buf[byte + 2] | (buf[byte + 3] << 8));
+		}
+		return;
+	}
+
+	// Both fields of a sample lie within one 64-bit word, 2*bits + 7 <= 64
+	long bit = first*bits;
+	long step = (long)stride*bits;
+	int s = 0;
+	for (; s < count && ((bit >> 3) + 8 <= len); s++, bit += step) {
+		const uint8_t *p = buf + (bit >> 3);
+		uint64_t w = (uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24)
+			| ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) | ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+		w >>= (bit & 7);
+		dst[s].r = extend((uint32_t)w & mask, bits);
+		dst[s].i = extend((uint32_t)(w >> bits) & mask, bits);
+	}
+	// Last samples, the word would run past the buffer
+	for (; s < count; s++, bit += step) {
+		uint64_t w = load64(buf, len, bit >> 3) >> (bit & 7);
+		dst[s].r = extend((uint32_t)w & mask, bits);
+		dst[s].i = extend((uint32_t)(w >> bits) & mask, bits);
+	}
+}
+
+}
@@ -0,0 +1,28 @@
+/* --------------------------------------------------------------------------------------------
+FILE:		packed_samples.h
+DESCRIPTION  Decoding of packed 12/14/16-bit capture streams.
+		The stream is read as little endian fields of 'bits' width, field f
+		occupying bits [f*bits, (f+1)*bits) counted from bit 0 of byte 0.
+		This is the order readdata_qspark() used to obtain by reversing the
+		buffer and reading it MSB first from the end.
+CONTENT:
+AUTHOR:		Lime Microsystems LTD
+DATE:
+-------------------------------------------------------------------------------------------- */
+#ifndef PACKED_SAMPLES_H
+#define PACKED_SAMPLES_H
+
+#include <stdint.h>
+#include "kiss_fft.h"
+
+namespace packed_samples {
+	// Signed value of field f, one field at a time
+	int field(const uint8_t *buf, long len, int bits, long f);
+
+	// count complex samples, sample s takes its real part from field
+	// first + s*stride and its imaginary part from the field after it.
+	// Decoded a 64-bit word per sample, bits must be 12, 14 or 16.
+	void unpack_cpx(const uint8_t *buf, long len, int bits, long first, int stride, int count, kiss_fft_cpx *dst);
+}
+
+#endif
@@ -5,13 +5,18 @@ CONTENT:
 AUTHOR:		Lime Microsystems LTD
 DATE:		Jan 01, 2016
 -------------------------------------------------------------------------------------------- */
-#include "nrc.h"
 #include "qadpd.h"
+#include "mpoly_kernels.h"
+#include <stdio.h>
+#include <math.h>
+#include <vector>
 
 // Constructors
 // --------------------------------------------------------------------------------------------
 
+#ifndef M_PI
 #define M_PI 3.14159265359
+#endif
 
 
 qadpd::qadpd(int N, int M, int Nd) {
@@ -21,25 +26,17 @@ qadpd::qadpd(int N, int M, int Nd) {
 	g = 1.0;
 	lambda = 0.999;
 	alpha = 0.1;
+	delta = 1.0e-6;
 	training = LU;
 	//squared envelope
 	//sEnv = false;
 	sEnv = true;
 	am = (double)(1<<(14-1));
 	skip = 0;
-	fname = _T("qadpd_error.log");
-	fname2 = _T("qadpd_coeff.log");
-    uI_reg = 0; // 19.11.2015
-    uQ_reg = 0; // 19.11.2015
-	dI_reg = 0; 
-    dQ_reg = 0;
-	a = 0; b = 0;
-	a_ = 0; b_ = 0;
-	xIe = 0; xIep = 0;
-	xQe = 0; xQep = 0;
-	A = 0; B = 0; 
-	index = 0;
-	Ap = 0; Bp = 0;
+	fname = "qadpd_error.log";
+	fname2 = "qadpd_coeff.log";
+	head = 0; tapMask = 0;
+	dpos = 0; dMask = 0;
 	fp = 0;  fp2 = 0;
 	err = 0.0;
 	aerr = 0.0;
@@ -57,25 +54,17 @@ qadpd::qadpd(int N, int M, int Nd, double G, double Lambda, double Am, int Skip)
 	g = G;
 	lambda = Lambda;
 	alpha = 0.1;
+	delta = 1.0e-6;
 	training = LU;
 	// squared envelope
 	sEnv = true;
 	//sEnv = false;
 	am = Am;
 	skip = Skip;
-	fname = _T("qadpd_error.log");
-	fname2 = _T("qadpd_coeff.log");
-    uI_reg = 0; // 19.11.2015
-    uQ_reg = 0; // 19.11.2015
-	dI_reg = 0; 
-	dQ_reg = 0;
-	a = 0; b = 0;
-	a_ = 0; b_ = 0;
-	xIe = 0; xIep = 0;
-	xQe = 0; xQep = 0;
-	A = 0; B = 0; 
-	index = 0;
-	Ap = 0; Bp = 0;
+	fname = "qadpd_error.log";
+	fname2 = "qadpd_coeff.log";
+	head = 0; tapMask = 0;
+	dpos = 0; dMask = 0;
 	fp = 0;  fp2 = 0;
 	err = 0.0;
 	aerr = 0.0;
@@ -90,43 +79,24 @@ qadpd::qadpd(int N, int M, int Nd, double G, double Lambda, double Am, int Skip)
 
 void qadpd::release_memory(){
 	
-	if (nd != 0) {
-		if (uI_reg)  delete[] uI_reg;
-		if (uQ_reg)  delete[] uQ_reg;
-		if (dI_reg)  delete[] dI_reg;
-		if (dQ_reg)  delete[] dQ_reg;
-		uI_reg = 0;
-		uQ_reg = 0;
-		dI_reg = 0;
-		dQ_reg = 0;
-	}
+	dI_reg.clear(); dQ_reg.clear();
+	uI_reg.clear(); uQ_reg.clear();
 	// Polynomials
-	if (a)    nrc::free_matrix(a, 0, n, 0, m);
-	if (b)    nrc::free_matrix(b, 0, n, 0, m);
-
-	if (a_)    nrc::free_matrix(a_, 0, n, 0, m);
-	if (b_)    nrc::free_matrix(b_, 0, n, 0, m);
-
-	if (xIe)  nrc::free_matrix(xIe, 0, n, 0, m);
-	if (xIep) nrc::free_matrix(xIep, 0, n, 0, m);
-	if (xQe)  nrc::free_matrix(xQe, 0, n, 0, m);
-	if (xQep) nrc::free_matrix(xQep, 0, n, 0, m);
+	a.clear(); b.clear();
+	a_.clear(); b_.clear();
+	xIe.clear(); xIep.clear();
+	xQe.clear(); xQep.clear();
 	// Linear system of equations
-	if (A)     nrc::free_matrix(A, 1, 2 * (n + 1)*(m + 1), 1, 2 * (n + 1)*(m + 1));
-	if (Ap)    nrc::free_matrix(Ap, 1, 2 * (n + 1)*(m + 1), 1, 2 * (n + 1)*(m + 1));
-	if (B)     nrc::free_vector(B, 1, 2 * (n + 1)*(m + 1));
-	if (Bp)    nrc::free_vector(Bp, 1, 2 * (n + 1)*(m + 1));
-	if (index) nrc::free_ivector(index, 1, 2 * (n + 1)*(m + 1));
+	Gr.clear(); Gi.clear();
+	hr.clear(); hi.clear();
+	A.clear();
+	B.clear(); Bp.clear();
+	index.clear();
+	Pr.clear(); Pi.clear(); w.clear();
+	phi.clear(); Pphi.clear();
 
 	if (fp) fclose(fp);
 	if (fp2) fclose(fp2);	
-	a = 0; b = 0;
-	a_ = 0; b_ = 0;
-	xIe = 0; xIep = 0;
-	xQe = 0; xQep = 0;
-	A = 0; B = 0;
-	index = 0;
-	Ap = 0; Bp = 0;
 	fp = 0;  fp2 = 0;
 	skiping = -1;
 	updating = -1;
@@ -135,41 +105,11 @@ void qadpd::release_memory(){
 qadpd::~qadpd()
 {
 	// Delay registers
-	if (nd != 0) {
-		if (uI_reg)  delete[] uI_reg; 
-		if (uQ_reg)  delete[] uQ_reg; 
-		if (dI_reg)  delete[] dI_reg;
-		if (dQ_reg)  delete[] dQ_reg;
-		uI_reg = 0;
-		uQ_reg = 0;
-		dI_reg = 0;
-		dQ_reg = 0;
-	}
-	// Polynomials
-	if(a)    nrc::free_matrix(a,    0, n, 0, m);
-	if(b)    nrc::free_matrix(b,    0, n, 0, m);
-	if (a_)    nrc::free_matrix(a_, 0, n, 0, m);
-	if (b_)    nrc::free_matrix(b_, 0, n, 0, m);
-	if(xIe)  nrc::free_matrix(xIe,  0, n, 0, m);
-	if(xIep) nrc::free_matrix(xIep, 0, n, 0, m);
-	if(xQe)  nrc::free_matrix(xQe,  0, n, 0, m);
-	if(xQep) nrc::free_matrix(xQep, 0, n, 0, m);
-	// Linear system of equations
-	if(A)     nrc::free_matrix(A,      1, 2*(n+1)*(m+1), 1, 2*(n+1)*(m+1));
-	if(Ap)    nrc::free_matrix(Ap,     1, 2*(n+1)*(m+1), 1, 2*(n+1)*(m+1));
-	if(B)     nrc::free_vector(B,      1, 2*(n+1)*(m+1));
-	if(Bp)    nrc::free_vector(Bp,     1, 2*(n+1)*(m+1));
-	if(index) nrc::free_ivector(index, 1, 2*(n+1)*(m+1));
+	// freed by their destructors
+	// Polynomials and the linear system are freed by their destructors
 
 	if (fp) fclose(fp);
 	if (fp2) fclose(fp2);	
-	a = 0; b = 0;
-	a_ = 0; b_ = 0;
-	xIe = 0; xIep = 0;
-	xQe = 0; xQep = 0;
-	A = 0; B = 0;
-	index = 0;
-	Ap = 0; Bp = 0;
 	fp = 0;  fp2 = 0;
 	skiping = -1;
 	updating = -1;
@@ -178,29 +118,47 @@ qadpd::~qadpd()
 
 void qadpd::reset_matrix(){
 
-	for (int i = 1; i <= 2 * (n + 1)*(m + 1); i++) {
-		B[i] = Bp[i] = 0.0;
-		index[i] = 0;
-		for (int j = 1; j <= 2 * (n + 1)*(m + 1); j++)
-			A[i][j] = Ap[i][j] = 0.0;
+	Gr.fill(0.0);
+	Gi.fill(0.0);
+	hr.fill(0.0);
+	hi.fill(0.0);
+	A.fill(0.0);
+	B.fill(0.0);
+	Bp.fill(0.0);
+	for (int i = 0; i < 2 * (n + 1)*(m + 1); i++) index[i] = 0;
+
+	// RLS restarts from the current coefficients
+	Pr.fill(0.0);
+	Pi.fill(0.0);
+	for (int i = 0; i < (n + 1)*(m + 1); i++) Pr[i][i] = 1.0 / delta;
+	for (int i = 0; i <= n; i++) {
+		for (int j = 0; j <= m; j++) {
+			w[i + (n + 1)*j] = a_[i][j];
+			w[i + (n + 1)*j + (n + 1)*(m + 1)] = b_[i][j];
+		}
 	}
-
 }
 
 
 void qadpd::prepare(){
-	for (int i = 0; i <= n; i++) {
-		for (int j = 0; j <= m; j++) {
-			xIe[i][j] = xIep[i][j] = 0.0;
-			xQe[i][j] = xQep[i][j] = 0.0;
-		}
-	}
-	if (nd != 0) {
-		for (int k = 0; k<nd; k++) {
-			dI_reg[k] = dQ_reg[k] = 0.0;
-			uI_reg[k] = uQ_reg[k] = 0.0;
-		}
-	}
+	clear_delay_lines();
+}
+
+// Smallest power of two holding len values
+static int ring_size(int len)
+{
+	int size = 1;
+	while (size < len) size <<= 1;
+	return size;
+}
+
+void qadpd::clear_delay_lines(){
+	xIe.fill(0.0); xIep.fill(0.0);
+	xQe.fill(0.0); xQep.fill(0.0);
+	head = 0;
+	dI_reg.fill(0.0); dQ_reg.fill(0.0);
+	uI_reg.fill(0.0); uQ_reg.fill(0.0);
+	dpos = 0;
 }
 // --------------------------------------------------------------------------------------------
 void qadpd::init(int N, int M, int Nd, double G, double Lambda,  double Am, int Skip)
@@ -224,27 +182,19 @@ void qadpd::init(int N, int M, int Nd, double G, double Lambda,  double Am, int
 	//sEnv = false;
 	am = Am;	
 	skip = Skip;
-	fname = _T("qadpd_error.log");
-	fname2 = _T("qadpd_coeff.log");
+	// fname and fname2 keep the names set by the constructor or the caller
 	//update = 0; izbacio
 
-	// Delay registers
+	// Delay registers, power of two rings of at least nd values
 	if(nd != 0) {
-		//if (dI_reg) delete[] dI_reg;
-		//if (dQ_reg) delete[] dQ_reg;
-		//if (uI_reg)  delete[] uI_reg;
-		//if (uQ_reg)  delete[] uQ_reg;
-
-		dI_reg = new double[nd];
-		dQ_reg = new double[nd];
-        uI_reg = new double[nd]; 
-		uQ_reg = new double[nd]; 
-
-        for(int k=0; k<nd; k++) {            
-            dI_reg[k] = dQ_reg[k] = 0.0;
-			uI_reg[k] = uQ_reg[k] = 0.0; 
-        }
+		int size = ring_size(nd);
+		dI_reg.resize(size);
+		dQ_reg.resize(size);
+		uI_reg.resize(size);
+		uQ_reg.resize(size);
+		dMask = size - 1;
 	}
+	dpos = 0;
 	// Polynomials
 	
 	//if (a)    nrc::free_matrix(a, 0, n, 0, m);
@@ -256,23 +206,24 @@ void qadpd::init(int N, int M, int Nd, double G, double Lambda,  double Am, int
 	
 	
     // Polynomials
-	a = nrc::matrix(0, n, 0, m);
-	b = nrc::matrix(0, n, 0, m);	
+	a.resize(n + 1, m + 1);
+	b.resize(n + 1, m + 1);
 
-	a_ = nrc::matrix(0, n, 0, m);
-	b_ = nrc::matrix(0, n, 0, m);
+	a_.resize(n + 1, m + 1);
+	b_.resize(n + 1, m + 1);
 
-	xIe = nrc::matrix(0, n, 0, m);
-	xIep = nrc::matrix(0, n, 0, m);
-	xQe = nrc::matrix(0, n, 0, m);
-	xQep = nrc::matrix(0, n, 0, m);
+	// Tap delay lines, rows of a power of two ring
+	xIe.resize(ring_size(n + 1), m + 1);
+	xIep.resize(ring_size(n + 1), m + 1);
+	xQe.resize(ring_size(n + 1), m + 1);
+	xQep.resize(ring_size(n + 1), m + 1);
+	tapMask = ring_size(n + 1) - 1;
+	head = 0;
 
 	for(int i=0; i<=n; i++) {		
 		for(int j=0; j<=m; j++) {
 			a[i][j] = b[i][j] = 0.0;
 			a_[i][j] = b_[i][j] = 0.0; // novel
-			xIe[i][j] = xIep[i][j] = 0.0;
-			xQe[i][j] = xQep[i][j] = 0.0;
 		}
 	}
 
@@ -289,18 +240,22 @@ void qadpd::init(int N, int M, int Nd, double G, double Lambda,  double Am, int
 	//if (index) nrc::free_ivector(index, 1, 2 * (n + 1)*(m + 1));
 	
 	// Linear system of equations
-	A =      nrc::matrix(1, 2*(n+1)*(m+1), 1, 2*(n+1)*(m+1));
-	Ap =     nrc::matrix(1, 2*(n+1)*(m+1), 1, 2*(n+1)*(m+1));
-	B =      nrc::vector(1, 2*(n+1)*(m+1));
-	Bp =     nrc::vector(1, 2*(n+1)*(m+1));
-	index =  nrc::ivector(1, 2*(n+1)*(m+1));
-
-	for(int i=1; i<=2*(n+1)*(m+1); i++) {
-		B[i] = Bp[i] = 0.0;
-		index[i] = 0;
-		for(int j=1; j<=2*(n+1)*(m+1); j++) 
-			A[i][j] = Ap[i][j] = 0.0;
-	}
+	Gr.resize((n+1)*(m+1), (n+1)*(m+1));
+	Gi.resize((n+1)*(m+1), (n+1)*(m+1));
+	hr.resize((n+1)*(m+1));
+	hi.resize((n+1)*(m+1));
+	A.resize(2*(n+1)*(m+1), 2*(n+1)*(m+1));
+	B.resize(2*(n+1)*(m+1));
+	Bp.resize(2*(n+1)*(m+1));
+	index.resize(2*(n+1)*(m+1));
+
+	Pr.resize((n+1)*(m+1), (n+1)*(m+1));
+	Pi.resize((n+1)*(m+1), (n+1)*(m+1));
+	w.resize(2*(n+1)*(m+1));
+	phi.resize(2*(n+1)*(m+1));
+	Pphi.resize(2*(n+1)*(m+1));
+
+	reset_matrix();
 	
 	skiping = -1;
 	updating = -1;
@@ -316,7 +271,7 @@ void qadpd::init(int N, int M, int Nd, double G, double Lambda,  double Am, int
 	}
 
 	if (fp) fclose(fp);
-	//fp = NULL;
+	fp = NULL;
 
 	if(fname2.length() > 0) {
 		fp2 = fopen(fname2.c_str(), "w");		
@@ -327,7 +282,7 @@ void qadpd::init(int N, int M, int Nd, double G, double Lambda,  double Am, int
 	}
 
 	if (fp2) fclose(fp2);
-	//fp2 = NULL;
+	fp2 = NULL;
 
 	write_coeff();
 
@@ -361,7 +316,6 @@ void qadpd::always(double XIp, double XQp, double XI, double XQ, double YIp, dou
 void qadpd::write_coeff(){
 
 	// Print the coefficients
-	fname2 = _T("qadpd_coeff.log");
 	if (fname2.length() > 0) {
 		fp2 = fopen(fname2.c_str(), "a");
 	}
@@ -395,7 +349,6 @@ void qadpd::write_error(){
 void qadpd::start()
 {
 
-	fname = _T("qadpd_error.log");
 	if (fname.length() > 0) {
 		fp = fopen(fname.c_str(), "a");
 	}
@@ -422,29 +375,34 @@ void qadpd::oeval(double XIp, double XQp, double XI, double XQ, double YIp, doub
 	double dI, dQ;		// Delayed xp
 	
 
+	// The software predistorter is only used when u does not come from the FPGA
+	bool softYp = (nd == 0) || (Yp_FPGA == false);
+
 	// Envelopes
 	e  =   XI*XI +   XQ*XQ; e  /= am*am; 
 	if(sEnv == false) e  = sqrt(e);
-	ep = XIp*XIp + XQp*XQp; ep /= am*am; 
-	if(sEnv == false) ep = sqrt(ep);
 
-	// Update delay register matrices
-	for(int i=n; i>0; i--) {
-		for(int j=0; j<=m; j++) {
-			 xIe[i][j] =  xIe[i-1][j];
-			xIep[i][j] = xIep[i-1][j];
-			 xQe[i][j] =  xQe[i-1][j];
-			xQep[i][j] = xQep[i-1][j];
-		}
-	}
-	xIe[0][0] = XI;	xIep[0][0] = XIp;
-	xQe[0][0] = XQ; xQep[0][0] = XQp;
-	
+	// Update delay register matrices, the new sample takes the row of the
+	// oldest tap instead of moving every row down. Each power series is
+	// computed once here and read by every tap afterwards.
+	head = (head + 1) & tapMask;
+	double *eI = xIe[head], *eIp = xIep[head];
+	double *eQ = xQe[head], *eQp = xQep[head];
+	eI[0] = XI;
+	eQ[0] = XQ;
 	for(int j=1; j<=m; j++) {
-		 xIe[0][j] =  xIe[0][j-1] * e;
-		xIep[0][j] = xIep[0][j-1] * ep;
-		 xQe[0][j] =  xQe[0][j-1] * e;
-		xQep[0][j] = xQep[0][j-1] * ep;
+		 eI[j] =  eI[j-1] * e;
+		 eQ[j] =  eQ[j-1] * e;
+	}
+	if (softYp) {
+		ep = XIp*XIp + XQp*XQp; ep /= am*am; 
+		if(sEnv == false) ep = sqrt(ep);
+		eIp[0] = XIp;
+		eQp[0] = XQp;
+		for(int j=1; j<=m; j++) {
+			eIp[j] = eIp[j-1] * ep;
+			eQp[j] = eQp[j-1] * ep;
+		}
 	}
 
 	// potrebno je (n+1) poziva ove funkcije 
@@ -454,13 +412,22 @@ void qadpd::oeval(double XIp, double XQp, double XI, double XQ, double YIp, doub
 	//  control software
 
 	for(int i=0; i<= n; i++) {
+		const double *ai = a[i], *bi = b[i];
+		const double *xIi = xIe[tap(i)], *xQi = xQe[tap(i)];
 		for(int j=0; j<=m; j++) {
-            yI  += a[i][j]* xIe[i][j] - b[i][j]* xQe[i][j]; 
-            yQ  += a[i][j]* xQe[i][j] + b[i][j]* xIe[i][j];
-			
-			//ovo je nebitno jer se racuna hardverski
-            YpI  += a[i][j]* xIep[i][j] - b[i][j]* xQep[i][j]; 
-            YpQ  += a[i][j]* xQep[i][j] + b[i][j]* xIep[i][j];
+            yI  += ai[j]* xIi[j] - bi[j]* xQi[j]; 
+            yQ  += ai[j]* xQi[j] + bi[j]* xIi[j];
+		}
+	}
+	//ovo je nebitno jer se racuna hardverski
+	if (softYp) {
+		for(int i=0; i<= n; i++) {
+			const double *ai = a[i], *bi = b[i];
+			const double *xIpi = xIep[tap(i)], *xQpi = xQep[tap(i)];
+			for(int j=0; j<=m; j++) {
+	            YpI  += ai[j]* xIpi[j] - bi[j]* xQpi[j]; 
+	            YpQ  += ai[j]* xQpi[j] + bi[j]* xIpi[j];
+			}
 		}
 	}
 
@@ -497,10 +464,13 @@ void qadpd::oeval(double XIp, double XQp, double XI, double XQ, double YIp, doub
         uI = YpI; // 19.11.2015
         uQ = YpQ; // 19.11.2015
 	} else {
-		dI = dI_reg[nd-1]; for(int k=nd-1; k>=1; k--) dI_reg[k] = dI_reg[k-1]; dI_reg[0] = XIp;
-		dQ = dQ_reg[nd-1]; for(int k=nd-1; k>=1; k--) dQ_reg[k] = dQ_reg[k-1]; dQ_reg[0] = XQp;
-        uI  =  uI_reg[nd-1]; for(int k=nd-1; k>=1; k--)  uI_reg[k] =  uI_reg[k-1];  uI_reg[0] = YpI_; 
-        uQ  =  uQ_reg[nd-1]; for(int k=nd-1; k>=1; k--)  uQ_reg[k] =  uQ_reg[k-1];  uQ_reg[0] = YpQ_; 
+		// value written nd samples ago, then this sample takes its slot
+		int old = (dpos - nd) & dMask;
+		dI = dI_reg[old]; dI_reg[dpos] = XIp;
+		dQ = dQ_reg[old]; dQ_reg[dpos] = XQp;
+        uI  =  uI_reg[old];  uI_reg[dpos] = YpI_; 
+        uQ  =  uQ_reg[old];  uQ_reg[dpos] = YpQ_; 
+		dpos = (dpos + 1) & dMask;
 	}
 
 	// Errors
@@ -515,6 +485,85 @@ void qadpd::oeval(double XIp, double XQp, double XI, double XQ, double YIp, doub
 	
 }
 
+// --------------------------------------------------------------------------------------------
+// Power series x*e^j, j = 0..m, of count samples, term j of sample s at
+// pI[j*stride + s]. The terms of a sample are computed once, every tap then
+// reads them at s - i, so one basis serves all taps and, shifted, every lag
+// of the delay search.
+// --------------------------------------------------------------------------------------------
+void qadpd::basis(const double *XI, const double *XQ, int count, double *pI, double *pQ, int stride) const
+{
+	mpoly::power_basis(XI, XQ, count, m, am, sEnv, pI, pQ, stride);
+}
+
+// --------------------------------------------------------------------------------------------
+// Memory polynomial over a precomputed basis, for s = 0..count-1
+// y[s] = sum (a[i][j] + j*b[i][j])*p[j*stride + s - i]
+// The basis has to hold n samples before s = 0, zeros where the signal has
+// no history. The output is not clipped.
+// --------------------------------------------------------------------------------------------
+void qadpd::eval_basis(const double *pI, const double *pQ, int stride, int count, double *YI, double *YQ) const
+{
+	for (int k = 0; k < count; k++) YI[k] = YQ[k] = 0.0;
+	for (int i = 0; i <= n; i++)
+		for (int j = 0; j <= m; j++)
+			mpoly::cmac(YI, YQ, pI + j*stride - i, pQ + j*stride - i, a[i][j], b[i][j], count);
+}
+
+// --------------------------------------------------------------------------------------------
+// Output evaluation of a whole span.
+// Gives the same y, u and err as calling oeval() for every sample after
+// prepare(), without touching the delay registers. The span is processed in
+// blocks of EVAL_BLOCK samples, the basis of each block is built once with
+// the n samples before it and evaluated by eval_basis().
+// Err can be NULL.
+// --------------------------------------------------------------------------------------------
+#define EVAL_BLOCK 512
+
+void qadpd::oeval_block(const double *XIp, const double *XQp, const double *XI, const double *XQ,
+	const double *YIp, const double *YQp, int count, bool Yp_FPGA,
+	double *YI, double *YQ, double *UI, double *UQ, double *Err) const
+{
+	int stride = n + EVAL_BLOCK;
+	bool softYp = (nd == 0) || (Yp_FPGA == false);
+	std::vector<double> bI((m+1)*stride, 0.0), bQ((m+1)*stride, 0.0);
+	std::vector<double> ypI, ypQ;	// predistorter output before the nd delay
+	if (softYp) {
+		ypI.resize(count);
+		ypQ.resize(count);
+	}
+
+	for (int s0 = 0; s0 < count; s0 += EVAL_BLOCK) {
+		int len = (count - s0 < EVAL_BLOCK) ? (count - s0) : EVAL_BLOCK;
+		int hist = (s0 < n) ? s0 : n;
+
+		// Postdistorter, feedback signal. Before the span the delay lines
+		// hold zeros, the first n - hist slots stay zero.
+		basis(XI + s0 - hist, XQ + s0 - hist, len + hist, &bI[n - hist], &bQ[n - hist], stride);
+		eval_basis(&bI[n], &bQ[n], stride, len, YI + s0, YQ + s0);
+		mpoly::clip(YI + s0, len, 0 - am, am - 1);
+		mpoly::clip(YQ + s0, len, 0 - am, am - 1);
+
+		// Predistorter, computed in software
+		if (softYp) {
+			basis(XIp + s0 - hist, XQp + s0 - hist, len + hist, &bI[n - hist], &bQ[n - hist], stride);
+			eval_basis(&bI[n], &bQ[n], stride, len, &ypI[s0], &ypQ[s0]);
+		}
+	}
+
+	// Delays
+	const double *uIsrc = softYp ? &ypI[0] : YIp;
+	const double *uQsrc = softYp ? &ypQ[0] : YQp;
+	for (int s = 0; s < count; s++) {
+		if (s >= nd) {
+			UI[s] = uIsrc[s - nd];
+			UQ[s] = uQsrc[s - nd];
+		}
+		else UI[s] = UQ[s] = 0.0;
+		if (Err) Err[s] = fabs(sqrt((YI[s]-UI[s])*(YI[s]-UI[s]) + (YQ[s]-UQ[s])*(YQ[s]-UQ[s])))/am;
+	}
+}
+
 // --------------------------------------------------------------------------------------------
 // Recursive Least Squares
 // --------------------------------------------------------------------------------------------
@@ -621,85 +670,295 @@ void qadpd::reset_coeff()
 		for (int j = 0; j <= m; j++) {
 			a[i][j] = b[i][j] = 0.0;
 			a_[i][j] = b_[i][j] = 0.0; // novel
-			xIe[i][j] = xIep[i][j] = 0.0;
-			xQe[i][j] = xQep[i][j] = 0.0;
 		}
 	}
+	xIe.fill(0.0); xIep.fill(0.0);
+	xQe.fill(0.0); xQep.fill(0.0);
 
 	a[0][0] = 1.0;
 	a_[0][0] = 1.0;
 }
 
+// --------------------------------------------------------------------------------------------
+// One exponentially weighted RLS step for the complex regression row x of a
+// sample, Phi = [Re x; Im x], with the same G = lambda*G + x^H*x as the LU
+// path. P = inv(G) is Hermitian, so with v = P*conj(x)
+// w = w + v*(d - x*w)/den and P = (P - v*v^H/den)/lambda, den = lambda + x*v.
+// Only the upper triangle of P is kept.
+// --------------------------------------------------------------------------------------------
+void qadpd::rls_update(const double *Phi, double dI, double dQ)
+{
+	int K = (n+1)*(m+1);
+	const double *xr = Phi, *xi = Phi + K;
+	double *vr = Pphi.data(), *vi = Pphi.data() + K;
+
+	// v = P*conj(x), row c of the upper triangle also gives column c below it
+	for(int c=0; c<K; c++) vr[c] = vi[c] = 0.0;
+	for(int c=0; c<K; c++) {
+		const double *pr = Pr[c], *pi = Pi[c];
+		double sr = pr[c]*xr[c];	// the diagonal is real
+		double si = -pr[c]*xi[c];
+		for(int d=c+1; d<K; d++) {
+			sr += pr[d]*xr[d] + pi[d]*xi[d];
+			si += pi[d]*xr[d] - pr[d]*xi[d];
+			vr[d] += pr[d]*xr[c] - pi[d]*xi[c];
+			vi[d] -= pi[d]*xr[c] + pr[d]*xi[c];
+		}
+		vr[c] += sr;
+		vi[c] += si;
+	}
+
+	double den = lambda;	// lambda + x*v, real for a Hermitian P
+	double er = dI, ei = dQ;	// e = d - x*w
+	for(int c=0; c<K; c++) {
+		den += xr[c]*vr[c] - xi[c]*vi[c];
+		er -= xr[c]*w[c] - xi[c]*w[c+K];
+		ei -= xr[c]*w[c+K] + xi[c]*w[c];
+	}
+
+	double rden = 1.0/den, rlambda = 1.0/lambda;
+	for(int c=0; c<K; c++) {
+		double kr = vr[c]*rden, ki = vi[c]*rden;
+		w[c]   += kr*er - ki*ei;
+		w[c+K] += kr*ei + ki*er;
+		// P[c][d] -= k[c]*conj(v[d])
+		double *pr = Pr[c], *pi = Pi[c];
+		for(int d=c; d<K; d++) {
+			pr[d] = (pr[d] - (kr*vr[d] + ki*vi[d]))*rlambda;
+			pi[d] = (pi[d] - (ki*vr[d] - kr*vi[d]))*rlambda;
+		}
+	}
+}
+
 void qadpd::train()
 {
 
-	int ij, kl;
-	double dd=0.0;
-	
-	for(int k=0; k<=n; k++) {
-		for(int l=0; l<=m; l++) {
-			kl = k+(n+1)*l;
+	int ij;
 
-            Bp[1+kl] = lambda*Bp[1+kl] + uI*xIe[k][l]/am/am + uQ*xQe[k][l]/am/am;// 19.11.2015
+	// Basis of this sample, x[c] = phi[c] + j*phi[c+K]
+	int K = (n+1)*(m+1);
+	for(int i=0; i<=n; i++) {
+		const double *xIi = xIe[tap(i)], *xQi = xQe[tap(i)];
+		for(int j=0; j<=m; j++) {
+			ij = i+(n+1)*j;
+			phi[ij] = xIi[j]/am;
+			phi[ij+K] = xQi[j]/am;
+		}
+	}
 
-			B [1+kl] = Bp[1+kl];
-            Bp[1+kl+(n+1)*(m+1)] = lambda*Bp[1+kl+(n+1)*(m+1)] - uI*xQe[k][l]/am/am + uQ*xIe[k][l]/am/am;// 19.11.2015
-			B [1+kl+(n+1)*(m+1)] = Bp[1+kl+(n+1)*(m+1)];
+	if(training == RLS) {
+		rls_update(phi.data(), uI/am, uQ/am);
+		if (updating==0) {
 			for(int i=0; i<=n; i++) {
 				for(int j=0; j<=m; j++) {
-					ij = i+(n+1)*j;
-					Ap[1+kl][1+ij] = lambda*Ap[1+kl][1+ij] + 
-								xIe[i][j]*xIe[k][l]/am/am +
-                                xQe[i][j]*xQe[k][l]/am/am;// 19.11.2015
-					A [1+kl][1+ij] = Ap[1+kl][1+ij];
-
-					Ap[1+kl][1+ij+(n+1)*(m+1)] = 
-						lambda*Ap[1+kl][1+ij+(n+1)*(m+1)] - 
-							xQe[i][j]*xIe[k][l]/am/am +
-                            xIe[i][j]*xQe[k][l]/am/am;// 19.11.2015
-					A [1+kl][1+ij+(n+1)*(m+1)] = Ap[1+kl][1+ij+(n+1)*(m+1)];
-
-					Ap[1+kl+(n+1)*(m+1)][1+ij] = 
-						lambda*Ap[1+kl+(n+1)*(m+1)][1+ij] - 
-                                    			xIe[i][j]*xQe[k][l]/am/am +
-                            xQe[i][j]*xIe[k][l]/am/am;// 19.11.2015
-					A [1+kl+(n+1)*(m+1)][1+ij] = Ap[1+kl+(n+1)*(m+1)][1+ij];
-
-					Ap[1+kl+(n+1)*(m+1)][1+ij+(n+1)*(m+1)] = 
-						lambda*Ap[1+kl+(n+1)*(m+1)][1+ij+(n+1)*(m+1)] + 
-								xQe[i][j]*xQe[k][l]/am/am +
-                                xIe[i][j]*xIe[k][l]/am/am;// 19.11.2015
-					A [1+kl+(n+1)*(m+1)][1+ij+(n+1)*(m+1)] = 
-						Ap[1+kl+(n+1)*(m+1)][1+ij+(n+1)*(m+1)];
+					a_[i][j] = w[i+(n+1)*j];
+					b_[i][j] = w[i+(n+1)*j+(n+1)*(m+1)];
 				}
 			}
 		}
+		return;
 	}
-	
+
+	// G = lambda*G + x^H*x on the upper triangle, h = lambda*h + x^H*u
+	double ur = uI/am, ui = uQ/am;
+	for(int c=0; c<K; c++) {
+		double xr = phi[c], xi = -phi[c+K];	// conj(x[c])
+		double *gr = Gr[c], *gi = Gi[c];
+		for(int d=c; d<K; d++) {
+			gr[d] = lambda*gr[d] + xr*phi[d] - xi*phi[d+K];
+			gi[d] = lambda*gi[d] + xr*phi[d+K] + xi*phi[d];
+		}
+		hr[c] = lambda*hr[c] + xr*ur - xi*ui;
+		hi[c] = lambda*hi[c] + xr*ui + xi*ur;
+	}
+
 	//update ++;
 
     if (updating==0) {
-		if(training == LU) {
-			nrc::ludcmp(A, 2*(n+1)*(m+1), index, &dd); 
-			nrc::lubksb(A, 2*(n+1)*(m+1), index, B);
-		} 
-		else {
-			for(int i=0; i<=n; i++) {
-				for(int j=0; j<=m; j++) {
-					B[1+i+(n+1)*j] = a[i][j];
-					B[1+i+(n+1)*j+(n+1)*(m+1)] = b[i][j];
-				}
-			}
-			if(training == GRAD)    nrc::lgrad(A, Bp, B, 2*(n+1)*(m+1), alpha);
-			else if(training == GS) nrc::gauss_seidel(A, Bp, B, 2*(n+1)*(m+1));
-		}
+		solve();
 		// update
 		for(int i=0; i<=n; i++) {
 			for(int j=0; j<=m; j++) {
-				a_[i][j] = B[1+i+(n+1)*j]; //novel
-				b_[i][j] = B[1+i+(n+1)*j+(n+1)*(m+1)]; //novel
+				a_[i][j] = B[i+(n+1)*j]; //novel
+				b_[i][j] = B[i+(n+1)*j+(n+1)*(m+1)]; //novel
 			}
 		}
      } // if updating
 }
 
+// --------------------------------------------------------------------------------------------
+// Real form of G*w = h, A = [Re G, -Im G; Im G, Re G] and Bp = [Re h; Im h],
+// from the upper triangle of G
+// --------------------------------------------------------------------------------------------
+void qadpd::real_form()
+{
+	int K = (n+1)*(m+1);
+	for(int c=0; c<K; c++) {
+		for(int d=0; d<K; d++) {
+			double re = (d >= c) ? Gr[c][d] : Gr[d][c];
+			double im = (d >= c) ? Gi[c][d] : -Gi[d][c];
+			A[c][d]     = re;
+			A[c][d+K]   = -im;
+			A[c+K][d]   = im;
+			A[c+K][d+K] = re;
+		}
+		Bp[c]   = hr[c];
+		Bp[c+K] = hi[c];
+	}
+}
+
+// --------------------------------------------------------------------------------------------
+// Solves the normal equations into B, real parts first. LU and BLOCK use the
+// complex Cholesky and fall back to LU on the real form if G is not positive
+// definite. GS and GRAD iterate on the real form from the current a, b.
+// --------------------------------------------------------------------------------------------
+void qadpd::solve()
+{
+	int K = (n+1)*(m+1);
+	double dd = 0.0;
+
+	if((training == LU) || (training == BLOCK)) {
+		dense::vec p(K);
+		if(dense::zcholdc(Gr, Gi, p.data()) == 0) {
+			dense::zcholsl(Gr, Gi, p.data(), hr.data(), hi.data(), B.data(), B.data() + K);
+			return;
+		}
+		real_form();
+		for(int i=0; i<2*K; i++) B[i] = Bp[i];
+		dense::ludcmp(A, &index[0], &dd);
+		dense::lubksb(A, &index[0], B.data());
+		return;
+	}
+
+	real_form();
+	for(int i=0; i<=n; i++) {
+		for(int j=0; j<=m; j++) {
+			B[i+(n+1)*j] = a[i][j];
+			B[i+(n+1)*j+(n+1)*(m+1)] = b[i][j];
+		}
+	}
+	if(training == GRAD)    dense::lgrad(A, Bp.data(), B.data(), alpha);
+	else if(training == GS) dense::gauss_seidel(A, Bp.data(), B.data());
+}
+
+
+// --------------------------------------------------------------------------------------------
+// Block least squares over a whole capture.
+// Samples [0, Skip) only fill the delay lines, samples [Skip, count) are the
+// regression rows. The rows are weighted by lambda in the same way as the
+// per sample accumulation in train(), so the result matches the LU path
+// for the same samples. The memory polynomial basis is built by basis(),
+// X^H*X and X^H*u are accumulated over blocks of BLOCK_ROWS rows, and the
+// system is solved once by solve().
+// --------------------------------------------------------------------------------------------
+#define BLOCK_ROWS 128
+
+int qadpd::train_block(const double *XIp, const double *XQp, const double *XI, const double *XQ,
+	const double *YIp, const double *YQp, int count, int Skip, bool Yp_FPGA)
+{
+	int K = (n+1)*(m+1);
+	int rows = count - Skip;
+
+	if ((rows <= 0) || (Skip <= n + nd)) return -1;
+
+	// Power series x*e^j of every sample, [j*count + s], shared by all taps
+	std::vector<double> pI((m+1)*count), pQ((m+1)*count);
+	bool softYp = (nd == 0) || (Yp_FPGA == false);
+	basis(XI, XQ, count, &pI[0], &pQ[0], count);
+
+	// Postdistorter target u, normalised. The software predistorter runs
+	// over the xp basis, rows start at Skip - nd > n so every tap is valid.
+	std::vector<double> uIv(rows), uQv(rows);
+	if (softYp) {
+		std::vector<double> ppI((m+1)*count), ppQ((m+1)*count);
+		basis(XIp, XQp, count, &ppI[0], &ppQ[0], count);
+		eval_basis(&ppI[Skip - nd], &ppQ[Skip - nd], count, rows, &uIv[0], &uQv[0]);
+	}
+	else {
+		for (int t = 0; t < rows; t++) {
+			uIv[t] = YIp[Skip + t - nd];
+			uQv[t] = YQp[Skip + t - nd];
+		}
+	}
+	for (int t = 0; t < rows; t++) {
+		uIv[t] /= am;
+		uQv[t] /= am;
+	}
+
+	// Hermitian G = X^H*W*X (upper triangle) and h = X^H*W*u
+	std::vector<double> Gr_(K*K, 0.0), Gi_(K*K, 0.0);
+	std::vector<double> hr_(K, 0.0), hi_(K, 0.0);
+	std::vector<double> Xr(K*BLOCK_ROWS), Xi(K*BLOCK_ROWS);
+	std::vector<double> wXr(K*BLOCK_ROWS), wXi(K*BLOCK_ROWS);
+
+	double wlast = 1.0;	// lambda^(rows-1-t) for the last row of the block
+	for (int t0 = rows; t0 > 0; t0 -= BLOCK_ROWS) {
+		int tb = (t0 >= BLOCK_ROWS) ? (t0 - BLOCK_ROWS) : 0;
+		int R = t0 - tb;
+		double wt = wlast;
+		for (int r = R - 1; r >= 0; r--) {
+			int s = Skip + tb + r;
+			for (int k = 0; k <= n; k++) {
+				for (int l = 0; l <= m; l++) {
+					int c = k + (n+1)*l;
+					double xr = pI[l*count + s - k]/am;
+					double xi = pQ[l*count + s - k]/am;
+					Xr[c*BLOCK_ROWS + r] = xr;
+					Xi[c*BLOCK_ROWS + r] = xi;
+					wXr[c*BLOCK_ROWS + r] = wt*xr;
+					wXi[c*BLOCK_ROWS + r] = wt*xi;
+				}
+			}
+			wt *= lambda;
+		}
+		wlast = wt;
+
+		for (int c = 0; c < K; c++) {
+			const double *wxr = &wXr[c*BLOCK_ROWS];
+			const double *wxi = &wXi[c*BLOCK_ROWS];
+			for (int d = c; d < K; d++) {
+				const double *xr = &Xr[d*BLOCK_ROWS];
+				const double *xi = &Xi[d*BLOCK_ROWS];
+				double re = 0.0, im = 0.0;
+				for (int r = 0; r < R; r++) {
+					re += wxr[r]*xr[r] + wxi[r]*xi[r];
+					im += wxr[r]*xi[r] - wxi[r]*xr[r];
+				}
+				Gr_[c*K + d] += re;
+				Gi_[c*K + d] += im;
+			}
+			const double *ur = &uIv[tb];
+			const double *ui = &uQv[tb];
+			double re = 0.0, im = 0.0;
+			for (int r = 0; r < R; r++) {
+				re += wxr[r]*ur[r] + wxi[r]*ui[r];
+				im += wxr[r]*ui[r] - wxi[r]*ur[r];
+			}
+			hr_[c] += re;
+			hi_[c] += im;
+		}
+	}
+
+	// Appended to the forgotten history
+	for (int c = 0; c < K; c++) {
+		double *gr = Gr[c], *gi = Gi[c];
+		for (int d = c; d < K; d++) {
+			gr[d] = wlast*gr[d] + Gr_[c*K + d];
+			gi[d] = wlast*gi[d] + Gi_[c*K + d];
+		}
+		hr[c] = wlast*hr[c] + hr_[c];
+		hi[c] = wlast*hi[c] + hi_[c];
+	}
+	solve();
+
+	for (int i = 0; i <= n; i++) {
+		for (int j = 0; j <= m; j++) {
+			a_[i][j] = B[i+(n+1)*j];
+			b_[i][j] = B[i+(n+1)*j+(n+1)*(m+1)];
+		}
+	}
+	write_coeff();
+	skiping = -1;
+	updating = -1;
+	return 0;
+}
@@ -6,7 +6,10 @@ AUTHOR:		Lime Microsystems LTD
 DATE:		Jan 01, 2016
 -------------------------------------------------------------------------------------------- */
 //using namespace std;
-#include <wx/string.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "dense_matrix.h"
 
 class qadpd { 
 public:   
@@ -30,6 +33,7 @@ public:
     double g;		// The gain of the predistorter
     double lambda;  // RLS/SGRAD weighting coefficient
     double alpha;   // SGRAD adaptation step size
+    double delta;   // RLS initialisation, P(0) = I/delta
     int training;	// Training algorithm flag
     bool sEnv;		// Use squared envelope if true
     double am;		// Amplitude of IO signals.
@@ -38,13 +42,15 @@ public:
 	int skiping;
 	int updating;
 
-	wxString fname;	// Log file name
-	wxString fname2;	// Log file name
+	std::string fname;	// Log file name
+	std::string fname2;	// Log file name
 
-    enum {LU, GS, GRAD};	// Available training algorithms
+    enum {LU, GS, GRAD, RLS, BLOCK};	// Available training algorithms
                 // LU = LU factorisation
                 // GS = Gauss-Seidel
                 // GRAD = Gradient descent
+                // RLS = Recursive least squares, rank-one update of P
+                // BLOCK = Whole capture least squares, see train_block()
 	void write_coeff();
 	void reset_coeff();
 	void write_error();
@@ -56,15 +62,24 @@ public:
 	void release_memory();
 	void always(double XIp, double XQp, double XI, double XQ, double YIp, double YQp, bool Yp_FPGA);
 	void oeval(double XIp, double XQp, double XI, double XQ, double YIp, double YQp, bool Yp_FPGA);
+	// Power series of a span, computed once and shared by every tap, see qadpd.cpp
+	void basis(const double *XI, const double *XQ, int count, double *pI, double *pQ, int stride) const;
+	void eval_basis(const double *pI, const double *pQ, int stride, int count, double *YI, double *YQ) const;
+	void oeval_block(const double *XIp, const double *XQp, const double *XI, const double *XQ,
+		const double *YIp, const double *YQp, int count, bool Yp_FPGA,
+		double *YI, double *YQ, double *UI, double *UQ, double *Err) const;
+	int train_block(const double *XIp, const double *XQp, const double *XI, const double *XQ,
+		const double *YIp, const double *YQp, int count, int Skip, bool Yp_FPGA);
 	void start();
 	void finish();
 	int update_coeff(double range);
 	double uI, uQ, yI, yQ; //19.11.2015
-	double **a, **b;		// The cefficients
-	double **a_, **b_;		// The novel cefficients
+	dense::mat a, b;		// The cefficients, a[i][j] for tap i, power j
+	dense::mat a_, b_;		// The novel cefficients
 private:    
 		// Output evaluation
     void train();		// RLS or gradient descent adaptation
+    void rls_update(const double *phi, double dI, double dQ); // One rank-one RLS step
 
     // Internal variables
     // Delayed yp and postdistorter output.
@@ -74,18 +89,35 @@ private:
 	FILE *fp;			// Log file
 	FILE *fp2;			// Log file
 
-    double *dI_reg, *dQ_reg; // *u_reg, izbaceno 19.11.2015
-    // Delay registers
-    double *uI_reg,*uQ_reg; // novo 19.11.2015
+    // nd delay registers, power of two rings written at dpos
+    dense::vec dI_reg, dQ_reg; // *u_reg, izbaceno 19.11.2015
+    dense::vec uI_reg, uQ_reg; // novo 19.11.2015
+    int dpos, dMask;
     // Predistorter parameters
    
 	
 
-    double **xIe, **xIep;	// Delay register matrices
-    double **xQe, **xQep;
-    // RLS variables used in constructing and solving the equations
-    double **A, *B;
-    int *index;
-    double **Ap, *Bp;
+    // Delay register matrices, power of two rings of rows.
+    // Tap i of the power series is row tap(i), the newest sample is row head.
+    dense::mat xIe, xIep;
+    dense::mat xQe, xQep;
+    int head, tapMask;
+    int tap(int i) const { return (head - i) & tapMask; }
+    void clear_delay_lines();
+    // Normal equations G*w = h, w[i+(n+1)*j] = a[i][j] + j*b[i][j].
+    // G is complex Hermitian, K = (n+1)*(m+1), only its upper triangle is
+    // accumulated. solve() puts the Cholesky factor below the diagonal.
+    dense::mat Gr, Gi; dense::vec hr, hi;
+    // Real form of the equations, built by real_form() for the LU fallback
+    // and the iterative solvers (0-based, K2 = 2*(n+1)*(m+1))
+    dense::mat A; dense::vec B;
+    std::vector<int> index;
+    dense::vec Bp;
+    void real_form();
+    void solve();
+    // RLS variables, inverse of G (upper triangle of Pr + j*Pi) and
+    // coefficient estimate, real parts first like B
+    dense::mat Pr, Pi; dense::vec w;
+    dense::vec phi, Pphi;
 	 // , update;
 };
\ No newline at end of file
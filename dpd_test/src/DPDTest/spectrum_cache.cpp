@@ -0,0 +1,123 @@
+/* --------------------------------------------------------------------------------------------
+FILE:		spectrum_cache.cpp
+DESCRIPTION  Spectra of the xp, yp, x and y signals for the DPD plots
+CONTENT:
+AUTHOR:		Lime Microsystems LTD
+DATE:
+-------------------------------------------------------------------------------------------- */
+#include "spectrum_cache.h"
+
+#include <math.h>
+#include <thread>
+
+static int signal_threads(int threads)
+{
+	if (threads > 0) return threads;
+	threads = (int)std::thread::hardware_concurrency();
+	if (threads < 1) threads = 1;
+	return (threads < spectrum_cache::MAX_SIGNALS) ? threads : spectrum_cache::MAX_SIGNALS;
+}
+
+spectrum_cache::spectrum_cache(int threads)
+	: n(0), plan(0), table(0), pool(signal_threads(threads)), jobIn(0), jobWindowed(0), jobOut(0)
+{
+	job = [this](int k) {
+		const kiss_fft_cpx *in = jobIn[k];
+		kiss_fft_cpx *windowed = jobWindowed[k];
+		if (table) {
+			const float *w = &table->coefs[0];
+			for (int i = 0; i < n; i++) {
+				windowed[i].r = in[i].r * w[i];
+				windowed[i].i = in[i].i * w[i];
+			}
+		}
+		else if (windowed != in) {
+			for (int i = 0; i < n; i++) windowed[i] = in[i];
+		}
+		kiss_fft(plan, windowed, jobOut[k]);
+	};
+}
+
+spectrum_cache::~spectrum_cache()
+{
+	for (std::map<int, kiss_fft_cfg>::iterator it = plans.begin(); it != plans.end(); ++it)
+		kiss_fft_free(it->second);
+}
+
+void spectrum_cache::configure(int size, int window)
+{
+	if (size <= 0) {
+		n = 0;
+		plan = 0;
+		table = 0;
+		return;
+	}
+
+	std::map<int, kiss_fft_cfg>::iterator p = plans.find(size);
+	if (p == plans.end()) p = plans.insert(std::make_pair(size, kiss_fft_alloc(size, 0, 0, 0))).first;
+	n = size;
+	plan = p->second;
+
+	if ((window <= WINDOW_NONE) || (window > WINDOW_HANNING)) {
+		table = 0;
+		return;
+	}
+	std::pair<int, int> key(size, window);
+	std::map<std::pair<int, int>, window_table>::iterator w = windows.find(key);
+	if (w == windows.end()) {
+		w = windows.insert(std::make_pair(key, window_table())).first;
+		make_window(window, size, w->second);
+	}
+	table = &w->second;
+}
+
+const float *spectrum_cache::window() const
+{
+	return table ? &table->coefs[0] : 0;
+}
+
+double spectrum_cache::amplitude_correction() const
+{
+	return table ? table->correction : 1.0;
+}
+
+void spectrum_cache::transform(int count, const kiss_fft_cpx *const *in, kiss_fft_cpx *const *windowed,
+	kiss_fft_cpx *const *out)
+{
+	if ((n <= 0) || (count <= 0)) return;
+	if (count > MAX_SIGNALS) count = MAX_SIGNALS;
+	jobIn = in;
+	jobWindowed = windowed;
+	jobOut = out;
+	pool.run(count, job);
+}
+
+// Coefficients and amplitude correction of the GUI window functions
+void spectrum_cache::make_window(int type, int N, window_table &table)
+{
+	float a0 = 0.35875;
+	float a1 = 0.48829;
+	float a2 = 0.14128;
+	float a3 = 0.01168;
+	float h0 = 0.54;
+	float PI = 3.14159265359;
+	std::vector<float> &w = table.coefs;
+	w.resize(N);
+
+	double sum = 0;
+	for (int i = 0; i < N; ++i) {
+		switch (type) {
+		case WINDOW_BLACKMAN_HARRIS:
+			w[i] = a0 - a1*cos((2 * PI*i) / (N - 1)) + a2*cos((4 * PI*i) / (N - 1)) - a3*cos((6 * PI*i) / (N - 1));
+			break;
+		case WINDOW_HAMMING:
+			w[i] = h0 - (1 - h0)*cos((2 * PI*i) / (N));
+			break;
+		default:	// WINDOW_HANNING
+			w[i] = 0.5 *(1 - cos((2 * PI*i) / (N)));
+			break;
+		}
+		sum += w[i];
+	}
+	table.correction = 1.0 / (sum / N);
+}
@@ -0,0 +1,67 @@
+/* --------------------------------------------------------------------------------------------
+FILE:		spectrum_cache.h
+DESCRIPTION  Spectra of the xp, yp, x and y signals for the DPD plots. FFT plans and window
+		tables are kept between refreshes, keyed by FFT size and window type, so a
+		refresh with unchanged settings allocates nothing. The signals of one
+		refresh are transformed in parallel.
+CONTENT:
+AUTHOR:		Lime Microsystems LTD
+DATE:
+-------------------------------------------------------------------------------------------- */
+#ifndef SPECTRUM_CACHE_H
+#define SPECTRUM_CACHE_H
+
+#include "kiss_fft.h"
+#include "worker_pool.h"
+
+#include <vector>
+#include <map>
+#include <utility>
+#include <functional>
+
+class spectrum_cache {
+public:
+	// Window types, in the order of the window choice in the GUI
+	enum {WINDOW_NONE, WINDOW_BLACKMAN_HARRIS, WINDOW_HAMMING, WINDOW_HANNING};
+	enum {MAX_SIGNALS = 4};
+
+	// threads = 0 uses one thread per signal, at most one per core
+	explicit spectrum_cache(int threads = 0);
+	~spectrum_cache();
+
+	// Selects the FFT size and the window. A plan or table is only built the
+	// first time its size and type are used. Unknown types give no window.
+	void configure(int n, int window);
+	int size() const { return n; }
+	const float *window() const;			// size() coefficients, NULL for none
+	double amplitude_correction() const;	// 1/mean of the window, 1 for none
+
+	// out[k] = FFT of in[k]*window over size() samples, k < count <= MAX_SIGNALS.
+	// in[k]*window is kept in windowed[k], a copy of in[k] without a window.
+	void transform(int count, const kiss_fft_cpx *const *in, kiss_fft_cpx *const *windowed,
+		kiss_fft_cpx *const *out);
+
+private:
+	spectrum_cache(const spectrum_cache &);
+	spectrum_cache &operator=(const spectrum_cache &);
+
+	struct window_table {
+		std::vector<float> coefs;
+		double correction;
+	};
+	static void make_window(int type, int n, window_table &table);
+
+	std::map<int, kiss_fft_cfg> plans;
+	std::map<std::pair<int, int>, window_table> windows;
+	int n;
+	kiss_fft_cfg plan;					// of size n
+	const window_table *table;			// NULL for no window
+
+	worker_pool pool;
+	std::function<void(int)> job;		// built once, transforms signal k
+	const kiss_fft_cpx *const *jobIn;
+	kiss_fft_cpx *const *jobWindowed;
+	kiss_fft_cpx *const *jobOut;
+};
+
+#endif
@@ -0,0 +1,75 @@
+/* --------------------------------------------------------------------------------------------
+FILE:		worker_pool.cpp
+DESCRIPTION  Fixed set of worker threads running indexed jobs for the DPD engine
+CONTENT:
+AUTHOR:		Lime Microsystems LTD
+DATE:
+-------------------------------------------------------------------------------------------- */
+#include "worker_pool.h"
+
+worker_pool::worker_pool(int n) : current(0), next(0), count(0), pending(0), batch(0), quit(false)
+{
+	if (n <= 0) n = (int)std::thread::hardware_concurrency();
+	if (n <= 0) n = 1;
+	// the caller of run() is a worker too
+	for (int i = 0; i < n - 1; i++) threads.push_back(std::thread(&worker_pool::loop, this));
+}
+
+worker_pool::~worker_pool()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		quit = true;
+	}
+	wake.notify_all();
+	for (size_t i = 0; i < threads.size(); i++) threads[i].join();
+}
+
+// Next job index of the current batch, lock held by the caller
+bool worker_pool::take(int &index)
+{
+	if (current == 0 || next >= count) return false;
+	index = next++;
+	return true;
+}
+
+void worker_pool::run(int n, const std::function<void(int)> &job)
+{
+	if (n <= 0) return;
+	std::unique_lock<std::mutex> guard(lock);
+	current = &job;
+	next = 0;
+	count = n;
+	pending = n;
+	batch++;
+	wake.notify_all();
+
+	int index;
+	while (take(index)) {
+		guard.unlock();
+		job(index);
+		guard.lock();
+		pending--;
+	}
+	finished.wait(guard, [this]() { return pending == 0; });
+	current = 0;
+}
+
+void worker_pool::loop()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	unsigned long seen = 0;
+	while (true) {
+		wake.wait(guard, [&]() { return quit || (current != 0 && batch != seen && next < count); });
+		if (quit) return;
+		seen = batch;
+		const std::function<void(int)> *job = current;
+		int index;
+		while (take(index)) {
+			guard.unlock();
+			(*job)(index);
+			guard.lock();
+			if (--pending == 0) finished.notify_all();
+		}
+	}
+}
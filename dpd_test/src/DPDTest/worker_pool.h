@@ -0,0 +1,46 @@
+/* --------------------------------------------------------------------------------------------
+FILE:		worker_pool.h
+DESCRIPTION  Fixed set of worker threads running indexed jobs for the DPD engine
+CONTENT:
+AUTHOR:		Lime Microsystems LTD
+DATE:
+-------------------------------------------------------------------------------------------- */
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+class worker_pool {
+public:
+	// threads = 0 uses one thread per core
+	explicit worker_pool(int threads = 0);
+	~worker_pool();
+
+	// Threads running jobs, the caller of run() included
+	int size() const { return (int)threads.size() + 1; }
+
+	// Calls job(0) .. job(count-1) on the workers and returns when all have
+	// finished. The calling thread takes jobs as well. Not reentrant, one
+	// run() at a time.
+	void run(int count, const std::function<void(int)> &job);
+
+private:
+	worker_pool(const worker_pool &);
+	worker_pool &operator=(const worker_pool &);
+	void loop();
+	bool take(int &index);
+
+	std::vector<std::thread> threads;
+	std::mutex lock;
+	std::condition_variable wake, finished;
+	const std::function<void(int)> *current;
+	int next, count, pending;
+	unsigned long batch;
+	bool quit;
+};
+
+#endif
@@ -0,0 +1,243 @@
+/**
+    @file DPDUtil.cpp
+    @author Lime Microsystems
+    @brief Command line DPD loop: captures, trains and uploads the
+    predistorter coefficients without a display
+*/
+
+#include <ConnectionRegistry.h>
+#include <IConnection.h>
+#include "dpd_engine.h"
+#include "dpd_pipeline.h"
+#include "dpd_board.h"
+#include "coef_upload.h"
+#include "capture_file.h"
+#include "qadpd.h"
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <csignal>
+#include <string>
+#include <chrono>
+#include <thread>
+using namespace lime;
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onSignal(int)
+{
+    stopRequested = 1;
+}
+
+static void printHelp(void)
+{
+    std::cout << "Usage: DPDUtil [options]" << std::endl;
+    std::cout << "  --module=NAME     connection module, e.g. STREAM (first found by default)," << std::endl;
+    std::cout << "                    DPDSim runs against the simulated board and PA" << std::endl;
+    std::cout << "  --serial=SERIAL   board serial number" << std::endl;
+    std::cout << "  --addr=ADDR       board address, simulator settings for DPDSim, e.g. pa=rapp,snr=60" << std::endl;
+    std::cout << "  --n=2             memory depth" << std::endl;
+    std::cout << "  --m=2             nonlinearity order" << std::endl;
+    std::cout << "  --nd=0            error delay" << std::endl;
+    std::cout << "  --lambda=0.998    RLS weighting" << std::endl;
+    std::cout << "  --am=14           signal amplitude bits" << std::endl;
+    std::cout << "  --training=LU     LU, GS, GRAD, RLS or BLOCK" << std::endl;
+    std::cout << "  --update=100      adaptation samples per capture" << std::endl;
+    std::cout << "  --delay-range=3   feedback delay search range" << std::endl;
+    std::cout << "  --frac-delay      align the sub-sample delay too" << std::endl;
+    std::cout << "  --gain=1.0        feedback gain" << std::endl;
+    std::cout << "  --range=16        coefficient range" << std::endl;
+    std::cout << "  --frames=0        stop after this many captures, 0 runs until Ctrl+C" << std::endl;
+    std::cout << "  --no-train        evaluate only, the coefficients are not changed" << std::endl;
+    std::cout << "  --record=FILE     save the raw captures for dpd_replay_bench" << std::endl;
+    std::cout << "  --quiet           print the summary only" << std::endl;
+    std::cout << "  --log             write qadpd_error.log and qadpd_coeff.log, they grow with every frame" << std::endl;
+    std::cout << "Settings that converge on DPDSim, with the defaults above:" << std::endl;
+    std::cout << "  --addr=pa=rapp                 (default PA)" << std::endl;
+    std::cout << "  --addr=pa=mp,rms=0.15          rms=0.25 drives the PA too hard" << std::endl;
+    std::cout << "  --addr=pa=saleh,rms=0.12 --m=1 higher orders run out of range" << std::endl;
+}
+
+//! Value of --name=value, or nullptr if arg is not that option
+static const char *optionValue(const char *arg, const char *name)
+{
+    size_t len = strlen(name);
+    if (strncmp(arg, name, len) != 0 || arg[len] != '=') return nullptr;
+    return arg + len + 1;
+}
+
+static int trainingAlgorithm(const std::string &name)
+{
+    if (name == "LU") return qadpd::LU;
+    if (name == "GS") return qadpd::GS;
+    if (name == "GRAD") return qadpd::GRAD;
+    if (name == "RLS") return qadpd::RLS;
+    if (name == "BLOCK") return qadpd::BLOCK;
+    return -1;
+}
+
+//! Postdistorter error power relative to its output, in dB
+static double errorDb(const dpd_frame &f)
+{
+    double e = 0.0, u = 0.0;
+    for (size_t i = 0; i < f.error.size(); ++i)
+    {
+        e += f.error[i].r*f.error[i].r + f.error[i].i*f.error[i].i;
+        u += f.u[i].r*f.u[i].r + f.u[i].i*f.u[i].i;
+    }
+    if (e <= 0.0 || u <= 0.0) return -INFINITY;
+    return 10.0*log10(e/u);
+}
+
+int main(int argc, char **argv)
+{
+    ConnectionHandle hint;
+    int N = 2, M = 2, ND = 0, AM = 14, training = qadpd::LU;
+    double lambda = 0.998;
+    //with a few adaptation samples the solve is ill-conditioned, the coefficients run out of range
+    dpd_settings settings = {100, 3, false, true, 16.0};
+    double gain = 1.0;
+    bool train = true, quiet = false, log = false;
+    unsigned long frames = 0;
+    std::string record;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char *a = argv[i];
+        const char *v;
+        if (strcmp(a, "--help") == 0 || strcmp(a, "-h") == 0) { printHelp(); return EXIT_SUCCESS; }
+        else if ((v = optionValue(a, "--module")) != nullptr) hint.module = v;
+        else if ((v = optionValue(a, "--serial")) != nullptr) hint.serial = v;
+        else if ((v = optionValue(a, "--addr")) != nullptr) hint.addr = v;
+        else if ((v = optionValue(a, "--n")) != nullptr) N = atoi(v);
+        else if ((v = optionValue(a, "--m")) != nullptr) M = atoi(v);
+        else if ((v = optionValue(a, "--nd")) != nullptr) ND = atoi(v);
+        else if ((v = optionValue(a, "--lambda")) != nullptr) lambda = atof(v);
+        else if ((v = optionValue(a, "--am")) != nullptr) AM = atoi(v);
+        else if ((v = optionValue(a, "--training")) != nullptr) training = trainingAlgorithm(v);
+        else if ((v = optionValue(a, "--update")) != nullptr) settings.update = atoi(v);
+        else if ((v = optionValue(a, "--delay-range")) != nullptr) settings.delayRange = atoi(v);
+        else if ((v = optionValue(a, "--gain")) != nullptr) gain = atof(v);
+        else if ((v = optionValue(a, "--range")) != nullptr) settings.range = atof(v);
+        else if ((v = optionValue(a, "--frames")) != nullptr) frames = strtoul(v, nullptr, 10);
+        else if ((v = optionValue(a, "--record")) != nullptr) record = v;
+        else if (strcmp(a, "--frac-delay") == 0) settings.fracDelay = true;
+        else if (strcmp(a, "--no-train") == 0) train = false;
+        else if (strcmp(a, "--quiet") == 0) quiet = true;
+        else if (strcmp(a, "--log") == 0) log = true;
+        else
+        {
+            std::cerr << "Unknown option " << a << std::endl;
+            printHelp();
+            return EXIT_FAILURE;
+        }
+    }
+    if (training < 0)
+    {
+        std::cerr << "Unknown training algorithm" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (N < 0 || M < 0 || ND < 0 || N >= coef_upload::ROWS || M >= coef_upload::COLS)
+    {
+        std::cerr << "The gateware takes n < " << coef_upload::ROWS << " and m < " << coef_upload::COLS << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    auto handles = ConnectionRegistry::findConnections(hint);
+    if (handles.empty())
+    {
+        std::cerr << "No board found" << std::endl;
+        return EXIT_FAILURE;
+    }
+    auto conn = ConnectionRegistry::makeConnection(handles.front());
+    if (conn == nullptr || !conn->IsOpen())
+    {
+        std::cerr << "Failed to open " << handles.front().serialize() << std::endl;
+        if (conn != nullptr) ConnectionRegistry::freeConnection(conn);
+        return EXIT_FAILURE;
+    }
+    std::cout << "Connected to " << conn->GetHandle().serialize() << std::endl;
+
+    dpd_engine engine(1);
+    engine.set_channels(1, N, M, ND);
+    qadpd *q = engine.channel(0);
+    if (!log)
+    {
+        q->fname.clear();
+        q->fname2.clear();
+    }
+    engine.init(N, M, ND, lambda, 1 << (AM - 1), 0, training);
+
+    capture_file::writer recorder;
+    if (!record.empty() && recorder.open(record.c_str(), dpd_board::CAPTURE_SAMPLES, dpd_board::CAPTURE_BITS) != 0)
+    {
+        std::cerr << "Cannot create " << record << std::endl;
+        ConnectionRegistry::freeConnection(conn);
+        return EXIT_FAILURE;
+    }
+
+    coef_upload::uploader uploader;
+    unsigned long uploadFailures = 0;
+    // runs on the pipeline capture thread, the only user of recorder
+    bool recording = !record.empty();
+    auto capture = [conn, &recorder, recording](std::vector<unsigned char> &buffer)
+    {
+        bool timedOut;
+        int received = dpd_board::capture(conn, dpd_board::CAPTURE_SAMPLES, dpd_board::CAPTURE_BITS, buffer, timedOut);
+        if (recording && received > 0) recorder.append(buffer);
+        return received;
+    };
+    // runs on the pipeline train thread, which owns q
+    auto upload = [conn, q, &uploader, &uploadFailures, &settings]()
+    {
+        coef_upload::table next;
+        coef_upload::quantize(q->a, q->b, q->n, q->m, settings.range, next);
+        if (uploader.upload(conn, next) != 0) ++uploadFailures;
+    };
+
+    dpd_pipeline_config cfg;
+    cfg.samples = dpd_board::CAPTURE_SAMPLES;
+    cfg.captureSamples = dpd_board::CAPTURE_SAMPLES;
+    cfg.bitsInSample = dpd_board::CAPTURE_BITS;
+    cfg.gain = gain;
+    cfg.train = train;
+    cfg.settings = settings;
+    cfg.lag = 0;
+    cfg.fftSize = 0; // no spectra without a display
+    cfg.window = 0;
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    dpd_pipeline pipeline(engine);
+    auto t0 = std::chrono::steady_clock::now();
+    pipeline.start(cfg, capture, upload);
+
+    unsigned long done = 0;
+    while (!stopRequested && (frames == 0 || done < frames))
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        auto f = pipeline.latest();
+        if (!f || f->seq + 1 == done) continue;
+        done = f->seq + 1;
+        if (!quiet)
+            std::cout << "frame " << f->seq << "  lag " << f->lag << "  status " << f->status
+                << "  error " << std::fixed << std::setprecision(2) << errorDb(*f) << " dB" << std::endl;
+    }
+    pipeline.stop();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    std::cout << "Frames: " << done << " in " << std::setprecision(2) << elapsed << " s ("
+        << (elapsed > 0 ? done/elapsed : 0.0) << " frames/s)" << std::endl;
+    std::cout << "Failed captures: " << pipeline.failures() << ", failed uploads: " << uploadFailures << std::endl;
+    auto c = engine.coeffs(0);
+    if (c)
+        std::cout << "Last training: " << c->samples << " samples, align " << std::setprecision(3) << 1e3*c->alignTime
+            << " ms, train " << 1e3*c->trainTime << " ms, update " << 1e3*c->solveTime << " ms" << std::endl;
+    recorder.close();
+
+    ConnectionRegistry::freeConnection(conn);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,335 @@
+/**
+    @file SamplePacking.cpp
+    @author Lime Microsystems
+    @brief Packing of complex16_t samples into PacketLTE payloads and back.
+
+    The 12 bit compressed kernels need SSSE3 byte shuffles, they are compiled
+    with a function target attribute and picked at run time. The 12 in 16
+    kernels only need SSE2, the x86-64 baseline. One and two channel layouts
+    are vectorised, other channel counts use the scalar loops.
+*/
+
+#include "SamplePacking.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define PACKING_SSE2
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TARGET_SSSE3
+#else
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#endif
+#endif
+
+using namespace lime;
+
+typedef void (*UnpackFn)(const uint8_t *, complex16_t * const *, const int, const size_t);
+typedef void (*PackFn)(const complex16_t * const *, uint8_t *, const int, const size_t);
+
+/***********************************************************************
+ * Scalar kernels, also used for the tails of the vector kernels
+ **********************************************************************/
+static void Unpack12BitScalar(const uint8_t *src, complex16_t * const *dst, const int channelsCount, const size_t samplesCount)
+{
+    for (size_t s = 0; s < samplesCount; ++s)
+    {
+        for (int ch = 0; ch < channelsCount; ++ch)
+        {
+            const uint8_t *p = src + 3 * (s*channelsCount + ch);
+            int16_t sample;
+            //I sample
+            sample = (p[1] & 0x0F) << 8;
+            sample |= p[0];
+            sample = sample << 4;
+            sample = sample >> 4;
+            dst[ch][s].i = sample;
+            //Q sample
+            sample = p[2] << 4;
+            sample |= (p[1] >> 4) & 0x0F;
+            sample = sample << 4;
+            sample = sample >> 4;
+            dst[ch][s].q = sample;
+        }
+    }
+}
+
+static void Pack12BitScalar(const complex16_t * const *src, uint8_t *dst, const int channelsCount, const size_t samplesCount)
+{
+    for (size_t s = 0; s < samplesCount; ++s)
+    {
+        for (int ch = 0; ch < channelsCount; ++ch)
+        {
+            uint8_t *p = dst + 3 * (s*channelsCount + ch);
+            p[0] = src[ch][s].i & 0xFF;
+            p[1] = ((src[ch][s].i >> 8) & 0x0F) | ((src[ch][s].q << 4) & 0xF0);
+            p[2] = (src[ch][s].q >> 4) & 0xFF;
+        }
+    }
+}
+
+static void Unpack12In16Scalar(const uint8_t *src, complex16_t * const *dst, const int channelsCount, const size_t samplesCount)
+{
+    for (size_t s = 0; s < samplesCount; ++s)
+    {
+        for (int ch = 0; ch < channelsCount; ++ch)
+        {
+            const uint8_t *p = src + 4 * (s*channelsCount + ch);
+            int16_t sample;
+            sample = ((p[1] & 0x0F) << 8) | p[0];
+            sample = sample << 4;
+            sample = sample >> 4;
+            dst[ch][s].i = sample;
+            sample = ((p[3] & 0x0F) << 8) | p[2];
+            sample = sample << 4;
+            sample = sample >> 4;
+            dst[ch][s].q = sample;
+        }
+    }
+}
+
+static void Pack12In16Scalar(const complex16_t * const *src, uint8_t *dst, const int channelsCount, const size_t samplesCount)
+{
+    for (size_t s = 0; s < samplesCount; ++s)
+    {
+        for (int ch = 0; ch < channelsCount; ++ch)
+        {
+            uint8_t *p = dst + 4 * (s*channelsCount + ch);
+            p[0] = src[ch][s].i & 0xFF;
+            p[1] = ((src[ch][s].i >> 8) & 0x0F) | 0x10;
+            p[2] = src[ch][s].q & 0xFF;
+            p[3] = (src[ch][s].q >> 8) & 0x0F;
+        }
+    }
+}
+
+#ifdef PACKING_SSE2
+/***********************************************************************
+ * Vector kernels, 4 samples per channel per iteration
+ **********************************************************************/
+
+//splits c0s0,c1s0,c0s1,c1s1 | c0s2,c1s2,c0s3,c1s3 into the two channels
+static inline void Deinterleave(__m128i r0, __m128i r1, complex16_t *ch0, complex16_t *ch1)
+{
+    __m128i a = _mm_shuffle_epi32(r0, 0xD8);
+    __m128i b = _mm_shuffle_epi32(r1, 0xD8);
+    _mm_storeu_si128((__m128i *)ch0, _mm_unpacklo_epi64(a, b));
+    _mm_storeu_si128((__m128i *)ch1, _mm_unpackhi_epi64(a, b));
+}
+
+//12 bytes of 4 pairs into 4 complex16_t
+TARGET_SSSE3 static inline __m128i Decode12(const uint8_t *p)
+{
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11);
+    const __m128i lowHalf = _mm_set1_epi32(0x0000FFFF);
+    __m128i x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)p), shuffle);
+    //I = bits 0..11 of its lane, Q = bits 4..15 of its lane
+    __m128i y = _mm_or_si128(_mm_and_si128(_mm_slli_epi16(x, 4), lowHalf), _mm_andnot_si128(lowHalf, x));
+    return _mm_srai_epi16(y, 4);
+}
+
+//4 complex16_t into 12 bytes of 4 pairs
+TARGET_SSSE3 static inline void Encode12(__m128i w, uint8_t *p)
+{
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    __m128i v = _mm_or_si128(_mm_and_si128(w, _mm_set1_epi32(0x00000FFF)),
+                             _mm_and_si128(_mm_srli_epi32(w, 4), _mm_set1_epi32(0x00FFF000)));
+    v = _mm_shuffle_epi8(v, shuffle);
+    _mm_storel_epi64((__m128i *)p, v);
+    int32_t last = _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+    memcpy(p + 8, &last, 4);
+}
+
+TARGET_SSSE3 static void Unpack12BitSSSE3(const uint8_t *src, complex16_t * const *dst, const int channelsCount, const size_t samplesCount)
+{
+    if (channelsCount != 1 && channelsCount != 2)
+        return Unpack12BitScalar(src, dst, channelsCount, samplesCount);
+
+    //each 16 byte load uses 12 bytes, stop before reading past the payload
+    const size_t pairs = samplesCount*channelsCount;
+    size_t s = 0;
+    for (; (s + 4)*channelsCount + 2 <= pairs; s += 4)
+    {
+        const uint8_t *p = src + 3 * s*channelsCount;
+        if (channelsCount == 1)
+            _mm_storeu_si128((__m128i *)(dst[0] + s), Decode12(p));
+        else
+            Deinterleave(Decode12(p), Decode12(p + 12), dst[0] + s, dst[1] + s);
+    }
+    complex16_t *tail[2] = { dst[0] + s, (channelsCount == 2) ? dst[1] + s : nullptr };
+    Unpack12BitScalar(src + 3 * s*channelsCount, tail, channelsCount, samplesCount - s);
+}
+
+TARGET_SSSE3 static void Pack12BitSSSE3(const complex16_t * const *src, uint8_t *dst, const int channelsCount, const size_t samplesCount)
+{
+    if (channelsCount != 1 && channelsCount != 2)
+        return Pack12BitScalar(src, dst, channelsCount, samplesCount);
+
+    size_t s = 0;
+    for (; s + 4 <= samplesCount; s += 4)
+    {
+        uint8_t *p = dst + 3 * s*channelsCount;
+        __m128i c0 = _mm_loadu_si128((const __m128i *)(src[0] + s));
+        if (channelsCount == 1)
+            Encode12(c0, p);
+        else
+        {
+            __m128i c1 = _mm_loadu_si128((const __m128i *)(src[1] + s));
+            Encode12(_mm_unpacklo_epi32(c0, c1), p);
+            Encode12(_mm_unpackhi_epi32(c0, c1), p + 12);
+        }
+    }
+    const complex16_t *tail[2] = { src[0] + s, (channelsCount == 2) ? src[1] + s : nullptr };
+    Pack12BitScalar(tail, dst + 3 * s*channelsCount, channelsCount, samplesCount - s);
+}
+
+static void Unpack12In16SSE2(const uint8_t *src, complex16_t * const *dst, const int channelsCount, const size_t samplesCount)
+{
+    if (channelsCount != 1 && channelsCount != 2)
+        return Unpack12In16Scalar(src, dst, channelsCount, samplesCount);
+
+    size_t s = 0;
+    for (; s + 4 <= samplesCount; s += 4)
+    {
+        const __m128i *p = (const __m128i *)(src + 4 * s*channelsCount);
+        __m128i r0 = _mm_srai_epi16(_mm_slli_epi16(_mm_loadu_si128(p), 4), 4);
+        if (channelsCount == 1)
+            _mm_storeu_si128((__m128i *)(dst[0] + s), r0);
+        else
+        {
+            __m128i r1 = _mm_srai_epi16(_mm_slli_epi16(_mm_loadu_si128(p + 1), 4), 4);
+            Deinterleave(r0, r1, dst[0] + s, dst[1] + s);
+        }
+    }
+    complex16_t *tail[2] = { dst[0] + s, (channelsCount == 2) ? dst[1] + s : nullptr };
+    Unpack12In16Scalar(src + 4 * s*channelsCount, tail, channelsCount, samplesCount - s);
+}
+
+static void Pack12In16SSE2(const complex16_t * const *src, uint8_t *dst, const int channelsCount, const size_t samplesCount)
+{
+    if (channelsCount != 1 && channelsCount != 2)
+        return Pack12In16Scalar(src, dst, channelsCount, samplesCount);
+
+    const __m128i mask = _mm_set1_epi16(0x0FFF);
+    const __m128i flagI = _mm_set1_epi32(0x00001000);
+    size_t s = 0;
+    for (; s + 4 <= samplesCount; s += 4)
+    {
+        __m128i *p = (__m128i *)(dst + 4 * s*channelsCount);
+        __m128i c0 = _mm_loadu_si128((const __m128i *)(src[0] + s));
+        if (channelsCount == 1)
+            _mm_storeu_si128(p, _mm_or_si128(_mm_and_si128(c0, mask), flagI));
+        else
+        {
+            __m128i c1 = _mm_loadu_si128((const __m128i *)(src[1] + s));
+            _mm_storeu_si128(p, _mm_or_si128(_mm_and_si128(_mm_unpacklo_epi32(c0, c1), mask), flagI));
+            _mm_storeu_si128(p + 1, _mm_or_si128(_mm_and_si128(_mm_unpackhi_epi32(c0, c1), mask), flagI));
+        }
+    }
+    const complex16_t *tail[2] = { src[0] + s, (channelsCount == 2) ? src[1] + s : nullptr };
+    Pack12In16Scalar(tail, dst + 4 * s*channelsCount, channelsCount, samplesCount - s);
+}
+
+static bool HasSSSE3(void)
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 9)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("ssse3");
+#endif
+}
+#endif
+
+/***********************************************************************
+ * Dispatch
+ **********************************************************************/
+struct PackingKernels
+{
+    PackingKernels(void)
+    {
+        //every supported set replaces the previous one
+        Select("scalar");
+        Select("SSE2");
+        Select("SSSE3");
+    }
+    bool Select(const char *which)
+    {
+        if (strcmp(which, "scalar") == 0)
+        {
+            unpack12 = Unpack12BitScalar;
+            pack12 = Pack12BitScalar;
+            unpack12in16 = Unpack12In16Scalar;
+            pack12in16 = Pack12In16Scalar;
+            name = "scalar";
+            return true;
+        }
+#ifdef PACKING_SSE2
+        //12 bit compressed has no SSE2 kernels
+        if (strcmp(which, "SSE2") == 0)
+        {
+            unpack12 = Unpack12BitScalar;
+            pack12 = Pack12BitScalar;
+            unpack12in16 = Unpack12In16SSE2;
+            pack12in16 = Pack12In16SSE2;
+            name = "SSE2";
+            return true;
+        }
+        if (strcmp(which, "SSSE3") == 0 && HasSSSE3())
+        {
+            unpack12 = Unpack12BitSSSE3;
+            pack12 = Pack12BitSSSE3;
+            unpack12in16 = Unpack12In16SSE2;
+            pack12in16 = Pack12In16SSE2;
+            name = "SSSE3";
+            return true;
+        }
+#endif
+        return false;
+    }
+    UnpackFn unpack12;
+    PackFn pack12;
+    UnpackFn unpack12in16;
+    PackFn pack12in16;
+    const char *name;
+};
+
+static PackingKernels &Kernels(void)
+{
+    static PackingKernels kernels;
+    return kernels;
+}
+
+const char *lime::SamplePackingImplementation(void)
+{
+    return Kernels().name;
+}
+
+bool lime::SelectSamplePackingImplementation(const char *name)
+{
+    return Kernels().Select(name);
+}
+
+void lime::Unpack12Bit(const uint8_t *src, complex16_t * const *dst, const int channelsCount, const size_t samplesCount)
+{
+    Kernels().unpack12(src, dst, channelsCount, samplesCount);
+}
+
+void lime::Pack12Bit(const complex16_t * const *src, uint8_t *dst, const int channelsCount, const size_t samplesCount)
+{
+    Kernels().pack12(src, dst, channelsCount, samplesCount);
+}
+
+void lime::Unpack12In16(const uint8_t *src, complex16_t * const *dst, const int channelsCount, const size_t samplesCount)
+{
+    Kernels().unpack12in16(src, dst, channelsCount, samplesCount);
+}
+
+void lime::Pack12In16(const complex16_t * const *src, uint8_t *dst, const int channelsCount, const size_t samplesCount)
+{
+    Kernels().pack12in16(src, dst, channelsCount, samplesCount);
+}
@@ -0,0 +1,56 @@
+/**
+    @file SamplePacking.h
+    @author Lime Microsystems
+    @brief Packing of complex16_t samples into PacketLTE payloads and back.
+
+    12 bit compressed: 3 bytes per I/Q pair, I in the low 12 bits.
+    12 in 16: 4 bytes per I/Q pair, each value in a little endian int16.
+    With several channels the pairs of each sample are interleaved,
+    channel 0 first.
+*/
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "dataTypes.h"
+
+namespace lime
+{
+
+/** @brief Name of the kernels selected for this CPU, "SSSE3", "SSE2" or "scalar"
+*/
+const char *SamplePackingImplementation(void);
+
+/** @brief Forces the kernels to use, for tests and benchmarks
+    Must not be called while other threads pack or unpack samples.
+    @param name "SSSE3", "SSE2" (12 bit compressed stays scalar) or "scalar"
+    @return false if this build or CPU does not have them, the selection is unchanged then
+*/
+bool SelectSamplePackingImplementation(const char *name);
+
+/** @brief Decodes 12 bit compressed samples and splits them by channel
+    @param src packet payload
+    @param dst destination array for each channel
+    @param channelsCount number of interleaved channels
+    @param samplesCount number of samples per channel to decode
+*/
+void Unpack12Bit(const uint8_t *src, complex16_t * const *dst, const int channelsCount, const size_t samplesCount);
+
+/** @brief Encodes samples of each channel into 12 bit compressed payload
+    @param src source array for each channel
+    @param dst packet payload, 3*channelsCount*samplesCount bytes
+    @param channelsCount number of channels to interleave
+    @param samplesCount number of samples per channel to encode
+*/
+void Pack12Bit(const complex16_t * const *src, uint8_t *dst, const int channelsCount, const size_t samplesCount);
+
+/** @brief Decodes 12 in 16 bit samples and splits them by channel
+*/
+void Unpack12In16(const uint8_t *src, complex16_t * const *dst, const int channelsCount, const size_t samplesCount);
+
+/** @brief Encodes samples into 12 in 16 bit payload, bit 12 of every I value
+    is set as the transmitter expects
+*/
+void Pack12In16(const complex16_t * const *src, uint8_t *dst, const int channelsCount, const size_t samplesCount);
+
+}
@@ -5,6 +5,7 @@
 #include <iostream>
 #include <ciso646>
 #include "fifo.h"
+#include "SamplePacking.h"
 
 #include "kiss_fft.h"
 
@@ -102,7 +103,6 @@ void StreamerLTE::ReceivePackets(const StreamerLTE_ThreadData &args)
     int bi = 0;
     unsigned long totalBytesReceived = 0; //for data rate calculation
     int m_bufferFailures = 0;
-    int16_t sample;
 
     uint32_t samplesReceived = 0;
 
@@ -212,27 +212,10 @@ void StreamerLTE::ReceivePackets(const StreamerLTE_ThreadData &args)
                     }
                 }
 
-                for (uint16_t b = 0; b < numPktBytes; b += stepSize)
-                {
-                    for (int ch = 0; ch < channelsCount; ++ch)
-                    {
-                        //I sample
-                        sample = (pktStart[b + 1 + 3 * ch] & 0x0F) << 8;
-                        sample |= (pktStart[b + 3 * ch] & 0xFF);
-                        sample = sample << 4;
-                        sample = sample >> 4;
-                        tempPacket.samples[ch][samplesCollected].i = sample;
-
-                        //Q sample
-                        sample = pktStart[b + 2 + 3 * ch] << 4;
-                        sample |= (pktStart[b + 1 + 3 * ch] >> 4) & 0x0F;
-                        sample = sample << 4;
-                        sample = sample >> 4;
-                        tempPacket.samples[ch][samplesCollected].q = sample;
-                    }
-                    ++samplesCollected;
-                    ++samplesReceived;
-                }
+                const uint32_t numSamples = numPktBytes/stepSize;
+                Unpack12Bit(pktStart, tempPacket.samples, channelsCount, numSamples);
+                samplesCollected += numSamples;
+                samplesReceived += numSamples;
                 tempPacket.last = samplesCollected;
 
                 uint32_t samplesPushed = rxFIFO->push_samples((const complex16_t**)tempPacket.samples, samplesCollected, channelsCount, tempPacket.timestamp, 10, statusFlags);
@@ -336,7 +319,6 @@ void StreamerLTE::ReceivePacketsUncompressed(const StreamerLTE_ThreadData &args)
     int bi = 0;
     unsigned long totalBytesReceived = 0; //for data rate calculation
     int m_bufferFailures = 0;
-    int16_t sample;
 
     uint32_t samplesReceived = 0;
 
@@ -361,27 +343,10 @@ void StreamerLTE::ReceivePacketsUncompressed(const StreamerLTE_ThreadData &args)
 
                 uint8_t* pktStart = (uint8_t*)pkt[pktIndex].data;
                 const int stepSize = channelsCount * 4;
-                for (uint16_t b = 0; b < sizeof(pkt->data); b += stepSize)
-                {
-                    for (int ch = 0; ch < channelsCount; ++ch)
-                    {
-                        //I sample
-                        sample = (pktStart[b + 1 + 4 * ch] & 0x0F) << 8;
-                        sample |= (pktStart[b + 4 * ch] & 0xFF);
-                        sample = sample << 4;
-                        sample = sample >> 4;
-                        tempPacket.samples[ch][samplesCollected].i = sample;
-
-                        //Q sample
-                        sample = (pktStart[b + 3 + 4 * ch] & 0x0F) << 8;
-                        sample |= pktStart[b + 2 + 4 * ch] & 0xFF;
-                        sample = sample << 4;
-                        sample = sample >> 4;
-                        tempPacket.samples[ch][samplesCollected].q = sample;
-                    }
-                    ++samplesCollected;
-                    ++samplesReceived;
-                }
+                const uint32_t numSamples = sizeof(pkt->data)/stepSize;
+                Unpack12In16(pktStart, tempPacket.samples, channelsCount, numSamples);
+                samplesCollected += numSamples;
+                samplesReceived += numSamples;
                 tempPacket.last = samplesCollected;
 
                 uint32_t samplesPushed = rxFIFO->push_samples((const complex16_t**)tempPacket.samples, samplesCollected, channelsCount, tempPacket.timestamp, 10);
@@ -689,22 +654,9 @@ void StreamerLTE::TransmitPackets(const StreamerLTE_ThreadData &args)
                 pkt[i].reserved[0] |= (1 << 4); //ignore timestamp
             uint8_t* dataStart = (uint8_t*)pkt[i].data;
             const int stepSize = channelsCount * 3;
-            int samplesCollected = 0;
-            for (uint16_t b = 0; b < sizeof(pkt->data); b += stepSize)
-            {
-                for (int ch = 0; ch < channelsCount; ++ch)
-                {
-                    //I sample
-                    dataStart[b + 3 * ch] = outSamples[ch][samplesCollected].i & 0xFF;
-                    dataStart[b + 1 + 3 * ch] = (outSamples[ch][samplesCollected].i >> 8) & 0x0F;
-
-                    //Q sample
-                    dataStart[b + 1 + 3 * ch] |= (outSamples[ch][samplesCollected].q << 4) & 0xF0;
-                    dataStart[b + 2 + 3 * ch] = (outSamples[ch][samplesCollected].q >> 4) & 0xFF;
-                }
-                ++samplesCollected;
-                ++samplesSent;
-            }
+            const uint32_t numSamples = sizeof(pkt->data)/stepSize;
+            Pack12Bit(outSamples, dataStart, channelsCount, numSamples);
+            samplesSent += numSamples;
             ++i;
             if ((statusFlags & STATUS_FLAG_TX_END) != 0) break;
         }
@@ -839,22 +791,9 @@ void StreamerLTE::TransmitPacketsUncompressed(const StreamerLTE_ThreadData &args
             pkt[i].counter = timestamp;
             uint8_t* dataStart = (uint8_t*)pkt[i].data;
             const int stepSize = channelsCount * 4;
-            int samplesCollected = 0;
-            for (uint16_t b = 0; b < sizeof(pkt->data); b += stepSize)
-            {
-                for (int ch = 0; ch < channelsCount; ++ch)
-                {
-                    //I sample
-                    dataStart[b + 4 * ch] = outSamples[ch][samplesCollected].i & 0xFF;
-                    dataStart[b + 1 + 4 * ch] = (outSamples[ch][samplesCollected].i >> 8) & 0x0F | 0x10;
-
-                    //Q sample
-                    dataStart[b + 2 + 4 * ch] |= (outSamples[ch][samplesCollected].q ) & 0xFF;
-                    dataStart[b + 3 + 4 * ch] = (outSamples[ch][samplesCollected].q >> 8) & 0x0F;
-                }
-                ++samplesCollected;
-                ++samplesSent;
-            }
+            const uint32_t numSamples = sizeof(pkt->data)/stepSize;
+            Pack12In16(outSamples, dataStart, channelsCount, numSamples);
+            samplesSent += numSamples;
             ++i;
         }
 
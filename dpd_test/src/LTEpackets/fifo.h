@@ -7,13 +7,22 @@
 #include <vector>
 #include <thread>
 #include <queue>
-#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <string.h>
 #include "dataTypes.h"
 #include <assert.h>
 
 namespace lime{
 
 /*  @brief Single producer, single consumer FIFO
+
+    Lock-free ring of packet frames. Only the producer advances mTail and only
+    the consumer advances mHead, a frame between them belongs to the consumer
+    and every other frame to the producer. push_samples() must be called from
+    one thread and pop_samples() from one (other) thread. A side that has to
+    wait spins (optional) and then parks on a condition variable; the other
+    side only takes the mutex to wake it when it is actually parked.
 */
 class LMS_SamplesFIFO
 {
@@ -24,16 +33,19 @@ public:
         uint32_t itemsFilled;
     };
 
+    enum WaitPolicy
+    {
+        WAIT_PARK,          //!< park on the condition variable at once
+        WAIT_SPIN_THEN_PARK //!< yield spinCount times before parking
+    };
+
     /*  @brief Returns information about FIFO size and fullness
     */
     BufferInfo GetInfo()
     {
-        //lock both reading and writing until information is collected
-        std::unique_lock<std::mutex> lck2(readLock);
-        std::unique_lock<std::mutex> lck(writeLock);
         BufferInfo stats;
         stats.size = mBufferSize;
-        stats.itemsFilled = mElementsFilled.load();
+        stats.itemsFilled = mTail.load() - mHead.load();
         return stats;
     }
 
@@ -44,6 +56,9 @@ public:
 	{   
         mBuffer = nullptr;
         mBufferSize = 0;
+        mSpinCount = 0;
+        mReaderParked.store(false);
+        mWriterParked.store(false);
         Reset(bufLength, channelsCount);
 	}
 	
@@ -51,8 +66,17 @@ public:
     {   
         delete []mBuffer;
     };
+
+    /** @brief Selects how push_samples/pop_samples wait for the other side
+        @param policy WAIT_PARK or WAIT_SPIN_THEN_PARK
+        @param spinCount number of yields before parking with WAIT_SPIN_THEN_PARK
+    */
+    void SetWaitPolicy(WaitPolicy policy, uint32_t spinCount = 1000)
+    {
+        mSpinCount = (policy == WAIT_SPIN_THEN_PARK) ? spinCount : 0;
+    }
 	
-    /** @brief inserts samples to FIFO, operation is thread-safe
+    /** @brief inserts samples to FIFO, must be called from the producer thread only
     @param buffer pointers to arrays containing samples data of each channel
     @param samplesCount number of samples to insert from each buffer channel
     @param channelsCount number of channels to insert
@@ -64,42 +88,42 @@ public:
     {
         assert(buffer != nullptr);
         uint32_t samplesTaken = 0;
-        std::unique_lock<std::mutex> lck(writeLock);
+        uint32_t tail = mTail.load(std::memory_order_relaxed);
         while (samplesTaken < samplesCount)
         {   
-            while (mElementsFilled.load() >= mBufferSize) //buffer might be full, wait for free slots
+            if (tail - mHead.load(std::memory_order_acquire) >= mBufferSize) //buffer might be full, wait for free slots
             {
-                if (canWrite.wait_for(lck, std::chrono::milliseconds(timeout_ms)) == std::cv_status::timeout)
+                if (!WaitFor(mWriterParked, writeLock, canWrite, timeout_ms, [this, tail]() { return tail - mHead.load() < mBufferSize; }))
                     return samplesTaken;
             }
 
-            int tailIndex = mTail.load(); //which element to fill
-            while (mElementsFilled.load() < mBufferSize && samplesTaken < samplesCount) // not to release lock too often
+            //fill all free frames before publishing them one by one
+            uint32_t head = mHead.load(std::memory_order_acquire);
+            while (tail - head < mBufferSize && samplesTaken < samplesCount)
             {
-                mBuffer[tailIndex].timestamp = timestamp + samplesTaken;
-                mBuffer[tailIndex].first = 0;
-                mBuffer[tailIndex].last = 0;
-                mBuffer[tailIndex].flags = flags;
-                while (mBuffer[tailIndex].last < mBuffer[tailIndex].samplesCount && samplesTaken < samplesCount)
+                PacketFrame &frame = mBuffer[tail & (mBufferSize - 1)];
+                frame.timestamp = timestamp + samplesTaken;
+                frame.first = 0;
+                frame.flags = flags;
+                const uint32_t toCopy = std::min<uint32_t>(frame.samplesCount, samplesCount - samplesTaken);
+                for (int ch = 0; ch < channelsCount; ++ch)
+                    memcpy(frame.samples[ch], &buffer[ch][samplesTaken], toCopy*sizeof(complex16_t));
+                frame.last = toCopy;
+                samplesTaken += toCopy;
+
+                ++tail;
+                mTail.store(tail); //advance to next one, full fence pairs with mReaderParked
+                if (mReaderParked.load())
                 {
-                    const int sampleIndex = mBuffer[tailIndex].last;
-                    for (int ch = 0; ch < channelsCount; ++ch)
-                    { 
-                        mBuffer[tailIndex].samples[ch][sampleIndex] = buffer[ch][samplesTaken];
-                    }
-                    ++samplesTaken;
-                    ++mBuffer[tailIndex].last;
+                    std::lock_guard<std::mutex> lck(readLock);
+                    canRead.notify_one();
                 }
-                mTail.store((tailIndex + 1) & (mBufferSize - 1));//advance to next one
-                tailIndex = mTail.load();
-                mElementsFilled.fetch_add(1);
-                canRead.notify_one();
             }
         }
         return samplesTaken;
     }
 	
-    /** @brief Takes samples out of FIFO, operation is thread-safe
+    /** @brief Takes samples out of FIFO, must be called from the consumer thread only
         @param buffer pointers to destination arrays for each channel's samples data, each array must be big enough to contain \samplesCount number of samples.
         @param samplesCount number of samples to pop
         @param channelsCount number of channels to pop
@@ -114,48 +138,126 @@ public:
         uint32_t samplesFilled = 0;		
 		*timestamp = 0;
         if (flags != nullptr) *flags = 0;
-        std::unique_lock<std::mutex> lck(readLock);
+        uint32_t head = mHead.load(std::memory_order_relaxed);
         while (samplesFilled < samplesCount)
         {   
-            while (mElementsFilled.load() == 0) //buffer might be empty, wait for packets
+            if (mTail.load(std::memory_order_acquire) == head) //buffer might be empty, wait for packets
             {
                 if (timeout_ms == 0) return samplesFilled;
-                if (canRead.wait_for(lck, std::chrono::milliseconds(timeout_ms)) == std::cv_status::timeout)
+                if (!WaitFor(mReaderParked, readLock, canRead, timeout_ms, [this, head]() { return mTail.load() != head; }))
                     return samplesFilled;
             }
 			if(samplesFilled == 0)
-                *timestamp = mBuffer[mHead.load()].timestamp + mBuffer[mHead.load()].first;
+                *timestamp = mBuffer[head & (mBufferSize - 1)].timestamp + mBuffer[head & (mBufferSize - 1)].first;
 			
-			while(mElementsFilled.load() > 0 && samplesFilled < samplesCount)
+            uint32_t tail = mTail.load(std::memory_order_acquire);
+			while(head != tail && samplesFilled < samplesCount)
 			{	
-				int headIndex = mHead.load();
-                if (flags != nullptr) *flags |= mBuffer[headIndex].flags;
-                while (mBuffer[headIndex].first < mBuffer[headIndex].last && samplesFilled < samplesCount)
+                PacketFrame &frame = mBuffer[head & (mBufferSize - 1)];
+                if (flags != nullptr) *flags |= frame.flags;
+                const uint32_t toCopy = std::min<uint32_t>(frame.last - frame.first, samplesCount - samplesFilled);
+                for (int ch = 0; ch < channelsCount; ++ch)
+                    memcpy(&buffer[ch][samplesFilled], &frame.samples[ch][frame.first], toCopy*sizeof(complex16_t));
+                frame.first += toCopy;
+                samplesFilled += toCopy;
+                if (frame.first == frame.last) //packet depleated
 				{
-                    for (int ch = 0; ch < channelsCount; ++ch)
-                    {   
-                        buffer[ch][samplesFilled] = mBuffer[headIndex].samples[ch][mBuffer[headIndex].first];                        
+                    frame.first = 0;
+                    frame.last = 0;
+                    frame.timestamp = 0;
+                    ++head;
+					mHead.store(head); //advance to next one, full fence pairs with mWriterParked
+                    if (mWriterParked.load())
+                    {
+                        std::lock_guard<std::mutex> lck(writeLock);
+                        canWrite.notify_one();
                     }
-                    ++mBuffer[headIndex].first;
-                    ++samplesFilled;
-				}
-                if (mBuffer[headIndex].first == mBuffer[headIndex].last) //packet depleated
-				{
-                    mBuffer[headIndex].first = 0;
-                    mBuffer[headIndex].last = 0;
-                    mBuffer[headIndex].timestamp = 0;
-					mHead.store( (headIndex + 1) & (mBufferSize - 1) );//advance to next one
-                    headIndex = mHead.load();
-					mElementsFilled.fetch_sub(1);
-                    canWrite.notify_one();
 				}
 			}
         }
         return samplesFilled;
 	}
 	
+    /** @brief Gives the consumer the oldest filled frame in place, must be
+        followed by release_read() before the next pop or acquire
+        @param timeout_ms timeout duration for operation
+        @param [out] handle frame handle to pass to release_read()
+        @return the frame, its unread samples are [first, last), or nullptr on timeout
+    */
+    PacketFrame* acquire_read(const uint32_t timeout_ms, uint32_t *handle)
+    {
+        uint32_t head = mHead.load(std::memory_order_relaxed);
+        if (mTail.load(std::memory_order_acquire) == head)
+        {
+            if (timeout_ms == 0) return nullptr;
+            if (!WaitFor(mReaderParked, readLock, canRead, timeout_ms, [this, head]() { return mTail.load() != head; }))
+                return nullptr;
+        }
+        *handle = head;
+        return &mBuffer[head & (mBufferSize - 1)];
+    }
+
+    /** @brief Returns the frame obtained with acquire_read() to the producer
+        @param handle value returned by acquire_read()
+    */
+    void release_read(const uint32_t handle)
+    {
+        assert(handle == mHead.load(std::memory_order_relaxed));
+        PacketFrame &frame = mBuffer[handle & (mBufferSize - 1)];
+        frame.first = 0;
+        frame.last = 0;
+        frame.timestamp = 0;
+        mHead.store(handle + 1);
+        if (mWriterParked.load())
+        {
+            std::lock_guard<std::mutex> lck(writeLock);
+            canWrite.notify_one();
+        }
+    }
+
+    /** @brief Gives the producer the next free frame in place, must be
+        followed by release_write() before the next push or acquire
+        @param timeout_ms timeout duration for operation
+        @param [out] handle frame handle to pass to release_write()
+        @return the frame, up to samplesCount samples per channel, or nullptr on timeout
+    */
+    PacketFrame* acquire_write(const uint32_t timeout_ms, uint32_t *handle)
+    {
+        uint32_t tail = mTail.load(std::memory_order_relaxed);
+        if (tail - mHead.load(std::memory_order_acquire) >= mBufferSize)
+        {
+            if (!WaitFor(mWriterParked, writeLock, canWrite, timeout_ms, [this, tail]() { return tail - mHead.load() < mBufferSize; }))
+                return nullptr;
+        }
+        *handle = tail;
+        return &mBuffer[tail & (mBufferSize - 1)];
+    }
+
+    /** @brief Publishes the frame obtained with acquire_write() to the consumer
+        @param handle value returned by acquire_write()
+        @param samplesCount number of samples written to each channel
+        @param timestamp timestamp of the first sample
+        @param flags optional flags associated with the samples
+    */
+    void release_write(const uint32_t handle, const uint32_t samplesCount, const uint64_t timestamp, const uint32_t flags = 0)
+    {
+        assert(handle == mTail.load(std::memory_order_relaxed));
+        PacketFrame &frame = mBuffer[handle & (mBufferSize - 1)];
+        frame.timestamp = timestamp;
+        frame.first = 0;
+        frame.last = samplesCount;
+        frame.flags = flags;
+        mTail.store(handle + 1);
+        if (mReaderParked.load())
+        {
+            std::lock_guard<std::mutex> lck(readLock);
+            canRead.notify_one();
+        }
+    }
+
     /** @brief Changes FIFO length and resets internal counter
 		@param bufLength FIFO length, must be power of 2
+        Must not be called while samples are being pushed or popped
     */
 	void Reset(uint32_t bufLength, uint8_t channelsCount)
 	{
@@ -173,7 +275,6 @@ public:
         
 		mHead.store(0);
 		mTail.store(0);
-        mElementsFilled.store(0);
 	}
 
     uint8_t GetChannelsCount()
@@ -182,14 +283,49 @@ public:
     }
 	
 protected:
+    /** @brief Spins and then parks until ready() or timeout
+        @return false on timeout
+    */
+    template <typename Predicate>
+    bool WaitFor(std::atomic<bool> &parked, std::mutex &lock, std::condition_variable &cond, const uint32_t timeout_ms, Predicate ready)
+    {
+        for (uint32_t i = 0; i < mSpinCount; ++i)
+        {
+            if (ready()) return true;
+            std::this_thread::yield();
+        }
+        std::unique_lock<std::mutex> lck(lock);
+        parked.store(true);
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        bool ok = true;
+        while (!ready())
+        {
+            if (cond.wait_until(lck, deadline) == std::cv_status::timeout)
+            {
+                ok = ready();
+                break;
+            }
+        }
+        parked.store(false);
+        return ok;
+    }
+
     int8_t mChannelsCount;
     uint32_t mBufferSize;
 	PacketFrame* mBuffer;
-    std::atomic<uint32_t> mHead;
-    std::atomic<uint32_t> mTail;
+    uint32_t mSpinCount;
+
+    //head and tail on separate cache lines, written by different threads
+    char mPad0[64];
+    std::atomic<uint32_t> mHead; //!< frames popped, consumer only
+    char mPad1[64 - sizeof(std::atomic<uint32_t>)];
+    std::atomic<uint32_t> mTail; //!< frames pushed, producer only
+    char mPad2[64 - sizeof(std::atomic<uint32_t>)];
+
+    std::atomic<bool> mReaderParked;
+    std::atomic<bool> mWriterParked;
     std::mutex writeLock;
     std::mutex readLock;
-	std::atomic<uint32_t> mElementsFilled;
     std::condition_variable canWrite;
     std::condition_variable canRead;
 };
@@ -238,3 +238,69 @@ int SoapyLMS7::readStreamStatus(
     if (metadata.packetDropped) return SOAPY_SDR_OVERFLOW;
     return 0;
 }
+
+/*******************************************************************
+ * Direct buffer access API
+ ******************************************************************/
+int SoapyLMS7::acquireReadBuffer(
+    SoapySDR::Stream *stream,
+    size_t &handle,
+    const void **buffs,
+    int &flags,
+    long long &timeNs,
+    const long timeoutUs)
+{
+    auto icstream = (IConnectionStream *)stream;
+    auto streamID = icstream->streamID;
+
+    StreamMetadata metadata;
+    int ret = _conn->AcquireReadBuffer(streamID, handle, buffs, timeoutUs/1000, metadata);
+
+    //output metadata
+    flags = 0;
+    if (metadata.endOfBurst) flags |= SOAPY_SDR_END_BURST;
+    if (metadata.hasTimestamp) flags |= SOAPY_SDR_HAS_TIME;
+    timeNs = SoapySDR::ticksToTimeNs(metadata.timestamp, _conn->GetHardwareTimestampRate());
+
+    if (ret == 0) return SOAPY_SDR_TIMEOUT;
+    return (ret > 0)? ret : SOAPY_SDR_NOT_SUPPORTED;
+}
+
+void SoapyLMS7::releaseReadBuffer(
+    SoapySDR::Stream *stream,
+    const size_t handle)
+{
+    auto icstream = (IConnectionStream *)stream;
+    _conn->ReleaseReadBuffer(icstream->streamID, handle);
+}
+
+int SoapyLMS7::acquireWriteBuffer(
+    SoapySDR::Stream *stream,
+    size_t &handle,
+    void **buffs,
+    const long timeoutUs)
+{
+    auto icstream = (IConnectionStream *)stream;
+    int ret = _conn->AcquireWriteBuffer(icstream->streamID, handle, buffs, timeoutUs/1000);
+
+    if (ret == 0) return SOAPY_SDR_TIMEOUT;
+    return (ret > 0)? ret : SOAPY_SDR_NOT_SUPPORTED;
+}
+
+void SoapyLMS7::releaseWriteBuffer(
+    SoapySDR::Stream *stream,
+    const size_t handle,
+    const size_t numElems,
+    int &flags,
+    const long long timeNs)
+{
+    auto icstream = (IConnectionStream *)stream;
+
+    //input metadata
+    StreamMetadata metadata;
+    metadata.timestamp = SoapySDR::timeNsToTicks(timeNs, _conn->GetHardwareTimestampRate());
+    metadata.hasTimestamp = (flags & SOAPY_SDR_HAS_TIME) != 0;
+    metadata.endOfBurst = (flags & SOAPY_SDR_END_BURST) != 0;
+
+    _conn->ReleaseWriteBuffer(icstream->streamID, handle, numElems, metadata);
+}
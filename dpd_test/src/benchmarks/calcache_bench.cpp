@@ -0,0 +1,266 @@
+/* --------------------------------------------------------------------------------------------
+FILE:		calcache_bench.cpp
+DESCRIPTION  CalibrationCache inserts and lookups against the previous front-end, which built
+		SQL strings and ran sqlite3_exec for every call, on a database in a temporary
+		HOME. Lookup results of both are compared, then the cache is reopened to check
+		that the batched inserts reached the database.
+		Usage: calcache_bench [lookups, 20000]
+CONTENT:
+AUTHOR:		Lime Microsystems LTD
+DATE:
+-------------------------------------------------------------------------------------------- */
+#include "CalibrationCache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <chrono>
+
+using namespace std;
+using namespace lime;
+
+static double interp(double x, double x0, double y0, double x1, double y1)
+{
+	return y0 + (y1 - y0) * (x - x0) / (x1 - x0);
+}
+
+// Previous front-end: a query string and sqlite3_exec per call
+class reference_cache
+{
+public:
+	reference_cache(const string &path) : db(0)
+	{
+		sqlite3_open(path.c_str(), &db);
+		exec("CREATE TABLE LMS7002M_VCO(boardID INTEGER, frequency INTEGER, channel INTEGER, transmitter BOOLEAN,"
+			" VCO INTEGER, CSW INTEGER, PRIMARY KEY (boardID, frequency, channel, transmitter));", 0, 0);
+		exec("CREATE TABLE LMS7002M_DC_IQ(boardID INTEGER, frequency INTEGER, channel INTEGER, transmitter BOOLEAN,"
+			" band_lna INTEGER, dcI INTEGER, dcQ INTEGER, gainI INTEGER, gainQ INTEGER, phaseOffset INTEGER,"
+			" PRIMARY KEY (boardID, frequency, channel, transmitter, band_lna));", 0, 0);
+	}
+	~reference_cache() { sqlite3_close(db); }
+
+	int InsertVCO_CSW(uint32_t boardId, double frequency, uint8_t channel, bool transmitter, int vco, int csw)
+	{
+		stringstream q;
+		q << "INSERT OR REPLACE INTO LMS7002M_VCO (boardID, frequency, channel, transmitter, vco, csw) VALUES ( "
+			<< boardId << "," << llrint(frequency) << "," << (int)channel << "," << (transmitter ? 1 : 0) << ","
+			<< vco << "," << csw << ");";
+		return exec(q.str(), 0, 0);
+	}
+
+	int GetVCO_CSW(uint32_t boardId, double frequency, uint8_t channel, bool transmitter, int *vco, int *csw)
+	{
+		vector<long long> row;
+		stringstream q;
+		q << "SELECT vco, csw FROM LMS7002M_VCO where boardID=" << boardId << " AND frequency=" << llrint(frequency)
+			<< " AND channel=" << (int)channel << " AND transmitter=" << (transmitter ? 1 : 0) << ";";
+		if (exec(q.str(), row_callback, &row) != 0 || row.empty()) return -1;
+		*vco = (int)row[0];
+		*csw = (int)row[1];
+		return 0;
+	}
+
+	int InsertDC_IQ(uint32_t boardId, double frequency, uint8_t channel, bool transmitter, int band_lna, const int *v)
+	{
+		stringstream q;
+		q << "INSERT OR REPLACE INTO LMS7002M_DC_IQ (boardID, frequency, channel, transmitter, band_lna, dcI, dcQ,"
+			" gainI, gainQ, phaseOffset) VALUES ( " << boardId << "," << llrint(frequency) << "," << (int)channel << ","
+			<< (transmitter ? 1 : 0) << "," << band_lna << ", " << v[0] << "," << v[1] << "," << v[2] << "," << v[3]
+			<< "," << v[4] << ");";
+		return exec(q.str(), 0, 0);
+	}
+
+	int GetDC_IQ(uint32_t boardId, double frequency, uint8_t channel, bool transmitter, int band_lna, int *v)
+	{
+		vector<long long> row;
+		stringstream q;
+		q << "SELECT dcI, dcQ, gainI, gainQ, phaseOffset FROM LMS7002M_DC_IQ where boardID=" << boardId
+			<< " AND frequency=" << llrint(frequency) << " AND channel=" << (int)channel << " AND transmitter="
+			<< (transmitter ? 1 : 0) << " AND band_lna=" << band_lna << ";";
+		if (exec(q.str(), row_callback, &row) != 0 || row.size() != 5) return -1;
+		for (int i = 0; i < 5; i++) v[i] = (int)row[i];
+		return 0;
+	}
+
+	int GetDC_IQ_Interp(uint32_t boardId, double frequency, uint8_t channel, bool transmitter, int band_lna, int *v)
+	{
+		vector<long long> freqs;
+		stringstream where;
+		where << " AND channel=" << (int)channel << " AND transmitter=" << (transmitter ? 1 : 0) << " AND band_lna="
+			<< band_lna;
+		stringstream q;
+		q << "SELECT min(frequency) as freq FROM LMS7002M_DC_IQ where boardID=" << boardId << " AND frequency >= "
+			<< llrint(frequency) << " AND frequency < " << llrint(frequency + 1e6) << where.str()
+			<< " UNION SELECT max(frequency) as freq FROM LMS7002M_DC_IQ where boardID=" << boardId
+			<< " AND frequency <= " << llrint(frequency) << " AND frequency > " << llrint(frequency - 1e6)
+			<< where.str() << ";";
+		if (exec(q.str(), row_callback, &freqs) != 0) return -1;
+		if (freqs.size() == 1 && fabs(double(freqs[0]) - frequency) <= 100)
+			return GetDC_IQ(boardId, freqs[0], channel, transmitter, band_lna, v);
+		if (freqs.size() != 2) return -1;
+		int v0[5], v1[5];
+		if (GetDC_IQ(boardId, freqs[0], channel, transmitter, band_lna, v0) != 0) return -1;
+		if (GetDC_IQ(boardId, freqs[1], channel, transmitter, band_lna, v1) != 0) return -1;
+		for (int i = 0; i < 5; i++) v[i] = (int)rint(interp(frequency, freqs[0], v0[i], freqs[1], v1[i]));
+		return 0;
+	}
+
+private:
+	static int row_callback(void *data, int argc, char **argv, char **)
+	{
+		vector<long long> *row = (vector<long long>*)data;
+		for (int i = 0; i < argc; i++)
+			if (argv[i]) row->push_back(stoll(argv[i]));
+		return 0;
+	}
+
+	int exec(const string &query, int (*callback)(void*, int, char**, char**), void *data)
+	{
+		return sqlite3_exec(db, query.c_str(), callback, data, 0) == SQLITE_OK ? 0 : -1;
+	}
+
+	sqlite3 *db;
+};
+
+struct Timer
+{
+	chrono::steady_clock::time_point t0;
+	void start() { t0 = chrono::steady_clock::now(); }
+	double stop() { return chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count(); }
+};
+
+static const uint32_t board = 0x1234;
+static const int bands = 2;
+static const int points = 200;
+
+// Calibration frequency grid, 0.6 MHz apart with some jitter so lookups interpolate
+static double grid(int i)
+{
+	return 2400e6 + i * 0.6e6 + (i % 3) * 1000;
+}
+
+static void values(int ch, int tx, int band, int i, int *v)
+{
+	for (int k = 0; k < 5; k++) v[k] = ((ch * 7 + tx * 5 + band * 3 + i * 11 + k * 13) % 200) - 100;
+}
+
+struct query
+{
+	double frequency;
+	uint8_t channel;
+	bool tx;
+	int band;
+};
+
+// Lookups through both front-ends, returns the number of differing results
+static int compare(CalibrationCache &cache, reference_cache &ref, const vector<query> &queries, double &tCache,
+	double &tRef)
+{
+	vector<int> a(queries.size() * 7), b(queries.size() * 7);
+	Timer t;
+	t.start();
+	for (size_t n = 0; n < queries.size(); n++) {
+		const query &q = queries[n];
+		int *v = &a[7 * n];
+		v[5] = cache.GetVCO_CSW(board, q.frequency, q.channel, q.tx, &v[5], &v[6]) == 0 ? v[5] : -1;
+		if (cache.GetDC_IQ_Interp(board, q.frequency, q.channel, q.tx, q.band, &v[0], &v[1], &v[2], &v[3], &v[4]) != 0)
+			v[0] = 1000;
+	}
+	tCache = t.stop() / queries.size();
+	t.start();
+	for (size_t n = 0; n < queries.size(); n++) {
+		const query &q = queries[n];
+		int *v = &b[7 * n];
+		v[5] = ref.GetVCO_CSW(board, q.frequency, q.channel, q.tx, &v[5], &v[6]) == 0 ? v[5] : -1;
+		if (ref.GetDC_IQ_Interp(board, q.frequency, q.channel, q.tx, q.band, v) != 0) v[0] = 1000;
+	}
+	tRef = t.stop() / queries.size();
+	int bad = 0;
+	for (size_t i = 0; i < a.size(); i++) bad += a[i] != b[i];
+	return bad;
+}
+
+int main(int argc, char **argv)
+{
+	const int lookups = (argc > 1) ? atoi(argv[1]) : 20000;
+	char dir[] = "/tmp/calcache_benchXXXXXX";
+	if (!mkdtemp(dir)) {
+		perror("mkdtemp");
+		return 1;
+	}
+	setenv("HOME", dir, 1);
+	const string refPath = string(dir) + "/reference.db";
+
+	int bad = 0;
+	vector<query> queries;
+	srand(1);
+	for (int n = 0; n < lookups; n++) {
+		query q;
+		const int i = rand() % points;
+		q.frequency = (rand() % 4) ? grid(i) + (rand() % 600000) : grid(i);
+		q.channel = rand() % 2;
+		q.tx = (rand() % 2) != 0;
+		q.band = rand() % bands;
+		queries.push_back(q);
+	}
+
+	double tCache, tRef;
+	{
+		CalibrationCache cache;
+		reference_cache ref(refPath);
+		Timer t;
+		int inserts = 0;
+		t.start();
+		for (int ch = 0; ch < 2; ch++)
+			for (int tx = 0; tx < 2; tx++)
+				for (int i = 0; i < points; i++) {
+					for (int band = 0; band < bands; band++) {
+						int v[5];
+						values(ch, tx, band, i, v);
+						bad += cache.InsertDC_IQ(board, grid(i), ch, tx != 0, band, v[0], v[1], v[2], v[3], v[4]) != 0;
+						inserts++;
+					}
+					bad += cache.InsertVCO_CSW(board, grid(i), ch, tx != 0, i % 3, i % 256) != 0;
+					inserts++;
+				}
+		bad += cache.Flush() != 0;
+		tCache = t.stop() / inserts;
+		t.start();
+		for (int ch = 0; ch < 2; ch++)
+			for (int tx = 0; tx < 2; tx++)
+				for (int i = 0; i < points; i++) {
+					for (int band = 0; band < bands; band++) {
+						int v[5];
+						values(ch, tx, band, i, v);
+						bad += ref.InsertDC_IQ(board, grid(i), ch, tx != 0, band, v) != 0;
+					}
+					bad += ref.InsertVCO_CSW(board, grid(i), ch, tx != 0, i % 3, i % 256) != 0;
+				}
+		tRef = t.stop() / inserts;
+		printf("%d inserts         %9.1f -> %7.1f us each (x%.0f)\n", inserts, tRef, tCache, tRef / tCache);
+
+		const int diff = compare(cache, ref, queries, tCache, tRef);
+		printf("%d lookups         %9.1f -> %7.1f us each (x%.0f), %d differences\n", lookups, tRef, tCache,
+			tRef / tCache, diff);
+		bad += diff;
+	}
+	{
+		// Reopened, the first lookup loads the board from the database
+		CalibrationCache cache;
+		reference_cache ref(refPath);
+		const int diff = compare(cache, ref, queries, tCache, tRef);
+		printf("reopened database  %d differences\n", diff);
+		bad += diff;
+	}
+
+	unlink(refPath.c_str());
+	unlink((string(dir) + "/.limesuite/LMS7002M_cache_values.db").c_str());
+	rmdir((string(dir) + "/.limesuite").c_str());
+	rmdir(dir);
+	printf("%s\n", bad ? "MISMATCH" : "results match");
+	return bad ? 1 : 0;
+}
@@ -0,0 +1,220 @@
+/* --------------------------------------------------------------------------------------------
+FILE:		control_bench.cpp
+DESCRIPTION  Register writes per second over the LMS64C control channel, one frame in flight
+		(request/response) against a pipelined channel, on a simulated board. Each Write
+		and Read costs the transfer time, the board answers a frame in the firmware
+		time after it arrives, one frame at a time.
+		A reply that times out is then checked not to be taken by the next transfers.
+		Usage: control_bench [transfer us, 60] [firmware us, 120] [pipeline depth, 4]
+CONTENT:
+AUTHOR:		Lime Microsystems LTD
+DATE:
+-------------------------------------------------------------------------------------------- */
+#include "LMS64CProtocol.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <deque>
+#include <future>
+#include <chrono>
+
+using namespace std;
+using namespace lime;
+
+typedef chrono::steady_clock sim_clock;
+
+static void wait_until(sim_clock::time_point t)
+{
+	while (sim_clock::now() < t) {}
+}
+
+// LMS64C board with BRDSPI registers, replies kept in order like a bulk endpoint
+class sim_board : public LMS64CProtocol
+{
+public:
+	sim_board(int transfer_us, int firmware_us)
+		: regs(0x10000, 0), maxInFlight(0), lateReply(0), transfer(transfer_us), firmware(firmware_us)
+	{
+	}
+
+	~sim_board()
+	{
+		StopControlThread();
+	}
+
+	bool IsOpen(void) { return true; }
+	eConnectionType GetType(void) { return USB_PORT; }
+
+	int Write(const unsigned char *buffer, int length, int timeout_ms = 0)
+	{
+		wait_until(sim_clock::now() + transfer);
+		reply r;
+		r.ready = sim_clock::now();
+		if (!replies.empty() && replies.back().ready > r.ready) r.ready = replies.back().ready;
+		r.ready += firmware;
+		r.frame.assign(buffer, buffer + length);
+		execute(r.frame);
+		replies.push_back(r);
+		if (replies.size() > maxInFlight) maxInFlight = replies.size();
+		return length;
+	}
+
+	int Read(unsigned char *buffer, int length, int timeout_ms = 0)
+	{
+		if (replies.empty()) return 0;
+		if (lateReply > 0 && --lateReply == 0) return 0;	// times out, the reply stays queued
+		wait_until(replies.front().ready);
+		wait_until(sim_clock::now() + transfer);
+		const vector<unsigned char> &f = replies.front().frame;
+		int n = length < (int)f.size() ? length : (int)f.size();
+		memcpy(buffer, &f[0], n);
+		replies.pop_front();
+		return n;
+	}
+
+	vector<uint16_t> regs;
+	size_t maxInFlight;
+	int lateReply;	// reads until one times out, 0: never
+
+private:
+	struct reply {
+		sim_clock::time_point ready;
+		vector<unsigned char> frame;
+	};
+
+	void execute(vector<unsigned char> &f)
+	{
+		const int blocks = f[2];
+		unsigned char *d = &f[8];
+		if (f[0] == CMD_BRDSPI_WR) {
+			for (int i = 0; i < blocks; i++)
+				regs[(d[4*i] << 8) | d[4*i + 1]] = (d[4*i + 2] << 8) | d[4*i + 3];
+		}
+		else if (f[0] == CMD_BRDSPI_RD) {
+			for (int i = blocks - 1; i >= 0; i--) {
+				uint16_t addr = (d[2*i] << 8) | d[2*i + 1];
+				d[4*i] = addr >> 8;
+				d[4*i + 1] = addr & 0xFF;
+				d[4*i + 2] = regs[addr] >> 8;
+				d[4*i + 3] = regs[addr] & 0xFF;
+			}
+		}
+		f[1] = STATUS_COMPLETED_CMD;
+	}
+
+	chrono::microseconds transfer;
+	chrono::microseconds firmware;
+	deque<reply> replies;
+};
+
+struct Timer
+{
+	sim_clock::time_point t0;
+	void start() { t0 = sim_clock::now(); }
+	double stop() { return chrono::duration<double>(sim_clock::now() - t0).count(); }
+};
+
+static uint16_t pattern(int run, int i)
+{
+	return (uint16_t)(run * 7919 + i * 31);
+}
+
+static int check(sim_board &board, const vector<uint32_t> &addrs, int run)
+{
+	int bad = 0;
+	for (size_t i = 0; i < addrs.size(); i++)
+		bad += board.regs[addrs[i]] != pattern(run, i);
+	return bad;
+}
+
+// One WriteRegisters call of all registers, its frames pipelined
+static double batch_writes(sim_board &board, const vector<uint32_t> &addrs, int run, int &bad)
+{
+	vector<uint32_t> values(addrs.size());
+	for (size_t i = 0; i < addrs.size(); i++) values[i] = pattern(run, i);
+	Timer t;
+	t.start();
+	bad += board.WriteRegisters(&addrs[0], &values[0], addrs.size()) != 0;
+	double s = t.stop();
+	bad += check(board, addrs, run);
+	return addrs.size() / s;
+}
+
+// Independent single register packets, one after another or all submitted at once
+static double packet_writes(sim_board &board, const vector<uint32_t> &addrs, int run, bool submit, int &bad)
+{
+	vector<LMS64CProtocol::GenericPacket> pkts(addrs.size());
+	for (size_t i = 0; i < addrs.size(); i++) {
+		pkts[i].cmd = CMD_BRDSPI_WR;
+		const uint16_t v = pattern(run, i);
+		const unsigned char bytes[4] = {(unsigned char)(addrs[i] >> 8), (unsigned char)(addrs[i] & 0xFF),
+			(unsigned char)(v >> 8), (unsigned char)(v & 0xFF)};
+		pkts[i].outBuffer.assign(bytes, bytes + 4);
+	}
+	Timer t;
+	t.start();
+	if (submit) {
+		vector<future<int> > done;
+		for (size_t i = 0; i < pkts.size(); i++) done.push_back(board.SubmitPacket(pkts[i]));
+		for (size_t i = 0; i < done.size(); i++) bad += done[i].get() != 0;
+	}
+	else {
+		for (size_t i = 0; i < pkts.size(); i++) bad += board.TransferPacket(pkts[i]) != 0;
+	}
+	double s = t.stop();
+	for (size_t i = 0; i < pkts.size(); i++) bad += pkts[i].status != STATUS_COMPLETED_CMD;
+	bad += check(board, addrs, run);
+	return addrs.size() / s;
+}
+
+static int read_back(sim_board &board, const vector<uint32_t> &addrs, int run)
+{
+	vector<uint32_t> values(addrs.size(), 0);
+	int bad = board.ReadRegisters(&addrs[0], &values[0], addrs.size()) != 0;
+	for (size_t i = 0; i < addrs.size(); i++) bad += values[i] != pattern(run, i);
+	return bad;
+}
+
+int main(int argc, char **argv)
+{
+	const int transfer_us = (argc > 1) ? atoi(argv[1]) : 60;
+	const int firmware_us = (argc > 2) ? atoi(argv[2]) : 120;
+	const int depth = (argc > 3) ? atoi(argv[3]) : 4;
+	printf("simulated board: transfer %d us, firmware %d us, pipeline depth %d\n", transfer_us, firmware_us, depth);
+
+	// DPD coefficient upload sized batch and a burst of independent writes
+	vector<uint32_t> batch, single;
+	for (int i = 0; i < 1024; i++) batch.push_back(0x0100 + i);
+	for (int i = 0; i < 256; i++) single.push_back(0x1000 + 3 * i);
+
+	sim_board board(transfer_us, firmware_us);
+	int bad = 0;
+	int run = 0;
+
+	board.SetControlPipelineDepth(1);
+	double batchBefore = batch_writes(board, batch, ++run, bad);
+	double singleBefore = packet_writes(board, single, ++run, false, bad);
+	board.SetControlPipelineDepth(depth);
+	double batchAfter = batch_writes(board, batch, ++run, bad);
+	bad += read_back(board, batch, run);
+	double singleAfter = packet_writes(board, single, ++run, true, bad);
+	bad += read_back(board, single, run);
+
+	printf("batch of %4d writes   %8.0f -> %8.0f writes/s (x%.2f)\n", (int)batch.size(), batchBefore, batchAfter,
+		batchAfter / batchBefore);
+	printf("%4d single packets    %8.0f -> %8.0f writes/s (x%.2f), submitted at once\n", (int)single.size(),
+		singleBefore, singleAfter, singleAfter / singleBefore);
+	printf("most frames in flight %d, %s\n", (int)board.maxInFlight, bad ? "MISMATCH" : "registers match");
+
+	// A reply that comes after its read timed out fails that transfer only
+	vector<uint32_t> values(batch.size(), 0);
+	board.lateReply = 3;
+	const int lateStatus = board.ReadRegisters(&batch[0], &values[0], batch.size());
+	const int recovered = read_back(board, single, run);
+	printf("late reply: transfer %s, next transfers %s\n", lateStatus ? "failed" : "NOT FAILED",
+		recovered ? "MISMATCH" : "match");
+	bad += (lateStatus == 0) + recovered;
+	return bad ? 1 : 0;
+}
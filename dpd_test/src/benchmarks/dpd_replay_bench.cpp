@@ -0,0 +1,382 @@
+/* --------------------------------------------------------------------------------------------
+FILE:		dpd_replay_bench.cpp
+DESCRIPTION  Offline DPD benchmark. Replays recorded captures (capture_file.h) or runs a
+		synthetic closed loop through a PA model, and trains a matrix of
+		(N, M, ND, lambda, algorithm) settings on them. Reports the training rate,
+		delay search and coefficient update times, the postdistorter NMSE on the next, unseen
+		capture and the ACPR of the PA output x.
+		  dpd_replay_bench [--file=captures.bin] [--frames=4] [--update=4000]
+		    [--n=1,2,3] [--m=2] [--nd=0] [--lambda=0.998] [--alg=LU,GS,RLS,BLOCK]
+		    [--bw=0.2] [--rms=0.15] [--pa=pa=mp] [--csv]
+		  dpd_replay_bench --record=captures.bin [--frames=4] [--bw=0.2] [--rms=0.15] [--pa=pa=mp]
+		Without --file every capture is made by the synthetic loop, so the ACPR shows
+		the linearisation. Its PA is the PAModel of the DPDSim connection, --pa takes
+		the same comma separated settings, e.g. --pa=pa=saleh,ba=1.5. A replayed file
+		is open loop, its captures are cycled if it holds fewer than --frames and the
+		ACPR is that of the recorded x.
+		GRAD is left out by default, its fixed step (qadpd::alpha) diverges on the
+		lambda weighted accumulation. Returns nonzero if a run gives non-finite
+		coefficients or NMSE.
+CONTENT:
+AUTHOR:		Lime Microsystems LTD
+DATE:
+-------------------------------------------------------------------------------------------- */
+#include "DPDTest/dpd_engine.h"
+#include "DPDTest/dpd_pipeline.h"
+#include "DPDTest/dpd_board.h"
+#include "DPDTest/capture_file.h"
+#include "DPDTest/qadpd.h"
+#include "ConnectionDPDSim/PAModel.h"
+#include "kiss_fft.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <random>
+#include <complex>
+
+using namespace std;
+
+typedef complex<double> cpx;
+
+static const double AMPLITUDE = 8192.0;	// full scale of the 14-bit fields
+
+// Comma separated list option, --name=1,2,3
+template <class T>
+static bool list_option(const char *arg, const char *name, vector<T> &out, T (*parse)(const char *))
+{
+	size_t len = strlen(name);
+	if (strncmp(arg, name, len) != 0 || arg[len] != '=') return false;
+	out.clear();
+	string s(arg + len + 1);
+	size_t p = 0;
+	while (p <= s.size()) {
+		size_t e = s.find(',', p);
+		if (e == string::npos) e = s.size();
+		if (e > p) out.push_back(parse(s.substr(p, e - p).c_str()));
+		p = e + 1;
+	}
+	return true;
+}
+
+static int parse_int(const char *s) { return atoi(s); }
+static double parse_double(const char *s) { return atof(s); }
+static int parse_alg(const char *s)
+{
+	const char *names[] = { "LU", "GS", "GRAD", "RLS", "BLOCK" };
+	for (int i = 0; i < 5; i++) if (strcmp(s, names[i]) == 0) return i;
+	return -1;
+}
+static const char *alg_name(int a)
+{
+	const char *names[] = { "LU", "GS", "GRAD", "RLS", "BLOCK" };
+	return (a >= 0 && a < 5) ? names[a] : "?";
+}
+
+// Band limited complex Gaussian signal, flat over |f| < bw/2, rms relative to full scale
+static void make_signal(int len, double bw, double rms, unsigned seed, vector<cpx> &s)
+{
+	mt19937 gen(seed);
+	normal_distribution<double> nd(0.0, 1.0);
+	vector<kiss_fft_cpx> spec(len), time(len);
+	int edge = (int)(bw / 2 * len);
+	for (int k = 0; k < len; k++) {
+		int f = (k <= len / 2) ? k : k - len;
+		bool in = (f > -edge) && (f < edge);
+		spec[k].r = in ? (float)nd(gen) : 0.0f;
+		spec[k].i = in ? (float)nd(gen) : 0.0f;
+	}
+	kiss_fft_cfg plan = kiss_fft_alloc(len, 1, 0, 0);
+	kiss_fft(plan, &spec[0], &time[0]);
+	kiss_fft_free(plan);
+
+	double p = 0.0;
+	for (int i = 0; i < len; i++) p += time[i].r*time[i].r + time[i].i*time[i].i;
+	double scale = rms * AMPLITUDE / sqrt(p / len);
+	s.resize(len);
+	for (int i = 0; i < len; i++) s[i] = cpx(time[i].r*scale, time[i].i*scale);
+}
+
+// PA of the DPDSim connection on samples normalised to full scale, the output delayed
+// by two samples and divided by the small signal gain as the simulator feedback is
+static void pa_model(const lime::PAModel &pa, const vector<cpx> &in, vector<cpx> &out)
+{
+	const int delay = 2;
+	const int mem = (int)lime::PAModel::MEMORY;
+	int len = (int)in.size();
+	vector<cpx> s(mem + len, cpx(0.0, 0.0)), y(len);
+	for (int i = 0; i < len; i++) s[mem + i] = in[i] / AMPLITUDE;
+	pa.Process(&s[mem], &y[0], len);
+	double scale = AMPLITUDE / pa.SmallSignalGain();
+	out.assign(len, cpx(0.0, 0.0));
+	for (int i = delay; i < len; i++) out[i] = y[i - delay] * scale;
+}
+
+static int clip14(double v)
+{
+	int i = (int)floor(v + 0.5);
+	if (i > 8191) i = 8191;
+	if (i < -8192) i = -8192;
+	return i;
+}
+
+// Field f of a little endian packed stream, the layout packed_samples decodes
+static void put_field(vector<unsigned char> &buf, int bits, long f, int v)
+{
+	uint32_t u = (uint32_t)v & ((1u << bits) - 1);
+	long bit = f * bits;
+	for (int k = 0; k < bits; k++, bit++)
+		if ((u >> k) & 1) buf[bit >> 3] |= (unsigned char)(1 << (bit & 7));
+}
+
+static void pack_burst(const vector<cpx> &xp, const vector<cpx> &yp, const vector<cpx> &x, vector<unsigned char> &buf)
+{
+	const int bits = dpd_board::CAPTURE_BITS;
+	long len = (long)xp.size();
+	buf.assign(dpd_board::burst_bytes(len, bits), 0);
+	for (long i = 0; i < len; i++) {
+		put_field(buf, bits, 4*i, clip14(xp[i].real()));
+		put_field(buf, bits, 4*i + 1, clip14(xp[i].imag()));
+		put_field(buf, bits, 4*i + 2, clip14(yp[i].real()));
+		put_field(buf, bits, 4*i + 3, clip14(yp[i].imag()));
+		put_field(buf, bits, 4*len + 2*i, clip14(x[i].real()));
+		put_field(buf, bits, 4*len + 2*i + 1, clip14(x[i].imag()));
+	}
+}
+
+// Adjacent channel power ratio of the middle 8192 samples, Hann window,
+// main channel |f| < bw/2, adjacent channels of the same width on either side
+static double acpr_db(const kiss_fft_cpx *s, int len, double bw)
+{
+	const int n = 8192;
+	if (len < n) return 0.0;
+	int off = (len - n) / 2;
+	vector<kiss_fft_cpx> in(n), out(n);
+	for (int i = 0; i < n; i++) {
+		float w = (float)(0.5 * (1.0 - cos(2 * M_PI * i / n)));
+		in[i].r = s[off + i].r * w;
+		in[i].i = s[off + i].i * w;
+	}
+	kiss_fft_cfg plan = kiss_fft_alloc(n, 0, 0, 0);
+	kiss_fft(plan, &in[0], &out[0]);
+	kiss_fft_free(plan);
+
+	double main = 0.0, lower = 0.0, upper = 0.0;
+	for (int k = 0; k < n; k++) {
+		double f = ((k <= n / 2) ? k : k - n) / (double)n;
+		double p = (double)out[k].r*out[k].r + (double)out[k].i*out[k].i;
+		if (fabs(f) < bw / 2) main += p;
+		else if (f >= bw / 2 && f < 1.5*bw) upper += p;
+		else if (f <= -bw / 2 && f > -1.5*bw) lower += p;
+	}
+	double adj = (lower > upper) ? lower : upper;
+	return 10.0 * log10(adj / main);
+}
+
+// Postdistorter error power relative to the predistorter output, dB
+static double nmse_db(const vector<kiss_fft_cpx> &u, const vector<kiss_fft_cpx> &err)
+{
+	double e = 0.0, p = 0.0;
+	for (size_t i = 0; i < u.size(); i++) {
+		e += err[i].r*err[i].r + err[i].i*err[i].i;
+		p += u[i].r*u[i].r + u[i].i*u[i].i;
+	}
+	return 10.0 * log10(e / p);
+}
+
+struct frame {
+	vector<kiss_fft_cpx> xp, yp, x, y, u, err;
+	void resize(int len)
+	{
+		xp.assign(len, kiss_fft_cpx()); yp.assign(len, kiss_fft_cpx()); x.assign(len, kiss_fft_cpx());
+		y.assign(len, kiss_fft_cpx()); u.assign(len, kiss_fft_cpx()); err.assign(len, kiss_fft_cpx());
+	}
+};
+
+// Synthetic capture k: xp through the current predistorter (identity before the
+// first training run), then through the PA model
+static void synthetic_burst(const lime::PAModel &pa, dpd_engine *engine, bool trained, int nd, int len, double bw,
+	double rms, unsigned k, vector<unsigned char> &buf)
+{
+	vector<cpx> xp, yp, x;
+	make_signal(len, bw, rms, 1000 + k, xp);
+	yp = xp;
+	if (engine && trained) {
+		frame f;
+		f.resize(len);
+		for (int i = 0; i < len; i++) {
+			f.xp[i].r = f.x[i].r = f.yp[i].r = (float)xp[i].real();
+			f.xp[i].i = f.x[i].i = f.yp[i].i = (float)xp[i].imag();
+		}
+		dpd_capture cap = { &f.xp[0], &f.x[0], &f.yp[0], len };
+		// u is the software predistorter output delayed by nd, written on [3, len-3)
+		engine->evaluate(0, cap, 0, false, &f.y[0], &f.u[0], &f.err[0]);
+		for (int i = 0; i < len; i++) {
+			int s = i + nd;
+			if (s >= 3 && s < len - 3) yp[i] = cpx(f.u[s].r, f.u[s].i);
+		}
+	}
+	pa_model(pa, yp, x);
+	pack_burst(xp, yp, x, buf);
+}
+
+int main(int argc, char **argv)
+{
+	vector<int> ns(1, 1), ms(1, 2), nds(1, 0), algs;
+	vector<double> lambdas(1, 0.998);
+	ns.push_back(2);
+	ns.push_back(3);
+	algs.push_back(qadpd::LU);
+	algs.push_back(qadpd::GS);
+	algs.push_back(qadpd::RLS);
+	algs.push_back(qadpd::BLOCK);
+	int frames = 4, update = 4000;
+	double bw = 0.2, rms = 0.15;	// the memory polynomial PA is driven too hard at 0.25
+	bool csv = false;
+	string file, record, paArgs = "pa=mp";
+
+	for (int i = 1; i < argc; i++) {
+		const char *a = argv[i];
+		if (list_option(a, "--n", ns, parse_int)) continue;
+		if (list_option(a, "--m", ms, parse_int)) continue;
+		if (list_option(a, "--nd", nds, parse_int)) continue;
+		if (list_option(a, "--lambda", lambdas, parse_double)) continue;
+		if (list_option(a, "--alg", algs, parse_alg)) continue;
+		if (strncmp(a, "--frames=", 9) == 0) frames = atoi(a + 9);
+		else if (strncmp(a, "--update=", 9) == 0) update = atoi(a + 9);
+		else if (strncmp(a, "--bw=", 5) == 0) bw = atof(a + 5);
+		else if (strncmp(a, "--rms=", 6) == 0) rms = atof(a + 6);
+		else if (strncmp(a, "--file=", 7) == 0) file = a + 7;
+		else if (strncmp(a, "--record=", 9) == 0) record = a + 9;
+		else if (strncmp(a, "--pa=", 5) == 0) paArgs = a + 5;
+		else if (strcmp(a, "--csv") == 0) csv = true;
+		else {
+			printf("unknown option %s\n", a);
+			return 2;
+		}
+	}
+	for (size_t i = 0; i < algs.size(); i++) {
+		if (algs[i] < 0) {
+			printf("unknown algorithm\n");
+			return 2;
+		}
+	}
+	if (frames < 2) frames = 2;	// the NMSE is measured on the capture after a training run
+	lime::PAModel pa;
+	if (pa.Configure(paArgs) != 0) {
+		printf("bad PA settings %s\n", paArgs.c_str());
+		return 2;
+	}
+
+	int len = dpd_board::CAPTURE_SAMPLES;
+	int bits = dpd_board::CAPTURE_BITS;
+
+	// Open loop synthetic captures for later replays
+	if (!record.empty()) {
+		capture_file::writer w;
+		if (w.open(record.c_str(), len, bits) != 0) {
+			printf("cannot create %s\n", record.c_str());
+			return 2;
+		}
+		vector<unsigned char> buf;
+		for (int k = 0; k < frames; k++) {
+			synthetic_burst(pa, NULL, false, 0, len, bw, rms, k, buf);
+			if (w.append(buf) != 0) {
+				printf("write to %s failed\n", record.c_str());
+				return 2;
+			}
+		}
+		printf("%d captures of %d samples written to %s\n", frames, len, record.c_str());
+		return 0;
+	}
+
+	capture_file::reader replay;
+	if (!file.empty()) {
+		if (replay.open(file.c_str()) != 0) {
+			printf("%s is not a capture file\n", file.c_str());
+			return 2;
+		}
+		len = replay.samples();
+		bits = replay.bits();
+	}
+
+	if (csv) printf("n,m,nd,lambda,alg,frames,samples_per_s,align_ms,update_ms,nmse_db,acpr_first_db,acpr_last_db\n");
+	else printf("%s, %d frames of %d samples, update %d\n", file.empty() ? "synthetic closed loop" : file.c_str(), frames, len, update);
+
+	int failed = 0;
+	dpd_settings settings = { update, 3, false, true, 16.0 };
+	for (size_t in = 0; in < ns.size(); in++)
+	for (size_t im = 0; im < ms.size(); im++)
+	for (size_t ind = 0; ind < nds.size(); ind++)
+	for (size_t il = 0; il < lambdas.size(); il++)
+	for (size_t ia = 0; ia < algs.size(); ia++) {
+		int N = ns[in], M = ms[im], ND = nds[ind], alg = algs[ia];
+		double lambda = lambdas[il];
+
+		dpd_engine engine(1);
+		engine.set_channels(1, N, M, ND);
+		engine.channel(0)->fname = "";	// no log files
+		engine.channel(0)->fname2 = "";
+		engine.init(N, M, ND, lambda, AMPLITUDE, 0, alg);
+		replay.rewind();
+
+		frame f;
+		f.resize(len);
+		vector<unsigned char> buf;
+		long samples = 0;
+		double trainTime = 0.0, alignTime = 0.0, solveTime = 0.0;
+		double nmse = 0.0, acprFirst = 0.0, acprLast = 0.0;
+		int lag = 0, done = 0;
+		bool finite = true;
+
+		for (int k = 0; k < frames; k++) {
+			if (file.empty()) synthetic_burst(pa, &engine, k > 0, ND, len, bw, rms, k, buf);
+			else if (replay.next(buf) != 0) {
+				// fewer captures than frames, start the file again
+				replay.rewind();
+				if (replay.next(buf) != 0) break;
+			}
+			dpd_decode(&buf[0], (long)buf.size(), bits, len, 1.0, &f.xp[0], &f.yp[0], &f.x[0]);
+
+			double acpr = acpr_db(&f.x[0], len, bw);
+			if (k == 0) acprFirst = acpr;
+			acprLast = acpr;
+
+			dpd_capture cap = { &f.xp[0], &f.x[0], &f.yp[0], len };
+			if (k > 0) {
+				// coefficients of the previous capture on this one
+				f.err.assign(len, kiss_fft_cpx());
+				f.u.assign(len, kiss_fft_cpx());
+				engine.evaluate(0, cap, lag, settings.ypFpga, &f.y[0], &f.u[0], &f.err[0]);
+				nmse = nmse_db(f.u, f.err);
+			}
+			engine.train_channel(0, cap, settings);
+			shared_ptr<const dpd_coeffs> c = engine.coeffs(0);
+			lag = c->lag;
+			samples += c->samples;
+			trainTime += c->trainTime;
+			alignTime += c->alignTime;
+			solveTime += c->solveTime;
+			for (size_t i = 0; i < c->a.size(); i++)
+				if (!isfinite(c->a[i]) || !isfinite(c->b[i])) finite = false;
+			done++;
+		}
+		if (!isfinite(nmse)) finite = false;
+		if (!finite) failed++;
+
+		double rate = (trainTime > 0.0) ? samples / trainTime : 0.0;
+		if (csv) {
+			printf("%d,%d,%d,%g,%s,%d,%.0f,%.3f,%.3f,%.2f,%.2f,%.2f\n", N, M, ND, lambda, alg_name(alg), done,
+				rate, 1e3*alignTime / done, 1e3*solveTime / done, nmse, acprFirst, acprLast);
+		}
+		else {
+			printf("n=%d m=%d nd=%d lambda=%-6g %-5s: %8.3f Msamples/s, align %7.3f ms, update %7.3f ms, "
+				"NMSE %7.2f dB, ACPR %6.2f -> %6.2f dB%s\n", N, M, ND, lambda, alg_name(alg), rate / 1e6,
+				1e3*alignTime / done, 1e3*solveTime / done, nmse, acprFirst, acprLast, finite ? "" : "  NOT FINITE");
+		}
+	}
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,175 @@
+/* --------------------------------------------------------------------------------------------
+FILE:		packing_bench.cpp
+DESCRIPTION  Pack and unpack time of PacketLTE payloads, the per sample StreamerLTE loops
+		against the SamplePacking kernels, for one and two channels
+CONTENT:
+AUTHOR:		Lime Microsystems LTD
+DATE:
+-------------------------------------------------------------------------------------------- */
+#include "LTEpackets/SamplePacking.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <chrono>
+
+using namespace std;
+using namespace lime;
+
+static const int payloadBytes = 4080;
+
+// Previous StreamerLTE loops
+static void unpack12_reference(const uint8_t *pktStart, complex16_t **dst, int channelsCount)
+{
+	const int stepSize = channelsCount * 3;
+	int samplesCollected = 0;
+	int16_t sample;
+	for (uint16_t b = 0; b < payloadBytes; b += stepSize)
+	{
+		for (int ch = 0; ch < channelsCount; ++ch)
+		{
+			sample = (pktStart[b + 1 + 3 * ch] & 0x0F) << 8;
+			sample |= (pktStart[b + 3 * ch] & 0xFF);
+			sample = sample << 4;
+			sample = sample >> 4;
+			dst[ch][samplesCollected].i = sample;
+			sample = pktStart[b + 2 + 3 * ch] << 4;
+			sample |= (pktStart[b + 1 + 3 * ch] >> 4) & 0x0F;
+			sample = sample << 4;
+			sample = sample >> 4;
+			dst[ch][samplesCollected].q = sample;
+		}
+		++samplesCollected;
+	}
+}
+
+static void pack12_reference(complex16_t **src, uint8_t *dataStart, int channelsCount)
+{
+	const int stepSize = channelsCount * 3;
+	int samplesCollected = 0;
+	for (uint16_t b = 0; b < payloadBytes; b += stepSize)
+	{
+		for (int ch = 0; ch < channelsCount; ++ch)
+		{
+			dataStart[b + 3 * ch] = src[ch][samplesCollected].i & 0xFF;
+			dataStart[b + 1 + 3 * ch] = (src[ch][samplesCollected].i >> 8) & 0x0F;
+			dataStart[b + 1 + 3 * ch] |= (src[ch][samplesCollected].q << 4) & 0xF0;
+			dataStart[b + 2 + 3 * ch] = (src[ch][samplesCollected].q >> 4) & 0xFF;
+		}
+		++samplesCollected;
+	}
+}
+
+static void unpack16_reference(const uint8_t *pktStart, complex16_t **dst, int channelsCount)
+{
+	const int stepSize = channelsCount * 4;
+	int samplesCollected = 0;
+	int16_t sample;
+	for (uint16_t b = 0; b < payloadBytes; b += stepSize)
+	{
+		for (int ch = 0; ch < channelsCount; ++ch)
+		{
+			sample = (pktStart[b + 1 + 4 * ch] & 0x0F) << 8;
+			sample |= (pktStart[b + 4 * ch] & 0xFF);
+			sample = sample << 4;
+			sample = sample >> 4;
+			dst[ch][samplesCollected].i = sample;
+			sample = (pktStart[b + 3 + 4 * ch] & 0x0F) << 8;
+			sample |= pktStart[b + 2 + 4 * ch] & 0xFF;
+			sample = sample << 4;
+			sample = sample >> 4;
+			dst[ch][samplesCollected].q = sample;
+		}
+		++samplesCollected;
+	}
+}
+
+static void pack16_reference(complex16_t **src, uint8_t *dataStart, int channelsCount)
+{
+	const int stepSize = channelsCount * 4;
+	int samplesCollected = 0;
+	for (uint16_t b = 0; b < payloadBytes; b += stepSize)
+	{
+		for (int ch = 0; ch < channelsCount; ++ch)
+		{
+			dataStart[b + 4 * ch] = src[ch][samplesCollected].i & 0xFF;
+			dataStart[b + 1 + 4 * ch] = ((src[ch][samplesCollected].i >> 8) & 0x0F) | 0x10;
+			dataStart[b + 2 + 4 * ch] = (src[ch][samplesCollected].q) & 0xFF; // was |=, relied on stale buffer contents
+			dataStart[b + 3 + 4 * ch] = (src[ch][samplesCollected].q >> 8) & 0x0F;
+		}
+		++samplesCollected;
+	}
+}
+
+struct Timer
+{
+	chrono::high_resolution_clock::time_point t0;
+	void start() { t0 = chrono::high_resolution_clock::now(); }
+	double stop() { return chrono::duration<double, micro>(chrono::high_resolution_clock::now() - t0).count(); }
+};
+
+int main(int argc, char **argv)
+{
+	const int packets = 256;
+	int repeat = (argc > 1) ? atoi(argv[1]) : 20;
+	int failed = 0;
+	printf("kernels: %s, %d packets per pass\n", SamplePackingImplementation(), packets);
+
+	for (int channelsCount = 1; channelsCount <= 2; channelsCount++)
+	{
+		for (int bytesPerPair = 3; bytesPerPair <= 4; bytesPerPair++)
+		{
+			const int samples = payloadBytes / (bytesPerPair * channelsCount);
+			vector<uint8_t> payload(payloadBytes*packets), packed0(payload.size()), packed1(payload.size());
+			vector<complex16_t> data0(samples*channelsCount*packets), data1(data0.size());
+			srand(channelsCount * 10 + bytesPerPair);
+			for (size_t i = 0; i < payload.size(); i++) payload[i] = rand() & 0xFF;
+			if (bytesPerPair == 4) // receiver ignores bits 12..15
+				for (size_t i = 1; i < payload.size(); i += 2) payload[i] &= 0x0F;
+
+			double tUnpackRef = 1e30, tUnpack = 1e30, tPackRef = 1e30, tPack = 1e30;
+			Timer t;
+			for (int r = 0; r < repeat; r++)
+			{
+				double a = 0, b = 0, c = 0, d = 0;
+				for (int p = 0; p < packets; p++)
+				{
+					complex16_t *dst0[2] = { &data0[p*channelsCount*samples], &data0[p*channelsCount*samples] + (channelsCount - 1)*samples };
+					complex16_t *dst1[2] = { &data1[p*channelsCount*samples], &data1[p*channelsCount*samples] + (channelsCount - 1)*samples };
+					const uint8_t *src = &payload[p*payloadBytes];
+					t.start();
+					if (bytesPerPair == 3) unpack12_reference(src, dst0, channelsCount);
+					else unpack16_reference(src, dst0, channelsCount);
+					a += t.stop();
+					t.start();
+					if (bytesPerPair == 3) Unpack12Bit(src, dst1, channelsCount, samples);
+					else Unpack12In16(src, dst1, channelsCount, samples);
+					b += t.stop();
+					t.start();
+					if (bytesPerPair == 3) pack12_reference(dst0, &packed0[p*payloadBytes], channelsCount);
+					else pack16_reference(dst0, &packed0[p*payloadBytes], channelsCount);
+					c += t.stop();
+					t.start();
+					if (bytesPerPair == 3) Pack12Bit(dst1, &packed1[p*payloadBytes], channelsCount, samples);
+					else Pack12In16(dst1, &packed1[p*payloadBytes], channelsCount, samples);
+					d += t.stop();
+				}
+				if (a < tUnpackRef) tUnpackRef = a;
+				if (b < tUnpack) tUnpack = b;
+				if (c < tPackRef) tPackRef = c;
+				if (d < tPack) tPack = d;
+			}
+
+			int mismatches = 0;
+			for (size_t i = 0; i < data0.size(); i++)
+				if (data0[i].i != data1[i].i || data0[i].q != data1[i].q) mismatches++;
+			mismatches += memcmp(&packed0[0], &packed1[0], packed0.size()) != 0;
+			failed += mismatches;
+			printf("%d ch, %s: unpack %8.1f -> %7.1f us (x%4.1f), pack %8.1f -> %7.1f us (x%4.1f), mismatches %d\n",
+				channelsCount, bytesPerPair == 3 ? "12 bit  " : "12 in 16",
+				tUnpackRef, tUnpack, tUnpackRef / tUnpack, tPackRef, tPack, tPackRef / tPack, mismatches);
+		}
+	}
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,157 @@
+/* --------------------------------------------------------------------------------------------
+FILE:		regmap_bench.cpp
+DESCRIPTION  Shadow register access of LMS7002M_RegistersMap against the previous std::map
+		storage, and Modify_SPI_Reg_bits throughput in cached mode, the chip behind a
+		connection that accepts every SPI transaction.
+		Usage: regmap_bench [million operations, 2]
+CONTENT:
+AUTHOR:		Lime Microsystems LTD
+DATE:
+-------------------------------------------------------------------------------------------- */
+#include "LMS7002M.h"
+#include "LMS7002M_RegistersMap.h"
+#include "LMS7002M_parameters.h"
+#include "IConnection.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <map>
+#include <chrono>
+
+using namespace std;
+using namespace lime;
+
+// Previous LMS7002M_RegistersMap storage
+class reference_map
+{
+public:
+	void InitializeDefaultValues(const vector<const LMS7Parameter*> &parameterList)
+	{
+		for (auto parameter : parameterList)
+		{
+			mChannelA[parameter->address].defaultValue |= parameter->defaultValue << parameter->lsb;
+			mChannelA[parameter->address].value = mChannelA[parameter->address].defaultValue;
+			if (parameter->address >= 0x0100)
+				mChannelB[parameter->address].value = mChannelA[parameter->address].value;
+		}
+		for (int i = 0; i < 32; ++i)	// NCO/PHO registers
+		{
+			mChannelA[0x0242 + i].value = mChannelB[0x0242 + i].value = 0;
+			mChannelA[0x0442 + i].value = mChannelB[0x0442 + i].value = 0;
+		}
+	}
+	uint16_t GetValue(uint8_t channel, uint16_t address) const
+	{
+		const map<const uint16_t, LMS7002M_RegistersMap::Register> &regMap = channel ? mChannelB : mChannelA;
+		auto iter = regMap.find(address);
+		return (iter != regMap.end()) ? iter->second.value : 0;
+	}
+	void SetValue(uint8_t channel, uint16_t address, uint16_t value)
+	{
+		if (channel == 0) mChannelA[address].value = value;
+		else mChannelB[address].value = value;
+	}
+	vector<uint16_t> GetUsedAddresses(uint8_t channel) const
+	{
+		vector<uint16_t> addresses;
+		for (auto iter : (channel ? mChannelB : mChannelA))
+			addresses.push_back(iter.first);
+		return addresses;
+	}
+private:
+	map<const uint16_t, LMS7002M_RegistersMap::Register> mChannelA, mChannelB;
+};
+
+// The cached path of Modify_SPI_Reg_bits: MAC lookup, read, mask, write to the selected channels
+template <class Map>
+static unsigned modify_loop(Map &regs, const vector<const LMS7Parameter*> &params, long count)
+{
+	const uint16_t macAddr = MAC.address;
+	unsigned check = 0;
+	for (long n = 0; n < count; n++)
+	{
+		const LMS7Parameter &p = *params[n % params.size()];
+		if (p.address == macAddr) continue;
+		int mac = regs.GetValue(0, macAddr) & 0x3;
+		int regNo = (mac == 2 && p.address >= 0x0100) ? 1 : 0;
+		uint16_t reg = regs.GetValue(regNo, p.address);
+		uint16_t mask = (~(~0 << (p.msb - p.lsb + 1))) << p.lsb;
+		reg = (reg & ~mask) | ((n << p.lsb) & mask);
+		if ((mac & 0x1) || p.address < 0x0100) regs.SetValue(0, p.address, reg);
+		if ((mac & 0x2) || p.address < 0x0100) regs.SetValue(1, p.address, reg);
+		check = check * 31 + reg;
+	}
+	return check;
+}
+
+// Accepts every SPI transaction, reads return zero
+class null_connection : public IConnection
+{
+public:
+	bool IsOpen(void) { return true; }
+	int TransactSPI(const int addr, const uint32_t *writeData, uint32_t *readData, const size_t size)
+	{
+		if (readData)
+			for (size_t i = 0; i < size; i++) readData[i] = 0;
+		return 0;
+	}
+};
+
+struct Timer
+{
+	chrono::high_resolution_clock::time_point t0;
+	void start() { t0 = chrono::high_resolution_clock::now(); }
+	double stop() { return chrono::duration<double, nano>(chrono::high_resolution_clock::now() - t0).count(); }
+};
+
+int main(int argc, char **argv)
+{
+	long count = (long)((argc > 1) ? atof(argv[1]) : 2.0) * 1000000L;
+	if (count <= 0) count = 1000000;
+	const vector<const LMS7Parameter*> &params = LMS7parameterList;
+	Timer t;
+
+	reference_map ref;
+	LMS7002M_RegistersMap *regs = new LMS7002M_RegistersMap();
+	ref.InitializeDefaultValues(params);
+	regs->InitializeDefaultValues(params);
+
+	t.start();
+	unsigned refCheck = modify_loop(ref, params, count);
+	double tRef = t.stop() / count;
+	t.start();
+	unsigned check = modify_loop(*regs, params, count);
+	double tMap = t.stop() / count;
+	int failed = (refCheck != check);
+	for (uint8_t ch = 0; ch < 2; ch++)
+		failed += ref.GetUsedAddresses(ch) != regs->GetUsedAddresses(ch);
+	printf("read-modify-write   %7.1f -> %6.1f ns (x%4.1f), %s\n", tRef, tMap, tRef / tMap,
+		failed ? "MISMATCH" : "same registers");
+
+	const int lists = 10000;
+	size_t used = 0;
+	t.start();
+	for (int i = 0; i < lists; i++) used += ref.GetUsedAddresses(i & 1).size();
+	tRef = t.stop() / lists;
+	t.start();
+	for (int i = 0; i < lists; i++) used += regs->GetUsedAddresses(i & 1).size();
+	tMap = t.stop() / lists;
+	printf("GetUsedAddresses    %7.1f -> %6.1f ns (x%4.0f), %d addresses\n", tRef, tMap, tRef / tMap,
+		(int)(used / (2 * lists)));
+	delete regs;
+
+	null_connection conn;
+	LMS7002M chip;
+	chip.SetConnection(&conn);
+	t.start();
+	for (long n = 0; n < count; n++)
+	{
+		const LMS7Parameter &p = *params[n % params.size()];
+		if (p.address == MAC.address) continue;
+		chip.Modify_SPI_Reg_bits(p, n & ((1 << (p.msb - p.lsb + 1)) - 1));
+	}
+	printf("Modify_SPI_Reg_bits %6.1f ns per call, %zu parameters\n", t.stop() / count, params.size());
+
+	return failed ? 1 : 0;
+}
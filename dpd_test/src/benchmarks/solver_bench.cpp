@@ -0,0 +1,117 @@
+/* --------------------------------------------------------------------------------------------
+FILE:		solver_bench.cpp
+DESCRIPTION  Solve time of the QADPD normal equations, K = 2(n+1)(m+1), with the row pointer
+		nrc solvers against the contiguous dense_matrix ones
+CONTENT:
+AUTHOR:		Lime Microsystems LTD
+DATE:
+-------------------------------------------------------------------------------------------- */
+#include "DPDTest/nrc.h"
+#include "DPDTest/dense_matrix.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <chrono>
+
+using namespace std;
+
+struct Timer
+{
+	chrono::high_resolution_clock::time_point t0;
+	void start() { t0 = chrono::high_resolution_clock::now(); }
+	double stop() { return chrono::duration<double, micro>(chrono::high_resolution_clock::now() - t0).count(); }
+};
+
+// Symmetric positive definite system like the accumulated A, B of qadpd::train()
+static void make_system(int K, vector<double> &A, vector<double> &B)
+{
+	int rows = 4 * K;
+	vector<double> X(rows*K);
+	for (size_t i = 0; i < X.size(); i++) X[i] = (rand() / (double)RAND_MAX - 0.5);
+	A.assign(K*K, 0.0);
+	B.assign(K, 0.0);
+	for (int i = 0; i < K; i++) {
+		for (int j = 0; j < K; j++) {
+			double s = 0.0;
+			for (int r = 0; r < rows; r++) s += X[r*K + i] * X[r*K + j];
+			A[i*K + j] = s;
+		}
+		A[i*K + i] += K;	// diagonally dominant, so the iterative solvers converge
+		B[i] = rand() / (double)RAND_MAX;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int repeat = (argc > 1) ? atoi(argv[1]) : 200;
+	const int sizes[][2] = { { 1, 1 }, { 2, 2 }, { 3, 2 }, { 3, 3 }, { 5, 3 }, { 7, 5 } };
+	const char *names[] = { "LU", "GS", "GRAD" };
+	int failed = 0;
+
+	for (int s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++) {
+		int n = sizes[s][0], m = sizes[s][1];
+		int K = 2 * (n + 1)*(m + 1);
+		vector<double> A0, B0;
+		srand(K);
+		make_system(K, A0, B0);
+
+		double **a = nrc::matrix(1, K, 1, K);
+		double *b = nrc::vector(1, K);
+		double *x = nrc::vector(1, K);
+		int *indx = nrc::ivector(1, K);
+		dense::mat da(K, K);
+		dense::vec db(K), dx(K);
+		vector<int> dindx(K);
+
+		for (int alg = 0; alg < 3; alg++) {
+			double tOld = 1e30, tNew = 1e30, d;
+			Timer t;
+			for (int r = 0; r < repeat; r++) {
+				for (int i = 0; i < K; i++) {
+					b[1 + i] = B0[i];
+					x[1 + i] = 0.0;
+					db[i] = B0[i];
+					dx[i] = 0.0;
+					for (int j = 0; j < K; j++) a[1 + i][1 + j] = da[i][j] = A0[i*K + j];
+				}
+				t.start();
+				if (alg == 0) {
+					nrc::ludcmp(a, K, indx, &d);
+					nrc::lubksb(a, K, indx, b);
+				}
+				else if (alg == 1) nrc::gauss_seidel(a, b, x, K);
+				else nrc::lgrad(a, b, x, K, 0.5 / K);
+				double e = t.stop();
+				if (e < tOld) tOld = e;
+
+				t.start();
+				if (alg == 0) {
+					dense::ludcmp(da, &dindx[0], &d);
+					dense::lubksb(da, &dindx[0], db.data());
+				}
+				else if (alg == 1) dense::gauss_seidel(da, db.data(), dx.data());
+				else dense::lgrad(da, db.data(), dx.data(), 0.5 / K);
+				e = t.stop();
+				if (e < tNew) tNew = e;
+			}
+
+			int mismatches = 0;
+			for (int i = 0; i < K; i++) {
+				double o = (alg == 0) ? b[1 + i] : x[1 + i];
+				double v = (alg == 0) ? db[i] : dx[i];
+				if (o != v) mismatches++;
+			}
+			failed += mismatches;
+			printf("n=%d m=%d K=%3d %-4s: nrc %8.2f us, dense %8.2f us, x%4.1f, mismatches %d\n",
+				n, m, K, names[alg], tOld, tNew, tOld / tNew, mismatches);
+		}
+
+		nrc::free_ivector(indx, 1, K);
+		nrc::free_vector(x, 1, K);
+		nrc::free_vector(b, 1, K);
+		nrc::free_matrix(a, 1, K, 1, K);
+	}
+	return failed ? 1 : 0;
+}
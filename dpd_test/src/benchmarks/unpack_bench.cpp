@@ -0,0 +1,126 @@
+/* --------------------------------------------------------------------------------------------
+FILE:		unpack_bench.cpp
+DESCRIPTION  Decode time of a 6 x 16384 sample packed capture, the byte reversal and
+		bit by bit ReadBitStream() path against packed_samples::unpack_cpx()
+CONTENT:
+AUTHOR:		Lime Microsystems LTD
+DATE:
+-------------------------------------------------------------------------------------------- */
+#include "DPDTest/packed_samples.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <chrono>
+
+using namespace std;
+
+// Previous DPDTest decoder
+static int ReadBitStream(const uint8_t* buffer, long offset, const uint8_t bitCount, bool toSigned = false)
+{
+	const int srcBitCount = 8;
+	int result = 0;
+	int bitsCollected = 0;
+	const uint8_t* src = buffer + (offset / srcBitCount) * 1;
+	offset = offset % srcBitCount;
+
+	while (bitsCollected < bitCount)
+	{
+		for (int b = srcBitCount - 1 - offset; b >= 0 && bitsCollected < bitCount; --b)
+		{
+			int bit = ((*src) & (1 << b)) > 0;
+			result <<= 1;
+			result |= bit;
+			offset = 0;
+			++bitsCollected;
+		}
+		offset = 0;
+		++src;
+	}
+	if (toSigned && (result & (1 << (bitCount - 1))))
+	{
+		result <<= 32 - bitCount;
+		result >>= 32 - bitCount;
+	}
+	return result;
+}
+
+static void decode_reference(uint8_t *buffer, long bytes, int bits, int samples,
+	kiss_fft_cpx *xp, kiss_fft_cpx *yp, kiss_fft_cpx *x)
+{
+	for (long i = 0; i < bytes / 2; ++i)
+	{
+		uint8_t temp = buffer[bytes - 1 - i];
+		buffer[bytes - 1 - i] = buffer[i];
+		buffer[i] = temp;
+	}
+	long bitOffset = bytes * 8 - (long)samples * 6 * bits;
+	for (int index = samples - 1; index >= 0; --index)
+	{
+		x[index].i = ReadBitStream(buffer, bitOffset, bits, true); bitOffset += bits;
+		x[index].r = ReadBitStream(buffer, bitOffset, bits, true); bitOffset += bits;
+	}
+	for (int index = samples - 1; index >= 0; --index)
+	{
+		yp[index].i = ReadBitStream(buffer, bitOffset, bits, true); bitOffset += bits;
+		yp[index].r = ReadBitStream(buffer, bitOffset, bits, true); bitOffset += bits;
+		xp[index].i = ReadBitStream(buffer, bitOffset, bits, true); bitOffset += bits;
+		xp[index].r = ReadBitStream(buffer, bitOffset, bits, true); bitOffset += bits;
+	}
+}
+
+static void decode_fast(const uint8_t *buffer, long bytes, int bits, int samples,
+	kiss_fft_cpx *xp, kiss_fft_cpx *yp, kiss_fft_cpx *x)
+{
+	packed_samples::unpack_cpx(buffer, bytes, bits, 0, 4, samples, xp);
+	packed_samples::unpack_cpx(buffer, bytes, bits, 2, 4, samples, yp);
+	packed_samples::unpack_cpx(buffer, bytes, bits, 4L * samples, 2, samples, x);
+}
+
+int main(int argc, char **argv)
+{
+	const int samples = 16384;
+	int repeat = (argc > 1) ? atoi(argv[1]) : 20;
+	int widths[] = { 12, 14, 16 };
+	int failed = 0;
+
+	for (int w = 0; w < 3; w++)
+	{
+		int bits = widths[w];
+		long bytes = (long)((samples * 6 * bits) / 8.0 + 0.5);
+		vector<uint8_t> capture(bytes), work(bytes);
+		srand(bits);
+		for (long i = 0; i < bytes; i++) capture[i] = rand() & 0xFF;
+
+		vector<kiss_fft_cpx> xp0(samples), yp0(samples), x0(samples);
+		vector<kiss_fft_cpx> xp1(samples), yp1(samples), x1(samples);
+
+		double tRef = 1e30, tFast = 1e30;
+		for (int r = 0; r < repeat; r++)
+		{
+			memcpy(&work[0], &capture[0], bytes);
+			chrono::high_resolution_clock::time_point t0 = chrono::high_resolution_clock::now();
+			decode_reference(&work[0], bytes, bits, samples, &xp0[0], &yp0[0], &x0[0]);
+			chrono::high_resolution_clock::time_point t1 = chrono::high_resolution_clock::now();
+			decode_fast(&capture[0], bytes, bits, samples, &xp1[0], &yp1[0], &x1[0]);
+			chrono::high_resolution_clock::time_point t2 = chrono::high_resolution_clock::now();
+			double a = chrono::duration<double, micro>(t1 - t0).count();
+			double b = chrono::duration<double, micro>(t2 - t1).count();
+			if (a < tRef) tRef = a;
+			if (b < tFast) tFast = b;
+		}
+
+		int mismatches = 0;
+		for (int i = 0; i < samples; i++)
+		{
+			if (xp0[i].r != xp1[i].r || xp0[i].i != xp1[i].i) mismatches++;
+			if (yp0[i].r != yp1[i].r || yp0[i].i != yp1[i].i) mismatches++;
+			if (x0[i].r != x1[i].r || x0[i].i != x1[i].i) mismatches++;
+		}
+		failed += mismatches;
+		printf("%2d bit: ReadBitStream %9.1f us, unpack_cpx %8.1f us, x%5.1f, mismatches %d\n",
+			bits, tRef, tFast, tRef / tFast, mismatches);
+	}
+	return failed ? 1 : 0;
+}
@@ -8,6 +8,7 @@
 #include <sstream>
 #include <ciso646>
 #include <cmath>
+#include <algorithm>
 #ifndef __unix__
     #include <Windows.h>
     #include <Shlobj.h>
@@ -21,6 +22,30 @@ static const char* cacheFilename = "LMS7002M_cache_values.db";
 
 int CalibrationCache::instanceCount = 0;
 sqlite3* CalibrationCache::db = nullptr;
+sqlite3_stmt* CalibrationCache::selectStatements[TABLE_COUNT] = {nullptr};
+sqlite3_stmt* CalibrationCache::insertStatements[TABLE_COUNT] = {nullptr};
+std::map<uint32_t, std::vector<CalibrationCache::Rows> > CalibrationCache::boards;
+std::vector<CalibrationCache::PendingWrite> CalibrationCache::pendingWrites;
+std::mutex CalibrationCache::lock;
+
+//columns after boardID: frequency, channel, transmitter, id if the table has one, values
+static const struct
+{
+    const char *select;
+    const char *insert;
+    bool hasId;
+    int valueCount;
+} tableQueries[] = {
+    {"SELECT frequency, channel, transmitter, vco, csw FROM LMS7002M_VCO WHERE boardID=?1;",
+     "INSERT OR REPLACE INTO LMS7002M_VCO (boardID, frequency, channel, transmitter, vco, csw) "
+     "VALUES (?1, ?2, ?3, ?4, ?5, ?6);", false, 2},
+    {"SELECT frequency, channel, transmitter, band_lna, dcI, dcQ, gainI, gainQ, phaseOffset FROM LMS7002M_DC_IQ WHERE boardID=?1;",
+     "INSERT OR REPLACE INTO LMS7002M_DC_IQ (boardID, frequency, channel, transmitter, band_lna, dcI, dcQ, gainI, gainQ, phaseOffset) "
+     "VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9, ?10);", true, 5},
+    {"SELECT bandwidth, channel, transmitter, filter_id, rcal, ccal, cfb FROM LMS7002M_FILTER_RC WHERE boardID=?1;",
+     "INSERT OR REPLACE INTO LMS7002M_FILTER_RC (boardID, bandwidth, channel, transmitter, filter_id, rcal, ccal, cfb) "
+     "VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8);", true, 3},
+};
 
 static inline double linearInterp(double x, double x0, double y0, double x1, double y1)
 {
@@ -73,12 +98,16 @@ CalibrationCache::CalibrationCache()
             initializeDatabase();
         }
         printf("LMS7002M values cache at %s\n", cachePath.c_str());
-    }
-    int rc = sqlite3_open(cachePath.c_str(), &db);
-    if( rc )
-    {
-        fprintf(stderr, "Can't open database: %s\n", sqlite3_errmsg(db));
-        sqlite3_close(db);
+
+        int rc = sqlite3_open(cachePath.c_str(), &db);
+        if( rc )
+        {
+            fprintf(stderr, "Can't open database: %s\n", sqlite3_errmsg(db));
+            sqlite3_close(db);
+            db = nullptr;
+        }
+        else
+            prepareStatements();
     }
     ++instanceCount;
 }
@@ -87,7 +116,20 @@ CalibrationCache::~CalibrationCache()
 {
     --instanceCount;
     if(instanceCount == 0)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        flush();
+        for (int i = 0; i < TABLE_COUNT; ++i)
+        {
+            sqlite3_finalize(selectStatements[i]);
+            sqlite3_finalize(insertStatements[i]);
+            selectStatements[i] = insertStatements[i] = nullptr;
+        }
         sqlite3_close(db);
+        db = nullptr;
+        boards.clear();
+        pendingWrites.clear();
+    }
 }
 
 /** @brief Creates database tables
@@ -158,303 +200,324 @@ cmd.push_back(
     return 0;
 }
 
-int CalibrationCache::InsertVCO_CSW(uint32_t boardId, double frequency, uint8_t channel, bool transmitter, int vco, int csw)
+bool CalibrationCache::Entry::operator<(const Entry &other) const
 {
-    char* zErrMsg = 0;
-    stringstream query;
-    query <<
-"INSERT OR REPLACE INTO LMS7002M_VCO (boardID, frequency, channel, transmitter, vco, csw) " <<
-"VALUES ( " << boardId << "," << std::llrint(frequency) << "," << (int)channel << "," << (transmitter?1:0) << "," <<vco<<","<<csw<<");";
+    if (channel != other.channel)
+        return channel < other.channel;
+    if (transmitter != other.transmitter)
+        return transmitter < other.transmitter;
+    if (id != other.id)
+        return id < other.id;
+    return frequency < other.frequency;
+}
 
-    int rc = sqlite3_exec(db, query.str().c_str(), nullptr, 0, &zErrMsg);
-    if( rc != SQLITE_OK )
+bool CalibrationCache::Entry::SameGroup(const Entry &other) const
+{
+    return channel == other.channel && transmitter == other.transmitter && id == other.id;
+}
+
+CalibrationCache::Entry CalibrationCache::makeKey(double frequency, uint8_t channel, bool transmitter, int id)
+{
+    Entry key;
+    key.channel = channel;
+    key.transmitter = transmitter;
+    key.id = id;
+    key.frequency = std::llrint(frequency);
+    for (int &value : key.values)
+        value = 0;
+    return key;
+}
+
+/** @brief Prepares the select and insert statements of the tables
+*/
+int CalibrationCache::prepareStatements()
+{
+    for (int i = 0; i < TABLE_COUNT; ++i)
     {
-        fprintf(stderr, "SQL error: %s\n", zErrMsg);
-        sqlite3_free(zErrMsg);
-        return -1;
+        if (sqlite3_prepare_v2(db, tableQueries[i].select, -1, &selectStatements[i], nullptr) != SQLITE_OK
+            || sqlite3_prepare_v2(db, tableQueries[i].insert, -1, &insertStatements[i], nullptr) != SQLITE_OK)
+        {
+            fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(db));
+            return -1;
+        }
     }
     return 0;
 }
 
-int CalibrationCache::GetVCO_CSW(uint32_t boardId, double frequency, uint8_t channel, bool transmitter, int *vco, int *csw)
+/** @brief Reads all values of the board from the database into sorted tables
+*/
+int CalibrationCache::loadBoard(uint32_t boardId, Rows *tables)
 {
-    struct QueryVCO_CSW
+    int status = 0;
+    for (int i = 0; i < TABLE_COUNT; ++i)
     {
-        QueryVCO_CSW() : vco(0), csw(0), found(false){};
-        int vco;
-        int csw;
-        bool found;
-    };
+        sqlite3_stmt *stmt = selectStatements[i];
+        if (stmt == nullptr)
+        {
+            status = -1;
+            continue;
+        }
+        const int idColumns = tableQueries[i].hasId ? 1 : 0;
+        sqlite3_bind_int64(stmt, 1, boardId);
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+        {
+            Entry entry = makeKey(0, sqlite3_column_int(stmt, 1), sqlite3_column_int(stmt, 2) != 0,
+                idColumns ? sqlite3_column_int(stmt, 3) : 0);
+            entry.frequency = sqlite3_column_int64(stmt, 0);
+            for (int v = 0; v < tableQueries[i].valueCount; ++v)
+            {
+                const int column = 3 + idColumns + v;
+                if (sqlite3_column_type(stmt, column) != SQLITE_NULL)
+                    entry.values[v] = sqlite3_column_int(stmt, column);
+                else if (i == TABLE_VCO && v == 1)
+                    entry.values[v] = 128; //CSW
+            }
+            tables[i].push_back(entry);
+        }
+        if (rc != SQLITE_DONE)
+        {
+            fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg(db));
+            status = -1;
+        }
+        sqlite3_reset(stmt);
+        std::sort(tables[i].begin(), tables[i].end());
+    }
+    return status;
+}
 
-auto lambda_callback = [](void *vco_csw_pair, int argc, char **argv, char **azColName)
+CalibrationCache::Rows &CalibrationCache::rows(uint32_t boardId, Table table)
 {
-    QueryVCO_CSW *vco_csw = (QueryVCO_CSW*)vco_csw_pair;
-    if(vco_csw != nullptr)
+    auto iter = boards.find(boardId);
+    if (iter == boards.end())
     {
-        vco_csw->vco = argv[0] != nullptr ? std::stoi(argv[0]) : 0;
-        vco_csw->csw = argv[1] != nullptr ? std::stoi(argv[1]) : 128;
-        vco_csw->found = true;
-        return 0;
+        iter = boards.insert(std::make_pair(boardId, std::vector<Rows>(TABLE_COUNT))).first;
+        loadBoard(boardId, &iter->second[0]);
     }
-    return 1;
-};
+    return iter->second[table];
+}
+
+const CalibrationCache::Entry *CalibrationCache::find(uint32_t boardId, Table table, const Entry &key)
+{
+    const Rows &values = rows(boardId, table);
+    auto iter = std::lower_bound(values.begin(), values.end(), key);
+    if (iter == values.end() || key < *iter)
+        return nullptr;
+    return &*iter;
+}
 
-    QueryVCO_CSW vco_csw_pair;
+int CalibrationCache::insert(Table table, uint32_t boardId, const Entry &entry)
+{
+    Rows &values = rows(boardId, table);
+    auto iter = std::lower_bound(values.begin(), values.end(), entry);
+    if (iter != values.end() && !(entry < *iter))
+        *iter = entry;
+    else
+        values.insert(iter, entry);
+
+    PendingWrite write;
+    write.table = table;
+    write.boardId = boardId;
+    write.entry = entry;
+    pendingWrites.push_back(write);
+    if (pendingWrites.size() >= WRITE_BATCH)
+        return flush();
+    return 0;
+}
 
+/** @brief Writes the pending inserts in one transaction
+    @return 0 when all pending inserts are stored, they stay pending otherwise
+*/
+int CalibrationCache::flush()
+{
+    if (pendingWrites.empty())
+        return 0;
+    if (db == nullptr)
+    {
+        const int count = int(pendingWrites.size());
+        pendingWrites.clear();
+        return ReportError("CalibrationCache: database is not open, %d values not stored", count);
+    }
     char* zErrMsg = 0;
-    stringstream query;
-    query << "SELECT vco, csw FROM LMS7002M_VCO where "<<
-"boardID="<<boardId<<
-" AND frequency="<<std::llrint(frequency)<<
-" AND channel="<<(int)channel<<
-" AND transmitter="<<(transmitter?1:0)<<";";
-
-    int rc = sqlite3_exec(db, query.str().c_str(), lambda_callback, &vco_csw_pair, &zErrMsg);
+    int rc = sqlite3_exec(db, "BEGIN TRANSACTION;", nullptr, 0, &zErrMsg);
+    for (const PendingWrite &write : pendingWrites)
+    {
+        if (rc != SQLITE_OK)
+            break;
+        sqlite3_stmt *stmt = insertStatements[write.table];
+        if (stmt == nullptr)
+        {
+            //statement was not prepared, nothing of the batch is stored
+            zErrMsg = sqlite3_mprintf("insert statement of table %d is not prepared", int(write.table));
+            rc = SQLITE_ERROR;
+            break;
+        }
+        const Entry &entry = write.entry;
+        int column = 1;
+        sqlite3_bind_int64(stmt, column++, write.boardId);
+        sqlite3_bind_int64(stmt, column++, entry.frequency);
+        sqlite3_bind_int(stmt, column++, entry.channel);
+        sqlite3_bind_int(stmt, column++, entry.transmitter ? 1 : 0);
+        if (tableQueries[write.table].hasId)
+            sqlite3_bind_int(stmt, column++, entry.id);
+        for (int v = 0; v < tableQueries[write.table].valueCount; ++v)
+            sqlite3_bind_int(stmt, column++, entry.values[v]);
+        rc = sqlite3_step(stmt) == SQLITE_DONE ? SQLITE_OK : SQLITE_ERROR;
+        sqlite3_reset(stmt);
+    }
+    if (rc == SQLITE_OK)
+        rc = sqlite3_exec(db, "COMMIT;", nullptr, 0, &zErrMsg);
     if( rc != SQLITE_OK )
     {
-        fprintf(stderr, "SQL error: %s\n", zErrMsg);
+        //the writes stay waiting for the next flush
+        fprintf(stderr, "SQL error: %s\n", zErrMsg ? zErrMsg : sqlite3_errmsg(db));
         sqlite3_free(zErrMsg);
-        return -1;
+        sqlite3_exec(db, "ROLLBACK;", nullptr, 0, nullptr);
+        return ReportError("CalibrationCache: failed to write %d values to the database", int(pendingWrites.size()));
     }
-    if(not vco_csw_pair.found)
+    pendingWrites.clear();
+    return 0;
+}
+
+int CalibrationCache::Flush()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return flush();
+}
+
+int CalibrationCache::InsertVCO_CSW(uint32_t boardId, double frequency, uint8_t channel, bool transmitter, int vco, int csw)
+{
+    Entry entry = makeKey(frequency, channel, transmitter, 0);
+    entry.values[0] = vco;
+    entry.values[1] = csw;
+    std::lock_guard<std::mutex> guard(lock);
+    return insert(TABLE_VCO, boardId, entry);
+}
+
+int CalibrationCache::GetVCO_CSW(uint32_t boardId, double frequency, uint8_t channel, bool transmitter, int *vco, int *csw)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    const Entry *entry = find(boardId, TABLE_VCO, makeKey(frequency, channel, transmitter, 0));
+    if(entry == nullptr)
         return -1;
     if(vco)
-        *vco = vco_csw_pair.vco;
+        *vco = entry->values[0];
     if(csw)
-        *csw = vco_csw_pair.csw;
+        *csw = entry->values[1];
     return 0;
 }
 
 int CalibrationCache::InsertDC_IQ(uint32_t boardId, double frequency, uint8_t channel, bool transmitter, int band_lna, int dcI, int dcQ, int gainI, int gainQ, int phaseOffset)
 {
-    char* zErrMsg = 0;
-    stringstream query;
-    query <<
-"INSERT OR REPLACE INTO LMS7002M_DC_IQ (boardID, frequency, channel, transmitter, band_lna, dcI, dcQ, gainI, gainQ, phaseOffset) " <<
-"VALUES ( " << boardId << "," << std::llrint(frequency) << "," << (int)channel << "," << (transmitter?1:0) << "," << band_lna << ", " <<
-dcI<<","<<dcQ<<","<<gainI<<","<<gainQ<<","<<phaseOffset<<");";
-
-    int rc = sqlite3_exec(db, query.str().c_str(), nullptr, 0, &zErrMsg);
-    if( rc != SQLITE_OK )
-    {
-        fprintf(stderr, "SQL error: %s\n", zErrMsg);
-        sqlite3_free(zErrMsg);
-        return -1;
-    }
-    return 0;
+    Entry entry = makeKey(frequency, channel, transmitter, band_lna);
+    entry.values[0] = dcI;
+    entry.values[1] = dcQ;
+    entry.values[2] = gainI;
+    entry.values[3] = gainQ;
+    entry.values[4] = phaseOffset;
+    std::lock_guard<std::mutex> guard(lock);
+    return insert(TABLE_DC_IQ, boardId, entry);
 }
 
 int CalibrationCache::GetDC_IQ(uint32_t boardId, double frequency, uint8_t channel, bool transmitter, int band_lna, int *dcI, int *dcQ, int *gainI, int *gainQ, int *phaseOffset)
 {
-    struct QueryDC_IQ
-    {
-        QueryDC_IQ() : dcI(0), dcQ(0), gainI(0), gainQ(0), phaseOffset(0), found(false){};
-        int dcI;
-        int dcQ;
-        int gainI;
-        int gainQ;
-        int phaseOffset;
-        bool found;
-    };
-
-    auto lambda_callback = [](void *dc_iq_data, int argc, char **argv, char **azColName)
+    std::unique_lock<std::mutex> guard(lock);
+    const Entry *entry = find(boardId, TABLE_DC_IQ, makeKey(frequency, channel, transmitter, band_lna));
+    if(entry == nullptr)
     {
-        QueryDC_IQ *data = (QueryDC_IQ*)dc_iq_data;
-        if(data != nullptr)
-        {
-            data->dcI = argv[0] != nullptr ? std::stoi(argv[0]) : 0;
-            data->dcQ = argv[1] != nullptr ? std::stoi(argv[1]) : 0;
-            data->gainI = argv[2] != nullptr ? std::stoi(argv[2]) : 0;
-            data->gainQ = argv[3] != nullptr ? std::stoi(argv[3]) : 0;
-            data->phaseOffset = argv[4] != nullptr ? std::stoi(argv[4]) : 0;
-            data->found = true;
-            return 0;
-        }
-        return 1;
-    };
-
-    QueryDC_IQ queryResults;
-
-    char* zErrMsg = 0;
-    stringstream query;
-    query << "SELECT dcI, dcQ, gainI, gainQ, phaseOffset FROM LMS7002M_DC_IQ where "<<
-"boardID="<<boardId<<
-" AND frequency="<<std::llrint(frequency)<<
-" AND channel="<<(int)channel<<
-" AND transmitter="<<(transmitter?1:0)<<
-" AND band_lna="<<band_lna<<
-";";
-
-    int rc = sqlite3_exec(db, query.str().c_str(), lambda_callback, &queryResults, &zErrMsg);
-    if( rc != SQLITE_OK )
-    {
-        fprintf(stderr, "SQL error: %s\n", zErrMsg);
-        sqlite3_free(zErrMsg);
-        return -1;
-    }
-    if(not queryResults.found)
+        guard.unlock();
         return ReportError("GetDC_IQ(%g MHz, ch=%d, tx=%d): cannot find match", frequency/1e6, int(channel), transmitter);
+    }
     if(dcI)
-        *dcI = queryResults.dcI;
+        *dcI = entry->values[0];
     if(dcQ)
-        *dcQ = queryResults.dcQ;
+        *dcQ = entry->values[1];
     if(gainI)
-        *gainI = queryResults.gainI;
+        *gainI = entry->values[2];
     if(gainQ)
-        *gainQ = queryResults.gainQ;
+        *gainQ = entry->values[3];
     if(phaseOffset)
-        *phaseOffset = queryResults.phaseOffset;
+        *phaseOffset = entry->values[4];
     return 0;
 }
 
 int CalibrationCache::GetDC_IQ_Interp(uint32_t boardId, double frequency, uint8_t channel, bool transmitter, int band_lna, int *dcI, int *dcQ, int *gainI, int *gainQ, int *phaseOffset)
 {
-    std::vector<double> closeFreqs;
-
-    auto lambda_callback = [](void *data, int argc, char **argv, char **azColName)
-    {
-        std::vector<double> *data_freqs = (std::vector<double>*)data;
-        if(data != nullptr)
-        {
-            for (size_t i = 0; i < argc; i++)
-            {
-                if (argv[i] == nullptr) continue;
-                data_freqs->push_back(double(std::stoll(argv[i])));
-            }
-            return 0;
-        }
-        return 1;
-    };
-
-    char* zErrMsg = 0;
-    stringstream query;
-    query << "SELECT min(frequency) as freq FROM LMS7002M_DC_IQ where "<<
-"boardID="<<boardId<<
-" AND frequency >= "<<std::llrint(frequency)<<
-" AND frequency < "<<std::llrint(frequency + 1e6)<<
-" AND channel="<<(int)channel<<
-" AND transmitter="<<(transmitter?1:0)<<
-" AND band_lna="<<band_lna<<
-" UNION SELECT max(frequency) as freq FROM LMS7002M_DC_IQ where "<<
-"boardID="<<boardId<<
-" AND frequency <= "<<std::llrint(frequency)<<
-" AND frequency > "<<std::llrint(frequency - 1e6)<<
-" AND channel="<<(int)channel<<
-" AND transmitter="<<(transmitter?1:0)<<
-" AND band_lna="<<band_lna<<
-";";
-
-    int rc = sqlite3_exec(db, query.str().c_str(), lambda_callback, &closeFreqs, &zErrMsg);
-    if( rc != SQLITE_OK )
-    {
-        fprintf(stderr, "SQL error: %s\n", zErrMsg);
-        ReportError("SQL error: %s", zErrMsg);
-        sqlite3_free(zErrMsg);
-        return -1;
-    }
+    std::unique_lock<std::mutex> guard(lock);
+    const Rows &values = rows(boardId, TABLE_DC_IQ);
+    const Entry key = makeKey(frequency, channel, transmitter, band_lna);
+
+    //closest frequencies within 1 MHz at and above, at and below
+    std::vector<const Entry*> close;
+    auto above = std::lower_bound(values.begin(), values.end(), key);
+    if (above != values.end() && above->SameGroup(key) && above->frequency < std::llrint(frequency + 1e6))
+        close.push_back(&*above);
+    auto below = std::upper_bound(values.begin(), values.end(), key);
+    if (below != values.begin() && (--below)->SameGroup(key) && below->frequency > std::llrint(frequency - 1e6)
+        && (close.empty() || close.front() != &*below))
+        close.insert(close.begin(), &*below);
 
     //found only one match, but its very close within margin
-    if (closeFreqs.size() == 1 and std::abs(closeFreqs.front()-frequency) <= 100)
+    if (close.size() == 1 and std::abs(close.front()->frequency - frequency) <= 100)
     {
-        return GetDC_IQ(boardId, closeFreqs.front(), channel, transmitter, band_lna, dcI, dcQ, gainI, gainQ, phaseOffset);
+        const Entry &entry = *close.front();
+        if(dcI)
+            *dcI = entry.values[0];
+        if(dcQ)
+            *dcQ = entry.values[1];
+        if(gainI)
+            *gainI = entry.values[2];
+        if(gainQ)
+            *gainQ = entry.values[3];
+        if(phaseOffset)
+            *phaseOffset = entry.values[4];
+        return 0;
     }
 
     //otherwise check for two results to perform interp
-    if (closeFreqs.size() != 2) return ReportError(
-        "GetDC_IQ_Interp(%g MHz, ch=%d, tx=%d): no matches between [%g, %g] MHz",
-        frequency/1e6, int(channel), transmitter, frequency/1e6-1, frequency/1e6+1);
+    if (close.size() != 2)
+    {
+        guard.unlock();
+        return ReportError(
+            "GetDC_IQ_Interp(%g MHz, ch=%d, tx=%d): no matches between [%g, %g] MHz",
+            frequency/1e6, int(channel), transmitter, frequency/1e6-1, frequency/1e6+1);
+    }
 
     //perform interpolation
-    double f0 = closeFreqs[0];
-    double f1 = closeFreqs[1];
-    int dcI0, dcQ0, gainI0, gainQ0, phaseOffset0;
-    int dcI1, dcQ1, gainI1, gainQ1, phaseOffset1;
-
-    rc = GetDC_IQ(boardId, f0, channel, transmitter, band_lna, &dcI0, &dcQ0, &gainI0, &gainQ0, &phaseOffset0);
-    if (rc != 0) return rc;
-
-    rc = GetDC_IQ(boardId, f1, channel, transmitter, band_lna, &dcI1, &dcQ1, &gainI1, &gainQ1, &phaseOffset1);
-    if (rc != 0) return rc;
-
-    *dcI = std::rint(linearInterp(frequency, f0, dcI0, f1, dcI1));
-    *dcQ = std::rint(linearInterp(frequency, f0, dcQ0, f1, dcQ1));
-    *gainI = std::rint(linearInterp(frequency, f0, gainI0, f1, gainI1));
-    *gainQ = std::rint(linearInterp(frequency, f0, gainQ0, f1, gainQ1));
-    *phaseOffset = std::rint(linearInterp(frequency, f0, phaseOffset0, f1, phaseOffset1));
+    const double f0 = close[0]->frequency;
+    const double f1 = close[1]->frequency;
+    const int *v0 = close[0]->values;
+    const int *v1 = close[1]->values;
+    *dcI = std::rint(linearInterp(frequency, f0, v0[0], f1, v1[0]));
+    *dcQ = std::rint(linearInterp(frequency, f0, v0[1], f1, v1[1]));
+    *gainI = std::rint(linearInterp(frequency, f0, v0[2], f1, v1[2]));
+    *gainQ = std::rint(linearInterp(frequency, f0, v0[3], f1, v1[3]));
+    *phaseOffset = std::rint(linearInterp(frequency, f0, v0[4], f1, v1[4]));
 
     return 0;
 }
 
 int CalibrationCache::InsertFilter_RC(uint32_t boardId, double bandwidth, uint8_t channel, bool transmitter, int filter_id, int rcal, int ccal, int cfb)
 {
-    char* zErrMsg = 0;
-    stringstream query;
-    query <<
-"INSERT OR REPLACE INTO LMS7002M_FILTER_RC (boardID, bandwidth, channel, transmitter, filter_id, rcal, ccal, cfb) " <<
-"VALUES ( " << boardId << "," << std::llrint(bandwidth) << "," << (int)channel << "," << (transmitter?1:0) << "," << filter_id << ", " <<
-rcal<<","<<ccal<<","<<cfb<<");";
-
-    int rc = sqlite3_exec(db, query.str().c_str(), nullptr, 0, &zErrMsg);
-    if( rc != SQLITE_OK )
-    {
-        fprintf(stderr, "SQL error: %s\n", zErrMsg);
-        sqlite3_free(zErrMsg);
-        return -1;
-    }
-    return 0;
+    Entry entry = makeKey(bandwidth, channel, transmitter, filter_id);
+    entry.values[0] = rcal;
+    entry.values[1] = ccal;
+    entry.values[2] = cfb;
+    std::lock_guard<std::mutex> guard(lock);
+    return insert(TABLE_FILTER_RC, boardId, entry);
 }
 
 int CalibrationCache::GetFilter_RC(uint32_t boardId, double bandwidth, uint8_t channel, bool transmitter, int filter_id, int *rcal, int *ccal, int *cfb)
 {
-    struct QueryFilter_RC
-    {
-        QueryFilter_RC() : rcal(0), ccal(0), cfb(0), found(false){};
-        int rcal;
-        int ccal;
-        int cfb;
-        bool found;
-    };
-
-    auto lambda_callback = [](void *filter_rc_data, int argc, char **argv, char **azColName)
-    {
-        QueryFilter_RC *data = (QueryFilter_RC*)filter_rc_data;
-        if(data != nullptr)
-        {
-            data->rcal = argv[0] != nullptr ? std::stoi(argv[0]) : 0;
-            data->ccal = argv[1] != nullptr ? std::stoi(argv[1]) : 0;
-            data->cfb = argv[2] != nullptr ? std::stoi(argv[2]) : 0;
-            data->found = true;
-            return 0;
-        }
-        return 1;
-    };
-
-    QueryFilter_RC queryResults;
-
-    char* zErrMsg = 0;
-    stringstream query;
-    query << "SELECT rcal, ccal, cfb FROM LMS7002M_FILTER_RC where "<<
-"boardID="<<boardId<<
-" AND bandwidth="<<std::llrint(bandwidth)<<
-" AND channel="<<(int)channel<<
-" AND transmitter="<<(transmitter?1:0)<<
-" AND filter_id="<<filter_id<<
-";";
-
-    int rc = sqlite3_exec(db, query.str().c_str(), lambda_callback, &queryResults, &zErrMsg);
-    if( rc != SQLITE_OK )
-    {
-        fprintf(stderr, "SQL error: %s\n", zErrMsg);
-        sqlite3_free(zErrMsg);
-        return -1;
-    }
-    if(not queryResults.found)
+    std::lock_guard<std::mutex> guard(lock);
+    const Entry *entry = find(boardId, TABLE_FILTER_RC, makeKey(bandwidth, channel, transmitter, filter_id));
+    if(entry == nullptr)
         return -1;
     if(rcal)
-        *rcal = queryResults.rcal;
+        *rcal = entry->values[0];
     if(ccal)
-        *ccal = queryResults.ccal;
+        *ccal = entry->values[1];
     if(cfb)
-        *cfb = queryResults.cfb;
+        *cfb = entry->values[2];
     return 0;
 }
@@ -4,10 +4,25 @@
 #include <stdint.h>
 #include <list>
 #include <sstream>
+#include <vector>
+#include <map>
+#include <mutex>
 #include <sqlite3.h>
 namespace lime
 {
 
+/** @brief Calibration values of the LMS7002M kept in an SQLite database.
+
+    The values of a board are read from the database on its first use and kept in
+    memory, sorted by channel, direction, band/LNA or filter and frequency, so
+    lookups do not touch the database. Inserts update the memory copy at once and
+    are written to the database with prepared statements, in one transaction per
+    batch: on Flush(), every WRITE_BATCH inserts and when the last instance is
+    destroyed. Callers that need the values stored call Flush() after inserting.
+    A batch that fails stays waiting, the insert that started it and every later
+    Flush() return the failure until it is written. Changes made to the database
+    by other processes are not seen.
+*/
 class CalibrationCache
 {
 public:
@@ -24,12 +39,59 @@ public:
     int InsertFilter_RC(uint32_t boardId, double bandwidth, uint8_t channel, bool transmitter, int filter_id, int rcal, int ccal, int cfb = 0);
     int GetFilter_RC(uint32_t boardId, double bandwidth, uint8_t channel, bool transmitter, int filter_id, int *rcal, int *ccal, int *cfb = nullptr);
 
+    //! Writes the pending inserts to the database, @return 0 when all are stored
+    int Flush();
+
+    static const size_t WRITE_BATCH = 64;
+
 protected:
+    enum Table
+    {
+        TABLE_VCO,
+        TABLE_DC_IQ,
+        TABLE_FILTER_RC,
+        TABLE_COUNT
+    };
+
+    //! Row of a table, ordered by channel, transmitter, id and frequency
+    struct Entry
+    {
+        uint8_t channel;
+        bool transmitter;
+        int id; //band_lna, filter_id
+        int64_t frequency; //frequency, bandwidth
+        int values[5];
+
+        bool operator<(const Entry &other) const;
+        bool SameGroup(const Entry &other) const;
+    };
+
+    struct PendingWrite
+    {
+        Table table;
+        uint32_t boardId;
+        Entry entry;
+    };
+
+    typedef std::vector<Entry> Rows;
+
+    static Entry makeKey(double frequency, uint8_t channel, bool transmitter, int id);
     int initializeDatabase();
+    int prepareStatements();
+    Rows &rows(uint32_t boardId, Table table);
+    int loadBoard(uint32_t boardId, Rows *tables);
+    int insert(Table table, uint32_t boardId, const Entry &entry);
+    const Entry *find(uint32_t boardId, Table table, const Entry &key);
+    int flush();
 
     static std::string cachePath;
     static int instanceCount;
     static sqlite3 *db;
+    static sqlite3_stmt *selectStatements[TABLE_COUNT];
+    static sqlite3_stmt *insertStatements[TABLE_COUNT];
+    static std::map<uint32_t, std::vector<Rows> > boards;
+    static std::vector<PendingWrite> pendingWrites;
+    static std::mutex lock;
 };
 
 }
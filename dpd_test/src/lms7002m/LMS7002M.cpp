@@ -68,6 +68,15 @@ void LMS7002M::Log(const char* text, LogType type)
     }
 }
 
+/** @brief Writes the values waiting in the calibration cache to its database,
+    a failure is logged as a warning because the chip settings are already applied
+*/
+void LMS7002M::SaveValuesCache(void)
+{
+    if (valueCache.Flush() != 0)
+        Log("Failed to save calibration values to the cache database", LOG_WARNING);
+}
+
 /** @brief Sets connection which is used for data communication with chip
 */
 void LMS7002M::SetConnection(IConnection* port, const size_t devIndex)
@@ -86,12 +95,15 @@ void LMS7002M::SetConnection(IConnection* port, const size_t devIndex)
 It requires IConnection to be set by SetConnection() to communicate with chip
 */
 LMS7002M::LMS7002M() :
+    useCache(0),
+    mRegistersMap(new LMS7002M_RegistersMap()),
     controlPort(nullptr),
     addrLMS7002M(-1),
     mdevIndex(0),
     mSelfCalDepth(0),
-    mRegistersMap(new LMS7002M_RegistersMap()),
-    useCache(0)
+    mLastVCOTune(),
+    mVCOAdaptiveSettle(false),
+    mTransactionDepth(0)
 {
     mCalibrationByMCU = true;
 
@@ -1006,6 +1018,7 @@ float_type LMS7002M::GetReferenceClk_TSP(bool tx)
 int LMS7002M::SetFrequencyCGEN(const float_type freq_Hz, const bool retainNCOfrequencies)
 {
     LMS7002M_SelfCalState state(this);
+    LMS7002M_Transaction transaction(this);
     float_type dFvco;
     float_type dFrac;
     int16_t iHdiv;
@@ -1058,7 +1071,9 @@ int LMS7002M::SetFrequencyCGEN(const float_type freq_Hz, const bool retainNCOfre
 #ifndef NDEBUG
     printf("CGEN: Freq=%g MHz, VCO=%g GHz, INT=%i, FRAC=%i, DIV_OUTCH_CGEN=%i\n", freq_Hz/1e6, dFvco/1e9, gINT, gFRAC, iHdiv);
 #endif // NDEBUG
-    return TuneVCO(VCO_CGEN);
+    int status = TuneVCO(VCO_CGEN);
+    int commitStatus = transaction.Commit();
+    return (status != 0) ? status : commitStatus;
 }
 
 bool LMS7002M::GetCGENLocked(void)
@@ -1072,7 +1087,152 @@ bool LMS7002M::GetSXLocked(bool tx)
     return (Get_SPI_Reg_bits(VCO_CMPHO.address, 13, 12, true) & 0x3) == 2;
 }
 
+namespace
+{
+//VCO comparators are read once after the fixed settle time
+const std::chrono::microseconds vcoSettleTime(5000);
+//with the adaptive settle they are read after a short wait, and again after waits
+//twice as long until two reads agree, never waiting longer than the fixed settle time
+const std::chrono::microseconds vcoSettleMin(50);
+//distance from a kept CSW within which it is used as the start of the search
+const int vcoSeedRange_MHz = 20;
+//CSW steps tried from a seed before falling back to the full search
+const int vcoSeedMaxSteps = 16;
+
+struct VCOTuner
+{
+    LMS7002M *lms;
+    uint16_t addrCSW;
+    uint8_t msb;
+    uint8_t lsb;
+    uint16_t addrCMP;
+    int steps;
+    int reads;
+    int status; //first failure to send CSW
+    bool adaptiveSettle;
+
+    //Sets CSW and returns the settled comparators value
+    uint8_t Compare(int csw)
+    {
+        lms->Modify_SPI_Reg_bits(addrCSW, msb, lsb, csw);
+        int rc = lms->FlushTransaction(); //settle time starts when the chip has the value
+        if (rc != 0)
+        {
+            if (status == 0)
+                status = rc;
+            return 0;
+        }
+        ++steps;
+        if (not adaptiveSettle)
+        {
+            std::this_thread::sleep_for(vcoSettleTime);
+            return Read();
+        }
+        auto wait = vcoSettleMin;
+        auto waited = wait;
+        std::this_thread::sleep_for(wait);
+        uint8_t cmphl = Read();
+        while (waited < vcoSettleTime)
+        {
+            std::this_thread::sleep_for(wait);
+            waited += wait;
+            uint8_t again = Read();
+            if (again == cmphl)
+                break;
+            cmphl = again;
+            wait *= 2;
+        }
+        return cmphl;
+    }
+
+    uint8_t Read()
+    {
+        ++reads;
+        return (uint8_t)lms->Get_SPI_Reg_bits(addrCMP, 13, 12, true);
+    }
+
+    //Binary search over the CSW bits, then middle of the lock range
+    int Search()
+    {
+        int csw = 0;
+        int csw_lowest = -1;
+        for (int i = 7; i >= 0; --i)
+        {
+            csw |= 1 << i;
+            uint8_t cmphl = Compare(csw);
+            if ((cmphl & 0x01) == 1) // reduce CSW
+                csw &= ~(1 << i);
+            if (cmphl == 2 && csw_lowest < 0)
+                csw_lowest = csw;
+        }
+        if (csw_lowest < 0)
+            return csw;
+        const int csw_highest = csw;
+        if (csw_lowest == csw_highest)
+        {
+            while (csw_lowest >= 0)
+            {
+                if (Compare(csw_lowest) == 0)
+                {
+                    ++csw_lowest;
+                    break;
+                }
+                else
+                    --csw_lowest;
+            }
+        }
+        return csw_lowest + (csw_highest - csw_lowest) / 2;
+    }
+
+    //Lock range around a locked seed. The seed is kept when both neighbours lock,
+    //otherwise the range is walked from the side that does not lock.
+    //Returns -1 when the walk gets too long.
+    int FromSeed(int seed)
+    {
+        const bool lowLocked = seed > 0 && Compare(seed - 1) == 2;
+        const bool highLocked = seed < 255 && Compare(seed + 1) == 2;
+        if (lowLocked && highLocked)
+            return seed;
+        int lo = seed;
+        int hi = seed;
+        if (lowLocked)
+        {
+            lo = seed - 1;
+            while (lo > 0 && seed - lo < vcoSeedMaxSteps && Compare(lo - 1) == 2)
+                --lo;
+        }
+        else if (highLocked)
+        {
+            hi = seed + 1;
+            while (hi < 255 && hi - seed < vcoSeedMaxSteps && Compare(hi + 1) == 2)
+                ++hi;
+        }
+        if (seed - lo >= vcoSeedMaxSteps || hi - seed >= vcoSeedMaxSteps)
+            return -1;
+        return lo + (hi - lo) / 2;
+    }
+};
+}
+
+/** @brief Returns VCO frequency of CLKGEN, SXR or SXT from the register values
+*/
+float_type LMS7002M::GetFrequencyVCO(VCO_Module module)
+{
+    if (module == VCO_CGEN)
+    {
+        uint16_t gINT = Get_SPI_Reg_bits(0x0088, 13, 0);
+        uint32_t gFRAC = ((gINT & 0xF) * 65536) | Get_SPI_Reg_bits(0x0087, 15, 0);
+        return GetReferenceClk_SX(Rx) * ((gINT >> 4) + 1 + gFRAC / 1048576.0);
+    }
+    uint16_t gINT = Get_SPI_Reg_bits(0x011E, 13, 0);
+    uint32_t gFRAC = ((gINT & 0xF) * 65536) | Get_SPI_Reg_bits(0x011D, 15, 0);
+    return GetReferenceClk_SX(module == VCO_SXT) * ((gINT >> 4) + 4 + gFRAC / 1048576.0)
+        * (Get_SPI_Reg_bits(LMS7param(EN_DIV2_DIVPROG)) + 1);
+}
+
 /** @brief Performs VCO tuning operations for CLKGEN, SXR, SXT modules
+    The search starts from the CSW found for the same VCO at the nearest frequency
+    within vcoSeedRange_MHz, otherwise it is a binary search over the CSW bits.
     @param module module selection for tuning 0-cgen, 1-SXR, 2-SXT
     @return 0-success, other-failure
 */
@@ -1080,14 +1240,15 @@ int LMS7002M::TuneVCO(VCO_Module module) // 0-cgen, 1-SXR, 2-SXT
 {
     const char* moduleName = (module == VCO_CGEN) ? "CGEN" : ((module == VCO_SXR) ? "SXR" : "SXT");
     checkConnection();
-	int8_t i;
+    const auto t0 = std::chrono::high_resolution_clock::now();
 	uint8_t cmphl; //comparators
-	int16_t csw_lowest = -1;
 	uint16_t addrVCOpd; // VCO power down address
-	uint16_t addrCSW_VCO;
-	uint16_t addrCMP; //comparator address
-	uint8_t lsb; //SWC lsb index
-	uint8_t msb; //SWC msb index
+    VCOTuner tuner;
+    tuner.lms = this;
+    tuner.steps = 0;
+    tuner.reads = 0;
+    tuner.status = 0;
+    tuner.adaptiveSettle = mVCOAdaptiveSettle;
 
 	Channel ch = this->GetActiveChannel(); //remember used channel
 
@@ -1095,19 +1256,20 @@ int LMS7002M::TuneVCO(VCO_Module module) // 0-cgen, 1-SXR, 2-SXT
 	{
         this->SetActiveChannel(Channel(module));
         addrVCOpd = LMS7param(PD_VCO).address;
-        addrCSW_VCO = LMS7param(CSW_VCO).address;
-        lsb = LMS7param(CSW_VCO).lsb;
-        msb = LMS7param(CSW_VCO).msb;
-        addrCMP = LMS7param(VCO_CMPHO).address;
+        tuner.addrCSW = LMS7param(CSW_VCO).address;
+        tuner.lsb = LMS7param(CSW_VCO).lsb;
+        tuner.msb = LMS7param(CSW_VCO).msb;
+        tuner.addrCMP = LMS7param(VCO_CMPHO).address;
 	}
 	else //set addresses to CGEN module
     {
         addrVCOpd = LMS7param(PD_VCO_CGEN).address;
-        addrCSW_VCO = LMS7param(CSW_VCO_CGEN).address;
-        lsb = LMS7param(CSW_VCO_CGEN).lsb;
-        msb = LMS7param(CSW_VCO_CGEN).msb;
-        addrCMP = LMS7param(VCO_CMPHO_CGEN).address;
+        tuner.addrCSW = LMS7param(CSW_VCO_CGEN).address;
+        tuner.lsb = LMS7param(CSW_VCO_CGEN).lsb;
+        tuner.msb = LMS7param(CSW_VCO_CGEN).msb;
+        tuner.addrCMP = LMS7param(VCO_CMPHO_CGEN).address;
     }
+    LMS7002M_Transaction transaction(this);
 	// Initialization
     int status = Modify_SPI_Reg_bits (addrVCOpd, 2, 1, 0); //activate VCO and comparator
     if(status != 0)
@@ -1118,52 +1280,112 @@ int LMS7002M::TuneVCO(VCO_Module module) // 0-cgen, 1-SXR, 2-SXT
         Modify_SPI_Reg_bits(LMS7param(SPDUP_VCO_CGEN), 1); //SHORT_NOISEFIL=1 SPDUP_VCO_ Short the noise filter resistor to speed up the settling time
 	else
         Modify_SPI_Reg_bits(LMS7param(SPDUP_VCO), 1); //SHORT_NOISEFIL=1 SPDUP_VCO_ Short the noise filter resistor to speed up the settling time
-	Modify_SPI_Reg_bits (addrCSW_VCO , msb, lsb , 0); //Set SWC_VCO<7:0>=<00000000>
 
-	i=7;
-	while(i>=0)
-	{
-        Modify_SPI_Reg_bits (addrCSW_VCO, lsb + i, lsb + i, 1); // CSW_VCO<i>=1
-        std::this_thread::sleep_for(std::chrono::milliseconds(5));
-        cmphl = (uint8_t)Get_SPI_Reg_bits(addrCMP, 13, 12, true);
-        if ( (cmphl&0x01) == 1) // reduce CSW
-            Modify_SPI_Reg_bits (addrCSW_VCO, lsb + i, lsb + i, 0); // CSW_VCO<i>=0
-        if( cmphl == 2 && csw_lowest < 0)
-            csw_lowest = Get_SPI_Reg_bits(addrCSW_VCO, msb, lsb);
-		--i;
-	}
-	if(csw_lowest >= 0)
-    {
-        uint16_t csw_highest = Get_SPI_Reg_bits(addrCSW_VCO, msb, lsb);
-        if(csw_lowest == csw_highest)
+    //CSW of the previous tunes of this VCO
+    const int selVCO = (module == VCO_CGEN) ? 0 : Get_SPI_Reg_bits(LMS7param(SEL_VCO));
+    std::map<int, VCOSeed> &seeds = mVCOSeeds[module][selVCO % 3];
+    const int vco_MHz = int(GetFrequencyVCO(module) / 1e6 + 0.5);
+    int csw = -1;
+    bool seeded = false;
+    //nearest kept CSW on both sides, locked ones first
+    const auto next = seeds.lower_bound(vco_MHz);
+    auto low = seeds.end();
+    auto high = seeds.end();
+    auto outOfRange = seeds.end();
+    for (auto it = next; it != seeds.begin(); )
+    {
+        if (vco_MHz - (--it)->first > vcoSeedRange_MHz)
+            break;
+        if (it->second.locked)
         {
-            while(csw_lowest>=0)
-            {
-                Modify_SPI_Reg_bits(addrCSW_VCO, msb, lsb, csw_lowest);
-                std::this_thread::sleep_for(std::chrono::milliseconds(5));
-                if(Get_SPI_Reg_bits(addrCMP, 13, 12, true) == 0)
-                {
-                    ++csw_lowest;
-                    break;
-                }
-                else
-                    --csw_lowest;
-            }
+            low = it;
+            break;
         }
-        Modify_SPI_Reg_bits(addrCSW_VCO, msb, lsb, csw_lowest+(csw_highest-csw_lowest)/2);
+        if (outOfRange == seeds.end())
+            outOfRange = it;
     }
+    for (auto it = next; it != seeds.end() && it->first - vco_MHz <= vcoSeedRange_MHz; ++it)
+    {
+        if (it->second.locked)
+        {
+            high = it;
+            break;
+        }
+        if (outOfRange == seeds.end() || it->first - vco_MHz < vco_MHz - outOfRange->first)
+            outOfRange = it;
+    }
+    int seed = -1;
+    if (high != seeds.end() && (low == seeds.end() || high->first == vco_MHz))
+        seed = high->second.csw;
+    else if (low != seeds.end() && high == seeds.end())
+        seed = low->second.csw;
+    else if (low != seeds.end())
+        seed = low->second.csw + (high->second.csw - low->second.csw) * (vco_MHz - low->first) / (high->first - low->first);
+    if (seed >= 0)
+    {
+        if (tuner.Compare(seed) == 2)
+            csw = tuner.FromSeed(seed);
+    }
+    else if (outOfRange != seeds.end() && (outOfRange->second.csw == 0 || outOfRange->second.csw == 255))
+    {
+        //a nearby frequency was out of the VCO range, one step shows if this one is too:
+        //comparators still asking for a higher CSW at 255, or a lower one at 0
+        seed = outOfRange->second.csw;
+        cmphl = tuner.Compare(seed);
+        if ((seed == 255 && cmphl == 0) || (seed == 0 && (cmphl & 0x01) == 1))
+            csw = seed;
+        else if (cmphl == 2)
+            csw = tuner.FromSeed(seed);
+    }
+    seeded = (csw >= 0);
+    if (csw < 0)
+        csw = tuner.Search();
+    Modify_SPI_Reg_bits(tuner.addrCSW, tuner.msb, tuner.lsb, csw);
+
     if (module == VCO_CGEN)
         Modify_SPI_Reg_bits(LMS7param(SPDUP_VCO_CGEN), 0); //SHORT_NOISEFIL=1 SPDUP_VCO_ Short the noise filter resistor to speed up the settling time
     else
         Modify_SPI_Reg_bits(LMS7param(SPDUP_VCO), 0); //SHORT_NOISEFIL=1 SPDUP_VCO_ Short the noise filter resistor to speed up the settling time
-    cmphl = (uint8_t)Get_SPI_Reg_bits(addrCMP, 13, 12, true);
+    cmphl = tuner.Read();
     this->SetActiveChannel(ch); //restore previously used channel
+    status = transaction.Commit();
+    if (status == 0)
+        status = tuner.status;
+    if (status != 0)
+        return ReportError(status, "TuneVCO(%s) - failed to write CSW", moduleName);
+
+    VCOSeed &entry = seeds[vco_MHz];
+    entry.csw = csw;
+    entry.locked = (cmphl == 2);
+
+    mLastVCOTune.module = module;
+    mLastVCOTune.duration_ms = std::chrono::duration<float_type, std::milli>(std::chrono::high_resolution_clock::now() - t0).count();
+    mLastVCOTune.steps = tuner.steps;
+    mLastVCOTune.comparatorReads = tuner.reads;
+    mLastVCOTune.seeded = seeded;
+    mLastVCOTune.csw = csw;
 
     if(cmphl == 2) return 0;
 
     return ReportError(EINVAL, "TuneVCO(%s) - failed to lock (cmphl != 2)", moduleName);
 }
 
+/** @brief Returns timing and search statistics of the last VCO tuning
+*/
+LMS7002M::VCOTuneInfo LMS7002M::GetLastVCOTuneInfo(void) const
+{
+    return mLastVCOTune;
+}
+
+/** @brief Forgets the CSW values found by previous VCO tunings
+*/
+void LMS7002M::ResetVCOTuneSeeds(void)
+{
+    for (int m = 0; m < 3; ++m)
+        for (int v = 0; v < 3; ++v)
+            mVCOSeeds[m][v].clear();
+}
+
 /** @brief Returns given parameter value from chip register
     @param param LMS7002M control parameter
     @param fromChip read directly from chip
@@ -1245,6 +1467,7 @@ int LMS7002M::Modify_SPI_Reg_mask(const uint16_t *addr, const uint16_t *masks, c
 int LMS7002M::SetFrequencySX(bool tx, float_type freq_Hz)
 {
     checkConnection();
+    LMS7002M_Transaction transaction(this);
     const uint8_t sxVCO_N = 2; //number of entries in VCO frequencies
     const float_type m_dThrF = 5500e6; //threshold to enable additional divider
     float_type VCOfreq;
@@ -1332,10 +1555,14 @@ int LMS7002M::SetFrequencySX(bool tx, float_type freq_Hz)
     if(useCache && !foundInCache)
     {
         valueCache.InsertVCO_CSW(boardId, freq_Hz, mdevIndex, tx, sel_vco, csw_value);
+        SaveValuesCache();
     }
     Modify_SPI_Reg_bits(LMS7param(SEL_VCO), sel_vco);
     Modify_SPI_Reg_bits(LMS7param(CSW_VCO), csw_value);
     this->SetActiveChannel(ch); //restore used channel
+    int status = transaction.Commit();
+    if (status != 0)
+        return status;
 
     if (canDeliverFrequency == false)
         return ReportError(EINVAL, "SetFrequencySX%s(%g MHz) - cannot deliver frequency", tx?"T":"R", freq_Hz / 1e6);
@@ -1596,9 +1823,46 @@ int LMS7002M::SPI_write_batch(const uint16_t* spiAddr, const uint16_t* spiData,
 
     checkConnection();
 
+    if (mTransactionDepth > 0)
+    {
+        mPendingWrites.insert(mPendingWrites.end(), data.begin(), data.end());
+        return 0;
+    }
     return controlPort->TransactSPI(addrLMS7002M, data.data(), nullptr, cnt);
 }
 
+/** @brief Starts collecting register writes, they are sent at the matching CommitTransaction()
+*/
+void LMS7002M::BeginTransaction(void)
+{
+    mTransactionDepth++;
+}
+
+/** @brief Ends the transaction, the outermost commit sends the collected writes
+    @return 0-success, other-failure
+*/
+int LMS7002M::CommitTransaction(void)
+{
+    if (mTransactionDepth == 0)
+        return 0;
+    if (--mTransactionDepth > 0)
+        return 0;
+    return FlushTransaction();
+}
+
+/** @brief Sends the collected writes in one batch, the transaction stays open
+    @return 0-success, other-failure
+*/
+int LMS7002M::FlushTransaction(void)
+{
+    if (mPendingWrites.empty())
+        return 0;
+    checkConnection();
+    int status = controlPort->TransactSPI(addrLMS7002M, mPendingWrites.data(), nullptr, mPendingWrites.size());
+    mPendingWrites.clear();
+    return status;
+}
+
 /** @brief Batches multiple register reads into least amount of transactions
     @param spiAddr SPI addresses to read
     @param spiData array for read data
@@ -1609,6 +1873,9 @@ int LMS7002M::SPI_read_batch(const uint16_t* spiAddr, uint16_t* spiData, uint16_
 {
     checkConnection();
 
+    int status = FlushTransaction(); //the chip must see the writes made before the read
+    if (status != 0) return status;
+
     std::vector<uint32_t> dataWr(cnt);
     std::vector<uint32_t> dataRd(cnt);
     for (size_t i = 0; i < cnt; ++i)
@@ -1616,7 +1883,7 @@ int LMS7002M::SPI_read_batch(const uint16_t* spiAddr, uint16_t* spiData, uint16_
         dataWr[i] = (uint32_t(spiAddr[i]) << 16);
     }
 
-    int status = controlPort->TransactSPI(addrLMS7002M, dataWr.data(), dataRd.data(), cnt);
+    status = controlPort->TransactSPI(addrLMS7002M, dataWr.data(), dataRd.data(), cnt);
     if (status != 0) return status;
 
     int mac = mRegistersMap->GetValue(0, LMS7param(MAC).address) & 0x0003;
@@ -2009,6 +2276,7 @@ int LMS7002M::SetInterfaceFrequency(float_type cgen_freq_Hz, const uint8_t inter
 {
     int status = 0;
     LMS7002M_SelfCalState state(this);
+    LMS7002M_Transaction transaction(this);
     status = Modify_SPI_Reg_bits(LMS7param(HBD_OVR_RXTSP), decimation);
     if(status != 0)
         return status;
@@ -2058,7 +2326,7 @@ int LMS7002M::SetInterfaceFrequency(float_type cgen_freq_Hz, const uint8_t inter
         Modify_SPI_Reg_bits(LMS7param(MCLK1SRC), mclk1src & 1);
     }
 
-    return status;
+    return transaction.Commit();
 }
 
 float_type LMS7002M::GetSampleRate(bool tx)
@@ -2192,6 +2460,7 @@ void LMS7002M::EnterSelfCalibration(void)
 {
     if (controlPort && mSelfCalDepth == 0)
     {
+        FlushTransaction();
         controlPort->EnterSelfCalibration(this->GetActiveChannelIndex());
     }
     mSelfCalDepth++;
@@ -2201,7 +2470,10 @@ void LMS7002M::ExitSelfCalibration(void)
 {
     mSelfCalDepth--;
     if (controlPort && mSelfCalDepth == 0)
+    {
+        FlushTransaction();
         controlPort->ExitSelfCalibration(this->GetActiveChannelIndex());
+    }
 }
 
 LMS7002M_SelfCalState::LMS7002M_SelfCalState(LMS7002M *rfic):
@@ -2215,6 +2487,27 @@ LMS7002M_SelfCalState::~LMS7002M_SelfCalState(void)
     rfic->ExitSelfCalibration();
 }
 
+LMS7002M_Transaction::LMS7002M_Transaction(LMS7002M *rfic):
+    rfic(rfic),
+    committed(false)
+{
+    rfic->BeginTransaction();
+}
+
+LMS7002M_Transaction::~LMS7002M_Transaction(void)
+{
+    if (!committed)
+        rfic->CommitTransaction();
+}
+
+int LMS7002M_Transaction::Commit(void)
+{
+    if (committed)
+        return 0;
+    committed = true;
+    return rfic->CommitTransaction();
+}
+
 void LMS7002M::EnableValuesCache(bool enabled)
 {
     useCache = enabled;
@@ -2234,3 +2527,13 @@ void LMS7002M::EnableCalibrationByMCU(bool enabled)
 {
     mCalibrationByMCU = enabled;
 }
+
+/** @brief Selects how long TuneVCO() waits for the VCO comparators after each CSW change
+    By default they are read once after the fixed settle time. The adaptive settle reads
+    them after 50 us and stops when two consecutive reads agree, which is faster but
+    can take a comparator that has not settled yet.
+*/
+void LMS7002M::EnableVCOAdaptiveSettle(bool enabled)
+{
+    mVCOAdaptiveSettle = enabled;
+}
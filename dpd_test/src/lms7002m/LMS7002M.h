@@ -12,6 +12,8 @@
 #include <cstdint>
 
 #include <sstream>
+#include <vector>
+#include <map>
 
 namespace lime{
 class IConnection;
@@ -120,6 +122,18 @@ public:
     void ExitSelfCalibration(void);
     ///@}
 
+    ///@name Register write transactions:
+    ///Writes made between begin and commit update the registers cache
+    ///at once, but are sent to the chip as one SPI batch at commit.
+    ///Every write is kept and sent in the order it was made, so strobe
+    ///pulses and MAC changes inside a transaction reach the chip as made.
+    ///Reads from chip, VCO tuning and self calibration enter/exit send
+    ///the waiting writes first. Safe to nest, always match calls.
+    void BeginTransaction(void);
+    int CommitTransaction(void);
+    int FlushTransaction(void);
+    ///@}
+
     ///@name Transmitter, Receiver calibrations
     /*!
      * Store the digital corrections for the current channel.
@@ -276,6 +290,21 @@ public:
         VCO_CGEN, VCO_SXR, VCO_SXT
     };
     int TuneVCO(VCO_Module module);
+    ///Statistics of the last TuneVCO() call
+    struct VCOTuneInfo
+    {
+        VCO_Module module;
+        float_type duration_ms; ///< whole TuneVCO() time
+        int steps; ///< CSW values tried
+        int comparatorReads; ///< comparator reads while settling
+        bool seeded; ///< started from the CSW of the same or a nearby frequency
+        int csw; ///< selected CSW
+    };
+    VCOTuneInfo GetLastVCOTuneInfo(void) const;
+    ///Forgets the CSW values kept from previous tunes
+    void ResetVCOTuneSeeds(void);
+    ///Reads the VCO comparators as soon as two reads agree instead of after the fixed settle time
+    void EnableVCOAdaptiveSettle(bool enabled);
     ///@}
 
     ///@name TSP
@@ -451,6 +480,7 @@ protected:
         LOG_DATA
     };
     virtual void Log(const char* text, LogType type);
+    void SaveValuesCache(void);
 
     ///port used for communicating with LMS7002M
     IConnection* controlPort;
@@ -458,6 +488,19 @@ protected:
     size_t mdevIndex;
     size_t mSelfCalDepth;
 
+    ///CSW of previous tunes by VCO frequency in MHz, for each module and SEL_VCO
+    struct VCOSeed
+    {
+        int16_t csw;
+        bool locked;
+    };
+    std::map<int, VCOSeed> mVCOSeeds[3][3];
+    VCOTuneInfo mLastVCOTune;
+    bool mVCOAdaptiveSettle;
+    float_type GetFrequencyVCO(VCO_Module module);
+    size_t mTransactionDepth;
+    std::vector<uint32_t> mPendingWrites; //SPI words waiting for commit
+
     int LoadConfigLegacyFile(const char* filename);
 };
 
@@ -476,6 +519,25 @@ private:
     LMS7002M *rfic;
 };
 
+/*!
+ * Helper class to begin a register write transaction upon construction,
+ * and to commit it automatically upon exit. Call Commit() to get the
+ * status of the writes, the commit upon exit cannot report it.
+ */
+class LMS7002M_Transaction
+{
+public:
+    LMS7002M_Transaction(LMS7002M *rfic);
+    ~LMS7002M_Transaction(void);
+
+    //! Ends the transaction, @return status of sending the waiting writes
+    int Commit(void);
+
+private:
+    LMS7002M *rfic;
+    bool committed;
+};
+
 
 }
 #endif
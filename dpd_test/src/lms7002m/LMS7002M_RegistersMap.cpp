@@ -1,10 +1,16 @@
 #include "LMS7002M_RegistersMap.h"
 #include "LMS7002M_parameters.h"
+#include <algorithm>
+#include <cstring>
 using namespace lime;
 
 LMS7002M_RegistersMap::LMS7002M_RegistersMap()
 {
-
+    for (int ch = 0; ch < 2; ++ch)
+    {
+        memset(mChannels[ch].table, 0, sizeof(mChannels[ch].table));
+        memset(mChannels[ch].used, 0, sizeof(mChannels[ch].used));
+    }
 }
 
 LMS7002M_RegistersMap::~LMS7002M_RegistersMap()
@@ -12,71 +18,94 @@ LMS7002M_RegistersMap::~LMS7002M_RegistersMap()
 
 }
 
+LMS7002M_RegistersMap::Register &LMS7002M_RegistersMap::Entry(uint8_t channel, uint16_t address)
+{
+    Channel &ch = mChannels[channel];
+    if (address >= TABLE_SIZE)
+    {
+        auto iter = ch.overflow.find(address);
+        if (iter != ch.overflow.end())
+            return iter->second;
+        Register &reg = ch.overflow[address];
+        reg.value = reg.defaultValue = reg.mask = 0;
+        ch.addresses.insert(std::lower_bound(ch.addresses.begin(), ch.addresses.end(), address), address);
+        return reg;
+    }
+    uint32_t &word = ch.used[address/32];
+    const uint32_t bit = 1u << (address%32);
+    if ((word & bit) == 0)
+    {
+        word |= bit;
+        ch.addresses.insert(std::lower_bound(ch.addresses.begin(), ch.addresses.end(), address), address);
+    }
+    return ch.table[address];
+}
+
+const LMS7002M_RegistersMap::Register *LMS7002M_RegistersMap::Find(uint8_t channel, uint16_t address) const
+{
+    if (channel > 1) return nullptr;
+    const Channel &ch = mChannels[channel];
+    if (address < TABLE_SIZE)
+        return (ch.used[address/32] & (1u << (address%32))) ? &ch.table[address] : nullptr;
+    auto iter = ch.overflow.find(address);
+    return (iter != ch.overflow.end()) ? &iter->second : nullptr;
+}
+
+uint16_t LMS7002M_RegistersMap::GetOverflowValue(uint8_t channel, uint16_t address) const
+{
+    const Register *reg = Find(channel, address);
+    return reg ? reg->value : 0;
+}
+
 uint16_t LMS7002M_RegistersMap::GetDefaultValue(uint16_t address) const
 {
-    auto iter = mChannelA.find(address);
-    if( iter != mChannelA.end())
-        return iter->second.defaultValue;
-    else
-        return 0;
+    const Register *reg = Find(0, address);
+    return reg ? reg->defaultValue : 0;
 }
 
 void LMS7002M_RegistersMap::InitializeDefaultValues(const std::vector<const LMS7Parameter*> parameterList)
 {
     for(auto parameter : parameterList)
     {
-        uint16_t regValue = mChannelA[parameter->address].defaultValue;
-        mChannelA[parameter->address].defaultValue = regValue | (parameter->defaultValue << parameter->lsb);
-        mChannelA[parameter->address].value = mChannelA[parameter->address].defaultValue;
+        Register &regA = Entry(0, parameter->address);
+        regA.defaultValue = regA.defaultValue | (parameter->defaultValue << parameter->lsb);
+        regA.value = regA.defaultValue;
         if(parameter->address >= 0x0100)
-            mChannelB[parameter->address].value = mChannelA[parameter->address].value;
+            Entry(1, parameter->address).value = regA.value;
     }
     //add NCO/PHO registers
     const uint16_t addr = 0x0242;
     for (int i = 0; i < 32; ++i)
-    {   
-        mChannelA[addr + i].defaultValue = 0;
-        mChannelA[addr + i].value = 0;
-        mChannelB[addr + i].defaultValue = 0;
-        mChannelB[addr + i].value = 0;
-        mChannelA[addr + i + 0x0200].defaultValue = 0;
-        mChannelA[addr + i + 0x0200].value = 0;
-        mChannelB[addr + i + 0x0200].defaultValue = 0;
-        mChannelB[addr + i + 0x0200].value = 0;
+    {
+        for (uint8_t ch = 0; ch < 2; ++ch)
+        {
+            Register &reg = Entry(ch, addr + i);
+            reg.defaultValue = 0;
+            reg.value = 0;
+            Register &rxReg = Entry(ch, addr + i + 0x0200);
+            rxReg.defaultValue = 0;
+            rxReg.value = 0;
+        }
     }
 }
 
-void LMS7002M_RegistersMap::SetValue(uint8_t channel, const uint16_t address, const uint16_t value)
+const std::vector<uint16_t> &LMS7002M_RegistersMap::GetUsedAddresses(const uint8_t channel) const
 {
-    if(channel == 0)
-        mChannelA[address].value = value;
-    else if(channel == 1)
-        mChannelB[address].value = value;
+    static const std::vector<uint16_t> none;
+    if (channel > 1) return none;
+    return mChannels[channel].addresses;
 }
 
-uint16_t LMS7002M_RegistersMap::GetValue(uint8_t channel, uint16_t address) const
+LMS7002M_RegistersMap &LMS7002M_RegistersMap::operator=(const LMS7002M_RegistersMap &other)
 {
-    const std::map<const uint16_t, Register> *regMap;
-    if(channel == 0)
-        regMap = &mChannelA;
-    else if(channel == 1)
-        regMap = &mChannelB;
-    std::map<const uint16_t, Register>::const_iterator iter;
-    iter = regMap->find(address);
-    if (iter != regMap->end())
-        return iter->second.value;
-    else
-        return 0;
-}
-
-std::vector<uint16_t> LMS7002M_RegistersMap::GetUsedAddresses(const uint8_t channel) const
-{
-    std::vector<uint16_t> addresses;
-    if(channel == 0)
-        for(auto iter : mChannelA)
-            addresses.push_back(iter.first);
-    else if(channel == 1)
-        for(auto iter : mChannelB)
-            addresses.push_back(iter.first);
-    return addresses;
+    if (this == &other) return *this;
+    for (uint8_t ch = 0; ch < 2; ++ch)
+    {
+        for (const uint16_t address : other.mChannels[ch].addresses)
+        {
+            if (Find(ch, address)) continue;
+            Entry(ch, address) = *other.Find(ch, address);
+        }
+    }
+    return *this;
 }
@@ -9,6 +9,13 @@ namespace lime{
 
 struct LMS7Parameter;
 
+/** @brief Shadow copy of the LMS7002M registers, channels A and B.
+
+    Addresses below TABLE_SIZE, the whole chip register space, are held in a flat
+    table indexed by address. A bitmap and a sorted list record which addresses are
+    in use, an address joins them when it gets a default value or is first written.
+    Addresses outside the table fall back to a map.
+*/
 class LMS7002M_RegistersMap
 {
 public:
@@ -19,26 +26,51 @@ public:
         uint16_t mask;
     };
 
+    static const uint16_t TABLE_SIZE = 0x0800;
+
     LMS7002M_RegistersMap();
     ~LMS7002M_RegistersMap();
 
-    uint16_t GetValue(uint8_t channel, uint16_t address) const;
-    void SetValue(uint8_t channel, const uint16_t address, const uint16_t value);
+    uint16_t GetValue(uint8_t channel, uint16_t address) const
+    {
+        if (channel > 1) return 0;
+        if (address < TABLE_SIZE) return mChannels[channel].table[address].value; //unused entries hold 0
+        return GetOverflowValue(channel, address);
+    }
+
+    void SetValue(uint8_t channel, const uint16_t address, const uint16_t value)
+    {
+        if (channel > 1) return;
+        const Channel &ch = mChannels[channel];
+        if (address < TABLE_SIZE && (ch.used[address/32] & (1u << (address%32))))
+            mChannels[channel].table[address].value = value;
+        else Entry(channel, address).value = value;
+    }
 
     void InitializeDefaultValues(const std::vector<const LMS7Parameter*> parameterList);
     uint16_t GetDefaultValue(uint16_t address) const;
-    std::vector<uint16_t> GetUsedAddresses(const uint8_t channel) const;
 
-    LMS7002M_RegistersMap &operator=(const LMS7002M_RegistersMap &other)
-    {
-        mChannelA.insert(other.mChannelA.begin(), other.mChannelA.end());
-        mChannelB.insert(other.mChannelB.begin(), other.mChannelB.end());
-        return *this;
-    }
+    //! Used addresses of the channel in ascending order
+    const std::vector<uint16_t> &GetUsedAddresses(const uint8_t channel) const;
+
+    //! Copies the registers of other that are not used here yet
+    LMS7002M_RegistersMap &operator=(const LMS7002M_RegistersMap &other);
 
 protected:
-    std::map<const uint16_t, Register> mChannelA;
-    std::map<const uint16_t, Register> mChannelB;
+    struct Channel
+    {
+        Register table[TABLE_SIZE];
+        uint32_t used[TABLE_SIZE/32];
+        std::map<uint16_t, Register> overflow;
+        std::vector<uint16_t> addresses;
+    };
+
+    //! Register at the address, marked as used on first access
+    Register &Entry(uint8_t channel, uint16_t address);
+    const Register *Find(uint8_t channel, uint16_t address) const;
+    uint16_t GetOverflowValue(uint8_t channel, uint16_t address) const;
+
+    Channel mChannels[2];
 };
 
 }
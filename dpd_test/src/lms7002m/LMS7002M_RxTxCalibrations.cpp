@@ -196,6 +196,7 @@ bool sign(const int number)
 */
 int LMS7002M::CalibrateTxSetup(float_type bandwidth_Hz, const bool useExtLoopback)
 {
+    LMS7002M_Transaction transaction(this);
     //Stage 2
     uint8_t ch = (uint8_t)Get_SPI_Reg_bits(LMS7param(MAC));
     uint8_t sel_band1_trf = (uint8_t)Get_SPI_Reg_bits(LMS7param(SEL_BAND1_TRF));
@@ -438,7 +439,7 @@ int LMS7002M::CalibrateTxSetup(float_type bandwidth_Hz, const bool useExtLoopbac
         Modify_SPI_Reg_bits(LMS7param(EN_NEXTTX_TRF), 1); //EN_NEXTTX_TRF 1
         Modify_SPI_Reg_bits(MAC, ch);
     }
-    return 0;
+    return transaction.Commit();
 }
 
 /** @brief Flips the CAPTURE bit and returns digital RSSI value
@@ -714,7 +715,10 @@ TxCalibrationEnd:
     }
 
     if(useCache)
+    {
         valueCache.InsertDC_IQ(boardId, txFreq*1e6, channel, true, band, dccorri, dccorrq, gcorri, gcorrq, phaseOffset);
+        SaveValuesCache();
+    }
 
     Modify_SPI_Reg_bits(LMS7param(MAC), ch);
     Modify_SPI_Reg_bits(LMS7param(DCCORRI_TXTSP), dccorri);
@@ -770,6 +774,7 @@ void LMS7002M::CalibrateRxDC_RSSI()
 */
 int LMS7002M::CalibrateRxSetup(float_type bandwidth_Hz, const bool useExtLoopback)
 {
+    LMS7002M_Transaction transaction(this);
     uint8_t ch = (uint8_t)Get_SPI_Reg_bits(LMS7param(MAC));
 
     //rfe
@@ -935,7 +940,7 @@ int LMS7002M::CalibrateRxSetup(float_type bandwidth_Hz, const bool useExtLoopbac
         Modify_SPI_Reg_bits(LMS7param(PD_TX_AFE2), 0);
         Modify_SPI_Reg_bits(MAC, ch);
     }
-    return 0;
+    return transaction.Commit();
 }
 
 /** @brief Calibrates Receiver. DC offset, IQ gains, IQ phase correction
@@ -1158,7 +1163,10 @@ RxCalibrationEndStage:
         return status;
     }
     if(useCache)
+    {
         valueCache.InsertDC_IQ(boardId, rxFreq*1e6, channel, false, lna, dcoffi, dcoffq, mingcorri, mingcorrq, phaseOffset);
+        SaveValuesCache();
+    }
 
     Modify_SPI_Reg_bits(LMS7param(MAC), ch);
     SetRxDCOFF((int8_t)dcoffi, (int8_t)dcoffq);
@@ -1625,7 +1633,10 @@ int LMS7002M::StoreDigitalCorrections(const bool isTx)
         phaseOffset = int16_t(Get_SPI_Reg_bits(LMS7param(IQCORR_RXTSP)) << 4) >> 4;
     }
 
-    return valueCache.InsertDC_IQ(boardId, freq, idx, isTx, band, dccorri, dccorrq, gcorri, gcorrq, phaseOffset);
+    int status = valueCache.InsertDC_IQ(boardId, freq, idx, isTx, band, dccorri, dccorrq, gcorri, gcorrq, phaseOffset);
+    if (status != 0)
+        return status;
+    return valueCache.Flush();
 }
 
 int LMS7002M::ApplyDigitalCorrections(const bool isTx)
@@ -360,7 +360,11 @@ TxFilterTuneEnd:
         Modify_SPI_Reg_bits(0x0105, 4, 0, 0x7); //set powerdowns
     }
 
-    if (storeInCache) valueCache.InsertFilter_RC(boardId, cutoff_Hz, idx, Tx, int(type), rcal, ccal_lpflad_tbb);
+    if (storeInCache)
+    {
+        valueCache.InsertFilter_RC(boardId, cutoff_Hz, idx, Tx, int(type), rcal, ccal_lpflad_tbb);
+        SaveValuesCache();
+    }
 
     return 0;
 }
@@ -632,6 +636,7 @@ RxFilterTuneEnd:
         Modify_SPI_Reg_bits(INPUT_CTL_PGA_RBB, 0x1);
         if (storeInCache) valueCache.InsertFilter_RC(boardId, bandwidth_Hz, idx, Rx, int(filter), rcc_ctl_lpfh_rbb, c_ctl_lpfh_rbb);
     }
+    if (storeInCache) SaveValuesCache();
 
     return 0;
 }
@@ -38,7 +38,9 @@ static int convertStatus(const int &status, const LMS64CProtocol::GenericPacket
     return ReportError(EPROTO, status2string(pkt.status));
 }
 
-LMS64CProtocol::LMS64CProtocol(void)
+LMS64CProtocol::LMS64CProtocol(void) :
+    mPipelineDepth(1),
+    mControlThreadQuit(false)
 {
     //set a sane-default for the rate
     _cachedRefClockRate = 61.44e6/2;
@@ -46,7 +48,22 @@ LMS64CProtocol::LMS64CProtocol(void)
 
 LMS64CProtocol::~LMS64CProtocol(void)
 {
-    return;
+    StopControlThread();
+}
+
+/** @brief Transfers the packets already submitted and stops the control thread,
+    later SubmitPacket() calls fail. Derived connections call it before closing
+    the port, because the thread transfers through their Write() and Read().
+*/
+void LMS64CProtocol::StopControlThread(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(mQueueLock);
+        mControlThreadQuit = true;
+        mQueueCond.notify_one();
+    }
+    if (mControlThread.joinable())
+        mControlThread.join();
 }
 
 int LMS64CProtocol::DeviceReset(void)
@@ -338,135 +355,272 @@ LMS64CProtocol::LMSinfo LMS64CProtocol::GetInfo()
 }
 
 /** @brief Transfers data between packet and connected device
+    Packets submitted earlier with SubmitPacket() are transferred first.
     @param pkt packet containing output data and to receive incomming data
     @return 0: success, other: failure
 */
 int LMS64CProtocol::TransferPacket(GenericPacket& pkt)
+{
+    {
+        std::lock_guard<std::mutex> lock(mControlPortLock);
+        bool queueEmpty;
+        {
+            std::lock_guard<std::mutex> queueLock(mQueueLock);
+            queueEmpty = mQueue.empty();
+        }
+        if (queueEmpty)
+        {
+            GenericPacket *pkts[1] = {&pkt};
+            int status = 0;
+            TransferPackets(pkts, &status, 1);
+            return status;
+        }
+    }
+    return SubmitPacket(pkt).get();
+}
+
+/** @brief Queues packet for transfer by the control thread
+    @param pkt packet containing output data and to receive incomming data,
+    must stay valid until the returned future is ready
+    @return future of the transfer status, 0: success, other: failure
+*/
+std::future<int> LMS64CProtocol::SubmitPacket(GenericPacket& pkt)
+{
+    std::lock_guard<std::mutex> lock(mQueueLock);
+    if (mControlThreadQuit)
+    {
+        std::promise<int> stopped;
+        stopped.set_value(ReportError(ENOTCONN, "control thread is stopped"));
+        return stopped.get_future();
+    }
+    if (not mControlThread.joinable())
+        mControlThread = std::thread(&LMS64CProtocol::ControlThreadLoop, this);
+    mQueue.push_back(ControlRequest());
+    mQueue.back().pkt = &pkt;
+    std::future<int> result = mQueue.back().done.get_future();
+    mQueueCond.notify_one();
+    return result;
+}
+
+/** @brief Sets how many frames are written before the reply of the first is read
+    @param depth frames in flight, 1 waits for every reply before the next write
+*/
+void LMS64CProtocol::SetControlPipelineDepth(const int depth)
 {
     std::lock_guard<std::mutex> lock(mControlPortLock);
-    int status = 0;
-    if(IsOpen() == false) ReportError(ENOTCONN, "connection is not open");
+    mPipelineDepth = depth < 1 ? 1 : depth;
+}
 
-    int packetLen;
+int LMS64CProtocol::GetControlPipelineDepth(void) const
+{
+    return mPipelineDepth;
+}
+
+/** @brief Transfers all packets queued by SubmitPacket(), in submission order
+*/
+void LMS64CProtocol::ControlThreadLoop(void)
+{
+    std::vector<ControlRequest> batch;
+    std::vector<GenericPacket*> pkts;
+    std::vector<int> status;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> queueLock(mQueueLock);
+            mQueueCond.wait(queueLock, [this]{ return mControlThreadQuit or not mQueue.empty(); });
+            if (mQueue.empty())
+                return;
+        }
+        {
+            //the port lock is taken before the queue is emptied,
+            //so TransferPacket() can not pass the packets of this batch
+            std::lock_guard<std::mutex> lock(mControlPortLock);
+            {
+                std::lock_guard<std::mutex> queueLock(mQueueLock);
+                for (auto &request : mQueue)
+                    batch.push_back(std::move(request));
+                mQueue.clear();
+            }
+            pkts.clear();
+            for (auto &request : batch)
+                pkts.push_back(request.pkt);
+            status.assign(batch.size(), 0);
+            TransferPackets(pkts.data(), status.data(), batch.size());
+        }
+        for (size_t i = 0; i < batch.size(); ++i)
+            batch[i].done.set_value(status[i]);
+        batch.clear();
+    }
+}
+
+/** @brief Transfers packets with up to pipeline depth frames in flight, mControlPortLock must be held
+    @param pkts packets containing output data and to receive incomming data
+    @param status returns transfer status of each packet, 0: success, other: failure
+    @param count number of packets
+*/
+void LMS64CProtocol::TransferPackets(GenericPacket* const* pkts, int *status, const size_t count)
+{
     eLMS_PROTOCOL protocol = LMS_PROTOCOL_UNDEFINED;
     if(this->GetType() == SPI_PORT)
         protocol = LMS_PROTOCOL_NOVENA;
     else
         protocol = LMS_PROTOCOL_LMS64C;
-    switch(protocol)
-    {
-    case LMS_PROTOCOL_UNDEFINED:
-        return ReportError("protocol type undefined");
-    case LMS_PROTOCOL_LMS64C:
-        packetLen = ProtocolLMS64C::pktLength;
-        break;
-    case LMS_PROTOCOL_NOVENA:
-        packetLen = pkt.outBuffer.size() > ProtocolNovena::pktLength ? ProtocolNovena::pktLength : pkt.outBuffer.size();
-        break;
-    default:
-        packetLen = 0;
-        return ReportError("Unknown protocol type %d", int(protocol));
-    }
-    int outLen = 0;
-    unsigned char* outBuffer = NULL;
-    outBuffer = PreparePacket(pkt, outLen, protocol);
-    unsigned char* inBuffer = new unsigned char[outLen];
-    memset(inBuffer, 0, outLen);
-
-    int outBufPos = 0;
-    int inDataPos = 0;
-    if(outLen == 0)
+
+    for (size_t p = 0; p < count; ++p)
+        status[p] = 0;
+    if(IsOpen() == false) ReportError(ENOTCONN, "connection is not open");
+
+    if(protocol == LMS_PROTOCOL_NOVENA)
     {
-        //printf("packet outlen = 0\n");
-        outLen = 1;
+        for (size_t p = 0; p < count; ++p)
+            status[p] = TransferPacketNovena(*pkts[p]);
+        return;
     }
 
-    if(protocol == LMS_PROTOCOL_NOVENA)
+    //frames of all packets go out back to back
+    const int packetLen = ProtocolLMS64C::pktLength;
+    mOutFrames.clear();
+    mPacketFrames.clear();
+    for (size_t p = 0; p < count; ++p)
     {
-        bool transferData = true; //some commands are fake, so don't need transferring
-        if(pkt.cmd == CMD_GET_INFO)
-        {
-            //spi does not have GET INFO, fake it to inform what device it is
-            pkt.status = STATUS_COMPLETED_CMD;
-            pkt.inBuffer.clear();
-            pkt.inBuffer.resize(64, 0);
-            pkt.inBuffer[0] = 0; //firmware
-            pkt.inBuffer[1] = LMS_DEV_NOVENA; //device
-            pkt.inBuffer[2] = 0; //protocol
-            pkt.inBuffer[3] = 0; //hardware
-            pkt.inBuffer[4] = EXP_BOARD_UNSUPPORTED; //expansion
-            transferData = false;
-        }
+        mPacketFrames.push_back(mOutFrames.size() / packetLen);
+        PreparePacket(*pkts[p], mOutFrames, protocol);
+    }
+    const int frames = mOutFrames.size() / packetLen;
+    mPacketFrames.push_back(frames);
+    mInFrames.assign(mOutFrames.size(), 0);
 
-        if(transferData)
+    int written = 0;
+    int received = 0;
+    int stale = 0;
+    int error = 0;
+    while (received < written || (written < frames && error == 0))
+    {
+        if (error == 0 && written < frames && written - received < mPipelineDepth)
         {
+            const unsigned char *frame = &mOutFrames[written*packetLen];
             if (callback_logData)
-                callback_logData(true, outBuffer, outLen);
-            int bytesWritten = Write(outBuffer, outLen);
-            if( bytesWritten == outLen)
-            {
-                if(pkt.cmd == CMD_LMS7002_RD)
-                {
-                    inDataPos = Read(&inBuffer[inDataPos], outLen);
-                    if(inDataPos != outLen)
-                        status = ReportError("Read(%d bytes) got %d", (int)outLen, (int)inDataPos);
-                    else
-                    {
-                        if (callback_logData)
-                            callback_logData(false, inBuffer, inDataPos);
-                    }
-                }
-                ParsePacket(pkt, inBuffer, inDataPos, protocol);
-            }
+                callback_logData(true, frame, packetLen);
+            if (Write(frame, packetLen))
+                ++written;
             else
-                status = ReportError("Write(%d bytes) got %d", (int)outLen, (int)bytesWritten);
+                error = ReportError("Write(%d bytes) failed", packetLen); //the replies in flight are still read
+            continue;
+        }
+        unsigned char *reply = &mInFrames[received*packetLen];
+        int bread = Read(reply, packetLen);
+        if(bread != packetLen)
+        {
+            error = ReportError("Read(%d bytes) failed", packetLen);
+            //read out the replies still in flight, a late one included,
+            //so the next transfer gets its own replies
+            for (int f = received; f < written; ++f)
+                if (Read(reply, packetLen) != packetLen)
+                    break;
+            break;
+        }
+        if (callback_logData)
+            callback_logData(false, reply, bread);
+        const unsigned char cmd = mOutFrames[received*packetLen];
+        if (reply[0] != cmd)
+        {
+            //a reply left in flight by a failed transfer is skipped,
+            //there can not be more of them than the pipeline depth
+            if (++stale <= mPipelineDepth)
+                continue;
+            error = ReportError(EPROTO, "reply to command 0x%02X, expected 0x%02X", reply[0], cmd);
+            for (int f = received; f < written; ++f)
+                if (Read(reply, packetLen) != packetLen)
+                    break;
+            break;
         }
+        ++received;
     }
-    else
+
+    for (size_t p = 0; p < count; ++p)
     {
-        for(int i=0; i<outLen; i+=packetLen)
+        const int first = mPacketFrames[p];
+        const int last = mPacketFrames[p+1];
+        const int parsed = std::min(std::max(received - first, 0), last - first);
+        ParsePacket(*pkts[p], &mInFrames[first*packetLen], parsed*packetLen, protocol);
+        if (parsed != last - first)
+            status[p] = error;
+    }
+}
+
+/** @brief Transfers packet over SPI port of Novena board, mControlPortLock must be held
+    @param pkt packet containing output data and to receive incomming data
+    @return 0: success, other: failure
+*/
+int LMS64CProtocol::TransferPacketNovena(GenericPacket& pkt)
+{
+    const eLMS_PROTOCOL protocol = LMS_PROTOCOL_NOVENA;
+    int status = 0;
+    mOutFrames.clear();
+    int outLen = PreparePacket(pkt, mOutFrames, protocol);
+    int inDataPos = 0;
+    if(outLen == 0)
+    {
+        //printf("packet outlen = 0\n");
+        outLen = 1;
+    }
+    mOutFrames.resize(outLen, 0);
+    mInFrames.assign(outLen, 0);
+    unsigned char* outBuffer = mOutFrames.data();
+    unsigned char* inBuffer = mInFrames.data();
+
+    bool transferData = true; //some commands are fake, so don't need transferring
+    if(pkt.cmd == CMD_GET_INFO)
+    {
+        //spi does not have GET INFO, fake it to inform what device it is
+        pkt.status = STATUS_COMPLETED_CMD;
+        pkt.inBuffer.clear();
+        pkt.inBuffer.resize(64, 0);
+        pkt.inBuffer[0] = 0; //firmware
+        pkt.inBuffer[1] = LMS_DEV_NOVENA; //device
+        pkt.inBuffer[2] = 0; //protocol
+        pkt.inBuffer[3] = 0; //hardware
+        pkt.inBuffer[4] = EXP_BOARD_UNSUPPORTED; //expansion
+        transferData = false;
+    }
+
+    if(transferData)
+    {
+        if (callback_logData)
+            callback_logData(true, outBuffer, outLen);
+        int bytesWritten = Write(outBuffer, outLen);
+        if( bytesWritten == outLen)
         {
-            int bytesToSend = packetLen;
-            if (callback_logData)
-                callback_logData(true, &outBuffer[outBufPos], bytesToSend);
-            if( Write(&outBuffer[outBufPos], bytesToSend) )
+            if(pkt.cmd == CMD_LMS7002_RD)
             {
-                outBufPos += packetLen;
-                long readLen = packetLen;
-                int bread = Read(&inBuffer[inDataPos], readLen);
-                if(bread != readLen && protocol != LMS_PROTOCOL_NOVENA)
+                inDataPos = Read(&inBuffer[inDataPos], outLen);
+                if(inDataPos != outLen)
+                    status = ReportError("Read(%d bytes) got %d", (int)outLen, (int)inDataPos);
+                else
                 {
-                    status = ReportError("Read(%d bytes) failed", (int)readLen);
-                    break;
+                    if (callback_logData)
+                        callback_logData(false, inBuffer, inDataPos);
                 }
-                if (callback_logData)
-                    callback_logData(false, &inBuffer[inDataPos], bread);
-                inDataPos += bread;
-            }
-            else
-            {
-                status = ReportError("Write(%d bytes) failed", (int)bytesToSend);
-                break;
             }
+            ParsePacket(pkt, inBuffer, inDataPos, protocol);
         }
-        ParsePacket(pkt, inBuffer, inDataPos, protocol);
+        else
+            status = ReportError("Write(%d bytes) got %d", (int)outLen, (int)bytesWritten);
     }
-    delete outBuffer;
-    delete inBuffer;
     return status;
 }
 
 /** @brief Takes generic packet and converts to specific protocol buffer
     @param pkt generic data packet to convert
-    @param length returns length of returned buffer
+    @param buffer the protocol buffer is appended here
     @param protocol which protocol to use for data
-    @return pointer to data buffer, must be manually deleted after use
+    @return length of the protocol buffer
 */
-unsigned char* LMS64CProtocol::PreparePacket(const GenericPacket& pkt, int& length, const eLMS_PROTOCOL protocol)
+int LMS64CProtocol::PreparePacket(const GenericPacket& pkt, std::vector<unsigned char>& buffer, const eLMS_PROTOCOL protocol)
 {
-    unsigned char* buffer = NULL;
+    const size_t start = buffer.size();
     if(protocol == LMS_PROTOCOL_UNDEFINED)
-        return NULL;
+        return 0;
 
     if(protocol == LMS_PROTOCOL_LMS64C)
     {
@@ -513,56 +667,45 @@ unsigned char* LMS64CProtocol::PreparePacket(const GenericPacket& pkt, int& leng
         bufLen *= packet.pktLength;
         if(bufLen == 0)
             bufLen = packet.pktLength;
-        buffer = new unsigned char[bufLen];
-        memset(buffer, 0, bufLen);
+        buffer.resize(start + bufLen, 0);
+        unsigned char* frames = &buffer[start];
         int srcPos = 0;
         for(int j=0; j*packet.pktLength<bufLen; ++j)
         {
             int pktPos = j*packet.pktLength;
-            buffer[pktPos] = packet.cmd;
-            buffer[pktPos+1] = packet.status;
+            frames[pktPos] = packet.cmd;
+            frames[pktPos+1] = packet.status;
             if(blockCount > (maxDataLength/byteBlockRatio))
             {
-                buffer[pktPos+2] = maxDataLength/byteBlockRatio;
-                blockCount -= buffer[pktPos+2];
+                frames[pktPos+2] = maxDataLength/byteBlockRatio;
+                blockCount -= frames[pktPos+2];
             }
             else
-                buffer[pktPos+2] = blockCount;
-            memcpy(&buffer[pktPos+3], packet.reserved, sizeof(packet.reserved));
+                frames[pktPos+2] = blockCount;
+            memcpy(&frames[pktPos+3], packet.reserved, sizeof(packet.reserved));
             int bytesToPack = (maxDataLength/byteBlockRatio)*byteBlockRatio;
             for (int k = 0; k<bytesToPack && srcPos < pkt.outBuffer.size(); ++srcPos, ++k)
-                buffer[pktPos + 8 + k] = pkt.outBuffer[srcPos];
+                frames[pktPos + 8 + k] = pkt.outBuffer[srcPos];
         }
-        length = bufLen;
     }
     else if(protocol == LMS_PROTOCOL_NOVENA)
     {
         if(pkt.cmd == CMD_LMS7002_RST)
         {
-            buffer = new unsigned char[8];
-            buffer[0] = 0x88;
-            buffer[1] = 0x06;
-            buffer[2] = 0x00;
-            buffer[3] = 0x18;
-            buffer[4] = 0x88;
-            buffer[5] = 0x06;
-            buffer[6] = 0x00;
-            buffer[7] = 0x38;
-            length = 8;
+            const unsigned char reset[8] = {0x88, 0x06, 0x00, 0x18, 0x88, 0x06, 0x00, 0x38};
+            buffer.insert(buffer.end(), reset, reset + 8);
         }
         else
         {
-            buffer = new unsigned char[pkt.outBuffer.size()];
-            memcpy(buffer, &pkt.outBuffer[0], pkt.outBuffer.size());
+            buffer.insert(buffer.end(), pkt.outBuffer.begin(), pkt.outBuffer.end());
             if (pkt.cmd == CMD_LMS7002_WR)
             {
-                for(int i=0; i<pkt.outBuffer.size(); i+=4)
+                for(size_t i=start; i<buffer.size(); i+=4)
                     buffer[i] |= 0x80;
             }
-            length = pkt.outBuffer.size();
         }
     }
-    return buffer;
+    return buffer.size() - start;
 }
 
 /** @brief Parses given data buffer into generic packet
@@ -7,6 +7,10 @@
 #pragma once
 #include <IConnection.h>
 #include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <future>
+#include <deque>
 #include <LMS64CCommands.h>
 #include <LMSBoards.h>
 
@@ -133,6 +137,24 @@ public:
      */
     int TransferPacket(GenericPacket &pkt);
 
+    /*!
+     * Queue a packet for transfer and return without waiting.
+     * A control thread transfers the queued packets in submission order,
+     * writing up to the pipeline depth of frames before reading replies.
+     * The packet must stay valid until the returned future is ready,
+     * the future gives the TransferPacket() status.
+     */
+    std::future<int> SubmitPacket(GenericPacket &pkt);
+
+    /*!
+     * Number of frames written before the reply of the first one is read.
+     * 1, the default, waits for each reply before the next write. Deeper
+     * pipelines need a transport and firmware that keep replies queued in
+     * order, callers opt in once that is known for their board.
+     */
+    void SetControlPipelineDepth(const int depth);
+    int GetControlPipelineDepth(void) const;
+
     struct LMSinfo
     {
         eLMS_DEV device;
@@ -168,6 +190,14 @@ public:
     virtual int CustomParameterRead(const uint8_t *ids, double *values, const int count, std::string* units);
     virtual int CustomParameterWrite(const uint8_t *ids, const double *values, const int count, const std::string* units);
 
+protected:
+    /*!
+     * Completes the queued packets and joins the control thread.
+     * Derived destructors call it before closing their port,
+     * later submissions fail with ENOTCONN.
+     */
+    void StopControlThread(void);
+
 private:
 
     int WriteLMS7002MSPI(const uint32_t *writeData, const size_t size);
@@ -179,9 +209,29 @@ private:
     int WriteADF4002SPI(const uint32_t *writeData, const size_t size);
     int ReadADF4002SPI(const uint32_t *writeData, uint32_t *readData, const size_t size);
 
-    unsigned char* PreparePacket(const GenericPacket &pkt, int &length, const eLMS_PROTOCOL protocol);
+    int PreparePacket(const GenericPacket &pkt, std::vector<unsigned char> &buffer, const eLMS_PROTOCOL protocol);
     int ParsePacket(GenericPacket &pkt, const unsigned char* buffer, const int length, const eLMS_PROTOCOL protocol);
+    void TransferPackets(GenericPacket* const* pkts, int *status, const size_t count);
+    int TransferPacketNovena(GenericPacket &pkt);
+    void ControlThreadLoop(void);
     std::mutex mControlPortLock;
+
+    //transfer buffers, reused by every transfer
+    std::vector<unsigned char> mOutFrames;
+    std::vector<unsigned char> mInFrames;
+    std::vector<int> mPacketFrames; //first frame of each packet
+    int mPipelineDepth;
+
+    struct ControlRequest
+    {
+        GenericPacket *pkt;
+        std::promise<int> done;
+    };
+    std::mutex mQueueLock;
+    std::condition_variable mQueueCond;
+    std::deque<ControlRequest> mQueue;
+    std::thread mControlThread;
+    bool mControlThreadQuit;
     double _cachedRefClockRate;
 };
 }
@@ -0,0 +1,336 @@
+#include "gtest/gtest.h"
+#include "ConnectionSTREAM/SampleConvert.h"
+#include "SamplePacking.h"
+#include "mpoly_kernels.h"
+#include <complex>
+#include <limits>
+#include <random>
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+using namespace std;
+using namespace lime;
+
+//lengths around the vector widths (4, 8, 16 values) to cover every tail size
+static const size_t lengths[] = { 0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 33, 63, 65, 1021 };
+
+//the first set is the reference, the others are skipped if the CPU lacks them
+static const char * const convertSets[] = { "scalar", "SSE2", "AVX2" };
+static const char * const packingSets[] = { "scalar", "SSE2", "SSSE3" };
+static const char * const mpolySets[] = { "scalar", "SSE2", "AVX2" };
+
+//samples of several channels, each channel starts one sample past a vector boundary
+class ChannelBuffers
+{
+public:
+    ChannelBuffers(int channels, size_t samples) : data(channels, vector<complex16_t>(samples + 1)), ptrs(channels)
+    {
+        for (int ch = 0; ch < channels; ++ch)
+            ptrs[ch] = data[ch].data() + 1;
+    }
+    complex16_t * const *Ptrs(void) { return ptrs.data(); }
+    bool Equals(const ChannelBuffers &other, size_t samples) const
+    {
+        for (size_t ch = 0; ch < ptrs.size(); ++ch)
+            for (size_t s = 0; s < samples; ++s)
+                if (ptrs[ch][s].i != other.ptrs[ch][s].i || ptrs[ch][s].q != other.ptrs[ch][s].q)
+                    return false;
+        return true;
+    }
+    vector<vector<complex16_t> > data;
+    vector<complex16_t *> ptrs;
+};
+
+TEST(SampleConvert, Int16ToFloatMatchesScalar)
+{
+    const char *selected = SampleConvertImplementation();
+    mt19937 rng(1);
+    uniform_int_distribution<int> value(-32768, 32767);
+    for (int linkBits : { 12, 14 })
+    for (size_t count : lengths)
+    {
+        vector<complex16_t> in(count + 1);
+        for (auto &v : in)
+        {
+            v.i = value(rng);
+            v.q = value(rng);
+        }
+        vector<complex<float> > ref(count + 1), out(count + 1);
+        ASSERT_TRUE(SelectSampleConvertImplementation(convertSets[0]));
+        ConvertInt16ToFloat(in.data() + 1, ref.data() + 1, count, linkBits);
+        for (const char *name : convertSets)
+        {
+            if (!SelectSampleConvertImplementation(name))
+                continue;
+            SCOPED_TRACE(name);
+            fill(out.begin(), out.end(), complex<float>(-3.0f, -3.0f));
+            ConvertInt16ToFloat(in.data() + 1, out.data() + 1, count, linkBits);
+            for (size_t j = 1; j <= count; ++j)
+                ASSERT_EQ(ref[j], out[j]) << "count " << count << " sample " << j - 1;
+            EXPECT_EQ(complex<float>(-3.0f, -3.0f), out[0]) << "count " << count;
+        }
+    }
+    SelectSampleConvertImplementation(selected);
+}
+
+TEST(SampleConvert, FloatToInt16MatchesScalar)
+{
+    const char *selected = SampleConvertImplementation();
+    mt19937 rng(2);
+    //out of range values check the saturation, halves check rounding to nearest even
+    uniform_real_distribution<float> value(-1.5f, 1.5f);
+    const float special[] = { numeric_limits<float>::quiet_NaN(), 1.0f, -1.0f, 0.5f/2048, 1.5f/2048, -2.5f/2048,
+        numeric_limits<float>::infinity(), -numeric_limits<float>::infinity(), 2047.5f/2048, -2048.5f/2048 };
+    for (int linkBits : { 12, 14 })
+    for (size_t count : lengths)
+    {
+        vector<complex<float> > in(count + 1);
+        for (size_t j = 0; j < in.size(); ++j)
+        {
+            const size_t k = j % 16;
+            const float i = k < sizeof(special)/sizeof(special[0]) ? special[k] : value(rng);
+            in[j] = complex<float>(i, value(rng));
+        }
+        vector<complex16_t> ref(count + 1), out(count + 1);
+        ASSERT_TRUE(SelectSampleConvertImplementation(convertSets[0]));
+        ConvertFloatToInt16(in.data() + 1, ref.data() + 1, count, linkBits);
+        for (const char *name : convertSets)
+        {
+            if (!SelectSampleConvertImplementation(name))
+                continue;
+            SCOPED_TRACE(name);
+            for (auto &v : out)
+                v.i = v.q = 0x5555;
+            ConvertFloatToInt16(in.data() + 1, out.data() + 1, count, linkBits);
+            for (size_t j = 1; j <= count; ++j)
+            {
+                ASSERT_EQ(ref[j].i, out[j].i) << "count " << count << " sample " << j - 1;
+                ASSERT_EQ(ref[j].q, out[j].q) << "count " << count << " sample " << j - 1;
+            }
+            EXPECT_EQ(0x5555, out[0].i);
+        }
+    }
+    SelectSampleConvertImplementation(selected);
+}
+
+TEST(SampleConvert, ScalarSaturatesAndRounds)
+{
+    const char *selected = SampleConvertImplementation();
+    ASSERT_TRUE(SelectSampleConvertImplementation("scalar"));
+    const complex<float> in[3] = { complex<float>(numeric_limits<float>::quiet_NaN(), 2.0f),
+        complex<float>(-2.0f, 0.5f/2048), complex<float>(1.5f/2048, -0.5f/2048) };
+    complex16_t out[3];
+    ConvertFloatToInt16(in, out, 3, 12);
+    EXPECT_EQ(0, out[0].i);
+    EXPECT_EQ(2047, out[0].q);
+    EXPECT_EQ(-2048, out[1].i);
+    EXPECT_EQ(0, out[1].q);
+    EXPECT_EQ(2, out[2].i);
+    EXPECT_EQ(0, out[2].q);
+    SelectSampleConvertImplementation(selected);
+}
+
+TEST(SamplePacking, UnpackMatchesScalar)
+{
+    const char *selected = SamplePackingImplementation();
+    mt19937 rng(3);
+    uniform_int_distribution<int> byte(0, 255);
+    for (int channels = 1; channels <= 3; ++channels)
+    for (size_t count : lengths)
+    {
+        //one spare byte in front so the payload is not aligned
+        vector<uint8_t> payload(4*channels*count + 1);
+        for (auto &b : payload)
+            b = byte(rng);
+        const uint8_t *src = payload.data() + 1;
+
+        ChannelBuffers ref12(channels, count), ref16(channels, count);
+        ASSERT_TRUE(SelectSamplePackingImplementation(packingSets[0]));
+        Unpack12Bit(src, ref12.Ptrs(), channels, count);
+        Unpack12In16(src, ref16.Ptrs(), channels, count);
+        for (const char *name : packingSets)
+        {
+            if (!SelectSamplePackingImplementation(name))
+                continue;
+            SCOPED_TRACE(name);
+            ChannelBuffers out12(channels, count), out16(channels, count);
+            Unpack12Bit(src, out12.Ptrs(), channels, count);
+            Unpack12In16(src, out16.Ptrs(), channels, count);
+            EXPECT_TRUE(ref12.Equals(out12, count)) << channels << " channels, count " << count;
+            EXPECT_TRUE(ref16.Equals(out16, count)) << channels << " channels, count " << count;
+            for (int ch = 0; ch < channels; ++ch)
+            {
+                //nothing is written in front of the destination
+                EXPECT_EQ(0, out12.data[ch][0].i);
+                EXPECT_EQ(0, out16.data[ch][0].q);
+            }
+        }
+    }
+    SelectSamplePackingImplementation(selected);
+}
+
+TEST(SamplePacking, PackMatchesScalar)
+{
+    const char *selected = SamplePackingImplementation();
+    mt19937 rng(4);
+    uniform_int_distribution<int> value(-2048, 2047);
+    for (int channels = 1; channels <= 3; ++channels)
+    for (size_t count : lengths)
+    {
+        ChannelBuffers in(channels, count);
+        for (auto &ch : in.data)
+            for (auto &v : ch)
+            {
+                v.i = value(rng);
+                v.q = value(rng);
+            }
+
+        //a guard byte after the payload checks that the tails stop in time
+        const size_t bytes12 = 3*channels*count, bytes16 = 4*channels*count;
+        vector<uint8_t> ref12(bytes12 + 1, 0xA5), ref16(bytes16 + 1, 0xA5);
+        ASSERT_TRUE(SelectSamplePackingImplementation(packingSets[0]));
+        Pack12Bit(in.Ptrs(), ref12.data(), channels, count);
+        Pack12In16(in.Ptrs(), ref16.data(), channels, count);
+        for (const char *name : packingSets)
+        {
+            if (!SelectSamplePackingImplementation(name))
+                continue;
+            SCOPED_TRACE(name);
+            vector<uint8_t> out12(bytes12 + 1, 0xA5), out16(bytes16 + 1, 0xA5);
+            Pack12Bit(in.Ptrs(), out12.data(), channels, count);
+            Pack12In16(in.Ptrs(), out16.data(), channels, count);
+            EXPECT_EQ(ref12, out12) << channels << " channels, count " << count;
+            EXPECT_EQ(ref16, out16) << channels << " channels, count " << count;
+            EXPECT_EQ(0xA5, out12[bytes12]);
+            EXPECT_EQ(0xA5, out16[bytes16]);
+        }
+    }
+    SelectSamplePackingImplementation(selected);
+}
+
+TEST(SamplePacking, ScalarRoundTrip)
+{
+    const char *selected = SamplePackingImplementation();
+    ASSERT_TRUE(SelectSamplePackingImplementation("scalar"));
+    const size_t count = 17;
+    ChannelBuffers in(2, count), out(2, count);
+    for (int ch = 0; ch < 2; ++ch)
+        for (size_t s = 0; s < count; ++s)
+        {
+            in.ptrs[ch][s].i = int16_t(s*241 - 2048);
+            in.ptrs[ch][s].q = int16_t(2047 - s*113*(ch + 1));
+        }
+    vector<uint8_t> payload(3*2*count);
+    Pack12Bit(in.Ptrs(), payload.data(), 2, count);
+    Unpack12Bit(payload.data(), out.Ptrs(), 2, count);
+    EXPECT_TRUE(in.Equals(out, count));
+    SelectSamplePackingImplementation(selected);
+}
+
+TEST(MpolyKernels, CmacMatchesScalar)
+{
+    const char *selected = mpoly::simd_name();
+    mt19937 rng(5);
+    uniform_real_distribution<double> value(-1.0, 1.0);
+    for (size_t count : lengths)
+    {
+        const int len = int(count);
+        vector<double> xI(len + 1), xQ(len + 1), yI0(len + 1), yQ0(len + 1);
+        for (int i = 0; i <= len; ++i)
+        {
+            xI[i] = value(rng);
+            xQ[i] = value(rng);
+            yI0[i] = value(rng);
+            yQ0[i] = value(rng);
+        }
+        const double a = value(rng), b = value(rng);
+        vector<double> refI(yI0), refQ(yQ0);
+        ASSERT_TRUE(mpoly::select_simd(mpolySets[0]));
+        mpoly::cmac(&refI[1], &refQ[1], &xI[1], &xQ[1], a, b, len);
+        for (const char *name : mpolySets)
+        {
+            if (!mpoly::select_simd(name))
+                continue;
+            SCOPED_TRACE(name);
+            vector<double> yI(yI0), yQ(yQ0);
+            mpoly::cmac(&yI[1], &yQ[1], &xI[1], &xQ[1], a, b, len);
+            for (int i = 0; i <= len; ++i)
+            {
+                ASSERT_DOUBLE_EQ(refI[i], yI[i]) << "len " << len << " sample " << i - 1;
+                ASSERT_DOUBLE_EQ(refQ[i], yQ[i]) << "len " << len << " sample " << i - 1;
+            }
+        }
+    }
+    mpoly::select_simd(selected);
+}
+
+TEST(MpolyKernels, PowerBasisMatchesScalar)
+{
+    const char *selected = mpoly::simd_name();
+    mt19937 rng(6);
+    uniform_real_distribution<double> value(-0.7, 0.7);
+    for (bool sEnv : { true, false })
+    for (int m : { 0, 1, 4 })
+    for (size_t count : lengths)
+    {
+        const int len = int(count);
+        //rows padded past len, the padding must stay untouched
+        const int stride = len + 3;
+        vector<double> xI(len + 1), xQ(len + 1);
+        for (int i = 0; i <= len; ++i)
+        {
+            xI[i] = value(rng);
+            xQ[i] = value(rng);
+        }
+        const size_t size = (m + 1)*stride + 1;
+        vector<double> refI(size, -7.0), refQ(size, -7.0);
+        ASSERT_TRUE(mpoly::select_simd(mpolySets[0]));
+        mpoly::power_basis(&xI[1], &xQ[1], len, m, 0.9, sEnv, &refI[1], &refQ[1], stride);
+        for (const char *name : mpolySets)
+        {
+            if (!mpoly::select_simd(name))
+                continue;
+            SCOPED_TRACE(name);
+            vector<double> pI(size, -7.0), pQ(size, -7.0);
+            mpoly::power_basis(&xI[1], &xQ[1], len, m, 0.9, sEnv, &pI[1], &pQ[1], stride);
+            for (size_t i = 0; i < size; ++i)
+            {
+                ASSERT_DOUBLE_EQ(refI[i], pI[i]) << "m " << m << " len " << len << " index " << i;
+                ASSERT_DOUBLE_EQ(refQ[i], pQ[i]) << "m " << m << " len " << len << " index " << i;
+            }
+        }
+    }
+    mpoly::select_simd(selected);
+}
+
+TEST(MpolyKernels, ClipMatchesScalar)
+{
+    const char *selected = mpoly::simd_name();
+    mt19937 rng(7);
+    uniform_real_distribution<double> value(-2.0, 2.0);
+    for (size_t count : lengths)
+    {
+        const int len = int(count);
+        vector<double> y0(len + 2);
+        for (auto &v : y0)
+            v = value(rng);
+        vector<double> ref(y0);
+        ASSERT_TRUE(mpoly::select_simd(mpolySets[0]));
+        mpoly::clip(&ref[1], len, -1.0, 1.0);
+        for (int i = 1; i <= len; ++i)
+        {
+            EXPECT_LE(ref[i], 1.0);
+            EXPECT_GE(ref[i], -1.0);
+        }
+        for (const char *name : mpolySets)
+        {
+            if (!mpoly::select_simd(name))
+                continue;
+            SCOPED_TRACE(name);
+            vector<double> y(y0);
+            mpoly::clip(&y[1], len, -1.0, 1.0);
+            EXPECT_EQ(ref, y) << "len " << len;
+        }
+    }
+    mpoly::select_simd(selected);
+}
@@ -0,0 +1,114 @@
+#include "gtest/gtest.h"
+#include "IConnection.h"
+#include "LMS7002M.h"
+#include "LMS7002M_parameters.h"
+#include <vector>
+using namespace std;
+using namespace lime;
+
+//records the SPI write words of every transaction, reads return zero
+class RecordingConnection : public IConnection
+{
+public:
+    RecordingConnection() : transactions(0), status(0) {}
+    bool IsOpen(void) { return true; }
+    int TransactSPI(const int addr, const uint32_t *writeData, uint32_t *readData, const size_t size)
+    {
+        transactions++;
+        if (readData)
+        {
+            for (size_t i = 0; i < size; i++)
+                readData[i] = 0;
+            return status;
+        }
+        for (size_t i = 0; i < size; i++)
+            writes.push_back(writeData[i]);
+        return status;
+    }
+
+    //values written to the address, in order
+    vector<uint16_t> WritesTo(uint16_t address) const
+    {
+        vector<uint16_t> values;
+        for (auto word : writes)
+            if (((word >> 16) & 0x7fff) == address)
+                values.push_back(word & 0xffff);
+        return values;
+    }
+
+    vector<uint32_t> writes;
+    int transactions;
+    int status;
+};
+
+static uint16_t Bit(const LMS7Parameter &param, uint16_t value)
+{
+    return (value >> param.lsb) & 1;
+}
+
+TEST(LMS7002M_Transaction, strobePulseReachesChip)
+{
+    RecordingConnection conn;
+    LMS7002M lms;
+    lms.SetConnection(&conn);
+    lms.SetActiveChannel(LMS7002M::ChA);
+    conn.writes.clear();
+    conn.transactions = 0;
+    {
+        LMS7002M_Transaction transaction(&lms);
+        lms.Modify_SPI_Reg_bits(TSGDCLDI_TXTSP, 0);
+        lms.Modify_SPI_Reg_bits(TSGDCLDI_TXTSP, 1);
+        lms.Modify_SPI_Reg_bits(TSGDCLDI_TXTSP, 0);
+        EXPECT_EQ(0, conn.transactions);
+        EXPECT_EQ(0, transaction.Commit());
+    }
+    EXPECT_EQ(1, conn.transactions);
+    auto values = conn.WritesTo(TSGDCLDI_TXTSP.address);
+    ASSERT_EQ(3u, values.size());
+    EXPECT_EQ(0, Bit(TSGDCLDI_TXTSP, values[0]));
+    EXPECT_EQ(1, Bit(TSGDCLDI_TXTSP, values[1]));
+    EXPECT_EQ(0, Bit(TSGDCLDI_TXTSP, values[2]));
+}
+
+TEST(LMS7002M_Transaction, dcLevelsLatchedInOrder)
+{
+    RecordingConnection conn;
+    LMS7002M lms;
+    lms.SetConnection(&conn);
+    lms.SetActiveChannel(LMS7002M::ChA);
+    conn.writes.clear();
+    {
+        LMS7002M_Transaction transaction(&lms);
+        lms.LoadDC_REG_IQ(LMS7002M::Tx, 0x1234, 0x0567);
+        EXPECT_EQ(0, transaction.Commit());
+    }
+    //DC_REG holds I while TSGDCLDI pulses, then Q while TSGDCLDQ pulses
+    uint16_t dcReg = 0;
+    vector<uint16_t> pulsesI, pulsesQ;
+    for (auto word : conn.writes)
+    {
+        const uint16_t address = (word >> 16) & 0x7fff;
+        const uint16_t value = word & 0xffff;
+        if (address == DC_REG_TXTSP.address)
+            dcReg = value;
+        if (address == TSGDCLDI_TXTSP.address && Bit(TSGDCLDI_TXTSP, value))
+            pulsesI.push_back(dcReg);
+        if (address == TSGDCLDQ_TXTSP.address && Bit(TSGDCLDQ_TXTSP, value))
+            pulsesQ.push_back(dcReg);
+    }
+    ASSERT_EQ(1u, pulsesI.size());
+    ASSERT_EQ(1u, pulsesQ.size());
+    EXPECT_EQ(0x1234, pulsesI[0]);
+    EXPECT_EQ(0x0567, pulsesQ[0]);
+}
+
+TEST(LMS7002M_Transaction, commitReportsFailure)
+{
+    RecordingConnection conn;
+    LMS7002M lms;
+    lms.SetConnection(&conn);
+    conn.status = -1;
+    LMS7002M_Transaction transaction(&lms);
+    EXPECT_EQ(0, lms.Modify_SPI_Reg_bits(TSGDCLDI_TXTSP, 1));
+    EXPECT_NE(0, transaction.Commit());
+}